@@ -2,12 +2,35 @@
 #include <string>
 #include <emscripten/console.h>
 #include "commands/commands.hpp"
+#include "lib/json.hpp"
+#include "lib/csv.hpp"
+#include "lib/encoding.hpp"
+#include "lib/hash.hpp"
+#include "lib/utf8.hpp"
+#include "lib/line_index.hpp"
+#include "lib/file_events.hpp"
+#include "lib/trigram_index.hpp"
+#include "lib/fts.hpp"
+#include "lib/path_index.hpp"
+#include "lib/tree_walk.hpp"
+#include "lib/compress.hpp"
+#include "lib/tar.hpp"
+#include "lib/zip.hpp"
+#include "lib/block_file.hpp"
+#include "lib/file_io.hpp"
+#include "lib/kv_store.hpp"
+#include "lib/btree.hpp"
+#include "lib/journal.hpp"
+#include "lib/cas.hpp"
+#include "lib/snapshot.hpp"
+#include <emscripten/eventloop.h>
 #include <fstream>
 #include <ios>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <cstring>
+#include <map>
 
 extern "C" {
     enum class KernelState {
@@ -21,9 +44,58 @@ extern "C" {
     int init() {
         emscripten_console_log("Kernel initializing...");
         emscripten_console_warn("This is an experimental WASM kernel");
+
+        // Finish the writes a reload cut short before anything reads them
+        std::string error;
+        if (!lib::journal_recover(error)) emscripten_console_error(error.c_str());
         return static_cast<int>(KernelState::RUNNING);
     }
 
+    // Group commit: journaled writes within one interval share a single
+    // log flush, and a queue past kJournalMaxPending flushes at once
+    static const size_t kJournalMaxPending = 4 * 1024 * 1024;
+    static double journal_interval_ms = 50;
+    static bool journal_timer = false;
+
+    static void journal_commit(void*) {
+        journal_timer = false;
+        lib::Journal* journal = lib::journal();
+        std::string error;
+        if (journal && !journal->commit(error)) emscripten_console_error(error.c_str());
+    }
+
+    static void journal_queued(lib::Journal* journal) {
+        if (journal_interval_ms <= 0 || journal->stats().pending_bytes >= kJournalMaxPending) {
+            journal_commit(nullptr);
+        } else if (!journal_timer) {
+            journal_timer = true;
+            emscripten_set_timeout(journal_commit, journal_interval_ms, nullptr);
+        }
+    }
+
+    // Exports that reach the FS directly apply the queue first, so they
+    // neither read a file's old content nor have what they write replaced
+    // by an older queued write
+    static void journal_flush() {
+        if (lib::journal()) journal_commit(nullptr);
+    }
+
+    // Members of a mounted zip are inflated on their own. True if `path`
+    // lies in a mount, with the member in `content` or, when it is missing
+    // or cannot be extracted, `error` set.
+    static bool read_mounted(const char* path, std::string& content, std::string& error) {
+        std::string member;
+        lib::ZipArchive* archive = lib::zip_lookup(path, member);
+        if (!archive) return false;
+        const lib::ZipEntry* entry = archive->find(member);
+        if (!entry) {
+            error = "Failed to open file for reading";
+        } else if (!archive->extract(*entry, content, error) && error.empty()) {
+            error = "Failed to read file";
+        }
+        return true;
+    }
+
     // Get kernel version
     EMSCRIPTEN_KEEPALIVE
     const char* get_version() {
@@ -38,6 +110,7 @@ extern "C" {
         if (command && *command) {  // Check if command is valid and not empty
             // emscripten_console_log(command);
             std::string cmd(command);  // Create a proper C++ string
+            journal_flush();
             return commands::execute_command(cmd);
         }
         emscripten_console_error("Empty or invalid command");
@@ -47,15 +120,28 @@ extern "C" {
     // Write file to emscripten virtual filesystem
     EMSCRIPTEN_KEEPALIVE
     int write_file(const char* path, const char* content) {
+        // Zip mounts are read-only
+        std::string member;
+        if (lib::zip_lookup(path, member)) {
+            emscripten_console_error("Cannot write to a read-only zip mount");
+            return -1;
+        }
+
+        if (lib::Journal* journal = lib::journal()) {
+            journal->write(path, content, strlen(content));
+            journal_queued(journal);
+            emscripten_console_log("File written successfully");
+            return 0;
+        }
+
         try {
-            std::ofstream file(path, std::ios::binary);
-            if (!file.is_open()) {
+            // Block-compressed when the directory's policy asks for it
+            std::string error;
+            if (!lib::store_file(path, content, strlen(content), error)) {
                 emscripten_console_error("Failed to open file for writing");
                 return -1;
             }
-            
-            file.write(content, strlen(content));
-            file.close();
+            lib::file_changed(path);
             
             emscripten_console_log("File written successfully");
             return 0;
@@ -68,30 +154,59 @@ extern "C" {
     // Read file from emscripten virtual filesystem
     EMSCRIPTEN_KEEPALIVE
     char* read_file(const char* path) {
+        // A journaled write not yet committed
+        const std::string* queued;
+        if (lib::journal() && lib::journal()->queued(path, queued)) {
+            if (!queued) {
+                emscripten_console_error("Failed to open file for reading");
+                return nullptr;
+            }
+            return strdup(queued->c_str());
+        }
+
+        std::string content, error;
+        if (read_mounted(path, content, error)) {
+            if (!error.empty()) {
+                emscripten_console_error(error.c_str());
+                return nullptr;
+            }
+            char* buffer = (char*)malloc(content.size() + 1);
+            if (!buffer) {
+                emscripten_console_error("Failed to allocate memory");
+                return nullptr;
+            }
+            memcpy(buffer, content.data(), content.size());
+            buffer[content.size()] = '\0';
+            return buffer;
+        }
+
         try {
-            std::ifstream file(path, std::ios::binary | std::ios::ate);
-            if (!file.is_open()) {
+            lib::BlockReader reader;
+            std::string error;
+            if (!reader.open(path, error)) {
                 emscripten_console_error("Failed to open file for reading");
                 return nullptr;
             }
 
-            auto size = file.tellg();
-            file.seekg(0, std::ios::beg);
+            size_t size = static_cast<size_t>(reader.size());
 
             // Allocate memory that will be freed by JavaScript
-            char* buffer = (char*)malloc(static_cast<size_t>(size) + 1);
+            char* buffer = (char*)malloc(size + 1);
             if (!buffer) {
                 emscripten_console_error("Failed to allocate memory");
                 return nullptr;
             }
 
-            if (!file.read(buffer, size)) {
+            if (!reader.read(0, size, buffer, error)) {
                 free(buffer);
                 emscripten_console_error("Failed to read file");
                 return nullptr;
             }
 
             buffer[size] = '\0';
+            if (!lib::utf8_validate(buffer, size)) {
+                emscripten_console_warn("File is not valid UTF-8");
+            }
             return buffer;
         } catch (const std::exception& e) {
             emscripten_console_error(e.what());
@@ -99,9 +214,58 @@ extern "C" {
         }
     }
 
+    // Read a UTF-8 text file as UTF-16 for JavaScript's UTF16ToString, which
+    // skips the byte-by-byte decode a char* return goes through. Stores the
+    // unit count in `out_len` when given; nullptr if the file cannot be read
+    // or is not valid UTF-8.
+    EMSCRIPTEN_KEEPALIVE
+    char16_t* read_text(const char* path, size_t* out_len) {
+        journal_flush();
+        std::string content, error;
+        if (read_mounted(path, content, error)) {
+            if (!error.empty()) {
+                emscripten_console_error(error.c_str());
+                return nullptr;
+            }
+        } else {
+            lib::BlockReader reader;
+            if (!reader.open(path, error)) {
+                emscripten_console_error("Failed to open file for reading");
+                return nullptr;
+            }
+            if (!reader.read(0, static_cast<size_t>(reader.size()), content, error)) {
+                emscripten_console_error("Failed to read file");
+                return nullptr;
+            }
+        }
+
+        if (!lib::utf8_validate(content.data(), content.size())) {
+            emscripten_console_error("File is not valid UTF-8");
+            return nullptr;
+        }
+
+        size_t units = lib::utf16_length_from_utf8(content.data(), content.size());
+        char16_t* buffer = (char16_t*)malloc((units + 1) * sizeof(char16_t));
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory");
+            return nullptr;
+        }
+
+        lib::utf8_to_utf16(content.data(), content.size(), buffer);
+        buffer[units] = 0;
+        if (out_len) *out_len = units;
+        return buffer;
+    }
+
     // Check if file exists
     EMSCRIPTEN_KEEPALIVE
     int file_exists(const char* path) {
+        std::string member;
+        if (lib::ZipArchive* archive = lib::zip_lookup(path, member)) {
+            return archive->find(member) || archive->is_directory(member) ? 1 : 0;
+        }
+        const std::string* queued;
+        if (lib::journal() && lib::journal()->queued(path, queued)) return queued ? 1 : 0;
         struct stat st;
         return stat(path, &st) == 0 ? 1 : 0;
     }
@@ -109,7 +273,27 @@ extern "C" {
     // Delete file
     EMSCRIPTEN_KEEPALIVE
     int delete_file(const char* path) {
+        std::string member;
+        if (lib::zip_lookup(path, member)) {
+            emscripten_console_error("Cannot delete from a read-only zip mount");
+            return -1;
+        }
+
+        if (lib::Journal* journal = lib::journal()) {
+            const std::string* queued = nullptr;
+            struct stat st;
+            if (journal->queued(path, queued) ? queued != nullptr : stat(path, &st) == 0 && !S_ISDIR(st.st_mode)) {
+                journal->remove(path);
+                journal_queued(journal);
+                emscripten_console_log("File deleted successfully");
+                return 0;
+            }
+            emscripten_console_error("Failed to delete file");
+            return -1;
+        }
+
         if (remove(path) == 0) {
+            lib::file_removed(path);
             emscripten_console_log("File deleted successfully");
             return 0;
         } else {
@@ -121,6 +305,22 @@ extern "C" {
     // List files in a directory
     EMSCRIPTEN_KEEPALIVE
     char* list_directory(const char* path) {
+        journal_flush();
+        std::string member;
+        if (lib::ZipArchive* archive = lib::zip_lookup(path, member)) {
+            std::vector<std::string> children;
+            if (!archive->list(member, children)) {
+                emscripten_console_error("Failed to open directory");
+                return nullptr;
+            }
+            std::string result;
+            for (const std::string& child : children) {
+                result += child.back() == '/' ? child.substr(0, child.size() - 1) : child;
+                result += "\n";
+            }
+            return strdup(result.c_str());
+        }
+
         DIR* dir = opendir(path);
         if (!dir) {
             emscripten_console_error("Failed to open directory");
@@ -147,4 +347,1212 @@ extern "C" {
         strcpy(buffer, result.c_str());
         return buffer;
     }
-} 
\ No newline at end of file
+
+    // Return `count` lines starting at 1-based line `start`, each with its
+    // newline, through the file's saved line index. Stores the file's total
+    // line count in `total_lines` when given. The string must be freed by
+    // JavaScript; nullptr if the file cannot be read.
+    EMSCRIPTEN_KEEPALIVE
+    char* line_range(const char* path, size_t start, size_t count, size_t* total_lines) {
+        journal_flush();
+        std::string text, content, error;
+        uint64_t lines = 0;
+        if (read_mounted(path, content, error)) {
+            // A zip member has no saved index; its lines are counted whole
+            if (!error.empty()) {
+                emscripten_console_error(error.c_str());
+                return nullptr;
+            }
+            for (size_t pos = 0; pos < content.size(); ++lines) {
+                size_t nl = content.find('\n', pos);
+                size_t next = nl == std::string::npos ? content.size() : nl + 1;
+                if (start > 0 && lines >= start - 1 && lines - (start - 1) < count) text.append(content, pos, next - pos);
+                pos = next;
+            }
+        } else {
+            lib::LineIndex index;
+            if (!index.open(path, error)) {
+                emscripten_console_error(error.c_str());
+                return nullptr;
+            }
+            if (start > 0 && !index.read_lines(start - 1, count, text, error)) {
+                emscripten_console_error(error.c_str());
+                return nullptr;
+            }
+            lines = index.line_count();
+        }
+
+        char* buffer = (char*)malloc(text.size() + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for lines");
+            return nullptr;
+        }
+
+        memcpy(buffer, text.data(), text.size());
+        buffer[text.size()] = '\0';
+        if (total_lines) *total_lines = static_cast<size_t>(lines);
+        return buffer;
+    }
+
+    // Query a JSON document in WASM memory with a path such as `.items[3].name`.
+    // Returns the matching values' JSON text, one per line, in memory that
+    // JavaScript must free; nullptr on error.
+    EMSCRIPTEN_KEEPALIVE
+    char* json_query(const char* buf, size_t len, const char* expr) {
+        lib::JsonDocument document;
+        std::vector<std::string_view> results;
+        std::string error;
+        if (!buf || !expr || !document.index(buf, len, error) || !document.query(expr, results, error)) {
+            emscripten_console_error(error.empty() ? "Invalid JSON query" : error.c_str());
+            return nullptr;
+        }
+
+        std::string result;
+        for (std::string_view value : results) {
+            result.append(value.data(), value.size());
+            result += "\n";
+        }
+
+        char* buffer = (char*)malloc(result.size() + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for query results");
+            return nullptr;
+        }
+
+        memcpy(buffer, result.c_str(), result.size() + 1);
+        return buffer;
+    }
+
+    // Run a record program (see lib::FieldProgram) over CSV in WASM memory,
+    // e.g. `where $status >= 400 count by $host`. Returns the output text in
+    // memory that JavaScript must free; nullptr on error.
+    EMSCRIPTEN_KEEPALIVE
+    char* csv_scan(const char* buf, size_t len, char delim, int header, const char* program) {
+        lib::FieldProgram parsed;
+        std::string error;
+        if (!buf || !program || !lib::parse_program(program, parsed, error)) {
+            emscripten_console_error(error.empty() ? "Invalid CSV program" : error.c_str());
+            return nullptr;
+        }
+
+        std::string result;
+        lib::CsvQuery query(parsed, delim ? delim : ',', header != 0, [&result](std::string_view text) {
+            result.append(text.data(), text.size());
+        });
+        query.feed(buf, len, true, error);
+        if (!error.empty()) {
+            emscripten_console_error(error.c_str());
+            return nullptr;
+        }
+        query.finish();
+
+        char* buffer = (char*)malloc(result.size() + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for scan results");
+            return nullptr;
+        }
+
+        memcpy(buffer, result.c_str(), result.size() + 1);
+        return buffer;
+    }
+
+    // Encode `len` bytes at `buf` as base64. Returns a NUL-terminated string
+    // that JavaScript must free; nullptr on allocation failure.
+    EMSCRIPTEN_KEEPALIVE
+    char* base64_encode(const uint8_t* buf, size_t len) {
+        char* buffer = (char*)malloc(lib::base64_encoded_size(len) + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for base64 output");
+            return nullptr;
+        }
+
+        buffer[lib::base64_encode(buf, len, buffer)] = '\0';
+        return buffer;
+    }
+
+    // Decode `len` characters of base64 (whitespace allowed). Returns bytes
+    // that JavaScript must free and stores their count in `out_len`;
+    // nullptr on invalid input.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* base64_decode(const char* str, size_t len, size_t* out_len) {
+        std::string decoded;
+        lib::Base64Decoder decoder;
+        if (!decoder.update(str, len, decoded) || !decoder.finish(decoded)) {
+            emscripten_console_error("Invalid base64 input");
+            return nullptr;
+        }
+
+        uint8_t* buffer = (uint8_t*)malloc(decoded.size() + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for decoded data");
+            return nullptr;
+        }
+
+        memcpy(buffer, decoded.data(), decoded.size());
+        if (out_len) *out_len = decoded.size();
+        return buffer;
+    }
+
+    // Encode `len` bytes at `buf` as lowercase hex. Returns a NUL-terminated
+    // string that JavaScript must free.
+    EMSCRIPTEN_KEEPALIVE
+    char* hex_encode(const uint8_t* buf, size_t len) {
+        char* buffer = (char*)malloc(len * 2 + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for hex output");
+            return nullptr;
+        }
+
+        lib::hex_encode(buf, len, buffer);
+        buffer[len * 2] = '\0';
+        return buffer;
+    }
+
+    // Decode `len` hex digits. Returns bytes that JavaScript must free and
+    // stores their count in `out_len`; nullptr on invalid input.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* hex_decode(const char* str, size_t len, size_t* out_len) {
+        uint8_t* buffer = (uint8_t*)malloc(len / 2 + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for decoded data");
+            return nullptr;
+        }
+
+        if (!lib::hex_decode(str, len, buffer)) {
+            free(buffer);
+            emscripten_console_error("Invalid hex input");
+            return nullptr;
+        }
+
+        if (out_len) *out_len = len / 2;
+        return buffer;
+    }
+
+    // Open streaming digests, keyed by the handle given to JavaScript
+    static std::map<int, lib::Hasher*> hashers;
+    static int next_hasher = 1;
+
+    // Start a digest: "sha256", "blake3", "xxh3" or "crc32c". Returns a
+    // handle for hash_update/hash_final, or -1 for an unknown algorithm.
+    EMSCRIPTEN_KEEPALIVE
+    int hash_init(const char* algorithm) {
+        lib::Hasher::Algorithm parsed;
+        if (!algorithm || !lib::Hasher::parse(algorithm, parsed)) {
+            emscripten_console_error("Unknown hash algorithm");
+            return -1;
+        }
+
+        int handle = next_hasher++;
+        hashers[handle] = new lib::Hasher(parsed);
+        return handle;
+    }
+
+    // Feed `len` bytes at `buf` into an open digest
+    EMSCRIPTEN_KEEPALIVE
+    int hash_update(int handle, const uint8_t* buf, size_t len) {
+        auto it = hashers.find(handle);
+        if (it == hashers.end()) {
+            emscripten_console_error("Invalid hash handle");
+            return -1;
+        }
+
+        it->second->update(buf, len);
+        return 0;
+    }
+
+    // Finish a digest and release its handle. Returns the digest as a
+    // lowercase hex string that JavaScript must free.
+    EMSCRIPTEN_KEEPALIVE
+    char* hash_final(int handle) {
+        auto it = hashers.find(handle);
+        if (it == hashers.end()) {
+            emscripten_console_error("Invalid hash handle");
+            return nullptr;
+        }
+
+        std::string digest = it->second->hex_digest();
+        delete it->second;
+        hashers.erase(it);
+
+        char* buffer = (char*)malloc(digest.size() + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for digest");
+            return nullptr;
+        }
+
+        memcpy(buffer, digest.c_str(), digest.size() + 1);
+        return buffer;
+    }
+
+    // Return 1 if `len` bytes at `buf` are well-formed UTF-8, 0 otherwise
+    EMSCRIPTEN_KEEPALIVE
+    int utf8_validate(const char* buf, size_t len) {
+        return lib::utf8_validate(buf, len) ? 1 : 0;
+    }
+
+    // Transcode UTF-8 to NUL-terminated UTF-16 that JavaScript must free,
+    // storing the unit count in `out_len`; nullptr on invalid UTF-8.
+    EMSCRIPTEN_KEEPALIVE
+    char16_t* utf8_to_utf16(const char* buf, size_t len, size_t* out_len) {
+        if (!lib::utf8_validate(buf, len)) {
+            emscripten_console_error("Invalid UTF-8 input");
+            return nullptr;
+        }
+
+        size_t units = lib::utf16_length_from_utf8(buf, len);
+        char16_t* buffer = (char16_t*)malloc((units + 1) * sizeof(char16_t));
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for UTF-16 output");
+            return nullptr;
+        }
+
+        lib::utf8_to_utf16(buf, len, buffer);
+        buffer[units] = 0;
+        if (out_len) *out_len = units;
+        return buffer;
+    }
+
+    // Transcode `len` UTF-16 units to NUL-terminated UTF-8 that JavaScript
+    // must free, storing the byte count in `out_len`; nullptr on an unpaired
+    // surrogate.
+    EMSCRIPTEN_KEEPALIVE
+    char* utf16_to_utf8(const char16_t* buf, size_t len, size_t* out_len) {
+        char* buffer = (char*)malloc(lib::utf8_length_from_utf16(buf, len) + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for UTF-8 output");
+            return nullptr;
+        }
+
+        size_t written = 0;
+        if (!lib::utf16_to_utf8(buf, len, buffer, written)) {
+            free(buffer);
+            emscripten_console_error("Invalid UTF-16 input");
+            return nullptr;
+        }
+
+        buffer[written] = '\0';
+        if (out_len) *out_len = written;
+        return buffer;
+    }
+
+    // Transcode UTF-8 to Latin-1 bytes that JavaScript must free, storing
+    // the count in `out_len`; nullptr on invalid UTF-8 or a character above
+    // U+00FF.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* utf8_to_latin1(const char* buf, size_t len, size_t* out_len) {
+        if (!lib::utf8_validate(buf, len)) {
+            emscripten_console_error("Invalid UTF-8 input");
+            return nullptr;
+        }
+
+        uint8_t* buffer = (uint8_t*)malloc(len + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for Latin-1 output");
+            return nullptr;
+        }
+
+        size_t written = 0;
+        if (!lib::utf8_to_latin1(buf, len, buffer, written)) {
+            free(buffer);
+            emscripten_console_error("Input is not representable in Latin-1");
+            return nullptr;
+        }
+
+        if (out_len) *out_len = written;
+        return buffer;
+    }
+
+    // Transcode Latin-1 to NUL-terminated UTF-8 that JavaScript must free,
+    // storing the byte count in `out_len`.
+    EMSCRIPTEN_KEEPALIVE
+    char* latin1_to_utf8(const uint8_t* buf, size_t len, size_t* out_len) {
+        size_t size = lib::utf8_length_from_latin1(buf, len);
+        char* buffer = (char*)malloc(size + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for UTF-8 output");
+            return nullptr;
+        }
+
+        lib::latin1_to_utf8(buf, len, buffer);
+        buffer[size] = '\0';
+        if (out_len) *out_len = size;
+        return buffer;
+    }
+
+    // Build (or rebuild) the substring search index over every file under
+    // `root`. Later write_file/delete_file calls keep it up to date.
+    EMSCRIPTEN_KEEPALIVE
+    int search_build(const char* root) {
+        journal_flush();
+        std::string error;
+        if (!root || !lib::build_search_index(root, error)) {
+            emscripten_console_error(error.empty() ? "Invalid search root" : error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // Find `query` in the indexed files. Returns "path:line:text" for each
+    // matching line, or just each matching path when `files_only` is set,
+    // in memory that JavaScript must free; nullptr without an index.
+    EMSCRIPTEN_KEEPALIVE
+    char* search_query(const char* query, int ignore_case, int files_only) {
+        journal_flush();
+        lib::TrigramIndex* index = lib::search_index();
+        if (!index || !query) {
+            emscripten_console_error("No search index; call search_build first");
+            return nullptr;
+        }
+
+        std::string result;
+        std::string last_path;
+        index->search(query, ignore_case != 0, [&](const std::string& path, size_t line, std::string_view text) {
+            if (files_only) {
+                if (path == last_path) return;
+                last_path = path;
+                result += path + "\n";
+                return;
+            }
+            result += path + ":" + std::to_string(line) + ":";
+            result.append(text.data(), text.size());
+            result += "\n";
+        });
+
+        char* buffer = (char*)malloc(result.size() + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for search results");
+            return nullptr;
+        }
+
+        memcpy(buffer, result.c_str(), result.size() + 1);
+        return buffer;
+    }
+
+    // Add or replace the document `key` with `len` bytes of text. Documents
+    // are buffered in memory and saved by index_commit or the next query.
+    EMSCRIPTEN_KEEPALIVE
+    int index_add(const char* key, const char* text, size_t len) {
+        std::string error;
+        if (!key || (!text && len > 0)) {
+            emscripten_console_error("Invalid document");
+            return -1;
+        }
+        if (!lib::fts_index()->add(key, std::string_view(text ? text : "", len), error)) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // Remove the document `key`; -1 if it is not indexed
+    EMSCRIPTEN_KEEPALIVE
+    int index_remove(const char* key) {
+        return key && lib::fts_index()->remove(key) ? 0 : -1;
+    }
+
+    // Save buffered documents and removals as index segments
+    EMSCRIPTEN_KEEPALIVE
+    int index_commit() {
+        std::string error;
+        if (!lib::fts_index()->commit(error)) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // Rank documents against the words in `query` by BM25. Returns up to
+    // `limit` "score\tkey" lines, best first, in memory that JavaScript must
+    // free; nullptr on error.
+    EMSCRIPTEN_KEEPALIVE
+    char* index_query(const char* query, int limit) {
+        std::string error;
+        std::vector<lib::FtsIndex::Hit> hits = lib::fts_index()->query(query ? query : "", limit > 0 ? limit : 0, error);
+        if (!error.empty()) {
+            emscripten_console_error(error.c_str());
+            return nullptr;
+        }
+
+        std::string result;
+        char score[32];
+        for (const lib::FtsIndex::Hit& hit : hits) {
+            snprintf(score, sizeof(score), "%.4f\t", hit.score);
+            result += score + hit.key + "\n";
+        }
+
+        char* buffer = (char*)malloc(result.size() + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for query results");
+            return nullptr;
+        }
+
+        memcpy(buffer, result.c_str(), result.size() + 1);
+        return buffer;
+    }
+
+    // Fuzzy-match `query` against every file path, as fzf does. Returns up
+    // to `limit` "score\tpath" lines, best first, in memory that JavaScript
+    // must free. The path index is built on first use and then follows
+    // write_file and delete_file.
+    EMSCRIPTEN_KEEPALIVE
+    char* find_fuzzy(const char* query, int limit) {
+        journal_flush();
+        std::string result;
+        for (const lib::PathIndex::Match& match : lib::path_index()->find(query ? query : "", limit > 0 ? limit : 0)) {
+            result += std::to_string(match.score) + "\t" + match.path + "\n";
+        }
+
+        char* buffer = (char*)malloc(result.size() + 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for fuzzy matches");
+            return nullptr;
+        }
+
+        memcpy(buffer, result.c_str(), result.size() + 1);
+        return buffer;
+    }
+
+    // Walk everything under `root` that passes find-style `predicates`
+    // (-name, -type, -size, -newer) in one call. Returns packed little-endian
+    // records, sorted by path, of u64 size, i64 mtime in milliseconds, u32
+    // path length, u8 type ('f', 'd', 'l' or 'o') and the path bytes, in
+    // memory that JavaScript must free; stores the byte count in `out_len`.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* walk_tree(const char* root, const char* predicates, size_t* out_len) {
+        journal_flush();
+        lib::WalkFilter filter;
+        std::vector<lib::WalkEntry> matches;
+        lib::WalkTotals totals;
+        std::string error;
+        std::vector<std::string> args = commands::split_args(predicates ? predicates : "");
+        if (!root || !lib::parse_walk_filter(args, 0, filter, error) || !lib::walk_tree(root, filter, &matches, totals, error)) {
+            emscripten_console_error(error.empty() ? "Invalid walk root" : error.c_str());
+            return nullptr;
+        }
+
+        static const size_t kRecordHeader = 8 + 8 + 4 + 1;
+        size_t size = 0;
+        for (const lib::WalkEntry& entry : matches) size += kRecordHeader + entry.path.size();
+
+        uint8_t* buffer = (uint8_t*)malloc(size ? size : 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for walk records");
+            return nullptr;
+        }
+
+        uint8_t* out = buffer;
+        for (const lib::WalkEntry& entry : matches) {
+            int64_t mtime_ms = entry.mtime / 1000000;
+            uint32_t path_len = static_cast<uint32_t>(entry.path.size());
+            memcpy(out, &entry.size, 8);
+            memcpy(out + 8, &mtime_ms, 8);
+            memcpy(out + 16, &path_len, 4);
+            out[20] = static_cast<uint8_t>(entry.type);
+            memcpy(out + kRecordHeader, entry.path.data(), path_len);
+            out += kRecordHeader + path_len;
+        }
+        if (out_len) *out_len = size;
+        return buffer;
+    }
+
+    // Open streaming compressors and decompressors, keyed by handle
+    static std::map<int, lib::Compressor*> compressors;
+    static std::map<int, lib::Decompressor*> decompressors;
+    static int next_codec = 1;
+
+    // Hand codec output to JavaScript in a buffer it must free
+    static uint8_t* codec_output(const std::string& data, size_t* out_len) {
+        uint8_t* buffer = (uint8_t*)malloc(data.size() ? data.size() : 1);
+        if (!buffer) {
+            emscripten_console_error("Failed to allocate memory for codec output");
+            return nullptr;
+        }
+
+        memcpy(buffer, data.data(), data.size());
+        if (out_len) *out_len = data.size();
+        return buffer;
+    }
+
+    // Start compressing with "lz4", "zstd" or "gzip" at `level` (0 for
+    // the codec's default). zstd uses the `dict_len` bytes at `dict` as its
+    // dictionary, raw or trained. Returns a handle for
+    // compress_update/compress_end, or -1 for an unknown codec.
+    EMSCRIPTEN_KEEPALIVE
+    int compress_begin(const char* codec, int level, const uint8_t* dict, size_t dict_len) {
+        lib::Compressor::Codec parsed;
+        if (!codec || !lib::Compressor::parse(codec, parsed)) {
+            emscripten_console_error("Unknown compression codec");
+            return -1;
+        }
+
+        std::string dictionary = dict ? std::string(reinterpret_cast<const char*>(dict), dict_len) : std::string();
+        int handle = next_codec++;
+        compressors[handle] = new lib::Compressor(parsed, level, dictionary);
+        return handle;
+    }
+
+    // Compress `len` more bytes at `buf`. Returns whatever compressed
+    // output is ready (often nothing until a block fills), in memory that
+    // JavaScript must free; stores its length in `out_len`.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* compress_update(int handle, const uint8_t* buf, size_t len, size_t* out_len) {
+        auto it = compressors.find(handle);
+        if (it == compressors.end()) {
+            emscripten_console_error("Invalid compression handle");
+            return nullptr;
+        }
+
+        std::string out;
+        it->second->update(buf, len, out);
+        return codec_output(out, out_len);
+    }
+
+    // Finish the frame and release the handle. Returns the remaining
+    // output, in memory that JavaScript must free.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* compress_end(int handle, size_t* out_len) {
+        auto it = compressors.find(handle);
+        if (it == compressors.end()) {
+            emscripten_console_error("Invalid compression handle");
+            return nullptr;
+        }
+
+        std::string out;
+        it->second->finish(out);
+        delete it->second;
+        compressors.erase(it);
+        return codec_output(out, out_len);
+    }
+
+    // Start decompressing LZ4, zstd or gzip data, told apart by its magic.
+    // Returns a handle for decompress_update/decompress_end.
+    EMSCRIPTEN_KEEPALIVE
+    int decompress_begin(const uint8_t* dict, size_t dict_len) {
+        std::string dictionary = dict ? std::string(reinterpret_cast<const char*>(dict), dict_len) : std::string();
+        int handle = next_codec++;
+        decompressors[handle] = new lib::Decompressor(dictionary);
+        return handle;
+    }
+
+    // Decompress `len` more bytes at `buf`. Returns the output decoded so
+    // far, in memory that JavaScript must free, or null if the input is
+    // corrupt.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* decompress_update(int handle, const uint8_t* buf, size_t len, size_t* out_len) {
+        auto it = decompressors.find(handle);
+        if (it == decompressors.end()) {
+            emscripten_console_error("Invalid decompression handle");
+            return nullptr;
+        }
+
+        std::string out, error;
+        if (!it->second->update(buf, len, out, error)) {
+            emscripten_console_error(error.c_str());
+            return nullptr;
+        }
+        return codec_output(out, out_len);
+    }
+
+    // Release the handle. Returns 0 if the input ended cleanly after a
+    // complete frame, -1 if it was truncated.
+    EMSCRIPTEN_KEEPALIVE
+    int decompress_end(int handle) {
+        auto it = decompressors.find(handle);
+        if (it == decompressors.end()) {
+            emscripten_console_error("Invalid decompression handle");
+            return -1;
+        }
+
+        std::string error;
+        bool ok = it->second->finish(error);
+        delete it->second;
+        decompressors.erase(it);
+        if (!ok) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // Compress `len` bytes at `buf` into a gzip file at `level` (1-9, 0
+    // for 6), using worker threads where available. Returns memory that
+    // JavaScript must free and stores its length in `out_len`.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* gzip(const uint8_t* buf, size_t len, int level, size_t* out_len) {
+        lib::GzipEncoder encoder(level ? level : 6);
+        std::string out;
+        encoder.update(buf, len, out);
+        encoder.finish(out);
+        return codec_output(out, out_len);
+    }
+
+    // Decompress the gzip file (one or more members) of `len` bytes at
+    // `buf`. Returns memory that JavaScript must free, or null if the data
+    // is corrupt or truncated.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* gunzip(const uint8_t* buf, size_t len, size_t* out_len) {
+        lib::GzipDecoder decoder;
+        std::string out, error;
+        if (!decoder.update(buf, len, out, error) || !decoder.finish(error)) {
+            emscripten_console_error(error.c_str());
+            return nullptr;
+        }
+        return codec_output(out, out_len);
+    }
+
+    // Unpack the tar archive (plain or gzip-compressed) of `len` bytes at
+    // `buf` into `dest`, which is created if missing. Returns the number of
+    // members unpacked, or -1 on error.
+    EMSCRIPTEN_KEEPALIVE
+    int tar_extract(const uint8_t* buf, size_t len, const char* dest) {
+        journal_flush();
+        if (!dest || !*dest) {
+            emscripten_console_error("Invalid destination");
+            return -1;
+        }
+        mkdir(dest, 0755);
+
+        // Fed in slices so that files are written while the rest decodes
+        static const size_t kSlice = 1024 * 1024;
+        lib::TarExtractor extractor(dest);
+        std::string error;
+        bool ok = true;
+        for (size_t offset = 0; ok && offset < len; offset += kSlice) {
+            ok = extractor.update(buf + offset, len - offset < kSlice ? len - offset : kSlice, error);
+        }
+        if (!ok || !extractor.finish(error)) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return static_cast<int>(extractor.members());
+    }
+
+    // Mount the zip at `archive` read-only on the absolute directory `dir`:
+    // only its central directory is read, and read_file, list_directory,
+    // file_exists, ls and cat then inflate single members on demand.
+    // Returns 0, or -1 if the archive cannot be read.
+    EMSCRIPTEN_KEEPALIVE
+    int zip_mount(const char* archive, const char* dir) {
+        journal_flush();
+        std::string error;
+        if (!archive || !dir || !lib::zip_mount(archive, dir, error)) {
+            emscripten_console_error(error.empty() ? "Invalid arguments" : error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int zip_unmount(const char* dir) {
+        return dir && lib::zip_unmount(dir) ? 0 : -1;
+    }
+
+    static std::map<int, lib::ZipArchive*> zip_archives;
+    static int next_zip = 1;
+
+    // Open a zip for reading single members without mounting it; returns a
+    // handle for zip_read and zip_close, or -1
+    EMSCRIPTEN_KEEPALIVE
+    int zip_open(const char* path) {
+        journal_flush();
+        lib::ZipArchive* archive = new lib::ZipArchive();
+        std::string error;
+        if (!path || !archive->open(path, error)) {
+            delete archive;
+            emscripten_console_error(error.empty() ? "Invalid path" : error.c_str());
+            return -1;
+        }
+        int handle = next_zip++;
+        zip_archives[handle] = archive;
+        return handle;
+    }
+
+    // Inflate member `name` of an open zip. Returns memory that JavaScript
+    // must free and stores its length in `out_len`; null if the member is
+    // missing or corrupt.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* zip_read(int handle, const char* name, size_t* out_len) {
+        auto it = zip_archives.find(handle);
+        if (it == zip_archives.end() || !name) {
+            emscripten_console_error("Invalid handle");
+            return nullptr;
+        }
+        const lib::ZipEntry* entry = it->second->find(name);
+        if (!entry) {
+            emscripten_console_error("No such member");
+            return nullptr;
+        }
+        std::string out, error;
+        if (!it->second->extract(*entry, out, error)) {
+            emscripten_console_error(error.c_str());
+            return nullptr;
+        }
+        return codec_output(out, out_len);
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int zip_close(int handle) {
+        auto it = zip_archives.find(handle);
+        if (it == zip_archives.end()) return -1;
+        delete it->second;
+        zip_archives.erase(it);
+        return 0;
+    }
+
+    // Store files written under `dir` (and directories below it without a
+    // policy of their own) block-compressed when `enabled`, or plain.
+    // Existing files keep their form until rewritten.
+    EMSCRIPTEN_KEEPALIVE
+    int set_compression(const char* dir, int enabled) {
+        journal_flush();
+        std::string error;
+        if (!dir || !lib::set_compression(dir, enabled != 0, error)) {
+            emscripten_console_error(error.empty() ? "Invalid directory" : error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // Read up to `len` bytes at `offset` of a plain or block-compressed
+    // file, decoding only the blocks that cover them. Returns memory that
+    // JavaScript must free and stores the length read in `out_len`; null
+    // if the file cannot be read.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* read_range(const char* path, size_t offset, size_t len, size_t* out_len) {
+        journal_flush();
+        std::string out, content, error;
+        if (path && read_mounted(path, content, error)) {
+            if (!error.empty()) {
+                emscripten_console_error(error.c_str());
+                return nullptr;
+            }
+            if (offset < content.size()) out.assign(content, offset, len);
+            return codec_output(out, out_len);
+        }
+        lib::BlockReader reader;
+        if (!path || !reader.open(path, error) || !reader.read(offset, len, out, error)) {
+            emscripten_console_error(error.empty() ? "Invalid arguments" : error.c_str());
+            return nullptr;
+        }
+        return codec_output(out, out_len);
+    }
+
+    static std::map<int, lib::KvStore*> kv_stores;
+    static int next_kv = 1;
+
+    // Open (creating if need be) the key-value store kept in `dir`; returns
+    // a handle for the other kv_ calls, or -1. Handles on the same
+    // directory share one store.
+    EMSCRIPTEN_KEEPALIVE
+    int kv_open(const char* dir) {
+        journal_flush();
+        std::string error;
+        lib::KvStore* store = dir ? lib::kv_store(dir, error) : nullptr;
+        if (!store) {
+            emscripten_console_error(error.empty() ? "Invalid directory" : error.c_str());
+            return -1;
+        }
+        int handle = next_kv++;
+        kv_stores[handle] = store;
+        return handle;
+    }
+
+    // The value stored under `key`. Returns memory that JavaScript must
+    // free and stores its length in `out_len`; null if the key is missing
+    // (with nothing logged) or on error.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* kv_get(int handle, const char* key, size_t* out_len) {
+        auto it = kv_stores.find(handle);
+        if (it == kv_stores.end() || !key) {
+            emscripten_console_error("Invalid handle");
+            return nullptr;
+        }
+        std::string value, error;
+        if (!it->second->get(key, value, error)) {
+            if (!error.empty()) emscripten_console_error(error.c_str());
+            return nullptr;
+        }
+        return codec_output(value, out_len);
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int kv_put(int handle, const char* key, const uint8_t* value, size_t len) {
+        auto it = kv_stores.find(handle);
+        if (it == kv_stores.end() || !key || (!value && len)) {
+            emscripten_console_error("Invalid handle");
+            return -1;
+        }
+        std::string error;
+        if (!it->second->put(key, std::string(reinterpret_cast<const char*>(value), len), error)) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int kv_delete(int handle, const char* key) {
+        auto it = kv_stores.find(handle);
+        if (it == kv_stores.end() || !key) {
+            emscripten_console_error("Invalid handle");
+            return -1;
+        }
+        std::string error;
+        if (!it->second->remove(key, error)) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // Up to `limit` pairs with start <= key < end, in key order; an empty
+    // `end` has no upper bound and a negative `limit` no limit. Returns
+    // memory that JavaScript must free, holding u32 key length, key, u32
+    // value length, value for each pair, and stores its length in
+    // `out_len`.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* kv_scan(int handle, const char* start, const char* end, int limit, size_t* out_len) {
+        auto it = kv_stores.find(handle);
+        if (it == kv_stores.end()) {
+            emscripten_console_error("Invalid handle");
+            return nullptr;
+        }
+        std::vector<std::pair<std::string, std::string>> pairs;
+        std::string error;
+        if (!it->second->scan(start ? start : "", end ? end : "", limit < 0 ? static_cast<size_t>(-1) : limit, pairs,
+                              error)) {
+            emscripten_console_error(error.c_str());
+            return nullptr;
+        }
+        std::string out;
+        for (const auto& pair : pairs) {
+            for (const std::string* part : {&pair.first, &pair.second}) {
+                lib::put32(out, static_cast<uint32_t>(part->size()));
+                out += *part;
+            }
+        }
+        return codec_output(out, out_len);
+    }
+
+    // Write out what the store holds in memory and drop the handle; the
+    // store itself stays open for other handles and the kv command
+    EMSCRIPTEN_KEEPALIVE
+    int kv_close(int handle) {
+        auto it = kv_stores.find(handle);
+        if (it == kv_stores.end()) return -1;
+        std::string error;
+        bool ok = it->second->flush(error);
+        kv_stores.erase(it);
+        if (!ok) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    static std::map<int, lib::BTree*> btrees;
+    static int next_btree = 1;
+    static std::map<int, lib::BTreeCursor> btree_cursors;
+    static int next_btree_cursor = 1;
+
+    // Open (creating if need be) the B+tree file at `path`; returns a
+    // handle for the other btree_ calls, or -1. Handles on the same file
+    // share one tree and buffer pool.
+    EMSCRIPTEN_KEEPALIVE
+    int btree_open(const char* path) {
+        journal_flush();
+        std::string error;
+        lib::BTree* tree = path ? lib::btree_file(path, error) : nullptr;
+        if (!tree) {
+            emscripten_console_error(error.empty() ? "Invalid path" : error.c_str());
+            return -1;
+        }
+        int handle = next_btree++;
+        btrees[handle] = tree;
+        return handle;
+    }
+
+    // The value stored under `key`. Returns memory that JavaScript must
+    // free and stores its length in `out_len`; null if the key is missing
+    // (with nothing logged) or on error.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* btree_get(int handle, const char* key, size_t* out_len) {
+        auto it = btrees.find(handle);
+        if (it == btrees.end() || !key) {
+            emscripten_console_error("Invalid handle");
+            return nullptr;
+        }
+        std::string value, error;
+        if (!it->second->get(key, value, error)) {
+            if (!error.empty()) emscripten_console_error(error.c_str());
+            return nullptr;
+        }
+        return codec_output(value, out_len);
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int btree_put(int handle, const char* key, const uint8_t* value, size_t len) {
+        auto it = btrees.find(handle);
+        if (it == btrees.end() || !key || (!value && len)) {
+            emscripten_console_error("Invalid handle");
+            return -1;
+        }
+        std::string error;
+        if (!it->second->put(key, std::string(reinterpret_cast<const char*>(value), len), error)) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // 0 if `key` was removed, 1 if it was not present, -1 on error
+    EMSCRIPTEN_KEEPALIVE
+    int btree_delete(int handle, const char* key) {
+        auto it = btrees.find(handle);
+        if (it == btrees.end() || !key) {
+            emscripten_console_error("Invalid handle");
+            return -1;
+        }
+        std::string error;
+        if (!it->second->remove(key, error)) {
+            if (error.empty()) return 1;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // Replace the tree's contents with the pairs packed in `buf` as u32
+    // key length, key, u32 value length, value, in key order, filling
+    // pages to `fill` (0.5 to 1.0). Returns the number of pairs, or -1.
+    EMSCRIPTEN_KEEPALIVE
+    int btree_load(int handle, const uint8_t* buf, size_t len, double fill) {
+        auto it = btrees.find(handle);
+        if (it == btrees.end() || (!buf && len)) {
+            emscripten_console_error("Invalid handle");
+            return -1;
+        }
+        size_t pos = 0;
+        int count = 0;
+        bool truncated = false;
+        auto field = [&](std::string& out) {
+            if (len - pos < 4) return false;
+            uint32_t size = lib::read32(buf + pos);
+            if (len - pos - 4 < size) return false;
+            out.assign(reinterpret_cast<const char*>(buf + pos + 4), size);
+            pos += 4 + size;
+            return true;
+        };
+        std::string error;
+        bool ok = it->second->bulk_load(
+            [&](std::string& key, std::string& value) {
+                if (pos == len) return false;
+                if (!field(key) || !field(value)) {
+                    truncated = true;
+                    return false;
+                }
+                ++count;
+                return true;
+            },
+            fill, error);
+        if (!ok || truncated) {
+            emscripten_console_error(truncated ? "Truncated pairs" : error.c_str());
+            return -1;
+        }
+        return count;
+    }
+
+    // A cursor over start <= key < end (no upper bound when `end` is
+    // empty or null) for btree_next; returns its handle, or -1
+    EMSCRIPTEN_KEEPALIVE
+    int btree_cursor(int handle, const char* start, const char* end) {
+        auto it = btrees.find(handle);
+        if (it == btrees.end()) {
+            emscripten_console_error("Invalid handle");
+            return -1;
+        }
+        int cursor = next_btree_cursor++;
+        btree_cursors[cursor] = it->second->scan(start ? start : "", end ? end : "");
+        return cursor;
+    }
+
+    // The cursor's next pair as u32 key length, key, u32 value length,
+    // value. Returns memory that JavaScript must free and stores its
+    // length in `out_len`; null at the end or on error.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* btree_next(int cursor, size_t* out_len) {
+        auto it = btree_cursors.find(cursor);
+        if (it == btree_cursors.end()) {
+            emscripten_console_error("Invalid cursor");
+            return nullptr;
+        }
+        std::string key, value, error;
+        if (!it->second.next(key, value, error)) {
+            if (!error.empty()) emscripten_console_error(error.c_str());
+            return nullptr;
+        }
+        std::string out;
+        for (const std::string* part : {&key, &value}) {
+            lib::put32(out, static_cast<uint32_t>(part->size()));
+            out += *part;
+        }
+        return codec_output(out, out_len);
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int btree_cursor_close(int cursor) {
+        return btree_cursors.erase(cursor) ? 0 : -1;
+    }
+
+    // Write the tree's dirty pages and drop the handle; the tree stays
+    // open for other handles, its cursors and the btree command
+    EMSCRIPTEN_KEEPALIVE
+    int btree_close(int handle) {
+        auto it = btrees.find(handle);
+        if (it == btrees.end()) return -1;
+        std::string error;
+        bool ok = it->second->flush(error);
+        btrees.erase(it);
+        if (!ok) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // Queue write_file and delete_file in the crash-safe journal, sharing
+    // one log flush among the writes of each `interval_ms` (0 flushes every
+    // write on its own). Replays what an interrupted session left first.
+    EMSCRIPTEN_KEEPALIVE
+    int journal_enable(double interval_ms) {
+        std::string error;
+        if (!lib::journal_enable(error)) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        journal_interval_ms = interval_ms;
+        return 0;
+    }
+
+    // Commit what is queued and go back to writing files directly
+    EMSCRIPTEN_KEEPALIVE
+    int journal_disable() {
+        std::string error;
+        if (!lib::journal_disable(error)) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // Commit the queued writes now instead of at the end of the interval
+    EMSCRIPTEN_KEEPALIVE
+    int journal_sync() {
+        lib::Journal* journal = lib::journal();
+        std::string error;
+        if (journal && !journal->commit(error)) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // Commit, then empty the log
+    EMSCRIPTEN_KEEPALIVE
+    int journal_checkpoint() {
+        lib::Journal* journal = lib::journal();
+        std::string error;
+        if (journal && (!journal->commit(error) || !journal->checkpoint(error))) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // Store `len` bytes as `name` in the deduplicating content store,
+    // replacing what was there. Returns the bytes of new chunks it had to
+    // keep (0 when every chunk was already stored), or -1.
+    EMSCRIPTEN_KEEPALIVE
+    double cas_put(const char* name, const uint8_t* buf, size_t len) {
+        std::string error;
+        lib::ContentStore* store = lib::content_store(error);
+        uint64_t added;
+        if (!store || !name || (!buf && len) || !store->put(name, buf, len, added, error)) {
+            emscripten_console_error(error.empty() ? "Invalid name" : error.c_str());
+            return -1;
+        }
+        return static_cast<double>(added);
+    }
+
+    // The content stored as `name`. Returns memory that JavaScript must
+    // free and stores its length in `out_len`; null if there is no `name`
+    // (with nothing logged) or on error.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* cas_get(const char* name, size_t* out_len) {
+        std::string error, content;
+        lib::ContentStore* store = lib::content_store(error);
+        if (!store || !name || !store->get(name, content, error)) {
+            if (!error.empty()) emscripten_console_error(error.c_str());
+            return nullptr;
+        }
+        return codec_output(content, out_len);
+    }
+
+    // "size\tchunks\tshared" for `name`, or for the whole store (empty or
+    // null `name`) "files\tbytes\tchunk refs\tdistinct chunks\tstored bytes".
+    // The string must be freed by JavaScript; nullptr if there is no `name`.
+    EMSCRIPTEN_KEEPALIVE
+    char* cas_stat(const char* name) {
+        std::string error;
+        lib::ContentStore* store = lib::content_store(error);
+        if (!store) {
+            emscripten_console_error(error.c_str());
+            return nullptr;
+        }
+        char line[160];
+        if (name && *name) {
+            lib::ContentStore::FileStat stat;
+            if (!store->stat(name, stat)) return nullptr;
+            snprintf(line, sizeof(line), "%llu\t%u\t%u", static_cast<unsigned long long>(stat.size), stat.chunks, stat.shared);
+        } else {
+            lib::ContentStore::Stats stats = store->stats();
+            snprintf(line, sizeof(line), "%llu\t%llu\t%llu\t%llu\t%llu", static_cast<unsigned long long>(stats.files),
+                     static_cast<unsigned long long>(stats.logical_bytes), static_cast<unsigned long long>(stats.chunk_refs),
+                     static_cast<unsigned long long>(stats.chunks), static_cast<unsigned long long>(stats.stored_bytes));
+        }
+        return strdup(line);
+    }
+
+    // Serialize the tree under `root` into one image for fs_restore, with
+    // each file LZ4-compressed when `compress` and it shrinks. Returns
+    // memory that JavaScript must free and stores its length in `out_len`;
+    // null on error.
+    EMSCRIPTEN_KEEPALIVE
+    uint8_t* fs_snapshot(const char* root, int compress, size_t* out_len) {
+        journal_flush();
+        std::string image, error;
+        if (!root || !lib::fs_snapshot(root, compress != 0, image, error)) {
+            emscripten_console_error(error.empty() ? "Invalid root" : error.c_str());
+            return nullptr;
+        }
+        return codec_output(image, out_len);
+    }
+
+    // Recreate the tree in the image of `len` bytes at `buf` under `root`
+    // in one call. Returns the number of entries restored, or -1.
+    EMSCRIPTEN_KEEPALIVE
+    int fs_restore(const uint8_t* buf, size_t len, const char* root) {
+        journal_flush();
+        if (!root || !*root || (!buf && len)) {
+            emscripten_console_error("Invalid destination");
+            return -1;
+        }
+        size_t entries;
+        std::string error;
+        if (!lib::fs_restore(buf, len, root, entries, error)) {
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return static_cast<int>(entries);
+    }
+}
@@ -3,6 +3,7 @@ declare module '@ecmaos/bios' {
     // Core functions from bios.cpp
     ccall: typeof ccall
     cwrap: typeof cwrap
+    UTF16ToString: typeof UTF16ToString
     _malloc(size: number): number
     _free(ptr: number): void
     _init(): number
@@ -13,9 +14,142 @@ declare module '@ecmaos/bios' {
     FS: typeof FS
     _write_file(path: string, content: string): number
     _read_file(path: string): string
+    _read_text(path: string, outLen: number): number
+    _line_range(path: string, start: number, count: number, totalLines: number): string
     _file_exists(path: string): number
     _delete_file(path: string): number
     _list_directory(path: string): string
+
+    // Data processing
+    _json_query(buf: number, len: number, expr: string): string
+    _csv_scan(buf: number, len: number, delim: number, header: number, program: string): string
+
+    // Binary encodings; decoders write the byte count to the `outLen` pointer
+    _base64_encode(buf: number, len: number): string
+    _base64_decode(str: number, len: number, outLen: number): number
+    _hex_encode(buf: number, len: number): string
+    _hex_decode(str: number, len: number, outLen: number): number
+
+    // Streaming digests ('sha256' | 'blake3' | 'xxh3' | 'crc32c'); hash_final
+    // returns the hex digest and releases the handle
+    _hash_init(algorithm: string): number
+    _hash_update(handle: number, buf: number, len: number): number
+    _hash_final(handle: number): string
+
+    // Text encodings; transcoders write the output length to the `outLen` pointer
+    _utf8_validate(buf: number, len: number): number
+    _utf8_to_utf16(buf: number, len: number, outLen: number): number
+    _utf16_to_utf8(buf: number, len: number, outLen: number): number
+    _utf8_to_latin1(buf: number, len: number, outLen: number): number
+    _latin1_to_utf8(buf: number, len: number, outLen: number): number
+
+    // Substring search over an indexed directory tree
+    _search_build(root: string): number
+    _search_query(query: string, ignoreCase: number, filesOnly: number): string
+
+    // Ranked (BM25) document search; index_add buffers until index_commit
+    // or the next query
+    _index_add(key: string, text: number, len: number): number
+    _index_remove(key: string): number
+    _index_commit(): number
+    _index_query(query: string, limit: number): string
+
+    // Fuzzy "go to file" over every path in the file system
+    _find_fuzzy(query: string, limit: number): string
+
+    // Recursive walk with find-style predicates ("-name *.md -size +4k");
+    // returns packed records {u64 size, i64 mtimeMs, u32 pathLen, u8 type,
+    // path bytes} and writes their total length to the `outLen` pointer
+    _walk_tree(root: string, predicates: string, outLen: number): number
+
+    // Streaming compression ('lz4' | 'zstd' | 'gzip', level 0 for the
+    // default, an optional zstd dictionary). Update and end return output buffers to
+    // free and write their length to the `outLen` pointer; end releases
+    // the handle
+    _compress_begin(codec: string, level: number, dict: number, dictLen: number): number
+    _compress_update(handle: number, buf: number, len: number, outLen: number): number
+    _compress_end(handle: number, outLen: number): number
+
+    // Streaming decompression of LZ4, zstd or gzip data; update returns 0
+    // for corrupt input, end returns -1 if the input was truncated
+    _decompress_begin(dict: number, dictLen: number): number
+    _decompress_update(handle: number, buf: number, len: number, outLen: number): number
+    _decompress_end(handle: number): number
+
+    // One-shot gzip files (level 1-9, 0 for 6); both return buffers to
+    // free, gunzip returns 0 for corrupt or truncated input
+    _gzip(buf: number, len: number, level: number, outLen: number): number
+    _gunzip(buf: number, len: number, outLen: number): number
+
+    // Unpack a tar or .tar.gz archive into dest (created if missing);
+    // returns the number of members, or -1 on error
+    _tar_extract(buf: number, len: number, dest: string): number
+
+    // Read-only zip mounts on an absolute directory, served member by
+    // member to _read_file, _read_text, _read_range, _line_range,
+    // _list_directory, _file_exists, ls and cat
+    _zip_mount(archive: string, dir: string): number
+    _zip_unmount(dir: string): number
+
+    // Single members of an unmounted zip; read returns a buffer to free
+    // and writes its length to the `outLen` pointer, or 0 if missing
+    _zip_open(path: string): number
+    _zip_read(handle: number, name: string, outLen: number): number
+    _zip_close(handle: number): number
+
+    // Per-directory block compression: files written under `dir` are
+    // stored in 64 KB LZ4 blocks and read back transparently;
+    // read_range decodes only the blocks it needs and returns a buffer to
+    // free, writing its length to the `outLen` pointer
+    _set_compression(dir: string, enabled: number): number
+    _read_range(path: string, offset: number, len: number, outLen: number): number
+
+    // Log-structured key-value store in an FS directory. get returns a
+    // buffer to free (0 if missing) and writes its length to `outLen`;
+    // scan packs u32 key length, key, u32 value length, value per pair
+    _kv_open(dir: string): number
+    _kv_get(handle: number, key: string, outLen: number): number
+    _kv_put(handle: number, key: string, value: number, len: number): number
+    _kv_delete(handle: number, key: string): number
+    _kv_scan(handle: number, start: string, end: string, limit: number, outLen: number): number
+    _kv_close(handle: number): number
+
+    // B+tree of 4 KB pages in one FS file behind a CLOCK buffer pool.
+    // get and next return a buffer to free (0 if missing or at the end)
+    // and write its length to `outLen`; load and next pack pairs as u32
+    // key length, key, u32 value length, value
+    _btree_open(path: string): number
+    _btree_get(handle: number, key: string, outLen: number): number
+    _btree_put(handle: number, key: string, value: number, len: number): number
+    _btree_delete(handle: number, key: string): number
+    _btree_load(handle: number, buf: number, len: number, fill: number): number
+    _btree_cursor(handle: number, start: string, end: string): number
+    _btree_next(cursor: number, outLen: number): number
+    _btree_cursor_close(cursor: number): number
+    _btree_close(handle: number): number
+
+    // Crash-safe journaled writes: write_file and delete_file are queued and
+    // committed to a checksummed log in groups every `intervalMs`; init
+    // replays a log left by an interrupted session
+    _journal_enable(intervalMs: number): number
+    _journal_disable(): number
+    _journal_sync(): number
+    _journal_checkpoint(): number
+
+    // Deduplicating content store: files are cut into content-defined chunks
+    // and each distinct chunk is kept once. put returns the bytes of new
+    // chunks; get returns a buffer to free (0 if missing) and writes its
+    // length to `outLen`; stat returns tab-separated counts for one name or,
+    // given '', the whole store
+    _cas_put(name: string, buf: number, len: number): number
+    _cas_get(name: string, outLen: number): number
+    _cas_stat(name: string): string
+
+    // Whole-tree images for booting into a prebuilt state: snapshot returns
+    // a buffer to free and writes its length to `outLen`; restore returns
+    // the number of entries recreated
+    _fs_snapshot(root: string, compress: number, outLen: number): number
+    _fs_restore(buf: number, len: number, root: string): number
   }
 
   export enum BIOSState {
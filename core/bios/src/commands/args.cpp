@@ -0,0 +1,39 @@
+#include "commands.hpp"
+
+namespace commands {
+    std::vector<std::string> split_args(const std::string& args) {
+        std::vector<std::string> result;
+        std::string current;
+        bool in_token = false;
+        char quote = '\0';
+
+        for (size_t i = 0; i < args.size(); ++i) {
+            char c = args[i];
+            if (quote) {
+                if (c == quote) {
+                    quote = '\0';
+                } else if (c == '\\' && quote == '"' && i + 1 < args.size()) {
+                    current += args[++i];
+                } else {
+                    current += c;
+                }
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+                in_token = true;
+            } else if (c == ' ' || c == '\t') {
+                if (in_token) {
+                    result.push_back(current);
+                    current.clear();
+                    in_token = false;
+                }
+            } else {
+                if (c == '\\' && i + 1 < args.size()) c = args[++i];
+                current += c;
+                in_token = true;
+            }
+        }
+
+        if (in_token) result.push_back(current);
+        return result;
+    }
+}
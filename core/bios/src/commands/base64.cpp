@@ -0,0 +1,124 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "encoding.hpp"
+#include "block_file.hpp"
+#include "file_events.hpp"
+#include <emscripten/console.h>
+#include <fstream>
+#include <cstdlib>
+#include <algorithm>
+
+namespace commands {
+    int base64(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        bool decode = false;
+        long wrap = 76;
+        std::vector<std::string> paths;
+
+        for (size_t i = 0; i < argv.size(); ++i) {
+            if (argv[i] == "-d") {
+                decode = true;
+            } else if (argv[i] == "-w" && i + 1 < argv.size()) {
+                wrap = std::strtol(argv[++i].c_str(), nullptr, 10);
+            } else {
+                paths.push_back(argv[i]);
+            }
+        }
+
+        if (paths.empty() || paths.size() > 2 || wrap < 0) {
+            emscripten_console_error("Usage: base64 [-d] [-w cols] <input> [output]");
+            return -1;
+        }
+
+        lib::BlockReader in;
+        std::string error;
+        if (!in.open(paths[0], error)) {
+            emscripten_console_error("Failed to open file");
+            return -1;
+        }
+
+        std::ofstream out_file;
+        if (paths.size() == 2) {
+            out_file.open(paths[1], std::ios::binary | std::ios::trunc);
+            if (!out_file.is_open()) {
+                emscripten_console_error("Failed to open file for writing");
+                return -1;
+            }
+        } else if (decode) {
+            emscripten_console_warn("base64: decoded output is logged as text");
+        }
+        Output output(out_file.is_open() ? &out_file : nullptr);
+
+        std::string block;
+        std::string encoded;
+        lib::Base64Encoder encoder;
+        lib::Base64Decoder decoder;
+        long column = 0;
+
+        // Emit encoded text, breaking lines every `wrap` characters
+        auto emit = [&](const std::string& text) {
+            if (wrap == 0) {
+                output.write(text);
+                return;
+            }
+            size_t pos = 0;
+            while (pos < text.size()) {
+                size_t take = std::min(text.size() - pos, static_cast<size_t>(wrap - column));
+                output.write(std::string_view(text).substr(pos, take));
+                pos += take;
+                column += take;
+                if (column == wrap) {
+                    output.write("\n");
+                    column = 0;
+                }
+            }
+        };
+
+        for (uint64_t offset = 0; offset < in.size(); offset += block.size()) {
+            block.clear();
+            if (!in.read(offset, kBlockSize, block, error) || block.empty()) {
+                emscripten_console_error("Failed to read file");
+                return -1;
+            }
+            size_t got = block.size();
+
+            encoded.clear();
+            if (decode) {
+                if (!decoder.update(block.data(), got, encoded)) {
+                    emscripten_console_error("base64: invalid input");
+                    return -1;
+                }
+                output.write(encoded);
+            } else {
+                encoder.update(reinterpret_cast<const uint8_t*>(block.data()), got, encoded);
+                emit(encoded);
+            }
+        }
+
+        encoded.clear();
+        if (decode) {
+            if (!decoder.finish(encoded)) {
+                emscripten_console_error("base64: invalid input");
+                return -1;
+            }
+            output.write(encoded);
+        } else {
+            encoder.finish(encoded);
+            emit(encoded);
+            // Unwrapped output to a file ends without a newline, as coreutils does
+            if (column > 0 || (wrap == 0 && !out_file.is_open())) output.write("\n");
+        }
+
+        // A file written here follows its directory's compression policy
+        output.flush(true);
+        if (out_file.is_open()) {
+            out_file.close();
+            if (!out_file || !lib::apply_compression(paths[1], error)) {
+                emscripten_console_error("Failed to write file");
+                return -1;
+            }
+            lib::file_changed(paths[1]);
+        }
+        return 0;
+    }
+}
@@ -0,0 +1,71 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "block_file.hpp"
+#include "file_events.hpp"
+#include <emscripten/console.h>
+#include <cstdio>
+
+namespace commands {
+    // Rewrite `path` compressed or plain, whatever its directory's policy
+    static bool repack(const std::string& path, bool compress, std::string& error) {
+        std::string content;
+        if (!lib::load_file(path, content, error)) return false;
+        if (!lib::store_file(path, content.data(), content.size(), error, compress ? 1 : 0)) return false;
+        lib::file_changed(path);
+        return true;
+    }
+
+    // `blockz --on|--off <dir>` sets whether files written under a
+    // directory are stored block-compressed, `blockz --pack|--unpack
+    // <file>...` converts existing files, and `blockz <file>...` shows
+    // each file's stored and content sizes
+    int blockz(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        std::string mode;
+        std::vector<std::string> paths;
+        for (const std::string& arg : argv) {
+            if (arg == "--on" || arg == "--off" || arg == "--pack" || arg == "--unpack") {
+                mode = arg;
+            } else {
+                paths.push_back(arg);
+            }
+        }
+        if (paths.empty() || ((mode == "--on" || mode == "--off") && paths.size() != 1)) {
+            emscripten_console_error("Usage: blockz [--on|--off <dir>] [--pack|--unpack] <file>...");
+            return -1;
+        }
+
+        std::string error;
+        if (mode == "--on" || mode == "--off") {
+            if (!lib::set_compression(paths[0], mode == "--on", error)) {
+                error = "blockz: " + error;
+                emscripten_console_error(error.c_str());
+                return -1;
+            }
+            return 0;
+        }
+
+        Output output;
+        int status = 0;
+        for (const std::string& path : paths) {
+            if (!mode.empty() && !repack(path, mode == "--pack", error)) {
+                error = "blockz: " + error;
+                emscripten_console_error(error.c_str());
+                status = -1;
+                continue;
+            }
+            lib::BlockReader reader;
+            if (!reader.open(path, error)) {
+                error = "blockz: " + error;
+                emscripten_console_error(error.c_str());
+                status = -1;
+                continue;
+            }
+            char line[64];
+            snprintf(line, sizeof(line), "%llu\t%llu\t%s\t", static_cast<unsigned long long>(reader.stored_size()),
+                     static_cast<unsigned long long>(reader.size()), reader.compressed() ? "blockz" : "plain");
+            output.line(line + path);
+        }
+        return status;
+    }
+}
@@ -0,0 +1,188 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "btree.hpp"
+#include "line_reader.hpp"
+#include <emscripten.h>
+#include <emscripten/console.h>
+#include <cstdio>
+#include <cstdlib>
+
+namespace commands {
+    static std::string bench_key(uint64_t i) {
+        char key[24];
+        snprintf(key, sizeof(key), "key%012llu", static_cast<unsigned long long>(i));
+        return key;
+    }
+
+    // Bulk load `count` keys, then time point lookups and 100-key range
+    // scans from random keys
+    static bool bench(lib::BTree* tree, uint64_t count, Output& output, std::string& error) {
+        char line[160];
+        uint64_t i = 0;
+        double start = emscripten_get_now();
+        bool ok = tree->bulk_load(
+            [&](std::string& key, std::string& value) {
+                if (i == count) return false;
+                key = bench_key(i);
+                value = std::to_string(i * 7);
+                ++i;
+                return true;
+            },
+            1.0, error);
+        if (!ok) return false;
+        double elapsed = emscripten_get_now() - start;
+        lib::BTree::Stats stats = tree->stats();
+        snprintf(line, sizeof(line), "load\t%llu keys\t%u pages\theight %u\t%.0f ms", static_cast<unsigned long long>(count),
+                 stats.pages, stats.height, elapsed);
+        output.line(line);
+        if (count == 0) return true;
+
+        uint32_t seed = 0x9e3779b9;
+        auto random = [&]() {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            return (static_cast<uint64_t>(seed) << 20 ^ seed) % count;
+        };
+
+        const int lookups = 200000;
+        uint64_t misses = tree->stats().misses;
+        std::string value;
+        start = emscripten_get_now();
+        for (int n = 0; n < lookups; ++n) {
+            uint64_t k = random();
+            if (!tree->get(bench_key(k), value, error) || value != std::to_string(k * 7)) {
+                if (error.empty()) error = "lookup of " + bench_key(k) + " failed";
+                return false;
+            }
+        }
+        elapsed = emscripten_get_now() - start;
+        snprintf(line, sizeof(line), "get\t%d lookups\t%.0f ms\t%.2f us/op\t%llu page misses", lookups, elapsed,
+                 elapsed * 1000 / lookups, static_cast<unsigned long long>(tree->stats().misses - misses));
+        output.line(line);
+
+        const int scans = 2000;
+        uint64_t rows = 0;
+        misses = tree->stats().misses;
+        start = emscripten_get_now();
+        for (int n = 0; n < scans; ++n) {
+            lib::BTreeCursor cursor = tree->scan(bench_key(random()), std::string());
+            std::string key;
+            for (int r = 0; r < 100 && cursor.next(key, value, error); ++r) ++rows;
+            if (!error.empty()) return false;
+        }
+        elapsed = emscripten_get_now() - start;
+        snprintf(line, sizeof(line), "scan\t%d x 100 keys\t%llu rows\t%.0f ms\t%.2f us/row\t%llu page misses", scans,
+                 static_cast<unsigned long long>(rows), elapsed, rows ? elapsed * 1000 / rows : 0.0,
+                 static_cast<unsigned long long>(tree->stats().misses - misses));
+        output.line(line);
+        return true;
+    }
+
+    // `btree <file> get <key>`, `put <key> <value>`, `del <key>`,
+    // `scan [start] [end] [-n limit]`, `load <sorted.tsv> [fill]`,
+    // `stats`, or `bench [count]`, which replaces the file's contents
+    // with `count` keys and times lookups and range scans over them
+    int btree(const std::string& args) {
+        static const char* usage = "Usage: btree <file> get|put|del|scan|load|stats|bench [args...]";
+        std::vector<std::string> argv = split_args(args);
+        if (argv.size() < 2) {
+            emscripten_console_error(usage);
+            return -1;
+        }
+
+        std::string error;
+        lib::BTree* tree = lib::btree_file(argv[0], error);
+        if (!tree) {
+            error = "btree: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+
+        const std::string& op = argv[1];
+        Output output;
+        bool ok;
+        if (op == "get" && argv.size() == 3) {
+            std::string value;
+            ok = tree->get(argv[2], value, error);
+            if (ok) {
+                output.line(value);
+            } else if (error.empty()) {
+                error = argv[2] + ": not found";
+            }
+        } else if (op == "put" && argv.size() == 4) {
+            ok = tree->put(argv[2], argv[3], error) && tree->flush(error);
+        } else if (op == "del" && argv.size() == 3) {
+            ok = tree->remove(argv[2], error) && tree->flush(error);
+            if (!ok && error.empty()) error = argv[2] + ": not found";
+        } else if (op == "scan") {
+            std::string bounds[2];
+            size_t count = 0;
+            size_t limit = static_cast<size_t>(-1);
+            for (size_t i = 2; i < argv.size(); ++i) {
+                if (argv[i] == "-n" && i + 1 < argv.size()) {
+                    limit = strtoul(argv[++i].c_str(), nullptr, 10);
+                } else if (count < 2) {
+                    bounds[count++] = argv[i];
+                } else {
+                    emscripten_console_error("Usage: btree <file> scan [start] [end] [-n limit]");
+                    return -1;
+                }
+            }
+            lib::BTreeCursor cursor = tree->scan(bounds[0], bounds[1]);
+            std::string key, value;
+            for (size_t n = 0; n < limit && cursor.next(key, value, error); ++n) output.line(key + "\t" + value);
+            ok = error.empty();
+        } else if (op == "load" && (argv.size() == 3 || argv.size() == 4)) {
+            // One "key<TAB>value" per line, in key order; the input may be
+            // block-compressed
+            lib::LineReader in(argv[2]);
+            if (!in.is_open()) {
+                error = "btree: cannot open " + argv[2];
+                emscripten_console_error(error.c_str());
+                return -1;
+            }
+            std::string_view line;
+            bool terminated;
+            double fill = argv.size() == 4 ? strtod(argv[3].c_str(), nullptr) : 0.9;
+            ok = tree->bulk_load(
+                [&](std::string& key, std::string& value) {
+                    if (!in.next(line, terminated)) return false;
+                    size_t tab = line.find('\t');
+                    key.assign(line.substr(0, tab));
+                    if (tab == std::string_view::npos) {
+                        value.clear();
+                    } else {
+                        value.assign(line.substr(tab + 1));
+                    }
+                    return true;
+                },
+                fill, error);
+            if (ok && in.failed()) {
+                error = in.error();
+                ok = false;
+            }
+        } else if (op == "stats" && argv.size() == 2) {
+            lib::BTree::Stats stats = tree->stats();
+            char line[200];
+            snprintf(line, sizeof(line), "%llu keys\t%u pages\theight %u\t%llu hits\t%llu misses\t%llu evictions",
+                     static_cast<unsigned long long>(stats.keys), stats.pages, stats.height,
+                     static_cast<unsigned long long>(stats.hits), static_cast<unsigned long long>(stats.misses),
+                     static_cast<unsigned long long>(stats.evictions));
+            output.line(line);
+            ok = true;
+        } else if (op == "bench" && argv.size() <= 3) {
+            ok = bench(tree, argv.size() == 3 ? strtoull(argv[2].c_str(), nullptr, 10) : 1000000, output, error);
+        } else {
+            emscripten_console_error(usage);
+            return -1;
+        }
+
+        if (!ok) {
+            error = "btree: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+}
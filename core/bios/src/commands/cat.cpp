@@ -1,6 +1,8 @@
 #include "commands.hpp"
+#include "utf8.hpp"
+#include "zip.hpp"
+#include "block_file.hpp"
 #include <emscripten/console.h>
-#include <fstream>
 
 namespace commands {
     int cat(const std::string& args) {
@@ -9,21 +11,42 @@ namespace commands {
             return -1;
         }
 
-        std::ifstream file(args, std::ios::binary | std::ios::ate);
-        if (!file.is_open()) {
+        // A member of a mounted zip is inflated on its own
+        std::string member;
+        if (lib::ZipArchive* archive = lib::zip_lookup(args, member)) {
+            const lib::ZipEntry* entry = archive->find(member);
+            std::string content, error;
+            if (!entry) {
+                emscripten_console_error("Failed to open file");
+                return -1;
+            }
+            if (!archive->extract(*entry, content, error)) {
+                error = "cat: " + error;
+                emscripten_console_error(error.c_str());
+                return -1;
+            }
+            if (!lib::utf8_validate(content.data(), content.size())) {
+                emscripten_console_warn("cat: file is not valid UTF-8");
+            }
+            emscripten_console_log(content.c_str());
+            return 0;
+        }
+
+        lib::BlockReader reader;
+        std::string content, error;
+        if (!reader.open(args, error)) {
             emscripten_console_error("Failed to open file");
             return -1;
         }
-
-        std::streamsize size = file.tellg();
-        file.seekg(0, std::ios::beg);
-
-        std::string content(size, '\0');
-        if (!file.read(&content[0], size)) {
+        if (!reader.read(0, static_cast<size_t>(reader.size()), content, error)) {
             emscripten_console_error("Failed to read file");
             return -1;
         }
 
+        if (!lib::utf8_validate(content.data(), content.size())) {
+            emscripten_console_warn("cat: file is not valid UTF-8");
+        }
+
         emscripten_console_log(content.c_str());
         return 0;
     }
@@ -1,15 +1,55 @@
 #pragma once
 #include <string>
+#include <vector>
 
 namespace commands {
     // Command function type definition
     typedef int (*CommandFunction)(const std::string& args);
 
+    // Block size used by commands that stream files instead of reading them whole
+    constexpr size_t kBlockSize = 64 * 1024;
+
+    // Split a command's argument string on whitespace, honoring quotes
+    std::vector<std::string> split_args(const std::string& args);
+
     // Command functions
     int ls(const std::string& args);
     int cat(const std::string& args);
     int echo(const std::string& args);
     int rm(const std::string& args);
+    int head(const std::string& args);
+    int tail(const std::string& args);
+    int diff(const std::string& args);
+    int sed(const std::string& args);
+    int cut(const std::string& args);
+    int fields(const std::string& args);
+    int json(const std::string& args);
+    int csv(const std::string& args);
+    int base64(const std::string& args);
+    int xxd(const std::string& args);
+    int sha256sum(const std::string& args);
+    int b3sum(const std::string& args);
+    int xxh(const std::string& args);
+    int crc32c(const std::string& args);
+    int lines(const std::string& args);
+    int search(const std::string& args);
+    int fts(const std::string& args);
+    int fzf(const std::string& args);
+    int find(const std::string& args);
+    int du(const std::string& args);
+    int cp(const std::string& args);
+    int mv(const std::string& args);
+    int lz4(const std::string& args);
+    int zstd(const std::string& args);
+    int gzip(const std::string& args);
+    int gunzip(const std::string& args);
+    int tar(const std::string& args);
+    int mount(const std::string& args);
+    int umount(const std::string& args);
+    int blockz(const std::string& args);
+    int kv(const std::string& args);
+    int btree(const std::string& args);
+    int dedup(const std::string& args);
 
     // Command registration and execution
     int execute_command(const std::string& command);
@@ -0,0 +1,245 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "compress.hpp"
+#include "block_file.hpp"
+#include "file_events.hpp"
+#include <emscripten/console.h>
+#include <cctype>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+
+namespace commands {
+    // Files stream through the codec this much at a time
+    static const size_t kCompressChunkSize = 16 * kBlockSize;
+
+    // Compress or decompress `input` into `output` a chunk at a time
+    static bool transform_file(const std::string& input, const std::string& output, lib::Compressor* compressor,
+                               lib::Decompressor* decompressor, uint64_t& read_bytes, uint64_t& written, std::string& error) {
+        lib::BlockReader in;
+        if (!in.open(input, error)) {
+            error = input + ": cannot open";
+            return false;
+        }
+        std::ofstream out(output, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            error = output + ": cannot create";
+            return false;
+        }
+
+        std::string chunk;
+        std::string produced;
+        read_bytes = written = 0;
+        while (read_bytes < in.size()) {
+            chunk.clear();
+            if (!in.read(read_bytes, kCompressChunkSize, chunk, error) || chunk.empty()) {
+                error = input + ": read error";
+                return false;
+            }
+            read_bytes += chunk.size();
+
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(chunk.data());
+            if (compressor) {
+                compressor->update(data, chunk.size(), produced);
+            } else if (!decompressor->update(data, chunk.size(), produced, error)) {
+                error = input + ": " + error;
+                return false;
+            }
+            out.write(produced.data(), produced.size());
+            written += produced.size();
+            produced.clear();
+        }
+
+        if (compressor) {
+            compressor->finish(produced);
+        } else if (!decompressor->finish(error)) {
+            error = input + ": " + error;
+            return false;
+        }
+        out.write(produced.data(), produced.size());
+        written += produced.size();
+        out.close();
+        if (!out) {
+            error = output + ": write error";
+            return false;
+        }
+        return lib::apply_compression(output, error);
+    }
+
+    static void report(Output& out, bool decompress, const std::string& input, const std::string& output, uint64_t read_bytes,
+                       uint64_t written) {
+        if (decompress) {
+            out.line(input + ": " + std::to_string(written) + " bytes => " + output);
+        } else {
+            char ratio[32];
+            snprintf(ratio, sizeof(ratio), "%.2f%%", read_bytes ? 100.0 * written / read_bytes : 100.0);
+            out.line(input + ": " + ratio + " (" + std::to_string(read_bytes) + " => " + std::to_string(written) + " bytes, " +
+                     output + ")");
+        }
+    }
+
+    static bool has_suffix(const std::string& path, const std::string& suffix) {
+        return path.size() > suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    static int compress_command(const char* name, lib::Compressor::Codec codec, const std::string& extension, int max_level,
+                                const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        bool decompress = false;
+        int level = 0;
+        std::string dictionary_path;
+        std::vector<std::string> paths;
+        bool usage = false;
+
+        for (size_t i = 0; i < argv.size(); ++i) {
+            const std::string& arg = argv[i];
+            if (arg == "-d") {
+                decompress = true;
+            } else if (arg == "-D" && codec == lib::Compressor::kZstd && i + 1 < argv.size()) {
+                dictionary_path = argv[++i];
+            } else if (arg.size() > 1 && arg[0] == '-' && isdigit(static_cast<unsigned char>(arg[1]))) {
+                level = atoi(arg.c_str() + 1);
+                if (level < 1 || level > max_level) usage = true;
+            } else {
+                paths.push_back(arg);
+            }
+        }
+
+        if (usage || paths.empty() || paths.size() > 2) {
+            std::string message = std::string("Usage: ") + name + " [-d] [-1..-" + std::to_string(max_level) + "]" +
+                                  (codec == lib::Compressor::kZstd ? " [-D dictionary]" : "") + " <input> [output]";
+            emscripten_console_error(message.c_str());
+            return -1;
+        }
+
+        std::string dictionary;
+        std::string error;
+        if (!dictionary_path.empty() && !lib::load_file(dictionary_path, dictionary, error)) {
+            std::string message = std::string(name) + ": " + dictionary_path + ": cannot read dictionary";
+            emscripten_console_error(message.c_str());
+            return -1;
+        }
+
+        // Default output: add the extension, or strip it to decompress
+        const std::string& input = paths[0];
+        std::string output = paths.size() > 1 ? paths[1] : input + extension;
+        if (decompress && paths.size() == 1) {
+            if (!has_suffix(input, extension)) {
+                std::string message = std::string(name) + ": " + input + ": unknown suffix, give an output name";
+                emscripten_console_error(message.c_str());
+                return -1;
+            }
+            output = input.substr(0, input.size() - extension.size());
+        }
+
+        if (output == input) {
+            std::string message = std::string(name) + ": " + input + ": input and output are the same file";
+            emscripten_console_error(message.c_str());
+            return -1;
+        }
+
+        lib::Compressor compressor(codec, level, dictionary);
+        lib::Decompressor decompressor(dictionary);
+        uint64_t read_bytes, written;
+        bool ok = transform_file(input, output, decompress ? nullptr : &compressor, decompress ? &decompressor : nullptr,
+                                 read_bytes, written, error);
+        if (!ok) {
+            std::remove(output.c_str());
+            error = std::string(name) + ": " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        lib::file_changed(output);
+
+        Output out;
+        report(out, decompress, input, output, read_bytes, written);
+        return 0;
+    }
+
+    // gzip-style: each file is replaced by its compressed (or decompressed)
+    // counterpart unless -k keeps it
+    static int gzip_command(const char* name, bool decompress, const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        bool keep = false;
+        int level = 0;
+        std::vector<std::string> paths;
+        bool usage = false;
+
+        for (const std::string& arg : argv) {
+            if (arg == "-d") {
+                decompress = true;
+            } else if (arg == "-k") {
+                keep = true;
+            } else if (arg.size() == 2 && arg[0] == '-' && arg[1] >= '1' && arg[1] <= '9') {
+                level = arg[1] - '0';
+            } else if (arg.size() > 1 && arg[0] == '-') {
+                usage = true;
+            } else {
+                paths.push_back(arg);
+            }
+        }
+
+        if (usage || paths.empty()) {
+            std::string message = std::string("Usage: ") + name + " [-d] [-k] [-1..-9] <file>...";
+            emscripten_console_error(message.c_str());
+            return -1;
+        }
+
+        Output out;
+        int status = 0;
+        for (const std::string& input : paths) {
+            std::string output;
+            if (!decompress) {
+                if (has_suffix(input, ".gz") || has_suffix(input, ".tgz")) {
+                    std::string message = std::string(name) + ": " + input + " already has .gz suffix -- unchanged";
+                    emscripten_console_error(message.c_str());
+                    status = -1;
+                    continue;
+                }
+                output = input + ".gz";
+            } else if (has_suffix(input, ".gz")) {
+                output = input.substr(0, input.size() - 3);
+            } else if (has_suffix(input, ".tgz")) {
+                output = input.substr(0, input.size() - 4) + ".tar";
+            } else {
+                std::string message = std::string(name) + ": " + input + ": unknown suffix -- ignored";
+                emscripten_console_error(message.c_str());
+                status = -1;
+                continue;
+            }
+
+            lib::Compressor compressor(lib::Compressor::kGzip, level);
+            lib::Decompressor decompressor;
+            uint64_t read_bytes, written;
+            std::string error;
+            if (!transform_file(input, output, decompress ? nullptr : &compressor, decompress ? &decompressor : nullptr, read_bytes,
+                                written, error)) {
+                std::remove(output.c_str());
+                error = std::string(name) + ": " + error;
+                emscripten_console_error(error.c_str());
+                status = -1;
+                continue;
+            }
+            lib::file_changed(output);
+            if (!keep && std::remove(input.c_str()) == 0) lib::file_removed(input);
+            report(out, decompress, input, output, read_bytes, written);
+        }
+        return status;
+    }
+
+    int lz4(const std::string& args) {
+        return compress_command("lz4", lib::Compressor::kLz4, ".lz4", lib::Lz4Encoder::kMaxLevel, args);
+    }
+
+    int zstd(const std::string& args) {
+        return compress_command("zstd", lib::Compressor::kZstd, ".zst", lib::ZstdEncoder::kMaxLevel, args);
+    }
+
+    int gzip(const std::string& args) {
+        return gzip_command("gzip", false, args);
+    }
+
+    int gunzip(const std::string& args) {
+        return gzip_command("gunzip", true, args);
+    }
+}
@@ -0,0 +1,90 @@
+#include "commands.hpp"
+#include "file_copy.hpp"
+#include <emscripten/console.h>
+#include <sys/stat.h>
+
+namespace commands {
+    // Where `source` lands: inside `target` when that is a directory
+    static std::string destination(const std::string& source, const std::string& target, bool into) {
+        if (!into) return target;
+        std::string name = source;
+        while (name.size() > 1 && name.back() == '/') name.pop_back();
+        size_t slash = name.rfind('/');
+        if (slash != std::string::npos) name.erase(0, slash + 1);
+        return target.back() == '/' ? target + name : target + "/" + name;
+    }
+
+    static bool is_directory(const std::string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    // `cp [-r] <source>... <target>` copies files, or directory trees with
+    // -r, keeping modes and modification times. With several sources the
+    // target must be a directory.
+    int cp(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        bool recursive = false;
+        std::vector<std::string> paths;
+        for (const std::string& arg : argv) {
+            if (arg == "-r" || arg == "-R") {
+                recursive = true;
+            } else {
+                paths.push_back(arg);
+            }
+        }
+        if (paths.size() < 2) {
+            emscripten_console_error("Usage: cp [-r] <source>... <target>");
+            return -1;
+        }
+
+        std::string target = paths.back();
+        paths.pop_back();
+        bool into = is_directory(target);
+        if (paths.size() > 1 && !into) {
+            std::string message = "cp: target " + target + " is not a directory";
+            emscripten_console_error(message.c_str());
+            return -1;
+        }
+
+        int status = 0;
+        for (const std::string& source : paths) {
+            std::string error;
+            if (!lib::copy_path(source, destination(source, target, into), recursive, error)) {
+                error = "cp: " + error;
+                emscripten_console_error(error.c_str());
+                status = -1;
+            }
+        }
+        return status;
+    }
+
+    // `mv <source>... <target>` renames, or moves into a target directory
+    int mv(const std::string& args) {
+        std::vector<std::string> paths = split_args(args);
+        if (paths.size() < 2) {
+            emscripten_console_error("Usage: mv <source>... <target>");
+            return -1;
+        }
+
+        std::string target = paths.back();
+        paths.pop_back();
+        bool into = is_directory(target);
+        if (paths.size() > 1 && !into) {
+            std::string message = "mv: target " + target + " is not a directory";
+            emscripten_console_error(message.c_str());
+            return -1;
+        }
+
+        int status = 0;
+        for (const std::string& source : paths) {
+            std::string error;
+            if (!lib::move_path(source, destination(source, target, into), error)) {
+                error = "mv: " + error;
+                emscripten_console_error(error.c_str());
+                status = -1;
+            }
+        }
+        return status;
+    }
+}
@@ -0,0 +1,94 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "csv.hpp"
+#include "block_file.hpp"
+#include <emscripten/console.h>
+#include <algorithm>
+#include <cstring>
+
+namespace commands {
+    // Rows are scanned from a chunk this size; longer rows grow it
+    static const size_t kChunkSize = 16 * kBlockSize;
+
+    int csv(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        char delim = ',';
+        bool header = false;
+        std::string source;
+        bool have_program = false;
+        std::vector<std::string> paths;
+
+        for (size_t i = 0; i < argv.size(); ++i) {
+            const std::string& arg = argv[i];
+            if (arg == "-d" && i + 1 < argv.size()) {
+                delim = argv[++i].empty() ? ',' : argv[i][0];
+            } else if (arg.size() > 2 && arg.compare(0, 2, "-d") == 0) {
+                delim = arg[2];
+            } else if (arg == "-H") {
+                header = true;
+            } else if (!have_program) {
+                source = arg;
+                have_program = true;
+            } else {
+                paths.push_back(arg);
+            }
+        }
+
+        if (!have_program || paths.size() != 1) {
+            emscripten_console_error("Usage: csv [-d delim] [-H] '<program>' <filename>");
+            return -1;
+        }
+
+        lib::FieldProgram program;
+        std::string error;
+        if (!lib::parse_program(source, program, error)) {
+            error = "csv: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+
+        lib::BlockReader file;
+        if (!file.open(paths[0], error)) {
+            emscripten_console_error("Failed to open file");
+            return -1;
+        }
+
+        Output output;
+        lib::CsvQuery query(program, delim, header, [&output](std::string_view text) { output.write(text); });
+
+        std::vector<char> chunk(kChunkSize);
+        size_t filled = 0;
+        uint64_t offset = 0;
+        bool eof = false;
+        while (!eof || filled > 0) {
+            if (!eof) {
+                size_t want = static_cast<size_t>(std::min<uint64_t>(chunk.size() - filled, file.size() - offset));
+                if (want > 0 && !file.read(offset, want, chunk.data() + filled, error)) {
+                    emscripten_console_error("Failed to read file");
+                    return -1;
+                }
+                filled += want;
+                offset += want;
+                eof = offset == file.size();
+            }
+
+            size_t consumed = query.feed(chunk.data(), filled, eof, error);
+            if (!error.empty()) {
+                error = "csv: " + error;
+                emscripten_console_error(error.c_str());
+                return -1;
+            }
+            if (eof) break;
+
+            if (consumed == 0 && filled == chunk.size()) {
+                chunk.resize(chunk.size() * 2);
+            } else {
+                memmove(chunk.data(), chunk.data() + consumed, filled - consumed);
+                filled -= consumed;
+            }
+        }
+
+        query.finish();
+        return 0;
+    }
+}
@@ -0,0 +1,135 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "line_reader.hpp"
+#include "search.hpp"
+#include <emscripten/console.h>
+#include <cstdlib>
+
+namespace commands {
+    // Fields up to this index are kept in a bitmap; ranges reaching past it
+    // keep their remainder as a range, so "1-4000000000" stays small
+    static const size_t kBitmapFields = 4096;
+
+    // A 1-based set of fields: explicit indices, closed ranges past the
+    // bitmap and an optional open-ended "N-" range
+    struct FieldSelection {
+        std::vector<bool> explicit_fields;
+        std::vector<std::pair<size_t, size_t>> ranges;
+        size_t open_from = 0;
+
+        bool contains(size_t index) const {
+            if (index < explicit_fields.size() && explicit_fields[index]) return true;
+            if (open_from && index >= open_from) return true;
+            for (const auto& range : ranges) {
+                if (index >= range.first && index <= range.second) return true;
+            }
+            return false;
+        }
+    };
+
+    // Parse a field list such as "1,3-5,7-"
+    static bool parse_field_list(const std::string& list, FieldSelection& selection) {
+        if (list.empty()) return false;
+
+        size_t pos = 0;
+        for (;;) {
+            size_t comma = list.find(',', pos);
+            std::string item = list.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+            if (item.empty()) return false;
+
+            size_t dash = item.find('-');
+            long lo, hi;
+            if (dash == std::string::npos) {
+                lo = hi = std::strtol(item.c_str(), nullptr, 10);
+            } else {
+                lo = dash == 0 ? 1 : std::strtol(item.c_str(), nullptr, 10);
+                hi = dash + 1 == item.size() ? -1 : std::strtol(item.c_str() + dash + 1, nullptr, 10);
+            }
+            if (lo < 1 || (hi != -1 && hi < lo)) return false;
+
+            if (hi == -1) {
+                if (!selection.open_from || static_cast<size_t>(lo) < selection.open_from) selection.open_from = lo;
+            } else {
+                size_t last = static_cast<size_t>(hi) < kBitmapFields ? static_cast<size_t>(hi) : kBitmapFields - 1;
+                if (static_cast<size_t>(lo) <= last) {
+                    if (selection.explicit_fields.size() <= last) selection.explicit_fields.resize(last + 1, false);
+                    for (size_t i = lo; i <= last; ++i) selection.explicit_fields[i] = true;
+                }
+                if (static_cast<size_t>(hi) > last) {
+                    selection.ranges.emplace_back(static_cast<size_t>(lo) > last ? lo : last + 1, hi);
+                }
+            }
+
+            if (comma == std::string::npos) break;
+            pos = comma + 1;
+        }
+        return true;
+    }
+
+    int cut(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        char delim = '\t';
+        std::string list;
+        bool only_delimited = false;
+        std::vector<std::string> paths;
+
+        for (size_t i = 0; i < argv.size(); ++i) {
+            const std::string& arg = argv[i];
+            if (arg == "-d" && i + 1 < argv.size()) {
+                delim = argv[++i].empty() ? '\t' : argv[i][0];
+            } else if (arg.size() > 2 && arg.compare(0, 2, "-d") == 0) {
+                delim = arg[2];
+            } else if (arg == "-f" && i + 1 < argv.size()) {
+                list = argv[++i];
+            } else if (arg.size() > 2 && arg.compare(0, 2, "-f") == 0) {
+                list = arg.substr(2);
+            } else if (arg == "-s") {
+                only_delimited = true;
+            } else {
+                paths.push_back(arg);
+            }
+        }
+
+        FieldSelection selection;
+        if (paths.empty() || !parse_field_list(list, selection)) {
+            emscripten_console_error("Usage: cut [-d delim] -f list [-s] <filename>...");
+            return -1;
+        }
+
+        Output output;
+        std::vector<std::string_view> fields;
+        for (const std::string& path : paths) {
+            lib::LineReader reader(path);
+            if (!reader.is_open()) {
+                emscripten_console_error("Failed to open file");
+                return -1;
+            }
+
+            std::string_view line;
+            bool terminated;
+            while (reader.next(line, terminated)) {
+                lib::split_fields(line, delim, fields);
+                if (fields.size() == 1) {
+                    if (!only_delimited) output.line(line);
+                    continue;
+                }
+
+                bool first = true;
+                for (size_t i = 0; i < fields.size(); ++i) {
+                    if (!selection.contains(i + 1)) continue;
+                    if (!first) output.write(std::string_view(&delim, 1));
+                    output.write(fields[i]);
+                    first = false;
+                }
+                output.write("\n");
+            }
+            if (reader.failed()) {
+                std::string error = "cut: " + reader.error();
+                emscripten_console_error(error.c_str());
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+}
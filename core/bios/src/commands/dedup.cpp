@@ -0,0 +1,109 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "block_file.hpp"
+#include "cas.hpp"
+#include "hash.hpp"
+#include "tree_walk.hpp"
+#include <emscripten/console.h>
+#include <cstdio>
+#include <unordered_set>
+
+namespace commands {
+    static void report(Output& output, uint64_t files, uint64_t bytes, uint64_t chunks, uint64_t distinct, uint64_t unique) {
+        char line[160];
+        uint64_t saved = bytes - unique;
+        snprintf(line, sizeof(line), "%llu files\t%llu bytes\t%llu chunks (%llu distinct)\t%llu unique bytes\t%llu saved (%.1f%%)",
+                 static_cast<unsigned long long>(files), static_cast<unsigned long long>(bytes),
+                 static_cast<unsigned long long>(chunks), static_cast<unsigned long long>(distinct),
+                 static_cast<unsigned long long>(unique), static_cast<unsigned long long>(saved),
+                 bytes ? 100.0 * saved / bytes : 0.0);
+        output.line(line);
+    }
+
+    // `dedup` reports what the content store holds and saves, `dedup
+    // <path>...` what chunking the files under the paths would save, and
+    // `dedup --store <path>...` puts those files in the store by path
+    int dedup(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        bool store = false;
+        std::vector<std::string> roots;
+        for (const std::string& arg : argv) {
+            if (arg == "--store") {
+                store = true;
+            } else if (!arg.empty() && arg[0] == '-') {
+                emscripten_console_error("Usage: dedup [--store] [path...]");
+                return -1;
+            } else {
+                roots.push_back(arg);
+            }
+        }
+
+        Output output;
+        std::string error;
+        lib::ContentStore* cas = nullptr;
+        if (roots.empty() || store) {
+            cas = lib::content_store(error);
+            if (!cas) {
+                error = "dedup: " + error;
+                emscripten_console_error(error.c_str());
+                return -1;
+            }
+        }
+        if (roots.empty()) {
+            lib::ContentStore::Stats stats = cas->stats();
+            report(output, stats.files, stats.logical_bytes, stats.chunk_refs, stats.chunks, stats.stored_bytes);
+            return 0;
+        }
+
+        lib::WalkFilter files;
+        files.type = 'f';
+        std::unordered_set<std::string> seen;
+        uint64_t count = 0, bytes = 0, chunks = 0, unique = 0;
+        int status = 0;
+        for (const std::string& root : roots) {
+            lib::WalkTotals totals;
+            std::vector<lib::WalkEntry> entries;
+            if (!lib::walk_tree(root, files, &entries, totals, error)) {
+                error = "dedup: " + error;
+                emscripten_console_error(error.c_str());
+                status = -1;
+                continue;
+            }
+
+            std::string content;
+            for (const lib::WalkEntry& entry : entries) {
+                // The store's own chunks would only count twice
+                if (entry.path.compare(0, 6, "/.bios") == 0 && (entry.path.size() == 6 || entry.path[6] == '/')) continue;
+                if (!lib::load_file(entry.path, content, error)) {
+                    error = "dedup: " + error;
+                    emscripten_console_error(error.c_str());
+                    status = -1;
+                    continue;
+                }
+                const uint8_t* data = reinterpret_cast<const uint8_t*>(content.data());
+                uint64_t added;
+                if (store && !cas->put(entry.path, data, content.size(), added, error)) {
+                    error = "dedup: " + error;
+                    emscripten_console_error(error.c_str());
+                    status = -1;
+                    continue;
+                }
+
+                for (size_t pos = 0; pos < content.size();) {
+                    size_t size = lib::cdc_cut(data + pos, content.size() - pos);
+                    lib::Blake3 hasher;
+                    hasher.update(data + pos, size);
+                    std::string digest(lib::ContentStore::kDigestSize, '\0');
+                    hasher.finish(reinterpret_cast<uint8_t*>(&digest[0]));
+                    if (seen.insert(digest).second) unique += size;
+                    ++chunks;
+                    pos += size;
+                }
+                ++count;
+                bytes += content.size();
+            }
+        }
+        report(output, count, bytes, chunks, seen.size(), unique);
+        return status;
+    }
+}
@@ -0,0 +1,302 @@
+#include "commands.hpp"
+#include "block_file.hpp"
+#include <emscripten/console.h>
+#include <string_view>
+#include <unordered_map>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+
+namespace commands {
+    // A file split into lines, each interned to an integer id so the diff
+    // core compares ints instead of strings. Line views point into `text`.
+    struct LineFile {
+        std::string text;
+        std::vector<std::string_view> lines;
+        std::vector<int> ids;
+    };
+
+    static bool load_lines(const std::string& path, LineFile& file) {
+        std::string error;
+        if (!lib::load_file(path, file.text, error)) return false;
+
+        std::string_view text(file.text);
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t nl = text.find('\n', pos);
+            size_t end = nl == std::string_view::npos ? text.size() : nl + 1;
+            file.lines.push_back(text.substr(pos, end - pos));
+            pos = end;
+        }
+        return true;
+    }
+
+    // Myers' O(ND) diff using the linear-space middle-snake bisection.
+    // Marks changed lines in `removed` (for a) and `added` (for b).
+    class MyersDiff {
+    public:
+        MyersDiff(const std::vector<int>& a, const std::vector<int>& b)
+            : a_(a), b_(b), removed(a.size(), 0), added(b.size(), 0) {
+            size_t max = a.size() + b.size() + 2;
+            forward_.resize(2 * max);
+            backward_.resize(2 * max);
+        }
+
+        void run() { compare(0, static_cast<int>(a_.size()), 0, static_cast<int>(b_.size())); }
+
+        const std::vector<int>& a_;
+        const std::vector<int>& b_;
+        std::vector<char> removed;
+        std::vector<char> added;
+
+    private:
+        std::vector<int> forward_;
+        std::vector<int> backward_;
+
+        void compare(int a0, int a1, int b0, int b1) {
+            // Fast path: strip the common prefix and suffix
+            while (a0 < a1 && b0 < b1 && a_[a0] == b_[b0]) { ++a0; ++b0; }
+            while (a0 < a1 && b0 < b1 && a_[a1 - 1] == b_[b1 - 1]) { --a1; --b1; }
+
+            if (a0 == a1) {
+                for (int j = b0; j < b1; ++j) added[j] = 1;
+                return;
+            }
+            if (b0 == b1) {
+                for (int i = a0; i < a1; ++i) removed[i] = 1;
+                return;
+            }
+
+            int x, y;
+            if (!bisect(a0, a1, b0, b1, x, y)) {
+                for (int i = a0; i < a1; ++i) removed[i] = 1;
+                for (int j = b0; j < b1; ++j) added[j] = 1;
+                return;
+            }
+
+            compare(a0, x, b0, y);
+            compare(x, a1, y, b1);
+        }
+
+        // Find the middle snake of the edit graph for a[a0,a1) x b[b0,b1) by
+        // running the forward and reverse searches until they overlap, and
+        // return the split point in (x, y)
+        bool bisect(int a0, int a1, int b0, int b1, int& x, int& y) {
+            const int n = a1 - a0;
+            const int m = b1 - b0;
+            const int max_d = (n + m + 1) / 2;
+            const int offset = max_d;
+            const int length = 2 * max_d + 2;
+            const int delta = n - m;
+            const bool odd = (delta & 1) != 0;
+
+            int* v1 = forward_.data();
+            int* v2 = backward_.data();
+            std::fill(v1, v1 + length, -1);
+            std::fill(v2, v2 + length, -1);
+            v1[offset + 1] = 0;
+            v2[offset + 1] = 0;
+
+            int k1_start = 0, k1_end = 0, k2_start = 0, k2_end = 0;
+            for (int d = 0; d < max_d; ++d) {
+                for (int k1 = -d + k1_start; k1 <= d - k1_end; k1 += 2) {
+                    int k1_offset = offset + k1;
+                    int x1 = (k1 == -d || (k1 != d && v1[k1_offset - 1] < v1[k1_offset + 1]))
+                        ? v1[k1_offset + 1] : v1[k1_offset - 1] + 1;
+                    int y1 = x1 - k1;
+                    while (x1 < n && y1 < m && a_[a0 + x1] == b_[b0 + y1]) { ++x1; ++y1; }
+                    v1[k1_offset] = x1;
+
+                    if (x1 > n) {
+                        k1_end += 2;
+                    } else if (y1 > m) {
+                        k1_start += 2;
+                    } else if (odd) {
+                        int k2_offset = offset + delta - k1;
+                        if (k2_offset >= 0 && k2_offset < length && v2[k2_offset] != -1 && x1 >= n - v2[k2_offset]) {
+                            x = a0 + x1;
+                            y = b0 + y1;
+                            return true;
+                        }
+                    }
+                }
+
+                for (int k2 = -d + k2_start; k2 <= d - k2_end; k2 += 2) {
+                    int k2_offset = offset + k2;
+                    int x2 = (k2 == -d || (k2 != d && v2[k2_offset - 1] < v2[k2_offset + 1]))
+                        ? v2[k2_offset + 1] : v2[k2_offset - 1] + 1;
+                    int y2 = x2 - k2;
+                    while (x2 < n && y2 < m && a_[a1 - x2 - 1] == b_[b1 - y2 - 1]) { ++x2; ++y2; }
+                    v2[k2_offset] = x2;
+
+                    if (x2 > n) {
+                        k2_end += 2;
+                    } else if (y2 > m) {
+                        k2_start += 2;
+                    } else if (!odd) {
+                        int k1_offset = offset + delta - k2;
+                        if (k1_offset >= 0 && k1_offset < length && v1[k1_offset] != -1) {
+                            int x1 = v1[k1_offset];
+                            int y1 = offset + x1 - k1_offset;
+                            if (x1 >= n - x2) {
+                                x = a0 + x1;
+                                y = b0 + y1;
+                                return true;
+                            }
+                        }
+                    }
+                }
+            }
+
+            return false;
+        }
+    };
+
+    static void append_range(std::string& out, char sign, int start, int count) {
+        out += sign;
+        // Empty ranges name the line before the change, as diff -u does
+        out += std::to_string(count == 0 ? start : start + 1);
+        if (count != 1) {
+            out += ',';
+            out += std::to_string(count);
+        }
+    }
+
+    static void append_line(std::string& out, char prefix, std::string_view line) {
+        out += prefix;
+        if (!line.empty() && line.back() == '\n') {
+            out.append(line.data(), line.size());
+        } else {
+            out.append(line.data(), line.size());
+            out += "\n\\ No newline at end of file\n";
+        }
+    }
+
+    int diff(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        int context = 3;
+        std::vector<std::string> paths;
+
+        for (size_t i = 0; i < argv.size(); ++i) {
+            if ((argv[i] == "-U" || argv[i] == "-u") && i + 1 < argv.size() && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+                context = std::atoi(argv[++i].c_str());
+            } else if (argv[i] == "-u") {
+                continue;
+            } else {
+                paths.push_back(argv[i]);
+            }
+        }
+
+        if (paths.size() != 2) {
+            emscripten_console_error("Usage: diff [-U lines] <file1> <file2>");
+            return -1;
+        }
+
+        LineFile a, b;
+        if (!load_lines(paths[0], a) || !load_lines(paths[1], b)) {
+            emscripten_console_error("Failed to read file");
+            return -1;
+        }
+
+        // Intern lines from both files into one id space
+        std::unordered_map<std::string_view, int> interned;
+        interned.reserve(a.lines.size() + b.lines.size());
+        for (LineFile* file : {&a, &b}) {
+            file->ids.reserve(file->lines.size());
+            for (std::string_view line : file->lines) {
+                auto it = interned.emplace(line, static_cast<int>(interned.size())).first;
+                file->ids.push_back(it->second);
+            }
+        }
+
+        MyersDiff engine(a.ids, b.ids);
+        engine.run();
+
+        // Flatten the change marks into an edit script: ' ' keep, '-' remove, '+' add
+        std::vector<char> script;
+        script.reserve(a.lines.size() + b.lines.size());
+        size_t i = 0, j = 0;
+        while (i < a.lines.size() || j < b.lines.size()) {
+            if (i < a.lines.size() && engine.removed[i]) {
+                script.push_back('-');
+                ++i;
+            } else if (j < b.lines.size() && engine.added[j]) {
+                script.push_back('+');
+                ++j;
+            } else {
+                script.push_back(' ');
+                ++i;
+                ++j;
+            }
+        }
+
+        std::string out;
+        size_t pos = 0;
+        int line_a = 0, line_b = 0;    // Lines consumed before script[pos]
+        while (pos < script.size()) {
+            if (script[pos] == ' ') {
+                ++pos;
+                ++line_a;
+                ++line_b;
+                continue;
+            }
+
+            if (out.empty()) {
+                out += "--- " + paths[0] + "\n+++ " + paths[1] + "\n";
+            }
+
+            // Grow the hunk until a run of unchanged lines exceeds twice the context
+            size_t lead = std::min(static_cast<size_t>(context), static_cast<size_t>(std::min(line_a, line_b)));
+            size_t start = pos - lead;
+            size_t end = pos;
+            while (end < script.size()) {
+                if (script[end] != ' ') {
+                    ++end;
+                    continue;
+                }
+                size_t run = end;
+                while (run < script.size() && script[run] == ' ') ++run;
+                if (run == script.size() || run - end > static_cast<size_t>(2 * context)) {
+                    end = std::min(run, end + context);
+                    break;
+                }
+                end = run;
+            }
+
+            int hunk_a = line_a - static_cast<int>(lead);
+            int hunk_b = line_b - static_cast<int>(lead);
+            int count_a = 0, count_b = 0;
+            for (size_t k = start; k < end; ++k) {
+                if (script[k] != '+') ++count_a;
+                if (script[k] != '-') ++count_b;
+            }
+
+            out += "@@ ";
+            append_range(out, '-', hunk_a, count_a);
+            out += ' ';
+            append_range(out, '+', hunk_b, count_b);
+            out += " @@\n";
+
+            int ia = hunk_a, ib = hunk_b;
+            for (size_t k = start; k < end; ++k) {
+                if (script[k] == '-') {
+                    append_line(out, '-', a.lines[ia++]);
+                } else if (script[k] == '+') {
+                    append_line(out, '+', b.lines[ib++]);
+                } else {
+                    append_line(out, ' ', a.lines[ia++]);
+                    ++ib;
+                }
+            }
+
+            pos = end;
+            line_a = ia;
+            line_b = ib;
+        }
+
+        if (out.empty()) return 0;
+        out.pop_back();
+        emscripten_console_log(out.c_str());
+        return 1;
+    }
+}
@@ -0,0 +1,94 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "tree_walk.hpp"
+#include <emscripten/console.h>
+#include <cstdio>
+#include <map>
+
+namespace commands {
+    // 1K blocks, or K/M/G with a decimal below 10 for -h
+    static std::string format_size(uint64_t bytes, bool human) {
+        if (!human) return std::to_string((bytes + 1023) / 1024);
+        if (bytes < 1024) return std::to_string(bytes);
+
+        static const char kUnits[] = "KMGT";
+        double value = static_cast<double>(bytes);
+        size_t unit = 0;
+        for (value /= 1024; value >= 1024 && unit + 1 < sizeof(kUnits) - 1; value /= 1024) ++unit;
+        char text[32];
+        if (value < 10) {
+            snprintf(text, sizeof(text), "%.1f%c", value, kUnits[unit]);
+        } else {
+            snprintf(text, sizeof(text), "%.0f%c", value, kUnits[unit]);
+        }
+        return text;
+    }
+
+    // `du [-s] [-h] [path...]` reports the apparent size of the files under
+    // each path (default "."): for every directory, or only in total with -s
+    int du(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        bool summarize = false;
+        bool human = false;
+        std::vector<std::string> roots;
+        for (const std::string& arg : argv) {
+            if (arg == "-s") {
+                summarize = true;
+            } else if (arg == "-h") {
+                human = true;
+            } else if (arg == "-sh" || arg == "-hs") {
+                summarize = human = true;
+            } else if (!arg.empty() && arg[0] == '-') {
+                emscripten_console_error("Usage: du [-s] [-h] [path...]");
+                return -1;
+            } else {
+                std::string root = arg;
+                while (root.size() > 1 && root.back() == '/') root.pop_back();
+                roots.push_back(root);
+            }
+        }
+        if (roots.empty()) roots.push_back(".");
+
+        Output output;
+        lib::WalkFilter everything;
+        std::string error;
+        int status = 0;
+        for (const std::string& root : roots) {
+            lib::WalkTotals totals;
+            std::vector<lib::WalkEntry> entries;
+            if (!lib::walk_tree(root, everything, summarize ? nullptr : &entries, totals, error)) {
+                error = "du: " + error;
+                emscripten_console_error(error.c_str());
+                status = -1;
+                continue;
+            }
+
+            if (summarize) {
+                output.line(format_size(totals.bytes, human) + "\t" + root);
+                continue;
+            }
+
+            // A descendant sorts after its directory, so walking the sizes
+            // backwards rolls each directory into its parent once it is complete
+            std::map<std::string, uint64_t> sizes;
+            for (const lib::WalkEntry& entry : entries) {
+                if (entry.type == 'd') {
+                    sizes[entry.path];
+                    continue;
+                }
+                size_t slash = entry.path.rfind('/');
+                if (slash == std::string::npos) continue;
+                auto parent = sizes.find(slash == 0 ? "/" : entry.path.substr(0, slash));
+                if (parent != sizes.end()) parent->second += entry.size;
+            }
+            for (auto it = sizes.rbegin(); it != sizes.rend(); ++it) {
+                if (it->first == root) continue;
+                size_t slash = it->first.rfind('/');
+                auto parent = sizes.find(slash == 0 ? "/" : it->first.substr(0, slash));
+                if (parent != sizes.end()) parent->second += it->second;
+            }
+            for (auto it = sizes.rbegin(); it != sizes.rend(); ++it) output.line(format_size(it->second, human) + "\t" + it->first);
+        }
+        return status;
+    }
+}
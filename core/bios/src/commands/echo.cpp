@@ -1,6 +1,8 @@
 #include "commands.hpp"
+#include "block_file.hpp"
+#include "file_events.hpp"
+#include "zip.hpp"
 #include <emscripten/console.h>
-#include <fstream>
 
 namespace commands {
     int echo(const std::string& args) {
@@ -13,13 +15,16 @@ namespace commands {
             content = content.substr(0, content.find_last_not_of(" \t") + 1);
             filename = filename.substr(filename.find_first_not_of(" \t"));
             
-            std::ofstream file(filename);
-            if (!file.is_open()) {
+            std::string member, error;
+            if (lib::zip_lookup(filename, member)) {
+                emscripten_console_error("Cannot write to a read-only zip mount");
+                return -1;
+            }
+            if (!lib::store_file(filename, content.data(), content.size(), error)) {
                 emscripten_console_error("Failed to open file for writing");
                 return -1;
             }
-            
-            file << content;
+            lib::file_changed(filename);
             return 0;
         } else {
             emscripten_console_log(args.c_str());
@@ -8,7 +8,40 @@ namespace commands {
         {"ls", ls},
         {"cat", cat},
         {"echo", echo},
-        {"rm", rm}
+        {"rm", rm},
+        {"head", head},
+        {"tail", tail},
+        {"diff", diff},
+        {"sed", sed},
+        {"cut", cut},
+        {"fields", fields},
+        {"json", json},
+        {"csv", csv},
+        {"base64", base64},
+        {"xxd", xxd},
+        {"sha256sum", sha256sum},
+        {"b3sum", b3sum},
+        {"xxh", xxh},
+        {"crc32c", crc32c},
+        {"lines", lines},
+        {"search", search},
+        {"fts", fts},
+        {"fzf", fzf},
+        {"find", find},
+        {"du", du},
+        {"cp", cp},
+        {"mv", mv},
+        {"lz4", lz4},
+        {"zstd", zstd},
+        {"gzip", gzip},
+        {"gunzip", gunzip},
+        {"tar", tar},
+        {"mount", mount},
+        {"umount", umount},
+        {"blockz", blockz},
+        {"kv", kv},
+        {"btree", btree},
+        {"dedup", dedup}
     };
 
     int execute_command(const std::string& command) {
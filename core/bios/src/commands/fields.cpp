@@ -0,0 +1,143 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "field_program.hpp"
+#include "flat_map.hpp"
+#include "line_reader.hpp"
+#include "search.hpp"
+#include <emscripten/console.h>
+
+namespace commands {
+    // `fields` runs a lib::FieldProgram over delimited records. Records are
+    // split into views of the read buffer; nothing is copied except group
+    // keys the first time they are seen.
+
+    static std::string_view field_of(const lib::FieldRef& ref, std::string_view record, const std::vector<std::string_view>& fields) {
+        if (ref.index == 0) return record;
+        return ref.index <= fields.size() ? fields[ref.index - 1] : std::string_view();
+    }
+
+    // A file that could not be read to the end fails the command, rather
+    // than counting as a shorter file
+    static int read_error(const lib::LineReader& reader) {
+        std::string error = "fields: " + reader.error();
+        emscripten_console_error(error.c_str());
+        return -1;
+    }
+
+    int fields(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        char delim = '\t';
+        bool header = false;
+        std::string source;
+        bool have_program = false;
+        std::vector<std::string> paths;
+
+        for (size_t i = 0; i < argv.size(); ++i) {
+            const std::string& arg = argv[i];
+            if (arg == "-d" && i + 1 < argv.size()) {
+                delim = argv[++i].empty() ? '\t' : argv[i][0];
+            } else if (arg.size() > 2 && arg.compare(0, 2, "-d") == 0) {
+                delim = arg[2];
+            } else if (arg == "-H") {
+                header = true;
+            } else if (!have_program) {
+                source = arg;
+                have_program = true;
+            } else {
+                paths.push_back(arg);
+            }
+        }
+
+        if (!have_program || paths.empty()) {
+            emscripten_console_error("Usage: fields [-d delim] [-H] '<program>' <filename>...");
+            return -1;
+        }
+
+        lib::FieldProgram program;
+        std::string error;
+        if (!lib::parse_program(source, program, error)) {
+            error = "fields: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+
+        if (!header && !program.resolve(std::vector<std::string>(), error)) {
+            error = "fields: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+
+        Output output;
+        lib::Aggregate total;
+        lib::FlatHashMap<lib::Aggregate> groups;
+        std::vector<std::string_view> record_fields;
+        const bool counting = program.action == lib::FieldProgram::kCount;
+
+        for (const std::string& path : paths) {
+            lib::LineReader reader(path);
+            if (!reader.is_open()) {
+                emscripten_console_error("Failed to open file");
+                return -1;
+            }
+
+            std::string_view line;
+            bool terminated;
+            if (header) {
+                if (!reader.next(line, terminated)) {
+                    if (reader.failed()) return read_error(reader);
+                    continue;
+                }
+                lib::split_fields(line, delim, record_fields);
+                std::vector<std::string> names(record_fields.begin(), record_fields.end());
+                if (!program.resolve(names, error)) {
+                    error = "fields: " + error;
+                    emscripten_console_error(error.c_str());
+                    return -1;
+                }
+            }
+
+            while (reader.next(line, terminated)) {
+                if (line.empty() && !terminated) break;
+                lib::split_fields(line, delim, record_fields);
+
+                bool keep = true;
+                for (const lib::Condition& condition : program.where) {
+                    if (!lib::test(condition, field_of(condition.field, line, record_fields))) {
+                        keep = false;
+                        break;
+                    }
+                }
+                if (!keep) continue;
+
+                if (program.action == lib::FieldProgram::kPrint) {
+                    for (size_t i = 0; i < program.print.size(); ++i) {
+                        if (i) output.write(std::string_view(&delim, 1));
+                        output.write(field_of(program.print[i], line, record_fields));
+                    }
+                    output.write("\n");
+                    continue;
+                }
+
+                std::string_view value = field_of(program.value, line, record_fields);
+                if (program.grouped) {
+                    lib::accumulate(groups[field_of(program.key, line, record_fields)], value, counting);
+                } else {
+                    lib::accumulate(total, value, counting);
+                }
+            }
+            if (reader.failed()) return read_error(reader);
+        }
+
+        if (program.action == lib::FieldProgram::kPrint) return 0;
+        if (!program.grouped) {
+            output.line(lib::format_result(total, program.action));
+            return 0;
+        }
+        for (const auto& entry : groups.entries()) {
+            output.write(entry.first);
+            output.write(std::string_view(&delim, 1));
+            output.line(lib::format_result(entry.second, program.action));
+        }
+        return 0;
+    }
+}
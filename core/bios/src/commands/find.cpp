@@ -0,0 +1,41 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "tree_walk.hpp"
+#include <emscripten/console.h>
+
+namespace commands {
+    // `find [path...] [-name glob] [-type f|d|l] [-size [+-]N[ckMG]] [-newer file]`
+    // lists everything under each path (default ".") that passes every
+    // predicate, sorted by path
+    int find(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        size_t first = 0;
+        while (first < argv.size() && (argv[first].empty() || argv[first][0] != '-')) ++first;
+
+        lib::WalkFilter filter;
+        std::string error;
+        if (!lib::parse_walk_filter(argv, first, filter, error)) {
+            error = "find: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+
+        std::vector<std::string> roots(argv.begin(), argv.begin() + first);
+        if (roots.empty()) roots.push_back(".");
+
+        Output output;
+        int status = 0;
+        for (const std::string& root : roots) {
+            std::vector<lib::WalkEntry> matches;
+            lib::WalkTotals totals;
+            if (!lib::walk_tree(root, filter, &matches, totals, error)) {
+                error = "find: " + error;
+                emscripten_console_error(error.c_str());
+                status = -1;
+                continue;
+            }
+            for (const lib::WalkEntry& entry : matches) output.line(entry.path);
+        }
+        return status;
+    }
+}
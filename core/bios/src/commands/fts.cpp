@@ -0,0 +1,124 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "fts.hpp"
+#include "block_file.hpp"
+#include <emscripten/console.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace commands {
+    // Index one file, or every file under a directory, keyed by path.
+    // Binary files (a NUL in the first block) are skipped.
+    static size_t add_path(lib::FtsIndex& index, const std::string& path, std::string& error) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return 0;
+
+        if (S_ISDIR(st.st_mode)) {
+            if (path == "/.bios") return 0;
+            DIR* dir = opendir(path.c_str());
+            if (!dir) return 0;
+            std::vector<std::string> children;
+            while (struct dirent* entry = readdir(dir)) {
+                if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+                children.push_back(path.back() == '/' ? path + entry->d_name : path + "/" + entry->d_name);
+            }
+            closedir(dir);
+
+            size_t added = 0;
+            for (const std::string& child : children) {
+                added += add_path(index, child, error);
+                if (!error.empty()) break;
+            }
+            return added;
+        }
+
+        std::string text, read_error;
+        if (!S_ISREG(st.st_mode) || !lib::load_file(path, text, read_error)) return 0;
+        if (memchr(text.data(), '\0', std::min<size_t>(text.size(), kBlockSize))) return 0;
+
+        return index.add(path, text, error) ? 1 : 0;
+    }
+
+    // `fts --add <path>...` indexes files and directory trees, `fts --remove
+    // <path>...` drops them, and `fts [-n count] <words>` lists the best
+    // matching documents by BM25 score. `fts --stats` describes the index.
+    int fts(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        if (argv.empty()) {
+            emscripten_console_error("Usage: fts [-n count] <words> | fts --add <path>... | fts --remove <path>... | fts --stats");
+            return -1;
+        }
+
+        lib::FtsIndex* index = lib::fts_index();
+        Output output;
+        std::string error;
+
+        if (argv[0] == "--add" || argv[0] == "--remove") {
+            if (argv.size() < 2) {
+                emscripten_console_error(argv[0] == "--add" ? "Usage: fts --add <path>..." : "Usage: fts --remove <path>...");
+                return -1;
+            }
+
+            size_t changed = 0;
+            for (size_t i = 1; i < argv.size() && error.empty(); ++i) {
+                if (argv[0] == "--add") {
+                    changed += add_path(*index, argv[i], error);
+                } else if (index->remove(argv[i])) {
+                    ++changed;
+                } else {
+                    std::string message = "fts: not indexed: " + argv[i];
+                    emscripten_console_warn(message.c_str());
+                }
+            }
+
+            if (!error.empty() || !index->commit(error)) {
+                error = "fts: " + error;
+                emscripten_console_error(error.c_str());
+                return -1;
+            }
+            output.line((argv[0] == "--add" ? "indexed " : "removed ") + std::to_string(changed) + " documents");
+            return 0;
+        }
+
+        if (argv[0] == "--stats") {
+            if (!index->commit(error)) {
+                error = "fts: " + error;
+                emscripten_console_error(error.c_str());
+                return -1;
+            }
+            output.line("documents: " + std::to_string(index->document_count()));
+            output.line("segments: " + std::to_string(index->segment_count()));
+            return 0;
+        }
+
+        size_t count = 10;
+        size_t first = 0;
+        if (argv[0] == "-n") {
+            if (argv.size() < 3 || std::atoll(argv[1].c_str()) <= 0) {
+                emscripten_console_error("Usage: fts [-n count] <words>");
+                return -1;
+            }
+            count = static_cast<size_t>(std::atoll(argv[1].c_str()));
+            first = 2;
+        }
+
+        std::string query;
+        for (size_t i = first; i < argv.size(); ++i) query += argv[i] + " ";
+        std::vector<lib::FtsIndex::Hit> hits = index->query(query, count, error);
+        if (!error.empty()) {
+            error = "fts: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+
+        char score[32];
+        for (const lib::FtsIndex::Hit& hit : hits) {
+            snprintf(score, sizeof(score), "%.4f  ", hit.score);
+            output.line(score + hit.key);
+        }
+        return 0;
+    }
+}
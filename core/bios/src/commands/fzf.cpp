@@ -0,0 +1,31 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "path_index.hpp"
+#include <emscripten/console.h>
+#include <cstdlib>
+
+namespace commands {
+    // `fzf [-n count] <query>` lists the files whose paths best match
+    // `query` as a fuzzy subsequence, best first (10 by default)
+    int fzf(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        size_t count = 10;
+        size_t first = 0;
+        if (!argv.empty() && argv[0] == "-n") {
+            if (argv.size() < 2 || std::atoll(argv[1].c_str()) <= 0) {
+                emscripten_console_error("Usage: fzf [-n count] <query>");
+                return -1;
+            }
+            count = static_cast<size_t>(std::atoll(argv[1].c_str()));
+            first = 2;
+        }
+        if (argv.size() != first + 1) {
+            emscripten_console_error("Usage: fzf [-n count] <query>");
+            return -1;
+        }
+
+        Output output;
+        for (const lib::PathIndex::Match& match : lib::path_index()->find(argv[first], count)) output.line(match.path);
+        return 0;
+    }
+}
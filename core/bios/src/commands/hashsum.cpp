@@ -0,0 +1,141 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "hash.hpp"
+#include "block_file.hpp"
+#include "line_reader.hpp"
+#include <emscripten/console.h>
+
+namespace commands {
+    // Large reads let BLAKE3 hash whole subtrees per update()
+    static const size_t kHashBlockSize = 16 * kBlockSize;
+
+    // Hash one file; false if it cannot be read
+    static bool hash_file(lib::Hasher::Algorithm algorithm, const std::string& path, std::string& block, std::string& digest) {
+        lib::BlockReader file;
+        std::string error;
+        if (!file.open(path, error)) return false;
+
+        lib::Hasher hasher(algorithm);
+        for (uint64_t offset = 0; offset < file.size(); offset += block.size()) {
+            block.clear();
+            if (!file.read(offset, kHashBlockSize, block, error) || block.empty()) return false;
+            hasher.update(reinterpret_cast<const uint8_t*>(block.data()), block.size());
+        }
+
+        digest = hasher.hex_digest();
+        return true;
+    }
+
+    // Verify "<digest>  <path>" lines as written by the same command
+    static int check_sums(const char* name, lib::Hasher::Algorithm algorithm, const std::string& list, Output& output) {
+        lib::LineReader reader(list);
+        if (!reader.is_open()) {
+            emscripten_console_error("Failed to open file");
+            return -1;
+        }
+
+        std::string block;
+        std::string_view line;
+        bool terminated;
+        std::string digest;
+        size_t failed = 0;
+
+        while (reader.next(line, terminated)) {
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (line.empty()) continue;
+
+            size_t space = line.find(' ');
+            if (space == std::string_view::npos || space + 2 > line.size()) {
+                std::string message = std::string(name) + ": improperly formatted line";
+                emscripten_console_warn(message.c_str());
+                continue;
+            }
+            std::string_view expected = line.substr(0, space);
+            // Second separator is ' ' for text mode or '*' for binary mode
+            std::string path(line.substr(space + 2));
+
+            std::string result = path;
+            if (!hash_file(algorithm, path, block, digest)) {
+                result += ": FAILED open or read";
+                ++failed;
+            } else if (digest != expected) {
+                result += ": FAILED";
+                ++failed;
+            } else {
+                result += ": OK";
+            }
+            output.line(result);
+        }
+        if (reader.failed()) {
+            std::string message = std::string(name) + ": " + reader.error();
+            emscripten_console_error(message.c_str());
+            return -1;
+        }
+
+        if (failed) {
+            std::string message = std::string(name) + ": " + std::to_string(failed) + " computed checksum(s) did NOT match";
+            emscripten_console_warn(message.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    static int hash_command(const char* name, lib::Hasher::Algorithm algorithm, const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        bool check = false;
+        std::vector<std::string> paths;
+
+        for (const std::string& arg : argv) {
+            if (arg == "-c") {
+                check = true;
+            } else {
+                paths.push_back(arg);
+            }
+        }
+
+        if (paths.empty()) {
+            std::string usage = std::string("Usage: ") + name + " [-c] <filename>...";
+            emscripten_console_error(usage.c_str());
+            return -1;
+        }
+
+        Output output;
+        if (check) {
+            int status = 0;
+            for (const std::string& path : paths) {
+                if (check_sums(name, algorithm, path, output) != 0) status = -1;
+            }
+            return status;
+        }
+
+        std::string block;
+        std::string digest;
+        int status = 0;
+        for (const std::string& path : paths) {
+            if (!hash_file(algorithm, path, block, digest)) {
+                std::string message = std::string(name) + ": " + path + ": Failed to read file";
+                emscripten_console_error(message.c_str());
+                status = -1;
+                continue;
+            }
+            output.line(digest + "  " + path);
+        }
+        return status;
+    }
+
+    int sha256sum(const std::string& args) {
+        return hash_command("sha256sum", lib::Hasher::kSha256, args);
+    }
+
+    int b3sum(const std::string& args) {
+        return hash_command("b3sum", lib::Hasher::kBlake3, args);
+    }
+
+    int xxh(const std::string& args) {
+        return hash_command("xxh", lib::Hasher::kXxh3, args);
+    }
+
+    int crc32c(const std::string& args) {
+        return hash_command("crc32c", lib::Hasher::kCrc32c, args);
+    }
+}
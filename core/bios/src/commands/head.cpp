@@ -0,0 +1,69 @@
+#include "commands.hpp"
+#include "block_file.hpp"
+#include <emscripten/console.h>
+#include <cstdlib>
+#include <cstring>
+
+namespace commands {
+    int head(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        long count = 10;
+        std::string path;
+
+        for (size_t i = 0; i < argv.size(); ++i) {
+            if (argv[i] == "-n" && i + 1 < argv.size()) {
+                count = std::strtol(argv[++i].c_str(), nullptr, 10);
+            } else if (argv[i].size() > 2 && argv[i].compare(0, 2, "-n") == 0) {
+                count = std::strtol(argv[i].c_str() + 2, nullptr, 10);
+            } else {
+                path = argv[i];
+            }
+        }
+
+        if (path.empty() || count < 0) {
+            emscripten_console_error("Usage: head [-n lines] <filename>");
+            return -1;
+        }
+
+        lib::BlockReader file;
+        std::string error;
+        if (!file.open(path, error)) {
+            emscripten_console_error("Failed to open file");
+            return -1;
+        }
+
+        // Read forward a block at a time and stop at the Nth newline
+        std::string output;
+        std::string buffer;
+        uint64_t offset = 0;
+        long seen = 0;
+
+        while (seen < count && offset < file.size()) {
+            buffer.clear();
+            if (!file.read(offset, kBlockSize, buffer, error)) {
+                emscripten_console_error("Failed to read file");
+                return -1;
+            }
+            size_t got = buffer.size();
+            offset += got;
+
+            const char* start = buffer.data();
+            const char* end = start + got;
+            const char* cursor = start;
+            while (seen < count) {
+                const char* nl = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+                if (!nl) {
+                    cursor = end;
+                    break;
+                }
+                cursor = nl + 1;
+                ++seen;
+            }
+            output.append(start, cursor - start);
+        }
+
+        if (!output.empty() && output.back() == '\n') output.pop_back();
+        emscripten_console_log(output.c_str());
+        return 0;
+    }
+}
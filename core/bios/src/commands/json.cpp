@@ -0,0 +1,57 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "json.hpp"
+#include "block_file.hpp"
+#include <emscripten/console.h>
+
+namespace commands {
+    int json(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        bool raw = false;
+        std::vector<std::string> positional;
+
+        for (const std::string& arg : argv) {
+            if (arg == "-r") {
+                raw = true;
+            } else {
+                positional.push_back(arg);
+            }
+        }
+
+        if (positional.size() != 2) {
+            emscripten_console_error("Usage: json [-r] <path> <filename>");
+            return -1;
+        }
+
+        lib::BlockReader file;
+        std::string content, error;
+        if (!file.open(positional[1], error)) {
+            emscripten_console_error("Failed to open file");
+            return -1;
+        }
+        if (!file.read(0, static_cast<size_t>(file.size()), content, error)) {
+            emscripten_console_error("Failed to read file");
+            return -1;
+        }
+
+        lib::JsonDocument document;
+        std::vector<std::string_view> results;
+        if (!document.index(content.data(), content.size(), error) || !document.query(positional[0], results, error)) {
+            error = "json: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+
+        Output output;
+        std::string decoded;
+        for (std::string_view result : results) {
+            // -r prints strings without quotes or escapes
+            if (raw && result.size() >= 2 && result.front() == '"' && lib::json_unescape(result.substr(1, result.size() - 2), decoded)) {
+                output.line(decoded);
+            } else {
+                output.line(result);
+            }
+        }
+        return results.empty() ? 1 : 0;
+    }
+}
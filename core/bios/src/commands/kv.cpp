@@ -0,0 +1,85 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "kv_store.hpp"
+#include <emscripten/console.h>
+#include <cstdio>
+#include <cstdlib>
+
+namespace commands {
+    // `kv <dir> get <key>`, `put <key> <value>`, `del <key>`,
+    // `scan [start] [end] [-n limit]`, `flush`, `compact` or `stats`
+    // works on the key-value store kept in a directory
+    int kv(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        if (argv.size() < 2) {
+            emscripten_console_error("Usage: kv <dir> get|put|del|scan|flush|compact|stats [args...]");
+            return -1;
+        }
+
+        std::string error;
+        lib::KvStore* store = lib::kv_store(argv[0], error);
+        if (!store) {
+            error = "kv: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+
+        const std::string& op = argv[1];
+        Output output;
+        bool ok;
+        if (op == "get" && argv.size() == 3) {
+            std::string value;
+            ok = store->get(argv[2], value, error);
+            if (ok) {
+                output.line(value);
+            } else if (error.empty()) {
+                error = argv[2] + ": not found";
+            }
+        } else if (op == "put" && argv.size() == 4) {
+            ok = store->put(argv[2], argv[3], error);
+        } else if (op == "del" && argv.size() == 3) {
+            ok = store->remove(argv[2], error);
+        } else if (op == "scan") {
+            std::string bounds[2];
+            size_t count = 0;
+            size_t limit = static_cast<size_t>(-1);
+            for (size_t i = 2; i < argv.size(); ++i) {
+                if (argv[i] == "-n" && i + 1 < argv.size()) {
+                    limit = strtoul(argv[++i].c_str(), nullptr, 10);
+                } else if (count < 2) {
+                    bounds[count++] = argv[i];
+                } else {
+                    emscripten_console_error("Usage: kv <dir> scan [start] [end] [-n limit]");
+                    return -1;
+                }
+            }
+            std::vector<std::pair<std::string, std::string>> pairs;
+            ok = store->scan(bounds[0], bounds[1], limit, pairs, error);
+            for (const auto& pair : pairs) output.line(pair.first + "\t" + pair.second);
+        } else if (op == "flush" && argv.size() == 2) {
+            ok = store->flush(error);
+        } else if (op == "compact" && argv.size() == 2) {
+            ok = store->compact(error);
+        } else if (op == "stats" && argv.size() == 2) {
+            lib::KvStore::Stats stats = store->stats();
+            char line[160];
+            snprintf(line, sizeof(line), "memtable\t%zu entries\t%zu bytes", stats.memtable_entries, stats.memtable_bytes);
+            output.line(line);
+            snprintf(line, sizeof(line), "tables\t%zu\t%llu entries\t%llu bytes%s", stats.tables,
+                     static_cast<unsigned long long>(stats.table_entries),
+                     static_cast<unsigned long long>(stats.table_bytes), stats.compacting ? "\tcompacting" : "");
+            output.line(line);
+            ok = true;
+        } else {
+            emscripten_console_error("Usage: kv <dir> get|put|del|scan|flush|compact|stats [args...]");
+            return -1;
+        }
+
+        if (!ok) {
+            error = "kv: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+}
@@ -0,0 +1,58 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "line_index.hpp"
+#include <emscripten/console.h>
+#include <cstdlib>
+#include <algorithm>
+
+namespace commands {
+    // `lines <file>` prints the line count; `lines <file> <start> [count]`
+    // prints `count` lines from 1-based line `start` through the file's
+    // saved line index, so paging deep into a large file costs one seek.
+    int lines(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        if (argv.empty() || argv.size() > 3) {
+            emscripten_console_error("Usage: lines <filename> [start [count]]");
+            return -1;
+        }
+
+        long long start = argv.size() > 1 ? std::strtoll(argv[1].c_str(), nullptr, 10) : 0;
+        long long count = argv.size() > 2 ? std::strtoll(argv[2].c_str(), nullptr, 10) : 10;
+        if (argv.size() > 1 && (start < 1 || count < 0)) {
+            emscripten_console_error("lines: start must be at least 1 and count non-negative");
+            return -1;
+        }
+
+        lib::LineIndex index;
+        std::string error;
+        if (!index.open(argv[0], error)) {
+            error = "lines: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+
+        Output output;
+        if (argv.size() == 1) {
+            output.line(std::to_string(index.line_count()));
+            return 0;
+        }
+
+        // Fetch a sample interval at a time so memory stays bounded
+        std::string text;
+        uint64_t first = static_cast<uint64_t>(start - 1);
+        uint64_t remaining = static_cast<uint64_t>(count);
+        while (remaining > 0 && first < index.line_count()) {
+            uint64_t batch = std::min<uint64_t>(remaining, lib::LineIndex::kInterval);
+            text.clear();
+            if (!index.read_lines(first, batch, text, error)) {
+                error = "lines: " + error;
+                emscripten_console_error(error.c_str());
+                return -1;
+            }
+            output.write(text);
+            first += batch;
+            remaining -= batch;
+        }
+        return 0;
+    }
+}
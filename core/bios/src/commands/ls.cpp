@@ -1,4 +1,5 @@
 #include "commands.hpp"
+#include "zip.hpp"
 #include <emscripten/console.h>
 #include <dirent.h>
 #include <sys/stat.h>
@@ -10,6 +11,22 @@ namespace commands {
         
         emscripten_console_log("Listing directory:");
         emscripten_console_log(path);
+
+        // Inside a mounted zip the listing comes from its central directory
+        std::string member;
+        if (lib::ZipArchive* archive = lib::zip_lookup(path, member)) {
+            std::vector<std::string> children;
+            if (!archive->list(member, children)) {
+                emscripten_console_error("Failed to open directory: ");
+                emscripten_console_error(path);
+                return -1;
+            }
+            for (const std::string& child : children) {
+                std::string entry_info = child.back() == '/' ? "d " + child.substr(0, child.size() - 1) : "- " + child;
+                emscripten_console_log(entry_info.c_str());
+            }
+            return 0;
+        }
         
         DIR* dir = opendir(path);
         if (!dir) {
@@ -0,0 +1,45 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "zip.hpp"
+#include <emscripten/console.h>
+
+namespace commands {
+    // `mount <archive.zip> <dir>` makes a zip archive readable under an
+    // absolute directory without extracting it; `mount` alone lists the
+    // mounts
+    int mount(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        Output output;
+        if (argv.empty()) {
+            for (const auto& mount : lib::zip_mounts()) output.line(mount.second + " on " + mount.first);
+            return 0;
+        }
+        if (argv.size() != 2) {
+            emscripten_console_error("Usage: mount <archive.zip> <dir>");
+            return -1;
+        }
+
+        std::string error;
+        if (!lib::zip_mount(argv[0], argv[1], error)) {
+            error = "mount: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    // `umount <dir>` drops the mount on a directory
+    int umount(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        if (argv.size() != 1) {
+            emscripten_console_error("Usage: umount <dir>");
+            return -1;
+        }
+        if (!lib::zip_unmount(argv[0])) {
+            std::string error = "umount: " + argv[0] + ": not mounted";
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+        return 0;
+    }
+}
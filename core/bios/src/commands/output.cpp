@@ -0,0 +1,28 @@
+#include "output.hpp"
+#include "commands.hpp"
+#include <emscripten/console.h>
+
+namespace commands {
+    void Output::write(std::string_view data) {
+        buffer_.append(data.data(), data.size());
+        if (buffer_.size() >= kBlockSize) flush(false);
+    }
+
+    void Output::flush(bool final) {
+        if (file_) {
+            file_->write(buffer_.data(), buffer_.size());
+            buffer_.clear();
+            return;
+        }
+        if (buffer_.empty()) return;
+
+        size_t end = final ? buffer_.size() : buffer_.rfind('\n');
+        if (end == std::string::npos) return;
+
+        // The console adds its own line break
+        size_t len = end > 0 && buffer_[end - 1] == '\n' && end == buffer_.size() ? end - 1 : end;
+        std::string chunk = buffer_.substr(0, len);
+        emscripten_console_log(chunk.c_str());
+        buffer_.erase(0, end < buffer_.size() ? end + 1 : end);
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace commands {
+    // Collects command output and logs it to the console in batches of
+    // complete lines, or writes it to a file when one is given
+    class Output {
+    public:
+        explicit Output(std::ofstream* file = nullptr) : file_(file) {}
+        ~Output() { flush(true); }
+
+        void write(std::string_view data);
+
+        // Write `data` followed by a newline
+        void line(std::string_view data) {
+            write(data);
+            write("\n");
+        }
+
+        // Emit buffered output; unless `final`, a trailing partial line is kept
+        void flush(bool final);
+
+    private:
+        std::ofstream* file_;
+        std::string buffer_;
+    };
+}
@@ -1,4 +1,6 @@
 #include "commands.hpp"
+#include "file_events.hpp"
+#include "zip.hpp"
 #include <emscripten/console.h>
 
 namespace commands {
@@ -8,7 +10,14 @@ namespace commands {
             return -1;
         }
 
+        std::string member;
+        if (lib::zip_lookup(args, member)) {
+            emscripten_console_error("Cannot delete from a read-only zip mount");
+            return -1;
+        }
+
         if (remove(args.c_str()) == 0) {
+            lib::file_removed(args);
             return 0;
         } else {
             emscripten_console_error("Failed to delete file");
@@ -0,0 +1,78 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "trigram_index.hpp"
+#include <emscripten/console.h>
+
+namespace commands {
+    // `search --index <root>` builds the trigram index over a directory tree;
+    // `search [-i] [-l] <text>` then lists matching lines as path:line:text
+    // (or only the matching paths with -l), reading just the files whose
+    // trigrams cover the query. `search --stats` describes the index.
+    int search(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        if (argv.empty()) {
+            emscripten_console_error("Usage: search [-i] [-l] <text> | search --index <root> | search --stats");
+            return -1;
+        }
+
+        Output output;
+        std::string error;
+        if (argv[0] == "--index") {
+            if (argv.size() != 2) {
+                emscripten_console_error("Usage: search --index <root>");
+                return -1;
+            }
+            lib::TrigramIndex* index = lib::build_search_index(argv[1], error);
+            if (!index) {
+                error = "search: " + error;
+                emscripten_console_error(error.c_str());
+                return -1;
+            }
+            output.line("indexed " + std::to_string(index->file_count()) + " files under " + index->root());
+            return 0;
+        }
+
+        lib::TrigramIndex* index = lib::search_index();
+        if (!index) {
+            emscripten_console_error("search: no index; build one with `search --index <root>`");
+            return -1;
+        }
+
+        if (argv[0] == "--stats") {
+            output.line("root: " + index->root());
+            output.line("files: " + std::to_string(index->file_count()));
+            output.line("trigrams: " + std::to_string(index->trigram_count()));
+            return 0;
+        }
+
+        bool ignore_case = false;
+        bool files_only = false;
+        size_t i = 0;
+        for (; i < argv.size() && argv[i].size() > 1 && argv[i][0] == '-'; ++i) {
+            if (argv[i] == "-i") {
+                ignore_case = true;
+            } else if (argv[i] == "-l") {
+                files_only = true;
+            } else {
+                break;
+            }
+        }
+        if (i + 1 != argv.size() || argv[i].empty()) {
+            emscripten_console_error("Usage: search [-i] [-l] <text>");
+            return -1;
+        }
+
+        std::string last_path;
+        index->search(argv[i], ignore_case, [&](const std::string& path, size_t line, std::string_view text) {
+            if (files_only) {
+                if (path != last_path) output.line(path);
+                last_path = path;
+                return;
+            }
+            output.write(path);
+            output.write(":" + std::to_string(line) + ":");
+            output.line(text);
+        });
+        return 0;
+    }
+}
@@ -0,0 +1,387 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "line_reader.hpp"
+#include "regex.hpp"
+#include "block_file.hpp"
+#include "file_events.hpp"
+#include <emscripten/console.h>
+#include <fstream>
+#include <memory>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <sys/stat.h>
+
+namespace commands {
+    struct SedAddress {
+        enum Type { kNone, kLine, kLast, kPattern } type = kNone;
+        long line = 0;
+        std::shared_ptr<lib::Regex> pattern;
+    };
+
+    struct SedCommand {
+        SedAddress first;
+        SedAddress last;
+        bool range = false;
+        bool active = false;     // Inside an address range
+        char name = 0;           // 's', 'd' or 'p'
+        lib::Regex pattern;
+        std::string replacement;
+        bool global = false;
+        bool print = false;
+        long occurrence = 1;
+    };
+
+    static bool parse_delimited(const std::string& script, size_t& pos, char delim, std::string& out) {
+        while (pos < script.size() && script[pos] != delim) {
+            if (script[pos] == '\\' && pos + 1 < script.size()) {
+                // Escaped delimiters lose their backslash; other escapes are kept for the regex
+                if (script[pos + 1] != delim) out += '\\';
+                out += script[pos + 1];
+                pos += 2;
+                continue;
+            }
+            out += script[pos++];
+        }
+        if (pos >= script.size()) return false;
+        ++pos;
+        return true;
+    }
+
+    static bool parse_address(const std::string& script, size_t& pos, int flags, SedAddress& address, std::string& error) {
+        if (pos >= script.size()) return true;
+        char c = script[pos];
+        if (isdigit(static_cast<unsigned char>(c))) {
+            address.type = SedAddress::kLine;
+            address.line = std::strtol(script.c_str() + pos, nullptr, 10);
+            while (pos < script.size() && isdigit(static_cast<unsigned char>(script[pos]))) ++pos;
+        } else if (c == '$') {
+            address.type = SedAddress::kLast;
+            ++pos;
+        } else if (c == '/') {
+            std::string source;
+            ++pos;
+            if (!parse_delimited(script, pos, '/', source)) {
+                error = "unterminated address regex";
+                return false;
+            }
+            address.type = SedAddress::kPattern;
+            address.pattern = std::make_shared<lib::Regex>();
+            if (!address.pattern->compile(source, flags, &error)) return false;
+        }
+        return true;
+    }
+
+    static bool parse_script(const std::string& script, int flags, std::vector<SedCommand>& commands, std::string& error) {
+        size_t pos = 0;
+        while (pos < script.size()) {
+            char c = script[pos];
+            if (c == ';' || c == '\n' || c == ' ' || c == '\t') {
+                ++pos;
+                continue;
+            }
+
+            SedCommand command;
+            if (!parse_address(script, pos, flags, command.first, error)) return false;
+            if (pos < script.size() && script[pos] == ',') {
+                ++pos;
+                command.range = true;
+                if (!parse_address(script, pos, flags, command.last, error)) return false;
+                if (command.last.type == SedAddress::kNone) {
+                    error = "missing range end";
+                    return false;
+                }
+            }
+            while (pos < script.size() && script[pos] == ' ') ++pos;
+            if (pos >= script.size()) {
+                error = "missing command";
+                return false;
+            }
+
+            command.name = script[pos++];
+            if (command.name == 's') {
+                if (pos >= script.size()) {
+                    error = "unterminated s command";
+                    return false;
+                }
+                char delim = script[pos++];
+                std::string source;
+                if (!parse_delimited(script, pos, delim, source) || !parse_delimited(script, pos, delim, command.replacement)) {
+                    error = "unterminated s command";
+                    return false;
+                }
+
+                int pattern_flags = flags;
+                while (pos < script.size() && script[pos] != ';' && script[pos] != '\n') {
+                    char flag = script[pos];
+                    if (flag == 'g') {
+                        command.global = true;
+                    } else if (flag == 'p') {
+                        command.print = true;
+                    } else if (flag == 'I' || flag == 'i') {
+                        pattern_flags |= lib::Regex::kIgnoreCase;
+                    } else if (isdigit(static_cast<unsigned char>(flag))) {
+                        command.occurrence = std::strtol(script.c_str() + pos, nullptr, 10);
+                        while (pos + 1 < script.size() && isdigit(static_cast<unsigned char>(script[pos + 1]))) ++pos;
+                    } else if (flag != ' ') {
+                        error = std::string("unknown option to s: ") + flag;
+                        return false;
+                    }
+                    ++pos;
+                }
+                if (command.occurrence < 1) {
+                    error = "invalid occurrence";
+                    return false;
+                }
+                if (!command.pattern.compile(source, pattern_flags, &error)) return false;
+            } else if (command.name != 'd' && command.name != 'p') {
+                error = std::string("unknown command: ") + command.name;
+                return false;
+            }
+
+            commands.push_back(std::move(command));
+        }
+        return true;
+    }
+
+    static bool address_matches(const SedAddress& address, const std::string& line, long number, bool last) {
+        lib::Regex::Match match;
+        switch (address.type) {
+            case SedAddress::kNone: return true;
+            case SedAddress::kLine: return number == address.line;
+            case SedAddress::kLast: return last;
+            case SedAddress::kPattern: return address.pattern->search(line, 0, match);
+        }
+        return false;
+    }
+
+    static bool selects(SedCommand& command, const std::string& line, long number, bool last) {
+        if (!command.range) return address_matches(command.first, line, number, last);
+
+        if (!command.active) {
+            if (!address_matches(command.first, line, number, last)) return false;
+            // A line-number end at or before the start closes the range immediately
+            command.active = !(command.last.type == SedAddress::kLine && command.last.line <= number);
+            return true;
+        }
+        if (address_matches(command.last, line, number, last) ||
+            (command.last.type == SedAddress::kLine && number > command.last.line)) {
+            command.active = false;
+        }
+        return true;
+    }
+
+    static void append_replacement(std::string& out, const std::string& replacement, const std::string& line,
+                                   const lib::Regex::Match& match) {
+        for (size_t i = 0; i < replacement.size(); ++i) {
+            char c = replacement[i];
+            if (c == '&') {
+                out.append(line, match.start[0], match.end[0] - match.start[0]);
+            } else if (c == '\\' && i + 1 < replacement.size()) {
+                char next = replacement[++i];
+                if (next >= '0' && next <= '9') {
+                    size_t group = next - '0';
+                    if (group < lib::Regex::kMaxGroups && match.matched(group)) {
+                        out.append(line, match.start[group], match.end[group] - match.start[group]);
+                    }
+                } else if (next == 'n') {
+                    out += '\n';
+                } else if (next == 't') {
+                    out += '\t';
+                } else {
+                    out += next;
+                }
+            } else {
+                out += c;
+            }
+        }
+    }
+
+    static bool substitute(const SedCommand& command, std::string& line) {
+        std::string result;
+        lib::Regex::Match match;
+        size_t copied = 0;
+        size_t from = 0;
+        size_t previous_end = std::string::npos;
+        long count = 0;
+        bool replaced = false;
+
+        while (from <= line.size() && command.pattern.search(line, from, match)) {
+            size_t start = match.start[0];
+            size_t end = match.end[0];
+
+            // An empty match right after the previous match is not a new match
+            if (start == end && start == previous_end) {
+                from = start + 1;
+                continue;
+            }
+
+            if (++count >= command.occurrence) {
+                result.append(line, copied, start - copied);
+                append_replacement(result, command.replacement, line, match);
+                copied = end;
+                replaced = true;
+                if (!command.global) break;
+            }
+
+            previous_end = end;
+            from = start == end ? end + 1 : end;
+        }
+
+        if (!replaced) return false;
+        result.append(line, copied, std::string::npos);
+        line.swap(result);
+        return true;
+    }
+
+    // Run the script over one input stream. Line numbers carry across files
+    // unless editing in place.
+    static void run_script(std::vector<SedCommand>& commands, lib::LineReader& reader, Output& output,
+                           bool quiet, bool final_input, long& number) {
+        std::string line;
+        std::string_view view;
+        bool terminated;
+        while (reader.next(view, terminated)) {
+            line.assign(view.data(), view.size());
+            ++number;
+            bool last = final_input && reader.at_end();
+            bool deleted = false;
+
+            for (SedCommand& command : commands) {
+                if (!selects(command, line, number, last)) continue;
+                if (command.name == 'd') {
+                    deleted = true;
+                    break;
+                }
+                if (command.name == 'p') {
+                    output.line(line);
+                } else if (substitute(command, line) && command.print) {
+                    output.line(line);
+                }
+            }
+
+            if (!deleted && !quiet) {
+                output.write(line);
+                if (terminated) output.write("\n");
+            }
+        }
+    }
+
+    int sed(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        bool quiet = false;
+        bool in_place = false;
+        int flags = 0;
+        std::string script;
+        bool have_script = false;
+        std::vector<std::string> paths;
+
+        for (size_t i = 0; i < argv.size(); ++i) {
+            const std::string& arg = argv[i];
+            if (arg == "-n") {
+                quiet = true;
+            } else if (arg == "-i") {
+                in_place = true;
+            } else if (arg == "-E" || arg == "-r") {
+                flags |= lib::Regex::kExtended;
+            } else if (arg == "-e" && i + 1 < argv.size()) {
+                if (have_script) script += '\n';
+                script += argv[++i];
+                have_script = true;
+            } else if (!have_script) {
+                script = arg;
+                have_script = true;
+            } else {
+                paths.push_back(arg);
+            }
+        }
+
+        if (!have_script || paths.empty()) {
+            emscripten_console_error("Usage: sed [-n] [-i] [-E] [-e script] <script> <filename>...");
+            return -1;
+        }
+
+        std::vector<SedCommand> commands;
+        std::string error;
+        if (!parse_script(script, flags, commands, error)) {
+            error = "sed: " + error;
+            emscripten_console_error(error.c_str());
+            return -1;
+        }
+
+        if (!in_place) {
+            Output output;
+            long number = 0;
+            for (size_t i = 0; i < paths.size(); ++i) {
+                lib::LineReader reader(paths[i]);
+                if (!reader.is_open()) {
+                    emscripten_console_error("Failed to open file");
+                    return -1;
+                }
+                run_script(commands, reader, output, quiet, i + 1 == paths.size(), number);
+                if (reader.failed()) {
+                    error = "sed: " + reader.error();
+                    emscripten_console_error(error.c_str());
+                    return -1;
+                }
+            }
+            return 0;
+        }
+
+        for (const std::string& path : paths) {
+            lib::LineReader reader(path);
+            struct stat st;
+            if (!reader.is_open() || stat(path.c_str(), &st) != 0) {
+                emscripten_console_error("Failed to open file");
+                return -1;
+            }
+
+            // Write beside the original and rename over it, so readers never
+            // observe a partially edited file
+            std::string temp = path + ".sed.tmp";
+            {
+                std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+                if (!file.is_open()) {
+                    emscripten_console_error("Failed to open file for writing");
+                    return -1;
+                }
+                Output output(&file);
+                long number = 0;
+                for (SedCommand& command : commands) command.active = false;
+                run_script(commands, reader, output, quiet, true, number);
+                output.flush(true);
+                // A file that could not be read to the end is left as it
+                // was, rather than replaced by the part that was
+                if (reader.failed()) {
+                    file.close();
+                    std::remove(temp.c_str());
+                    error = "sed: " + reader.error();
+                    emscripten_console_error(error.c_str());
+                    return -1;
+                }
+                if (!file) {
+                    std::remove(temp.c_str());
+                    emscripten_console_error("Failed to write file");
+                    return -1;
+                }
+            }
+
+            // The edited file is stored as the directory's policy says
+            if (!lib::apply_compression(temp, error)) {
+                std::remove(temp.c_str());
+                emscripten_console_error("Failed to write file");
+                return -1;
+            }
+
+            chmod(temp.c_str(), st.st_mode & 07777);
+            if (std::rename(temp.c_str(), path.c_str()) != 0) {
+                std::remove(temp.c_str());
+                emscripten_console_error("Failed to replace file");
+                return -1;
+            }
+            lib::file_changed(path);
+        }
+
+        return 0;
+    }
+}
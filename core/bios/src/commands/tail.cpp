@@ -0,0 +1,158 @@
+#include "commands.hpp"
+#include "block_file.hpp"
+#include <emscripten/console.h>
+#include <emscripten/eventloop.h>
+#include <cstdlib>
+#include <map>
+
+namespace commands {
+    // Poll interval for `tail -f`
+    static const double kFollowIntervalMs = 250;
+
+    struct Follower {
+        std::string path;
+        uint64_t offset;        // In the decoded content
+        std::string pending;    // Trailing partial line not yet logged
+        int interval;
+    };
+
+    static std::map<std::string, Follower*> followers;
+
+    // Find the offset of the first byte of the last `count` lines by scanning
+    // backwards from EOF one block at a time, so only the tail is ever read
+    static int64_t find_tail_offset(lib::BlockReader& file, uint64_t size, long count) {
+        std::vector<char> buffer(kBlockSize);
+        uint64_t pos = size;
+        long seen = 0;
+        bool skip_final = true;    // A newline terminating the last line doesn't count
+        std::string error;
+
+        while (pos > 0) {
+            size_t len = pos < buffer.size() ? static_cast<size_t>(pos) : buffer.size();
+            pos -= len;
+            if (!file.read(pos, len, buffer.data(), error)) return -1;
+
+            for (int64_t i = static_cast<int64_t>(len) - 1; i >= 0; --i) {
+                if (buffer[i] != '\n') {
+                    skip_final = false;
+                    continue;
+                }
+                if (skip_final) {
+                    skip_final = false;
+                    continue;
+                }
+                if (++seen == count) return static_cast<int64_t>(pos) + i + 1;
+            }
+        }
+
+        return 0;
+    }
+
+    static void log_lines(Follower* follower, const char* data, size_t len) {
+        follower->pending.append(data, len);
+        size_t last = follower->pending.rfind('\n');
+        if (last == std::string::npos) return;
+        follower->pending[last] = '\0';
+        emscripten_console_log(follower->pending.c_str());
+        follower->pending.erase(0, last + 1);
+    }
+
+    static void poll_follower(void* user_data) {
+        Follower* follower = static_cast<Follower*>(user_data);
+
+        lib::BlockReader file;
+        std::string error;
+        if (!file.open(follower->path, error)) return;
+
+        if (file.size() < follower->offset) {
+            emscripten_console_warn("tail: file truncated");
+            follower->offset = 0;
+            follower->pending.clear();
+        }
+
+        // Stream only the bytes appended since the last poll
+        std::string buffer;
+        while (follower->offset < file.size()) {
+            buffer.clear();
+            if (!file.read(follower->offset, kBlockSize, buffer, error) || buffer.empty()) break;
+            follower->offset += buffer.size();
+            log_lines(follower, buffer.data(), buffer.size());
+        }
+    }
+
+    static void stop_following(const std::string& path) {
+        for (auto it = followers.begin(); it != followers.end();) {
+            if (path.empty() || it->first == path) {
+                emscripten_clear_interval(it->second->interval);
+                delete it->second;
+                it = followers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    int tail(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        long count = 10;
+        bool follow = false;
+        bool stop = false;
+        std::string path;
+
+        for (size_t i = 0; i < argv.size(); ++i) {
+            if (argv[i] == "-n" && i + 1 < argv.size()) {
+                count = std::strtol(argv[++i].c_str(), nullptr, 10);
+            } else if (argv[i].size() > 2 && argv[i].compare(0, 2, "-n") == 0) {
+                count = std::strtol(argv[i].c_str() + 2, nullptr, 10);
+            } else if (argv[i] == "-f") {
+                follow = true;
+            } else if (argv[i] == "--stop") {
+                stop = true;
+            } else {
+                path = argv[i];
+            }
+        }
+
+        if (stop) {
+            stop_following(path);
+            return 0;
+        }
+
+        if (path.empty() || count < 0) {
+            emscripten_console_error("Usage: tail [-n lines] [-f] <filename> | tail --stop [filename]");
+            return -1;
+        }
+
+        lib::BlockReader file;
+        std::string error;
+        if (!file.open(path, error)) {
+            emscripten_console_error("Failed to open file");
+            return -1;
+        }
+
+        uint64_t size = file.size();
+        int64_t start = count == 0 ? static_cast<int64_t>(size) : find_tail_offset(file, size, count);
+        if (start < 0) {
+            emscripten_console_error("Failed to read file");
+            return -1;
+        }
+
+        std::string content;
+        if (!file.read(static_cast<uint64_t>(start), static_cast<size_t>(size - start), content, error)) {
+            emscripten_console_error("Failed to read file");
+            return -1;
+        }
+
+        if (!content.empty() && content.back() == '\n') content.pop_back();
+        if (count > 0) emscripten_console_log(content.c_str());
+
+        if (follow) {
+            stop_following(path);
+            Follower* follower = new Follower{path, size, "", 0};
+            follower->interval = emscripten_set_interval(poll_follower, kFollowIntervalMs, follower);
+            followers[path] = follower;
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,129 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "tar.hpp"
+#include "block_file.hpp"
+#include <emscripten/console.h>
+#include <cstdio>
+#include <sys/stat.h>
+
+namespace commands {
+    // Archives are read this much at a time
+    static const size_t kArchiveChunkSize = 16 * kBlockSize;
+
+    static bool extract_file(const std::string& archive, lib::TarExtractor& extractor, std::string& error) {
+        lib::BlockReader in;
+        if (!in.open(archive, error)) {
+            error = archive + ": cannot open";
+            return false;
+        }
+        std::string chunk;
+        for (uint64_t offset = 0; offset < in.size(); offset += chunk.size()) {
+            chunk.clear();
+            if (!in.read(offset, kArchiveChunkSize, chunk, error) || chunk.empty()) {
+                error = archive + ": read error";
+                return false;
+            }
+            if (!extractor.update(reinterpret_cast<const uint8_t*>(chunk.data()), chunk.size(), error)) {
+                error = archive + ": " + error;
+                return false;
+            }
+        }
+        if (!extractor.finish(error)) {
+            error = archive + ": " + error;
+            return false;
+        }
+        return true;
+    }
+
+    // `tar -c|-x|-t [-z] [-v] -f <archive> [-C <dir>] [path...]` creates,
+    // extracts or lists an archive. Flags may be bundled ("-xzvf a.tgz",
+    // or "xzvf a.tgz" as in old tar); extraction and listing recognise
+    // gzip-compressed archives by themselves, so -z only matters for -c
+    int tar(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        char mode = 0;
+        bool gzip = false;
+        bool verbose = false;
+        bool usage = false;
+        std::string archive;
+        std::string dir;
+        std::vector<std::string> paths;
+        for (size_t i = 0; i < argv.size(); ++i) {
+            std::string arg = argv[i];
+            if (i == 0 && !arg.empty() && arg[0] != '-') arg = "-" + arg;
+            if (arg == "-C") {
+                if (i + 1 < argv.size()) {
+                    dir = argv[++i];
+                } else {
+                    usage = true;
+                }
+            } else if (arg.size() > 1 && arg[0] == '-') {
+                for (size_t k = 1; k < arg.size(); ++k) {
+                    switch (arg[k]) {
+                        case 'c':
+                        case 'x':
+                        case 't':
+                            if (mode && mode != arg[k]) usage = true;
+                            mode = arg[k];
+                            break;
+                        case 'z':
+                            gzip = true;
+                            break;
+                        case 'v':
+                            verbose = true;
+                            break;
+                        case 'f':
+                            if (i + 1 < argv.size()) {
+                                archive = argv[++i];
+                            } else {
+                                usage = true;
+                            }
+                            break;
+                        default:
+                            usage = true;
+                    }
+                }
+            } else {
+                paths.push_back(arg);
+            }
+        }
+        if (usage || !mode || archive.empty() || (mode == 'c') != !paths.empty()) {
+            emscripten_console_error("Usage: tar -c|-x|-t [-z] [-v] -f <archive> [-C <dir>] [path...]");
+            return -1;
+        }
+
+        Output output;
+        std::vector<std::string> names;
+        std::string error;
+        if (mode == 'c') {
+            if (!lib::tar_create(dir, paths, archive, gzip, verbose ? &names : nullptr, error)) {
+                remove(archive.c_str());
+                error = "tar: " + error;
+                emscripten_console_error(error.c_str());
+                return -1;
+            }
+        } else {
+            std::string dest;
+            if (mode == 'x') {
+                dest = dir.empty() ? "." : dir;
+                struct stat info;
+                if (stat(dest.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+                    error = "tar: " + dest + ": not a directory";
+                    emscripten_console_error(error.c_str());
+                    return -1;
+                }
+            }
+            lib::TarExtractor extractor(dest, verbose || mode == 't' ? &names : nullptr);
+            bool ok = extract_file(archive, extractor, error);
+            for (const std::string& name : names) output.line(name);
+            if (!ok) {
+                error = "tar: " + error;
+                emscripten_console_error(error.c_str());
+                return -1;
+            }
+            return 0;
+        }
+        for (const std::string& name : names) output.line(name);
+        return 0;
+    }
+}
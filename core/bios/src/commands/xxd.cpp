@@ -0,0 +1,181 @@
+#include "commands.hpp"
+#include "output.hpp"
+#include "encoding.hpp"
+#include "block_file.hpp"
+#include "file_events.hpp"
+#include <emscripten/console.h>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+namespace commands {
+    // Bytes per line of plain (-p) output, as xxd does
+    static const size_t kPlainColumns = 30;
+
+    // Decode plain hex text, ignoring whitespace, into `out`
+    static int reverse_plain(lib::BlockReader& in, std::ofstream& out) {
+        std::string block;
+        std::string digits;
+        std::vector<uint8_t> bytes;
+        std::string error;
+
+        for (uint64_t offset = 0; offset < in.size(); offset += block.size()) {
+            block.clear();
+            if (!in.read(offset, kBlockSize, block, error) || block.empty()) {
+                emscripten_console_error("Failed to read file");
+                return -1;
+            }
+
+            for (char c : block) {
+                if (c != ' ' && c != '\n' && c != '\r' && c != '\t') digits += c;
+            }
+
+            // Keep an odd trailing digit for the next block
+            size_t whole = digits.size() & ~static_cast<size_t>(1);
+            bytes.resize(whole / 2);
+            if (!lib::hex_decode(digits.data(), whole, bytes.data())) {
+                emscripten_console_error("xxd: invalid hex input");
+                return -1;
+            }
+            out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+            digits.erase(0, whole);
+        }
+
+        if (!digits.empty()) {
+            emscripten_console_error("xxd: odd number of hex digits");
+            return -1;
+        }
+        return 0;
+    }
+
+    int xxd(const std::string& args) {
+        std::vector<std::string> argv = split_args(args);
+        bool plain = false;
+        bool reverse = false;
+        size_t columns = 16;
+        long long skip = 0;
+        long long limit = -1;
+        std::vector<std::string> paths;
+
+        for (size_t i = 0; i < argv.size(); ++i) {
+            const std::string& arg = argv[i];
+            if (arg == "-p") {
+                plain = true;
+            } else if (arg == "-r") {
+                reverse = true;
+            } else if (arg == "-c" && i + 1 < argv.size()) {
+                columns = std::strtoul(argv[++i].c_str(), nullptr, 10);
+            } else if (arg == "-s" && i + 1 < argv.size()) {
+                skip = std::strtoll(argv[++i].c_str(), nullptr, 0);
+            } else if (arg == "-l" && i + 1 < argv.size()) {
+                limit = std::strtoll(argv[++i].c_str(), nullptr, 0);
+            } else {
+                paths.push_back(arg);
+            }
+        }
+
+        if (paths.empty() || paths.size() > 2 || columns == 0 || skip < 0) {
+            emscripten_console_error("Usage: xxd [-p] [-r] [-c cols] [-s offset] [-l len] <input> [output]");
+            return -1;
+        }
+
+        lib::BlockReader in;
+        std::string error;
+        if (!in.open(paths[0], error)) {
+            emscripten_console_error("Failed to open file");
+            return -1;
+        }
+
+        std::ofstream out_file;
+        if (paths.size() == 2) {
+            out_file.open(paths[1], std::ios::binary | std::ios::trunc);
+            if (!out_file.is_open()) {
+                emscripten_console_error("Failed to open file for writing");
+                return -1;
+            }
+        }
+
+        if (reverse) {
+            if (!plain || !out_file.is_open()) {
+                emscripten_console_error("xxd: -r needs -p input and an output file");
+                return -1;
+            }
+            if (reverse_plain(in, out_file) != 0) return -1;
+            out_file.close();
+            if (!out_file || !lib::apply_compression(paths[1], error)) {
+                emscripten_console_error("Failed to write file");
+                return -1;
+            }
+            lib::file_changed(paths[1]);
+            return 0;
+        }
+
+        if (plain && columns == 16) columns = kPlainColumns;
+
+        Output output(out_file.is_open() ? &out_file : nullptr);
+        // Read whole lines at a time so each block formats independently
+        size_t block_size = kBlockSize / columns * columns + columns;
+        std::string block;
+        std::string hex;
+        std::string line;
+        unsigned long long offset = static_cast<unsigned long long>(skip);
+        long long remaining = limit;
+
+        while (offset < in.size() && remaining != 0) {
+            size_t want = block_size;
+            if (remaining > 0 && static_cast<long long>(want) > remaining) want = static_cast<size_t>(remaining);
+            block.clear();
+            if (!in.read(offset, want, block, error)) {
+                emscripten_console_error("Failed to read file");
+                return -1;
+            }
+            size_t got = block.size();
+            if (got == 0) break;
+            if (remaining > 0) remaining -= got;
+
+            hex.resize(got * 2);
+            lib::hex_encode(reinterpret_cast<const uint8_t*>(block.data()), got, &hex[0]);
+
+            for (size_t pos = 0; pos < got; pos += columns) {
+                size_t n = std::min(columns, got - pos);
+                if (plain) {
+                    output.write(std::string_view(hex).substr(pos * 2, n * 2));
+                    output.write("\n");
+                    continue;
+                }
+
+                char prefix[20];
+                snprintf(prefix, sizeof(prefix), "%08llx: ", offset + pos);
+                line = prefix;
+                for (size_t i = 0; i < columns; ++i) {
+                    if (i < n) {
+                        line.append(hex, (pos + i) * 2, 2);
+                    } else {
+                        line += "  ";
+                    }
+                    if (i % 2 == 1) line += ' ';
+                }
+                line += ' ';
+                for (size_t i = 0; i < n; ++i) {
+                    unsigned char c = static_cast<unsigned char>(block[pos + i]);
+                    line += c >= 0x20 && c < 0x7f ? static_cast<char>(c) : '.';
+                }
+                output.line(line);
+            }
+            offset += got;
+        }
+
+        // A file written here follows its directory's compression policy
+        output.flush(true);
+        if (out_file.is_open()) {
+            out_file.close();
+            if (!out_file || !lib::apply_compression(paths[1], error)) {
+                emscripten_console_error("Failed to write file");
+                return -1;
+            }
+            lib::file_changed(paths[1]);
+        }
+        return 0;
+    }
+}
@@ -106,8 +106,11 @@ export async function readFile() {
     if (!path) return log('Please provide a file path', 'error')
 
     try {
-        const content = bios.ccall('read_file', 'string', ['string'], [path])
-        if (content) {
+        // Validated and transcoded to UTF-16 in WASM; null for non-UTF-8 files
+        const pointer = bios.ccall('read_text', 'number', ['string', 'number'], [path, 0])
+        const content = pointer ? bios.UTF16ToString(pointer) : null
+        if (pointer) bios._free(pointer)
+        if (content !== null) {
             document.getElementById('file-content').value = content
             log(`File read successfully: ${path}`)
         } else log(`Failed to read file: ${path}`, 'error')
@@ -0,0 +1,403 @@
+#include "hash.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <thread>
+#endif
+
+namespace lib {
+    // BLAKE3: inputs are split into 1 KB chunks of sixteen 64-byte blocks,
+    // each chunk is reduced to a chaining value, and the chaining values are
+    // combined pairwise in a binary tree whose root yields the digest.
+
+    static const size_t kChunkLen = 1024;
+    static const size_t kBlockLen = 64;
+    // Largest subtree hashed in one batch; bounds the scratch space per update()
+    static const size_t kMaxSubtreeChunks = 1024;
+#ifdef __EMSCRIPTEN_PTHREADS__
+    // Chunks per worker below which threads cost more than they save
+    static const size_t kChunksPerWorker = 64;
+#endif
+
+    enum : uint8_t {
+        kChunkStart = 1 << 0,
+        kChunkEnd = 1 << 1,
+        kParent = 1 << 2,
+        kRoot = 1 << 3,
+    };
+
+    static const uint32_t kIv[8] = {
+        0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+    };
+
+    // Message word order for each of the seven rounds
+    static const uint8_t kSchedule[7][16] = {
+        {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+        {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+        {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+        {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+        {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+        {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+        {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+    };
+
+    static inline uint32_t rotr32(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    static inline void load_words(const uint8_t* in, uint32_t* words, size_t count) {
+        memcpy(words, in, count * 4);
+    }
+
+    static inline void store_words(const uint32_t* words, uint8_t* out, size_t count) {
+        memcpy(out, words, count * 4);
+    }
+
+    static inline void g(uint32_t* v, int a, int b, int c, int d, uint32_t x, uint32_t y) {
+        v[a] = v[a] + v[b] + x;
+        v[d] = rotr32(v[d] ^ v[a], 16);
+        v[c] = v[c] + v[d];
+        v[b] = rotr32(v[b] ^ v[c], 12);
+        v[a] = v[a] + v[b] + y;
+        v[d] = rotr32(v[d] ^ v[a], 8);
+        v[c] = v[c] + v[d];
+        v[b] = rotr32(v[b] ^ v[c], 7);
+    }
+
+    // Run the compression function; `out` receives all sixteen state words
+    static void compress(const uint32_t cv[8], const uint8_t block[64], uint64_t counter, uint32_t block_len, uint8_t flags, uint32_t out[16]) {
+        uint32_t m[16];
+        load_words(block, m, 16);
+        uint32_t v[16] = {
+            cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+            kIv[0], kIv[1], kIv[2], kIv[3],
+            static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32), block_len, flags,
+        };
+
+        for (const uint8_t* s : kSchedule) {
+            g(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+            g(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+            g(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+            g(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+            g(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+            g(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+            g(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+            g(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+        }
+
+        for (int i = 0; i < 8; ++i) {
+            out[i] = v[i] ^ v[i + 8];
+            out[i + 8] = v[i + 8] ^ cv[i];
+        }
+    }
+
+    static void parent_cv(const uint32_t left[8], const uint32_t right[8], uint32_t out[8]) {
+        uint8_t block[64];
+        store_words(left, block, 8);
+        store_words(right, block + 32, 8);
+        uint32_t state[16];
+        compress(kIv, block, 0, kBlockLen, kParent, state);
+        memcpy(out, state, 32);
+    }
+
+    // Hash `blocks` whole blocks starting at `in` into one chaining value
+    static void hash_one(const uint8_t* in, size_t blocks, uint64_t counter, uint8_t flags, uint8_t flags_start, uint8_t flags_end, uint8_t* out) {
+        uint32_t cv[8];
+        memcpy(cv, kIv, sizeof(cv));
+        uint8_t block_flags = flags | flags_start;
+        uint32_t state[16];
+        for (size_t i = 0; i < blocks; ++i, in += kBlockLen) {
+            if (i + 1 == blocks) block_flags |= flags_end;
+            compress(cv, in, counter, kBlockLen, block_flags, state);
+            memcpy(cv, state, sizeof(cv));
+            block_flags = flags;
+        }
+        store_words(cv, out, 8);
+    }
+
+#ifdef __wasm_simd128__
+    static inline v128_t rotr_vec(v128_t x, int n) {
+        return wasm_v128_or(wasm_u32x4_shr(x, n), wasm_i32x4_shl(x, 32 - n));
+    }
+
+    static inline v128_t rotr16_vec(v128_t x) {
+        return wasm_i8x16_shuffle(x, x, 2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    }
+
+    static inline v128_t rotr8_vec(v128_t x) {
+        return wasm_i8x16_shuffle(x, x, 1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+    }
+
+    static inline void g_vec(v128_t* v, int a, int b, int c, int d, v128_t x, v128_t y) {
+        v[a] = wasm_i32x4_add(wasm_i32x4_add(v[a], v[b]), x);
+        v[d] = rotr16_vec(wasm_v128_xor(v[d], v[a]));
+        v[c] = wasm_i32x4_add(v[c], v[d]);
+        v[b] = rotr_vec(wasm_v128_xor(v[b], v[c]), 12);
+        v[a] = wasm_i32x4_add(wasm_i32x4_add(v[a], v[b]), y);
+        v[d] = rotr8_vec(wasm_v128_xor(v[d], v[a]));
+        v[c] = wasm_i32x4_add(v[c], v[d]);
+        v[b] = rotr_vec(wasm_v128_xor(v[b], v[c]), 7);
+    }
+
+    // Transpose four rows of four words so lane i of each result comes from row i
+    static inline void transpose(v128_t& a, v128_t& b, v128_t& c, v128_t& d) {
+        v128_t ab_lo = wasm_i32x4_shuffle(a, b, 0, 4, 1, 5);
+        v128_t ab_hi = wasm_i32x4_shuffle(a, b, 2, 6, 3, 7);
+        v128_t cd_lo = wasm_i32x4_shuffle(c, d, 0, 4, 1, 5);
+        v128_t cd_hi = wasm_i32x4_shuffle(c, d, 2, 6, 3, 7);
+        a = wasm_i32x4_shuffle(ab_lo, cd_lo, 0, 1, 4, 5);
+        b = wasm_i32x4_shuffle(ab_lo, cd_lo, 2, 3, 6, 7);
+        c = wasm_i32x4_shuffle(ab_hi, cd_hi, 0, 1, 4, 5);
+        d = wasm_i32x4_shuffle(ab_hi, cd_hi, 2, 3, 6, 7);
+    }
+
+    // hash_one for four inputs at once, one per SIMD lane. Chunk inputs get
+    // consecutive counters; parents pass increment_counter = false.
+    static void hash_four(const uint8_t* const in[4], size_t blocks, uint64_t counter, bool increment_counter,
+                          uint8_t flags, uint8_t flags_start, uint8_t flags_end, uint8_t* out) {
+        v128_t h[8];
+        for (int i = 0; i < 8; ++i) h[i] = wasm_i32x4_splat(static_cast<int32_t>(kIv[i]));
+
+        uint64_t counters[4];
+        for (int lane = 0; lane < 4; ++lane) counters[lane] = counter + (increment_counter ? lane : 0);
+        const v128_t counter_lo = wasm_i32x4_make(
+            static_cast<int32_t>(counters[0]), static_cast<int32_t>(counters[1]),
+            static_cast<int32_t>(counters[2]), static_cast<int32_t>(counters[3]));
+        const v128_t counter_hi = wasm_i32x4_make(
+            static_cast<int32_t>(counters[0] >> 32), static_cast<int32_t>(counters[1] >> 32),
+            static_cast<int32_t>(counters[2] >> 32), static_cast<int32_t>(counters[3] >> 32));
+
+        uint8_t block_flags = flags | flags_start;
+        for (size_t block = 0; block < blocks; ++block) {
+            if (block + 1 == blocks) block_flags |= flags_end;
+
+            v128_t m[16];
+            size_t offset = block * kBlockLen;
+            for (int quarter = 0; quarter < 4; ++quarter) {
+                v128_t* words = m + quarter * 4;
+                for (int lane = 0; lane < 4; ++lane) words[lane] = wasm_v128_load(in[lane] + offset + quarter * 16);
+                transpose(words[0], words[1], words[2], words[3]);
+            }
+
+            v128_t v[16] = {
+                h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+                wasm_i32x4_splat(static_cast<int32_t>(kIv[0])), wasm_i32x4_splat(static_cast<int32_t>(kIv[1])),
+                wasm_i32x4_splat(static_cast<int32_t>(kIv[2])), wasm_i32x4_splat(static_cast<int32_t>(kIv[3])),
+                counter_lo, counter_hi, wasm_i32x4_splat(kBlockLen), wasm_i32x4_splat(block_flags),
+            };
+            for (const uint8_t* s : kSchedule) {
+                g_vec(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+                g_vec(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+                g_vec(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+                g_vec(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+                g_vec(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+                g_vec(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+                g_vec(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+                g_vec(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+            }
+            for (int i = 0; i < 8; ++i) h[i] = wasm_v128_xor(v[i], v[i + 8]);
+            block_flags = flags;
+        }
+
+        // Back to one chaining value per lane
+        transpose(h[0], h[1], h[2], h[3]);
+        transpose(h[4], h[5], h[6], h[7]);
+        for (int lane = 0; lane < 4; ++lane) {
+            wasm_v128_store(out + lane * 32, h[lane]);
+            wasm_v128_store(out + lane * 32 + 16, h[lane + 4]);
+        }
+    }
+#endif
+
+    // Hash `count` inputs of `blocks` blocks each, writing 32 bytes per input
+    static void hash_many(const uint8_t* const* in, size_t count, size_t blocks, uint64_t counter, bool increment_counter,
+                          uint8_t flags, uint8_t flags_start, uint8_t flags_end, uint8_t* out) {
+        size_t i = 0;
+#ifdef __wasm_simd128__
+        for (; i + 4 <= count; i += 4) {
+            hash_four(in + i, blocks, counter, increment_counter, flags, flags_start, flags_end, out + i * 32);
+            if (increment_counter) counter += 4;
+        }
+#endif
+        for (; i < count; ++i) {
+            hash_one(in[i], blocks, counter, flags, flags_start, flags_end, out + i * 32);
+            if (increment_counter) ++counter;
+        }
+    }
+
+    static void hash_chunks(const uint8_t* in, size_t chunks, uint64_t counter, uint8_t* out) {
+        std::vector<const uint8_t*> inputs(chunks);
+        for (size_t i = 0; i < chunks; ++i) inputs[i] = in + i * kChunkLen;
+        hash_many(inputs.data(), chunks, kChunkLen / kBlockLen, counter, true, 0, kChunkStart, kChunkEnd, out);
+    }
+
+    // Reduce a whole subtree of `chunks` (a power of two, at least two)
+    // to the chaining values of the root's two children
+    static void hash_subtree(const uint8_t* in, size_t chunks, uint64_t counter, uint32_t left[8], uint32_t right[8]) {
+        std::vector<uint8_t> cvs(chunks * 32);
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+        size_t workers = std::min<size_t>(std::thread::hardware_concurrency(), chunks / kChunksPerWorker);
+        if (workers > 1) {
+            std::vector<std::thread> threads;
+            size_t per_worker = (chunks + workers - 1) / workers;
+            for (size_t start = 0; start < chunks; start += per_worker) {
+                size_t count = std::min(per_worker, chunks - start);
+                threads.emplace_back(hash_chunks, in + start * kChunkLen, count, counter + start, cvs.data() + start * 32);
+            }
+            for (std::thread& thread : threads) thread.join();
+        } else {
+            hash_chunks(in, chunks, counter, cvs.data());
+        }
+#else
+        hash_chunks(in, chunks, counter, cvs.data());
+#endif
+
+        // Each parent block is two adjacent chaining values, so a level of
+        // the tree is hashed in place from the previous one
+        std::vector<const uint8_t*> parents(chunks / 2);
+        for (size_t count = chunks; count > 2; count /= 2) {
+            for (size_t i = 0; i < count / 2; ++i) parents[i] = cvs.data() + i * 64;
+            hash_many(parents.data(), count / 2, 1, 0, false, kParent, 0, 0, cvs.data());
+        }
+
+        memcpy(left, cvs.data(), 32);
+        memcpy(right, cvs.data() + 32, 32);
+    }
+
+    Blake3::Blake3() {
+        memcpy(chunk_cv_, kIv, sizeof(chunk_cv_));
+    }
+
+    void Blake3::merge_cv_stack(uint64_t total_chunks) {
+        size_t post_merge = static_cast<size_t>(__builtin_popcountll(total_chunks));
+        while (stack_len_ > post_merge) {
+            parent_cv(cv_stack_[stack_len_ - 2], cv_stack_[stack_len_ - 1], cv_stack_[stack_len_ - 2]);
+            --stack_len_;
+        }
+    }
+
+    void Blake3::push_cv(const uint32_t cv[8], uint64_t chunk_counter) {
+        merge_cv_stack(chunk_counter);
+        memcpy(cv_stack_[stack_len_++], cv, 32);
+    }
+
+    // Feed bytes into the current chunk, compressing a block only once the
+    // next byte arrives so the last block can carry the end flag
+    void Blake3::update_chunk(const uint8_t* data, size_t len) {
+        while (len > 0) {
+            if (block_len_ == kBlockLen) {
+                uint32_t state[16];
+                compress(chunk_cv_, block_, chunk_counter_, kBlockLen, blocks_compressed_ == 0 ? kChunkStart : 0, state);
+                memcpy(chunk_cv_, state, 32);
+                ++blocks_compressed_;
+                block_len_ = 0;
+            }
+            size_t take = std::min(len, kBlockLen - block_len_);
+            memcpy(block_ + block_len_, data, take);
+            block_len_ += take;
+            data += take;
+            len -= take;
+        }
+    }
+
+    void Blake3::update(const uint8_t* data, size_t len) {
+        if (len == 0) return;
+        size_t chunk_len = blocks_compressed_ * kBlockLen + block_len_;
+
+        // Top up a partially filled chunk first
+        if (chunk_len > 0) {
+            size_t take = std::min(len, kChunkLen - chunk_len);
+            update_chunk(data, take);
+            data += take;
+            len -= take;
+            if (len == 0) return;
+
+            uint32_t state[16];
+            uint8_t block_flags = (blocks_compressed_ == 0 ? kChunkStart : 0) | kChunkEnd;
+            memset(block_ + block_len_, 0, kBlockLen - block_len_);
+            compress(chunk_cv_, block_, chunk_counter_, static_cast<uint32_t>(block_len_), block_flags, state);
+            push_cv(state, chunk_counter_);
+            ++chunk_counter_;
+            memcpy(chunk_cv_, kIv, sizeof(chunk_cv_));
+            block_len_ = 0;
+            blocks_compressed_ = 0;
+        }
+
+        // Whole subtrees, as long as more input follows them. A subtree must
+        // start at a multiple of its own size in the chunk sequence.
+        while (len > kChunkLen) {
+            size_t chunks = std::min(len / kChunkLen, kMaxSubtreeChunks);
+            while (chunks & (chunks - 1)) chunks &= chunks - 1;
+            while (chunk_counter_ & (chunks - 1)) chunks /= 2;
+
+            if (chunks == 1) {
+                uint8_t cv_bytes[32];
+                hash_one(data, kChunkLen / kBlockLen, chunk_counter_, 0, kChunkStart, kChunkEnd, cv_bytes);
+                uint32_t cv[8];
+                load_words(cv_bytes, cv, 8);
+                push_cv(cv, chunk_counter_);
+            } else {
+                uint32_t left[8], right[8];
+                hash_subtree(data, chunks, chunk_counter_, left, right);
+                push_cv(left, chunk_counter_);
+                push_cv(right, chunk_counter_ + chunks / 2);
+            }
+            chunk_counter_ += chunks;
+            data += chunks * kChunkLen;
+            len -= chunks * kChunkLen;
+        }
+
+        if (len > 0) {
+            update_chunk(data, len);
+            merge_cv_stack(chunk_counter_);
+        }
+    }
+
+    void Blake3::finish(uint8_t* out) {
+        // Start from the output of the current chunk, or from the topmost
+        // parent when input ended exactly on a chunk boundary
+        uint32_t cv[8];
+        uint8_t block[64];
+        uint32_t block_len;
+        uint64_t counter;
+        uint8_t flags;
+        size_t remaining = stack_len_;
+
+        if (blocks_compressed_ > 0 || block_len_ > 0 || stack_len_ == 0) {
+            memcpy(cv, chunk_cv_, sizeof(cv));
+            memcpy(block, block_, block_len_);
+            memset(block + block_len_, 0, kBlockLen - block_len_);
+            block_len = static_cast<uint32_t>(block_len_);
+            counter = chunk_counter_;
+            flags = (blocks_compressed_ == 0 ? kChunkStart : 0) | kChunkEnd;
+        } else {
+            remaining -= 2;
+            memcpy(cv, kIv, sizeof(cv));
+            store_words(cv_stack_[remaining], block, 8);
+            store_words(cv_stack_[remaining + 1], block + 32, 8);
+            block_len = kBlockLen;
+            counter = 0;
+            flags = kParent;
+        }
+
+        uint32_t state[16];
+        while (remaining > 0) {
+            --remaining;
+            compress(cv, block, counter, block_len, flags, state);
+            store_words(cv_stack_[remaining], block, 8);
+            store_words(state, block + 32, 8);
+            memcpy(cv, kIv, sizeof(cv));
+            block_len = kBlockLen;
+            counter = 0;
+            flags = kParent;
+        }
+
+        compress(cv, block, counter, block_len, flags | kRoot, state);
+        store_words(state, out, 8);
+    }
+}
@@ -0,0 +1,329 @@
+#include "block_file.hpp"
+#include "file_io.hpp"
+#include "hash.hpp"
+#include "lz4.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lib {
+    static const char kMagic[4] = {'B', 'L', 'K', 'Z'};
+    static const uint32_t kVersion = 1;
+    static const size_t kHeaderSize = 24;
+    static const uint32_t kRawBlock = 0x80000000;
+    static const uint32_t kMaxBlockSize = 16 * 1024 * 1024;
+    static const char kPolicyFile[] = ".blockz";
+    static const size_t kCacheBlocks = 16;      // 1 MB of decoded 64 KB blocks
+
+    static bool read_at(int fd, uint64_t offset, uint8_t* data, size_t len) {
+        while (len > 0) {
+            ssize_t got = pread(fd, data, len, static_cast<off_t>(offset));
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+            data += got;
+            len -= got;
+            offset += got;
+        }
+        return true;
+    }
+
+    // Decoded blocks, least recently used first out
+    namespace {
+        struct CachedBlock {
+            uint64_t key = 0;           // Of the file version; 0 when the slot is free
+            uint64_t file = 0;          // Of the file, to drop every version when it is rewritten
+            uint32_t index = 0;
+            uint64_t used = 0;
+            std::string data;
+        };
+    }
+
+    static std::vector<CachedBlock> cache(kCacheBlocks);
+    static uint64_t cache_clock = 0;
+
+    static uint64_t file_id(const struct stat& st) {
+        uint64_t ids[2] = {static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino)};
+        return xxh3_64(reinterpret_cast<const uint8_t*>(ids), sizeof(ids));
+    }
+
+    static uint64_t version_key(const struct stat& st) {
+        uint64_t ids[4] = {file_id(st), static_cast<uint64_t>(st.st_size), static_cast<uint64_t>(st.st_mtim.tv_sec),
+                           static_cast<uint64_t>(st.st_mtim.tv_nsec)};
+        uint64_t key = xxh3_64(reinterpret_cast<const uint8_t*>(ids), sizeof(ids));
+        return key ? key : 1;
+    }
+
+    static void forget_file(uint64_t file) {
+        for (CachedBlock& slot : cache) {
+            if (slot.key && slot.file == file) {
+                slot.key = 0;
+                std::string().swap(slot.data);
+            }
+        }
+    }
+
+    std::string block_compress(const uint8_t* data, size_t len) {
+        uint32_t blocks = static_cast<uint32_t>((len + kBlockFileBlockSize - 1) / kBlockFileBlockSize);
+        std::string out(kMagic, sizeof(kMagic));
+        put32(out, kVersion);
+        put64(out, len);
+        put32(out, static_cast<uint32_t>(kBlockFileBlockSize));
+        put32(out, blocks);
+        size_t index = out.size();
+        out.resize(index + 4 * static_cast<size_t>(blocks));
+
+        std::string packed;
+        for (uint32_t i = 0; i < blocks; ++i) {
+            size_t start = i * kBlockFileBlockSize;
+            size_t size = len - start < kBlockFileBlockSize ? len - start : kBlockFileBlockSize;
+            Lz4Encoder encoder(1);
+            packed.clear();
+            encoder.update(data + start, size, packed);
+            encoder.finish(packed);
+
+            uint32_t length;
+            if (packed.size() < size) {
+                length = static_cast<uint32_t>(packed.size());
+                out += packed;
+            } else {
+                length = static_cast<uint32_t>(size) | kRawBlock;
+                out.append(reinterpret_cast<const char*>(data + start), size);
+            }
+            for (int b = 0; b < 4; ++b) out[index + 4 * i + b] = static_cast<char>(length >> (8 * b));
+        }
+        return out;
+    }
+
+    // Whether the nearest policy file at or above `dir` turns compression on
+    static bool policy_for(std::string dir) {
+        while (true) {
+            std::ifstream file((dir == "/" ? "" : dir) + "/" + kPolicyFile);
+            if (file.is_open()) {
+                std::string value;
+                file >> value;
+                return value == "on";
+            }
+            if (dir == "/" || dir.empty()) return false;
+            size_t slash = dir.rfind('/');
+            dir = slash == 0 || slash == std::string::npos ? "/" : dir.substr(0, slash);
+        }
+    }
+
+    bool compression_enabled(const std::string& path) {
+        std::string full = absolute_path(path);
+        size_t slash = full.rfind('/');
+        return policy_for(slash == 0 ? "/" : full.substr(0, slash));
+    }
+
+    bool set_compression(const std::string& dir, bool enabled, std::string& error) {
+        struct stat st;
+        if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            error = dir + ": not a directory";
+            return false;
+        }
+        std::string policy = (dir.back() == '/' ? dir : dir + "/") + kPolicyFile;
+        std::ofstream file(policy, std::ios::trunc);
+        file << (enabled ? "on\n" : "off\n");
+        file.close();
+        if (!file) {
+            error = policy + ": cannot write";
+            return false;
+        }
+        return true;
+    }
+
+    bool store_file(const std::string& path, const char* data, size_t len, std::string& error, int force) {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) forget_file(file_id(st));
+
+        bool compress = force < 0 ? compression_enabled(path) : force > 0;
+        std::string packed;
+        if (compress) {
+            packed = block_compress(reinterpret_cast<const uint8_t*>(data), len);
+            if (packed.size() < len) {
+                data = packed.data();
+                len = packed.size();
+            }
+        }
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            error = path + ": cannot open for writing";
+            return false;
+        }
+        file.write(data, static_cast<std::streamsize>(len));
+        file.close();
+        if (!file) {
+            error = path + ": write error";
+            return false;
+        }
+        return true;
+    }
+
+    bool apply_compression(const std::string& path, std::string& error) {
+        if (!compression_enabled(path)) return true;
+        struct stat st;
+        std::string content;
+        {
+            BlockReader reader;
+            if (!reader.open(path, error) || stat(path.c_str(), &st) != 0) return false;
+            if (reader.compressed()) return true;
+            if (!reader.read(0, static_cast<size_t>(reader.size()), content, error)) return false;
+        }
+        if (!store_file(path, content.data(), content.size(), error, 1)) return false;
+        set_mtime(path, static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+        return true;
+    }
+
+    bool load_file(const std::string& path, std::string& out, std::string& error) {
+        BlockReader reader;
+        if (!reader.open(path, error)) return false;
+        out.clear();
+        out.reserve(static_cast<size_t>(reader.size()));
+        return reader.read(0, static_cast<size_t>(reader.size()), out, error);
+    }
+
+    BlockReader::~BlockReader() {
+        if (fd_ >= 0) close(fd_);
+    }
+
+    bool BlockReader::open(const std::string& path, std::string& error) {
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd_ < 0 || fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode)) {
+            error = "cannot open " + path;
+            return false;
+        }
+        path_ = path;
+        size_ = stored_size_ = static_cast<uint64_t>(st.st_size);
+        key_ = version_key(st);
+        if (!read_index(error)) return false;
+        return true;
+    }
+
+    // Files without the magic and version are plain
+    bool BlockReader::read_index(std::string& error) {
+        uint8_t header[kHeaderSize];
+        if (stored_size_ < kHeaderSize || !read_at(fd_, 0, header, sizeof(header))) return true;
+        if (memcmp(header, kMagic, sizeof(kMagic)) != 0 || read32(header + 4) != kVersion) return true;
+
+        uint64_t size = read64(header + 8);
+        uint32_t block_size = read32(header + 16);
+        uint32_t blocks = read32(header + 20);
+        uint64_t data_start = kHeaderSize + 4 * static_cast<uint64_t>(blocks);
+        // The count is worked out without rounding up by adding, which
+        // would wrap for sizes near 2^64
+        if (block_size == 0 || block_size > kMaxBlockSize ||
+            blocks != size / block_size + (size % block_size != 0) || (blocks == 0 && size != 0) ||
+            data_start > stored_size_) {
+            error = path_ + ": corrupt block index";
+            return false;
+        }
+
+        std::vector<uint8_t> index(4 * static_cast<size_t>(blocks));
+        if (!read_at(fd_, kHeaderSize, index.data(), index.size())) {
+            error = "failed to read " + path_;
+            return false;
+        }
+        std::vector<uint64_t> offsets(blocks + 1);
+        std::vector<bool> raw(blocks);
+        offsets[0] = data_start;
+        for (uint32_t i = 0; i < blocks; ++i) {
+            uint32_t length = read32(&index[4 * i]);
+            raw[i] = (length & kRawBlock) != 0;
+            offsets[i + 1] = offsets[i] + (length & ~kRawBlock);
+        }
+        if (offsets[blocks] != stored_size_) {
+            error = path_ + ": corrupt block index";
+            return false;
+        }
+
+        size_ = size;
+        block_size_ = block_size;
+        offsets_.swap(offsets);
+        raw_.swap(raw);
+        return true;
+    }
+
+    const std::string* BlockReader::block(uint32_t index, std::string& error) {
+        CachedBlock* victim = &cache[0];
+        for (CachedBlock& slot : cache) {
+            if (slot.key == key_ && slot.index == index) {
+                slot.used = ++cache_clock;
+                return &slot.data;
+            }
+            if (slot.used < victim->used) victim = &slot;
+        }
+
+        uint64_t start = offsets_[index];
+        std::vector<uint8_t> stored(static_cast<size_t>(offsets_[index + 1] - start));
+        if (!read_at(fd_, start, stored.data(), stored.size())) {
+            error = "failed to read " + path_;
+            return nullptr;
+        }
+        uint64_t expected = size_ - static_cast<uint64_t>(index) * block_size_;
+        if (expected > block_size_) expected = block_size_;
+
+        std::string data;
+        if (raw_[index]) {
+            data.assign(reinterpret_cast<const char*>(stored.data()), stored.size());
+        } else {
+            Lz4Decoder decoder;
+            if (!decoder.update(stored.data(), stored.size(), data, error) || !decoder.finish(error)) {
+                error = path_ + ": block " + std::to_string(index) + ": " + error;
+                return nullptr;
+            }
+        }
+        if (data.size() != expected) {
+            error = path_ + ": block " + std::to_string(index) + " has the wrong size";
+            return nullptr;
+        }
+
+        struct stat st;
+        fstat(fd_, &st);
+        victim->key = key_;
+        victim->file = file_id(st);
+        victim->index = index;
+        victim->used = ++cache_clock;
+        victim->data.swap(data);
+        return &victim->data;
+    }
+
+    bool BlockReader::read(uint64_t offset, size_t len, std::string& out, std::string& error) {
+        if (offset >= size_) return true;
+        if (len > size_ - offset) len = static_cast<size_t>(size_ - offset);
+        size_t base = out.size();
+        out.resize(base + len);
+        if (!read(offset, len, &out[base], error)) {
+            out.resize(base);
+            return false;
+        }
+        return true;
+    }
+
+    bool BlockReader::read(uint64_t offset, size_t len, char* out, std::string& error) {
+        if (!compressed()) {
+            if (!read_at(fd_, offset, reinterpret_cast<uint8_t*>(out), len)) {
+                error = "failed to read " + path_;
+                return false;
+            }
+            return true;
+        }
+
+        while (len > 0) {
+            uint32_t index = static_cast<uint32_t>(offset / block_size_);
+            const std::string* data = block(index, error);
+            if (!data) return false;
+            size_t within = static_cast<size_t>(offset - static_cast<uint64_t>(index) * block_size_);
+            size_t take = data->size() - within < len ? data->size() - within : len;
+            memcpy(out, data->data() + within, take);
+            out += take;
+            offset += take;
+            len -= take;
+        }
+        return true;
+    }
+}
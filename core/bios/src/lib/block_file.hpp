@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lib {
+    // Block-compressed files. Content is cut into 64 KB blocks, each
+    // compressed on its own as an LZ4 frame (or kept raw when that does not
+    // shrink it), after a header and an index of the blocks' stored
+    // lengths, so any byte range decodes from the blocks covering it.
+    //
+    //   "BLKZ" u32 version, u64 size, u32 block size, u32 blocks,
+    //   u32 length[blocks] (top bit set for a raw block), block data
+    //
+    // Whether a file is written this way is a per-directory policy: the
+    // nearest ".blockz" file at or above its directory, holding "on" or
+    // "off". Readers recognise the header, so compressed and plain files
+    // read the same.
+    static const size_t kBlockFileBlockSize = 64 * 1024;
+
+    std::string block_compress(const uint8_t* data, size_t len);
+
+    // True if `path` would be stored compressed
+    bool compression_enabled(const std::string& path);
+
+    // Turn the policy on or off for `dir` and the directories below it
+    // that do not set their own
+    bool set_compression(const std::string& dir, bool enabled, std::string& error);
+
+    // Write `len` bytes to `path`, block-compressed if the policy (or
+    // `force`, when 1 or 0 rather than -1) says so and it saves space. The
+    // caller reports the change through file_changed.
+    bool store_file(const std::string& path, const char* data, size_t len, std::string& error, int force = -1);
+
+    // Bring `path`, just written plain by a writer that streams its output
+    // (cp, tar -x, lz4 -d, ...), under the policy: rewrite it compressed if
+    // compression_enabled(path) and that saves space. Files already
+    // compressed are left alone; the mode and modification time are kept.
+    bool apply_compression(const std::string& path, std::string& error);
+
+    // The whole content of `path`, decompressed if need be
+    bool load_file(const std::string& path, std::string& out, std::string& error);
+
+    // Random-access reads from a plain or block-compressed file. Decoded
+    // blocks are kept in a small cache shared by all readers, so reading a
+    // file in pieces decodes each block once.
+    class BlockReader {
+    public:
+        BlockReader() = default;
+        ~BlockReader();
+
+        BlockReader(const BlockReader&) = delete;
+        BlockReader& operator=(const BlockReader&) = delete;
+
+        bool open(const std::string& path, std::string& error);
+
+        uint64_t size() const { return size_; }
+        uint64_t stored_size() const { return stored_size_; }
+        bool compressed() const { return !offsets_.empty(); }
+
+        // Append up to `len` bytes from `offset` to `out`; fewer at the end
+        // of the file
+        bool read(uint64_t offset, size_t len, std::string& out, std::string& error);
+
+        // Copy exactly `len` bytes from `offset`, which must be within the file
+        bool read(uint64_t offset, size_t len, char* out, std::string& error);
+
+    private:
+        int fd_ = -1;
+        std::string path_;
+        uint64_t size_ = 0;
+        uint64_t stored_size_ = 0;
+        uint64_t key_ = 0;                  // Identifies this version of the file in the cache
+        uint32_t block_size_ = 0;
+        std::vector<uint64_t> offsets_;     // Of each block's data, then the end of the last
+        std::vector<bool> raw_;
+
+        bool read_index(std::string& error);
+        const std::string* block(uint32_t index, std::string& error);
+    };
+}
@@ -0,0 +1,665 @@
+#include "btree.hpp"
+#include "file_io.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lib {
+    static const char kMagic[4] = {'B', 'T', 'R', 'E'};
+    static const uint32_t kVersion = 1;
+    static const size_t kHeaderSize = 32;
+    static const size_t kNodeHeader = 10;       // Type, count, link, prefix length
+    static const size_t kLeafEntry = 6;         // Slot, suffix length, value length
+    static const size_t kInternalEntry = 8;     // Slot, suffix length, child
+    static const uint8_t kLeaf = 1;
+    static const uint8_t kInternal = 2;
+
+    static size_t common_prefix(const std::string& a, const std::string& b) {
+        size_t n = a.size() < b.size() ? a.size() : b.size();
+        size_t i = 0;
+        while (i < n && a[i] == b[i]) ++i;
+        return i;
+    }
+
+    // Page layout: u8 type, u8 unused, u16 count, u32 link (the next leaf,
+    // or an internal node's first child), u16 prefix length, the prefix,
+    // u16 slot[count] giving each entry's offset, then the entries: u16
+    // suffix length and u16 value length or u32 child, then the suffix and
+    // a leaf's value
+    namespace {
+        struct Page {
+            const uint8_t* data;
+
+            bool leaf() const { return data[0] == kLeaf; }
+            uint32_t count() const { return read16(data + 2); }
+            uint32_t link() const { return read32(data + 4); }
+            uint32_t prefix_size() const { return read16(data + 8); }
+            const uint8_t* prefix() const { return data + kNodeHeader; }
+            const uint8_t* entry(uint32_t i) const { return data + read16(data + kNodeHeader + prefix_size() + 2 * i); }
+            uint32_t suffix_size(uint32_t i) const { return read16(entry(i)); }
+            const uint8_t* suffix(uint32_t i) const { return entry(i) + (leaf() ? 4 : 6); }
+            uint32_t child(uint32_t i) const { return read32(entry(i) + 2); }
+
+            std::string key(uint32_t i) const {
+                std::string key(reinterpret_cast<const char*>(prefix()), prefix_size());
+                key.append(reinterpret_cast<const char*>(suffix(i)), suffix_size(i));
+                return key;
+            }
+
+            std::string value(uint32_t i) const {
+                const uint8_t* e = entry(i);
+                return std::string(reinterpret_cast<const char*>(e + 4 + read16(e)), read16(e + 2));
+            }
+
+            // The first entry whose key is >= `key` (> when `upper`),
+            // comparing only suffixes once the prefix matches
+            uint32_t search(const std::string& key, bool upper) const {
+                uint32_t p = prefix_size();
+                size_t n = key.size() < p ? key.size() : p;
+                int c = memcmp(prefix(), key.data(), n);
+                if (c > 0 || (c == 0 && key.size() < p)) return 0;
+                if (c < 0) return count();
+
+                const uint8_t* rest = reinterpret_cast<const uint8_t*>(key.data()) + p;
+                size_t rest_size = key.size() - p;
+                uint32_t lo = 0, hi = count();
+                while (lo < hi) {
+                    uint32_t mid = (lo + hi) / 2;
+                    uint32_t size = suffix_size(mid);
+                    int cmp = memcmp(suffix(mid), rest, size < rest_size ? size : rest_size);
+                    if (cmp == 0) cmp = size < rest_size ? -1 : size > rest_size ? 1 : 0;
+                    if (cmp < 0 || (upper && cmp == 0)) {
+                        lo = mid + 1;
+                    } else {
+                        hi = mid;
+                    }
+                }
+                return lo;
+            }
+
+            bool matches(uint32_t i, const std::string& key) const {
+                uint32_t p = prefix_size();
+                return i < count() && key.size() == p + suffix_size(i) && memcmp(prefix(), key.data(), p) == 0 &&
+                       memcmp(suffix(i), key.data() + p, key.size() - p) == 0;
+            }
+        };
+    }
+
+    static size_t prefix_of(const std::vector<std::string>& keys) {
+        if (keys.empty()) return 0;
+        // Keys are sorted, so the first and last share the common prefix
+        size_t p = common_prefix(keys.front(), keys.back());
+        return p > 0xffff ? 0xffff : p;
+    }
+
+    template <typename NodeT>
+    static size_t encoded_size(const NodeT& node) {
+        size_t p = prefix_of(node.keys);
+        size_t size = kNodeHeader + p;
+        for (size_t i = 0; i < node.keys.size(); ++i) {
+            size += (node.leaf ? kLeafEntry + node.values[i].size() : kInternalEntry) + node.keys[i].size() - p;
+        }
+        return size;
+    }
+
+    BTree::BTree(size_t frames) : frames_(frames < 8 ? 8 : frames), memory_(frames_.size() * kPageSize) {}
+
+    BTree::~BTree() {
+        std::string error;
+        if (fd_ >= 0) {
+            flush(error);
+            close(fd_);
+        }
+    }
+
+    bool BTree::open(const std::string& path, std::string& error) {
+        path_ = path;
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        struct stat st;
+        if (fd_ < 0 || fstat(fd_, &st) != 0) {
+            error = "cannot open " + path;
+            return false;
+        }
+        if (st.st_size == 0) return write_header(error);
+
+        uint8_t header[kHeaderSize];
+        if (pread(fd_, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+            memcmp(header, kMagic, sizeof(kMagic)) != 0 || read32(header + 4) != kVersion) {
+            error = path + ": not a B+tree file";
+            return false;
+        }
+        root_ = read32(header + 12);
+        pages_ = read32(header + 16);
+        height_ = read32(header + 20);
+        keys_ = read64(header + 24);
+        if (read32(header + 8) != kPageSize || pages_ == 0 || root_ >= pages_ || (root_ == 0) != (height_ == 0)) {
+            error = path + ": corrupt header";
+            return false;
+        }
+        return true;
+    }
+
+    bool BTree::write_header(std::string& error) {
+        uint8_t header[kHeaderSize];
+        memcpy(header, kMagic, sizeof(kMagic));
+        put32(header + 4, kVersion);
+        put32(header + 8, kPageSize);
+        put32(header + 12, root_);
+        put32(header + 16, pages_);
+        put32(header + 20, height_);
+        put64(header + 24, keys_);
+        if (pwrite(fd_, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+            error = path_ + ": write error";
+            return false;
+        }
+        header_dirty_ = false;
+        return true;
+    }
+
+    bool BTree::write_back(Frame& frame, std::string& error) {
+        if (!frame.dirty) return true;
+        const uint8_t* data = &memory_[(&frame - frames_.data()) * kPageSize];
+        off_t offset = static_cast<off_t>(frame.page) * kPageSize;
+        for (size_t done = 0; done < kPageSize;) {
+            ssize_t put = pwrite(fd_, data + done, kPageSize - done, offset + done);
+            if (put < 0 && errno == EINTR) continue;
+            if (put <= 0) {
+                error = path_ + ": write error";
+                return false;
+            }
+            done += put;
+        }
+        frame.dirty = false;
+        return true;
+    }
+
+    bool BTree::flush(std::string& error) {
+        for (Frame& frame : frames_) {
+            if (frame.used && !write_back(frame, error)) return false;
+        }
+        return !header_dirty_ || write_header(error);
+    }
+
+    // Take a frame for `page` from the clock: frames used since the hand
+    // last passed get another lap, the first one that was not is evicted
+    uint8_t* BTree::claim(uint32_t page, bool read, std::string& error) {
+        Frame* frame;
+        while (true) {
+            frame = &frames_[hand_];
+            hand_ = hand_ + 1 == frames_.size() ? 0 : hand_ + 1;
+            if (!frame->used) break;
+            if (frame->referenced) {
+                frame->referenced = false;
+                continue;
+            }
+            if (!write_back(*frame, error)) return nullptr;
+            resident_.erase(frame->page);
+            ++evictions_;
+            break;
+        }
+
+        size_t index = frame - frames_.data();
+        uint8_t* data = &memory_[index * kPageSize];
+        if (read) {
+            // Pages past the end of the file read as zeros
+            size_t done = 0;
+            while (done < kPageSize) {
+                ssize_t got = pread(fd_, data + done, kPageSize - done, static_cast<off_t>(page) * kPageSize + done);
+                if (got < 0 && errno == EINTR) continue;
+                if (got < 0) {
+                    frame->used = false;
+                    error = path_ + ": read error";
+                    return nullptr;
+                }
+                if (got == 0) break;
+                done += got;
+            }
+            memset(data + done, 0, kPageSize - done);
+        } else {
+            memset(data, 0, kPageSize);
+        }
+        frame->page = page;
+        frame->used = true;
+        frame->dirty = !read;
+        frame->referenced = true;
+        resident_[page] = index;
+        return data;
+    }
+
+    uint8_t* BTree::fetch(uint32_t page, bool write, std::string& error) {
+        if (page == 0 || page >= pages_) {
+            error = path_ + ": bad page reference";
+            return nullptr;
+        }
+        auto it = resident_.find(page);
+        if (it != resident_.end()) {
+            ++hits_;
+            Frame& frame = frames_[it->second];
+            frame.referenced = true;
+            frame.dirty = frame.dirty || write;
+            return &memory_[it->second * kPageSize];
+        }
+        ++misses_;
+        uint8_t* data = claim(page, true, error);
+        if (data && write) frames_[resident_[page]].dirty = true;
+        return data;
+    }
+
+    uint8_t* BTree::allocate(uint32_t& page, std::string& error) {
+        page = pages_++;
+        header_dirty_ = true;
+        return claim(page, false, error);
+    }
+
+    template <typename NodeT>
+    static void decode(const uint8_t* data, NodeT& node) {
+        Page page{data};
+        uint32_t count = page.count();
+        node.leaf = page.leaf();
+        node.next = node.leaf ? page.link() : 0;
+        node.keys.clear();
+        node.values.clear();
+        node.children.clear();
+        if (!node.leaf) node.children.push_back(page.link());
+        for (uint32_t i = 0; i < count; ++i) {
+            node.keys.push_back(page.key(i));
+            if (node.leaf) {
+                node.values.push_back(page.value(i));
+            } else {
+                node.children.push_back(page.child(i));
+            }
+        }
+    }
+
+    // Descend to the leaf that would hold `key`, noting each internal page
+    // and the child taken in `path`
+    uint32_t BTree::find_leaf(const std::string& key, std::vector<std::pair<uint32_t, uint32_t>>* path,
+                              std::string& error) {
+        uint32_t page = root_;
+        for (uint32_t level = 1; level < height_; ++level) {
+            const uint8_t* data = fetch(page, false, error);
+            if (!data) return 0;
+            Page node{data};
+            if (node.leaf()) {
+                error = path_ + ": corrupt tree";
+                return 0;
+            }
+            uint32_t index = node.search(key, true);
+            if (path) path->emplace_back(page, index);
+            page = index == 0 ? node.link() : node.child(index - 1);
+        }
+        return page;
+    }
+
+    bool BTree::get(const std::string& key, std::string& value, std::string& error) {
+        if (root_ == 0) return false;
+        uint32_t leaf = find_leaf(key, nullptr, error);
+        const uint8_t* data = leaf ? fetch(leaf, false, error) : nullptr;
+        if (!data) return false;
+        Page page{data};
+        uint32_t index = page.search(key, false);
+        if (!page.matches(index, key)) return false;
+        value = page.value(index);
+        return true;
+    }
+
+    bool BTree::store(uint32_t page, const Node& node, std::string& error) {
+        uint8_t* data = fetch(page, true, error);
+        if (!data) return false;
+        size_t p = prefix_of(node.keys);
+        uint32_t count = static_cast<uint32_t>(node.keys.size());
+        memset(data, 0, kPageSize);
+        data[0] = node.leaf ? kLeaf : kInternal;
+        put16(data + 2, static_cast<uint16_t>(count));
+        put32(data + 4, node.leaf ? node.next : node.children[0]);
+        put16(data + 8, static_cast<uint16_t>(p));
+        if (p) memcpy(data + kNodeHeader, node.keys[0].data(), p);
+
+        uint8_t* slots = data + kNodeHeader + p;
+        size_t offset = kNodeHeader + p + 2 * static_cast<size_t>(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            const std::string& key = node.keys[i];
+            put16(slots + 2 * i, static_cast<uint16_t>(offset));
+            put16(data + offset, static_cast<uint16_t>(key.size() - p));
+            if (node.leaf) {
+                put16(data + offset + 2, static_cast<uint16_t>(node.values[i].size()));
+                offset += 4;
+            } else {
+                put32(data + offset + 2, node.children[i + 1]);
+                offset += 6;
+            }
+            memcpy(data + offset, key.data() + p, key.size() - p);
+            offset += key.size() - p;
+            if (node.leaf) {
+                memcpy(data + offset, node.values[i].data(), node.values[i].size());
+                offset += node.values[i].size();
+            }
+        }
+        return true;
+    }
+
+    // Move the upper part of an overfull node to a new page, choosing the
+    // cut that leaves the larger half smallest. Sizes are measured against
+    // the whole node's prefix, which each half's own prefix only extends,
+    // so both halves are sure to fit.
+    bool BTree::split(uint32_t page, Node& node, std::string& separator, uint32_t& right, std::string& error) {
+        size_t n = node.keys.size();
+        size_t p = prefix_of(node.keys);
+        std::vector<size_t> sizes(n);
+        size_t total = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sizes[i] = (node.leaf ? kLeafEntry + node.values[i].size() : kInternalEntry) + node.keys[i].size() - p;
+            total += sizes[i];
+        }
+        // A leaf keeps keys [0, cut) and an internal node [0, cut), with
+        // keys[cut] moving up as the separator
+        size_t cut = 1;
+        size_t best = static_cast<size_t>(-1);
+        size_t left = 0;
+        for (size_t i = 1; i < n; ++i) {
+            left += sizes[i - 1];
+            size_t rest = total - left - (node.leaf ? 0 : sizes[i]);
+            size_t larger = left > rest ? left : rest;
+            if (larger < best && (node.leaf || i + 1 < n)) {
+                best = larger;
+                cut = i;
+            }
+        }
+
+        Node upper;
+        upper.leaf = node.leaf;
+        if (node.leaf) {
+            upper.keys.assign(node.keys.begin() + cut, node.keys.end());
+            upper.values.assign(node.values.begin() + cut, node.values.end());
+            node.values.resize(cut);
+            separator = upper.keys[0];
+        } else {
+            separator = node.keys[cut];
+            upper.keys.assign(node.keys.begin() + cut + 1, node.keys.end());
+            upper.children.assign(node.children.begin() + cut + 1, node.children.end());
+            node.children.resize(cut + 1);
+        }
+        node.keys.resize(cut);
+
+        if (!allocate(right, error)) return false;
+        if (node.leaf) {
+            upper.next = node.next;
+            node.next = right;
+        }
+        return store(right, upper, error) && store(page, node, error);
+    }
+
+    bool BTree::insert_into_parent(std::vector<std::pair<uint32_t, uint32_t>>& path, const std::string& key,
+                                   uint32_t child, std::string& error) {
+        if (path.empty()) {
+            Node root;
+            root.leaf = false;
+            root.keys.push_back(key);
+            root.children = {root_, child};
+            uint32_t page;
+            if (!allocate(page, error) || !store(page, root, error)) return false;
+            root_ = page;
+            ++height_;
+            return true;
+        }
+
+        uint32_t page = path.back().first;
+        uint32_t index = path.back().second;
+        path.pop_back();
+        const uint8_t* data = fetch(page, false, error);
+        if (!data) return false;
+        Node node;
+        decode(data, node);
+        node.keys.insert(node.keys.begin() + index, key);
+        node.children.insert(node.children.begin() + index + 1, child);
+        if (encoded_size(node) <= kPageSize) return store(page, node, error);
+
+        std::string separator;
+        uint32_t right;
+        return split(page, node, separator, right, error) && insert_into_parent(path, separator, right, error);
+    }
+
+    bool BTree::put(const std::string& key, const std::string& value, std::string& error) {
+        if (key.size() > kMaxKey || value.size() > kMaxValue) {
+            error = key.size() > kMaxKey ? "key too long" : "value too long";
+            return false;
+        }
+        ++version_;
+        header_dirty_ = true;
+        if (root_ == 0) {
+            Node leaf;
+            if (!allocate(root_, error) || !store(root_, leaf, error)) return false;
+            height_ = 1;
+        }
+
+        std::vector<std::pair<uint32_t, uint32_t>> path;
+        uint32_t leaf = find_leaf(key, &path, error);
+        const uint8_t* data = leaf ? fetch(leaf, false, error) : nullptr;
+        if (!data) return false;
+        Node node;
+        decode(data, node);
+        auto it = std::lower_bound(node.keys.begin(), node.keys.end(), key);
+        size_t index = it - node.keys.begin();
+        if (it != node.keys.end() && *it == key) {
+            node.values[index] = value;
+        } else {
+            node.keys.insert(it, key);
+            node.values.insert(node.values.begin() + index, value);
+            ++keys_;
+        }
+        if (encoded_size(node) <= kPageSize) return store(leaf, node, error);
+
+        std::string separator;
+        uint32_t right;
+        return split(leaf, node, separator, right, error) && insert_into_parent(path, separator, right, error);
+    }
+
+    bool BTree::remove(const std::string& key, std::string& error) {
+        if (root_ == 0) return false;
+        uint32_t leaf = find_leaf(key, nullptr, error);
+        const uint8_t* data = leaf ? fetch(leaf, false, error) : nullptr;
+        if (!data) return false;
+        Page page{data};
+        if (!page.matches(page.search(key, false), key)) return false;
+
+        Node node;
+        decode(data, node);
+        auto it = std::lower_bound(node.keys.begin(), node.keys.end(), key);
+        node.values.erase(node.values.begin() + (it - node.keys.begin()));
+        node.keys.erase(it);
+        ++version_;
+        --keys_;
+        header_dirty_ = true;
+        return store(leaf, node, error);
+    }
+
+    void BTree::reset() {
+        for (Frame& frame : frames_) frame = Frame();
+        resident_.clear();
+        hand_ = 0;
+        root_ = 0;
+        pages_ = 1;
+        height_ = 0;
+        keys_ = 0;
+        ++version_;
+        header_dirty_ = true;
+    }
+
+    bool BTree::bulk_load(const Source& source, double fill, std::string& error) {
+        reset();
+        if (ftruncate(fd_, kPageSize) != 0) {
+            error = path_ + ": cannot truncate";
+            return false;
+        }
+        size_t limit = static_cast<size_t>(kPageSize * (fill < 0.5 ? 0.5 : fill > 1.0 ? 1.0 : fill));
+
+        // Each level is built from the one below as (first key, page) pairs
+        std::vector<std::pair<std::string, uint32_t>> level;
+        Node node;
+        size_t entries = 0;         // Sum of the node's entry sizes with whole keys
+
+        // Leaves take consecutive pages, so each links to the page after it
+        auto emit_leaf = [&](bool last) {
+            uint32_t page;
+            if (!allocate(page, error)) return false;
+            node.next = last ? 0 : page + 1;
+            level.emplace_back(node.keys[0], page);
+            if (!store(page, node, error)) return false;
+            node.keys.clear();
+            node.values.clear();
+            return true;
+        };
+
+        std::string key, value, previous;
+        uint64_t count = 0;
+        while (source(key, value)) {
+            if (key.size() > kMaxKey || value.size() > kMaxValue) {
+                error = key.size() > kMaxKey ? "key too long" : "value too long";
+            } else if (count > 0 && key <= previous) {
+                error = "keys out of order at " + key;
+            }
+            size_t size = kLeafEntry + key.size() + value.size();
+            if (error.empty() && !node.keys.empty()) {
+                // Sorted keys share with the first whatever they all share
+                size_t p = common_prefix(node.keys[0], key);
+                if (kNodeHeader + p + entries + size - (node.keys.size() + 1) * p > limit) emit_leaf(false);
+            }
+            if (!error.empty()) {
+                reset();
+                return false;
+            }
+            entries = node.keys.empty() ? size : entries + size;
+            node.keys.push_back(key);
+            node.values.push_back(value);
+            previous.swap(key);
+            ++count;
+        }
+        if (!node.keys.empty() && !emit_leaf(true)) {
+            reset();
+            return false;
+        }
+        keys_ = count;
+        if (level.empty()) return flush(error);
+
+        height_ = 1;
+        while (level.size() > 1) {
+            std::vector<std::pair<std::string, uint32_t>> upper;
+            Node inner;
+            inner.leaf = false;
+            std::string first;
+            auto emit_inner = [&]() {
+                uint32_t page;
+                if (!allocate(page, error) || !store(page, inner, error)) return false;
+                upper.emplace_back(first, page);
+                inner.keys.clear();
+                inner.children.clear();
+                return true;
+            };
+
+            for (const auto& child : level) {
+                size_t size = kInternalEntry + child.first.size();
+                if (!inner.children.empty()) {
+                    size_t p = inner.keys.empty() ? child.first.size() : common_prefix(inner.keys[0], child.first);
+                    if (kNodeHeader + p + entries + size - (inner.keys.size() + 1) * p <= limit) {
+                        inner.keys.push_back(child.first);
+                        inner.children.push_back(child.second);
+                        entries += size;
+                        continue;
+                    }
+                    if (!emit_inner()) {
+                        reset();
+                        return false;
+                    }
+                }
+                inner.children.push_back(child.second);
+                first = child.first;
+                entries = 0;
+            }
+            if (!emit_inner()) {
+                reset();
+                return false;
+            }
+            level.swap(upper);
+            ++height_;
+        }
+        root_ = level[0].second;
+        return flush(error);
+    }
+
+    BTreeCursor BTree::scan(const std::string& start, const std::string& end) {
+        BTreeCursor cursor;
+        cursor.tree_ = this;
+        cursor.last_ = start;
+        cursor.end_ = end;
+        cursor.version_ = version_ - 1;
+        return cursor;
+    }
+
+    // Find the cursor's place: the first key at or after the start, or
+    // after the last key returned
+    bool BTree::seek(BTreeCursor& cursor, std::string& error) {
+        cursor.version_ = version_;
+        if (root_ == 0) {
+            cursor.done_ = true;
+            return true;
+        }
+        uint32_t leaf = find_leaf(cursor.last_, nullptr, error);
+        const uint8_t* data = leaf ? fetch(leaf, false, error) : nullptr;
+        if (!data) return false;
+        cursor.leaf_ = leaf;
+        cursor.slot_ = Page{data}.search(cursor.last_, cursor.started_);
+        return true;
+    }
+
+    bool BTreeCursor::next(std::string& key, std::string& value, std::string& error) {
+        if (done_) return false;
+        if (version_ != tree_->version_ && !tree_->seek(*this, error)) {
+            done_ = true;
+            return false;
+        }
+        while (!done_) {
+            const uint8_t* data = tree_->fetch(leaf_, false, error);
+            if (!data) {
+                done_ = true;
+                return false;
+            }
+            Page page{data};
+            if (slot_ < page.count()) {
+                key = page.key(slot_);
+                if (!end_.empty() && key >= end_) break;
+                value = page.value(slot_++);
+                last_ = key;
+                started_ = true;
+                return true;
+            }
+            // Emptied leaves stay linked in, so keep walking
+            leaf_ = page.link();
+            slot_ = 0;
+            if (leaf_ == 0) break;
+        }
+        done_ = true;
+        return false;
+    }
+
+    BTree::Stats BTree::stats() const {
+        return {keys_, pages_, height_, hits_, misses_, evictions_};
+    }
+
+    BTree* btree_file(const std::string& path, std::string& error) {
+        static std::map<std::string, BTree*> trees;
+        auto it = trees.find(path);
+        if (it != trees.end()) return it->second;
+
+        BTree* tree = new BTree();
+        if (!tree->open(path, error)) {
+            delete tree;
+            return nullptr;
+        }
+        trees[path] = tree;
+        return tree;
+    }
+}
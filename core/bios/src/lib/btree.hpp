@@ -0,0 +1,156 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lib {
+    class BTree;
+
+    // Walks the keys of a BTree in order from a start key up to (not
+    // including) an end key. Writes to the tree between steps are seen:
+    // the cursor picks up after the last key it returned.
+    class BTreeCursor {
+    public:
+        // Next pair; false at the end or on error (with `error` set)
+        bool next(std::string& key, std::string& value, std::string& error);
+
+    private:
+        friend class BTree;
+
+        BTree* tree_ = nullptr;
+        std::string end_;
+        std::string last_;
+        bool started_ = false;
+        bool done_ = false;
+        uint32_t leaf_ = 0;
+        uint32_t slot_ = 0;
+        uint64_t version_ = 0;          // Of the tree when leaf_ and slot_ were found
+    };
+
+    // Ordered index in a single file of fixed 4 KB pages. Page 0 is the
+    // header; every other page is a node. Leaves hold key/value pairs and
+    // link to the next leaf; internal nodes hold separator keys and child
+    // pages. Within a page the keys' common prefix is stored once and each
+    // entry keeps only its suffix, reached through a slot array so lookups
+    // binary search the page in place.
+    //
+    // Pages are read through a fixed pool of frames evicted by CLOCK:
+    // each frame has a reference bit set on use, and the hand clears bits
+    // until it finds a frame not used since its last pass. Dirty frames are
+    // written back on eviction and by flush().
+    //
+    // Deleting leaves the emptied space in place; nodes are not merged.
+    // bulk_load() builds a packed tree from sorted pairs far faster than
+    // one put() per pair.
+    class BTree {
+    public:
+        static const uint32_t kPageSize = 4096;
+        static const size_t kMaxKey = 512;
+        static const size_t kMaxValue = 1024;
+        static const size_t kDefaultFrames = 1024;      // 4 MB of pages
+
+        struct Stats {
+            uint64_t keys;
+            uint32_t pages;
+            uint32_t height;
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t evictions;
+        };
+
+        explicit BTree(size_t frames = kDefaultFrames);
+        ~BTree();
+
+        BTree(const BTree&) = delete;
+        BTree& operator=(const BTree&) = delete;
+
+        // Open the tree in `path`, creating an empty one if the file does
+        // not exist
+        bool open(const std::string& path, std::string& error);
+
+        // False with an empty `error` when `key` is not present
+        bool get(const std::string& key, std::string& value, std::string& error);
+        bool put(const std::string& key, const std::string& value, std::string& error);
+
+        // False with an empty `error` when `key` was not present
+        bool remove(const std::string& key, std::string& error);
+
+        // Fills in the next pair of a bulk load; false when there are no more
+        using Source = std::function<bool(std::string& key, std::string& value)>;
+
+        // Replace the whole tree with the pairs from `source`, which must
+        // come in key order with no duplicates, filling each page to `fill`
+        // (0.5 to 1.0). Leaves are written left to right onto consecutive
+        // pages, then each level of internal nodes above them.
+        bool bulk_load(const Source& source, double fill, std::string& error);
+
+        // A cursor over start <= key < end; no upper bound when `end` is empty
+        BTreeCursor scan(const std::string& start, const std::string& end);
+
+        // Write dirty pages and the header
+        bool flush(std::string& error);
+
+        Stats stats() const;
+        const std::string& path() const { return path_; }
+
+    private:
+        friend class BTreeCursor;
+
+        struct Frame {
+            uint32_t page = 0;
+            bool used = false;
+            bool dirty = false;
+            bool referenced = false;
+        };
+
+        // A page decoded for modification; internal nodes have one more
+        // child than keys
+        struct Node {
+            bool leaf = true;
+            uint32_t next = 0;
+            std::vector<std::string> keys;
+            std::vector<std::string> values;
+            std::vector<uint32_t> children;
+        };
+
+        std::string path_;
+        int fd_ = -1;
+        uint32_t root_ = 0;
+        uint32_t pages_ = 1;
+        uint32_t height_ = 0;
+        uint64_t keys_ = 0;
+        uint64_t version_ = 0;          // Bumped on every write, so cursors find their place again
+        bool header_dirty_ = false;
+
+        std::vector<Frame> frames_;
+        std::vector<uint8_t> memory_;
+        std::unordered_map<uint32_t, size_t> resident_;
+        size_t hand_ = 0;
+        uint64_t hits_ = 0;
+        uint64_t misses_ = 0;
+        uint64_t evictions_ = 0;
+
+        // The page's bytes, valid until the next fetch; `write` marks it dirty
+        uint8_t* fetch(uint32_t page, bool write, std::string& error);
+        uint8_t* allocate(uint32_t& page, std::string& error);
+        uint8_t* claim(uint32_t page, bool read, std::string& error);
+        bool write_back(Frame& frame, std::string& error);
+        bool write_header(std::string& error);
+
+        uint32_t find_leaf(const std::string& key, std::vector<std::pair<uint32_t, uint32_t>>* path, std::string& error);
+        bool store(uint32_t page, const Node& node, std::string& error);
+        bool insert_into_parent(std::vector<std::pair<uint32_t, uint32_t>>& path, const std::string& key, uint32_t child,
+                                std::string& error);
+        bool split(uint32_t page, Node& node, std::string& separator, uint32_t& right, std::string& error);
+        bool seek(BTreeCursor& cursor, std::string& error);
+        void reset();
+    };
+
+    // The tree in `path`, opened on first use and shared by the btree
+    // command and the exports; nullptr with `error` set if it cannot be
+    // opened
+    BTree* btree_file(const std::string& path, std::string& error);
+}
@@ -0,0 +1,279 @@
+#include "cas.hpp"
+#include "encoding.hpp"
+#include "file_io.hpp"
+#include "hash.hpp"
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lib {
+    static const char kManifestMagic[4] = {'C', 'A', 'S', 'M'};
+    static const uint32_t kVersion = 1;
+
+    // FastCDC's masks for an 8 KB average: 15 bits below it, 11 above,
+    // spread over the hash's high bits where the gear mixing is best
+    static const uint64_t kMaskSmall = 0x0003590703530000ull;
+    static const uint64_t kMaskLarge = 0x0000d90003530000ull;
+
+    // One random 64-bit value per byte, from splitmix64 so the table (and
+    // with it every cut point) is the same on every build
+    static const uint64_t* gear_table() {
+        static uint64_t table[256];
+        static bool ready = false;
+        if (!ready) {
+            uint64_t state = 0x9e3779b97f4a7c15ull;
+            for (uint64_t& entry : table) {
+                uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+                entry = z ^ (z >> 31);
+            }
+            ready = true;
+        }
+        return table;
+    }
+
+    size_t cdc_cut(const uint8_t* data, size_t len) {
+        if (len <= kCdcMinChunk) return len;
+        const uint64_t* gear = gear_table();
+        size_t normal = len < kCdcAvgChunk ? len : kCdcAvgChunk;
+        size_t end = len < kCdcMaxChunk ? len : kCdcMaxChunk;
+        uint64_t hash = 0;
+        size_t i = kCdcMinChunk;
+        for (; i < normal; ++i) {
+            hash = (hash << 1) + gear[data[i]];
+            if (!(hash & kMaskSmall)) return i + 1;
+        }
+        for (; i < end; ++i) {
+            hash = (hash << 1) + gear[data[i]];
+            if (!(hash & kMaskLarge)) return i + 1;
+        }
+        return end;
+    }
+
+    static std::string hex(const std::string& digest) {
+        std::string out(digest.size() * 2, '\0');
+        hex_encode(reinterpret_cast<const uint8_t*>(digest.data()), digest.size(), &out[0]);
+        return out;
+    }
+
+    static std::string chunk_path(const std::string& digest) {
+        std::string name = hex(digest);
+        return std::string(ContentStore::kDirectory) + "/chunks/" + name.substr(0, 2) + "/" + name;
+    }
+
+    static std::string manifest_path(const std::string& name) {
+        uint64_t id = xxh3_64(reinterpret_cast<const uint8_t*>(name.data()), name.size());
+        char file[24];
+        snprintf(file, sizeof(file), "%016llx", static_cast<unsigned long long>(id));
+        return std::string(ContentStore::kDirectory) + "/files/" + file;
+    }
+
+    // Write through a temporary file, so `path` is either absent or whole
+    static bool write_whole(const std::string& path, const char* data, size_t len, std::string& error) {
+        std::string temp = path + ".tmp";
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(data, static_cast<std::streamsize>(len));
+        out.close();
+        if (!out || rename(temp.c_str(), path.c_str()) != 0) {
+            ::remove(temp.c_str());
+            error = "cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+
+    bool ContentStore::open(std::string& error) {
+        std::string root = kDirectory;
+        for (size_t slash = root.find('/', 1); ; slash = root.find('/', slash + 1)) {
+            mkdir(root.substr(0, slash).c_str(), 0755);
+            if (slash == std::string::npos) break;
+        }
+        mkdir((root + "/chunks").c_str(), 0755);
+        mkdir((root + "/files").c_str(), 0755);
+
+        DIR* dir = opendir((root + "/files").c_str());
+        if (!dir) {
+            error = "cannot open " + root + "/files";
+            return false;
+        }
+        std::vector<std::string> manifests;
+        while (struct dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() == 16) manifests.push_back(root + "/files/" + name);
+        }
+        closedir(dir);
+
+        // A manifest that does not parse is passed over; its chunks are
+        // only kept if another file uses them
+        for (const std::string& path : manifests) {
+            std::ifstream in(path, std::ios::binary);
+            std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data());
+            size_t size = data.size();
+            if (size < 20 || memcmp(p, kManifestMagic, 4) != 0 || read32(p + 4) != kVersion) continue;
+            File file;
+            file.size = read64(p + 8);
+            uint32_t name_len = read32(p + 16);
+            if (size - 20 < name_len + 4ull) continue;
+            std::string name(reinterpret_cast<const char*>(p + 20), name_len);
+            size_t pos = 20 + name_len;
+            uint32_t count = read32(p + pos);
+            pos += 4;
+            if ((size - pos) / (kDigestSize + 4) < count) continue;
+            uint64_t total = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                file.chunks.push_back({std::string(reinterpret_cast<const char*>(p + pos), kDigestSize), read32(p + pos + kDigestSize)});
+                total += file.chunks.back().size;
+                pos += kDigestSize + 4;
+            }
+            if (total != file.size || files_.count(name)) continue;
+            add_file(name, std::move(file));
+        }
+        return true;
+    }
+
+    void ContentStore::add_file(const std::string& name, File file) {
+        for (const ChunkRef& ref : file.chunks) {
+            ChunkInfo& info = chunks_[ref.digest];
+            if (info.refs++ == 0) {
+                info.size = ref.size;
+                ++stats_.chunks;
+                stats_.stored_bytes += ref.size;
+            }
+            ++stats_.chunk_refs;
+        }
+        ++stats_.files;
+        stats_.logical_bytes += file.size;
+        files_[name] = std::move(file);
+    }
+
+    // Drop a file's references, deleting the chunks nothing else uses;
+    // the file is already out of files_ and its manifest is the caller's
+    bool ContentStore::release(const File& file, std::string& error) {
+        --stats_.files;
+        stats_.logical_bytes -= file.size;
+        bool ok = true;
+        for (const ChunkRef& ref : file.chunks) {
+            --stats_.chunk_refs;
+            auto chunk = chunks_.find(ref.digest);
+            if (chunk == chunks_.end() || --chunk->second.refs > 0) continue;
+            --stats_.chunks;
+            stats_.stored_bytes -= chunk->second.size;
+            chunks_.erase(chunk);
+            std::string path = chunk_path(ref.digest);
+            if (unlink(path.c_str()) != 0 && ok) {
+                error = "cannot delete " + path;
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    bool ContentStore::put(const std::string& name, const uint8_t* data, size_t len, uint64_t& added, std::string& error) {
+        File file;
+        file.size = len;
+        added = 0;
+        std::unordered_map<std::string, bool> written;
+        for (size_t pos = 0; pos < len;) {
+            size_t size = cdc_cut(data + pos, len - pos);
+            Blake3 hasher;
+            hasher.update(data + pos, size);
+            std::string digest(kDigestSize, '\0');
+            hasher.finish(reinterpret_cast<uint8_t*>(&digest[0]));
+
+            if (!chunks_.count(digest) && !written[digest]) {
+                std::string path = chunk_path(digest);
+                mkdir(path.substr(0, path.rfind('/')).c_str(), 0755);
+                if (!write_whole(path, reinterpret_cast<const char*>(data + pos), size, error)) return false;
+                written[digest] = true;
+                added += size;
+            }
+            file.chunks.push_back({digest, static_cast<uint32_t>(size)});
+            pos += size;
+        }
+
+        std::string manifest(kManifestMagic, sizeof(kManifestMagic));
+        put32(manifest, kVersion);
+        put64(manifest, file.size);
+        put32(manifest, static_cast<uint32_t>(name.size()));
+        manifest += name;
+        put32(manifest, static_cast<uint32_t>(file.chunks.size()));
+        for (const ChunkRef& ref : file.chunks) {
+            manifest += ref.digest;
+            put32(manifest, ref.size);
+        }
+        if (!write_whole(manifest_path(name), manifest.data(), manifest.size(), error)) return false;
+
+        // Take the new references before dropping the old ones, so chunks
+        // both versions share survive
+        auto old = files_.find(name);
+        if (old == files_.end()) {
+            add_file(name, std::move(file));
+            return true;
+        }
+        File previous = std::move(old->second);
+        files_.erase(old);
+        add_file(name, std::move(file));
+        return release(previous, error);
+    }
+
+    bool ContentStore::get(const std::string& name, std::string& out, std::string& error) {
+        auto it = files_.find(name);
+        if (it == files_.end()) return false;
+        out.clear();
+        out.reserve(static_cast<size_t>(it->second.size));
+        for (const ChunkRef& ref : it->second.chunks) {
+            std::string path = chunk_path(ref.digest);
+            std::ifstream in(path, std::ios::binary);
+            size_t start = out.size();
+            out.resize(start + ref.size);
+            if (!in.read(&out[start], ref.size) || in.peek() != std::ifstream::traits_type::eof()) {
+                error = path + ": missing or damaged chunk";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ContentStore::stat(const std::string& name, FileStat& out) const {
+        auto it = files_.find(name);
+        if (it == files_.end()) return false;
+        out.size = it->second.size;
+        out.chunks = static_cast<uint32_t>(it->second.chunks.size());
+        out.shared = 0;
+        for (const ChunkRef& ref : it->second.chunks) {
+            auto chunk = chunks_.find(ref.digest);
+            if (chunk != chunks_.end() && chunk->second.refs > 1) ++out.shared;
+        }
+        return true;
+    }
+
+    bool ContentStore::remove(const std::string& name, std::string& error) {
+        auto it = files_.find(name);
+        if (it == files_.end()) return false;
+        std::string path = manifest_path(name);
+        if (unlink(path.c_str()) != 0) {
+            error = "cannot delete " + path;
+            return false;
+        }
+        File file = std::move(it->second);
+        files_.erase(it);
+        return release(file, error);
+    }
+
+    ContentStore* content_store(std::string& error) {
+        static ContentStore* store = nullptr;
+        if (store) return store;
+        ContentStore* opened = new ContentStore();
+        if (!opened->open(error)) {
+            delete opened;
+            return nullptr;
+        }
+        store = opened;
+        return store;
+    }
+}
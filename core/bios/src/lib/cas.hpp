@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lib {
+    // Content-defined chunk boundaries by FastCDC: a gear hash rolls over
+    // the bytes and a chunk ends where its low bits are all zero. Below the
+    // average size a mask with more bits makes a cut less likely, above it
+    // one with fewer bits makes it more likely, which keeps sizes close to
+    // the average. Since cuts depend only on nearby bytes, an insertion
+    // moves the boundaries around it and no others.
+    static const size_t kCdcMinChunk = 2 * 1024;
+    static const size_t kCdcAvgChunk = 8 * 1024;
+    static const size_t kCdcMaxChunk = 64 * 1024;
+
+    // Length of the chunk starting at `data`
+    size_t cdc_cut(const uint8_t* data, size_t len);
+
+    // Deduplicating store of named files under kDirectory. Files are cut by
+    // cdc_cut() and each distinct chunk is kept once, named by its BLAKE3
+    // digest (chunks/ab/abcd...); a file is a manifest (files/<XXH3 of the
+    // name>) listing its chunks:
+    //
+    //   "CASM" u32 version, u64 size, u32 name length, name, u32 chunks,
+    //   then per chunk its 32-byte digest and u32 size
+    //
+    // Reference counts are rebuilt from the manifests on open(). New chunks
+    // are written before the manifest that uses them and old ones deleted
+    // after it is replaced, so an interrupted put() leaves at worst an
+    // unreferenced chunk.
+    class ContentStore {
+    public:
+        static constexpr const char* kDirectory = "/.bios/cas";
+        static const size_t kDigestSize = 32;
+
+        struct FileStat {
+            uint64_t size;
+            uint32_t chunks;
+            uint32_t shared;            // Chunks also used elsewhere
+        };
+
+        struct Stats {
+            uint64_t files;
+            uint64_t logical_bytes;     // Sum of the files' sizes
+            uint64_t chunk_refs;
+            uint64_t chunks;            // Distinct chunks
+            uint64_t stored_bytes;      // Their total size
+        };
+
+        // Read the manifests under kDirectory, creating it if need be
+        bool open(std::string& error);
+
+        // Store `data` as `name`, replacing what was there. `added` is set
+        // to the bytes of chunks the store did not already have.
+        bool put(const std::string& name, const uint8_t* data, size_t len, uint64_t& added, std::string& error);
+
+        // False with an empty `error` when there is no `name`
+        bool get(const std::string& name, std::string& out, std::string& error);
+        bool stat(const std::string& name, FileStat& out) const;
+
+        // False with an empty `error` when there is no `name`
+        bool remove(const std::string& name, std::string& error);
+
+        Stats stats() const { return stats_; }
+
+    private:
+        struct ChunkRef {
+            std::string digest;
+            uint32_t size;
+        };
+
+        struct ChunkInfo {
+            uint32_t size;
+            uint32_t refs;
+        };
+
+        struct File {
+            uint64_t size;
+            std::vector<ChunkRef> chunks;
+        };
+
+        std::map<std::string, File> files_;
+        std::unordered_map<std::string, ChunkInfo> chunks_;     // By digest
+        Stats stats_ = {};
+
+        void add_file(const std::string& name, File file);
+        bool release(const File& file, std::string& error);
+    };
+
+    // The store, opened on first use and shared by the dedup command and
+    // the exports; nullptr with `error` set if it cannot be opened
+    ContentStore* content_store(std::string& error);
+}
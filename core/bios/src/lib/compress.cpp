@@ -0,0 +1,89 @@
+#include "compress.hpp"
+
+namespace lib {
+    static const int kDefaultLz4Level = 1;
+    static const int kDefaultZstdLevel = 3;
+    static const int kDefaultGzipLevel = 6;
+
+    Compressor::Compressor(Codec codec, int level, const std::string& dictionary)
+        : codec_(codec),
+          lz4_(level ? level : kDefaultLz4Level),
+          zstd_(level ? level : kDefaultZstdLevel, codec == kZstd ? dictionary : std::string()),
+          gzip_(level ? level : kDefaultGzipLevel) {}
+
+    bool Compressor::parse(const std::string& name, Codec& codec) {
+        if (name == "lz4") {
+            codec = kLz4;
+        } else if (name == "zstd") {
+            codec = kZstd;
+        } else if (name == "gzip") {
+            codec = kGzip;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    void Compressor::update(const uint8_t* data, size_t len, std::string& out) {
+        switch (codec_) {
+            case kLz4: lz4_.update(data, len, out); break;
+            case kZstd: zstd_.update(data, len, out); break;
+            case kGzip: gzip_.update(data, len, out); break;
+        }
+    }
+
+    void Compressor::finish(std::string& out) {
+        switch (codec_) {
+            case kLz4: lz4_.finish(out); break;
+            case kZstd: zstd_.finish(out); break;
+            case kGzip: gzip_.finish(out); break;
+        }
+    }
+
+    Decompressor::Decompressor(const std::string& dictionary) : zstd_(dictionary) {}
+
+    bool Decompressor::update(const uint8_t* data, size_t len, std::string& out, std::string& error) {
+        if (codec_ == kUnknown) {
+            head_.insert(head_.end(), data, data + len);
+            if (head_.size() < 4) return true;
+            if (is_lz4_frame(head_.data(), head_.size())) {
+                codec_ = kLz4;
+            } else if (is_zstd_frame(head_.data(), head_.size())) {
+                codec_ = kZstd;
+            } else if (is_gzip_member(head_.data(), head_.size())) {
+                codec_ = kGzip;
+            } else {
+                error = "unknown compression format";
+                return false;
+            }
+            data = head_.data();
+            len = head_.size();
+        }
+
+        bool ok = false;
+        switch (codec_) {
+            case kLz4: ok = lz4_.update(data, len, out, error); break;
+            case kZstd: ok = zstd_.update(data, len, out, error); break;
+            case kGzip: ok = gzip_.update(data, len, out, error); break;
+            case kUnknown: break;
+        }
+        if (!head_.empty()) {
+            head_.clear();
+            head_.shrink_to_fit();
+        }
+        return ok;
+    }
+
+    bool Decompressor::finish(std::string& error) const {
+        switch (codec_) {
+            case kUnknown:
+                if (head_.empty()) return true;
+                error = "unknown compression format";
+                return false;
+            case kLz4: return lz4_.finish(error);
+            case kZstd: return zstd_.finish(error);
+            case kGzip: return gzip_.finish(error);
+        }
+        return false;
+    }
+}
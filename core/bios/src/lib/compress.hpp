@@ -0,0 +1,50 @@
+#pragma once
+#include "gzip.hpp"
+#include "lz4.hpp"
+#include "zstd.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lib {
+    // Streaming compression with any of the codecs. Output is a standard
+    // frame the matching command-line tool can read.
+    class Compressor {
+    public:
+        enum Codec { kLz4, kZstd, kGzip };
+
+        // Level 0 picks the codec's default; the dictionary is used by zstd
+        Compressor(Codec codec, int level, const std::string& dictionary = std::string());
+
+        // Parse "lz4", "zstd" or "gzip"; false if unknown
+        static bool parse(const std::string& name, Codec& codec);
+
+        void update(const uint8_t* data, size_t len, std::string& out);
+        void finish(std::string& out);
+
+    private:
+        Codec codec_;
+        Lz4Encoder lz4_;
+        ZstdEncoder zstd_;
+        GzipEncoder gzip_;
+    };
+
+    // Streaming decompression of whichever codec's frames the input holds
+    class Decompressor {
+    public:
+        explicit Decompressor(const std::string& dictionary = std::string());
+
+        bool update(const uint8_t* data, size_t len, std::string& out, std::string& error);
+        bool finish(std::string& error) const;
+
+    private:
+        enum Codec { kUnknown, kLz4, kZstd, kGzip };
+
+        Codec codec_ = kUnknown;
+        std::vector<uint8_t> head_;     // Input held back until the magic is known
+        Lz4Decoder lz4_;
+        ZstdDecoder zstd_;
+        GzipDecoder gzip_;
+    };
+}
@@ -0,0 +1,273 @@
+#include "csv.hpp"
+#include <cstring>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+namespace lib {
+    namespace {
+        inline uint64_t prefix_xor(uint64_t bits) {
+            bits ^= bits << 1;
+            bits ^= bits << 2;
+            bits ^= bits << 4;
+            bits ^= bits << 8;
+            bits ^= bits << 16;
+            bits ^= bits << 32;
+            return bits;
+        }
+
+        inline uint64_t match_mask(const char* block, char c) {
+#ifdef __wasm_simd128__
+            const v128_t needle = wasm_i8x16_splat(c);
+            uint64_t mask = 0;
+            for (int i = 0; i < 4; ++i) {
+                mask |= static_cast<uint64_t>(wasm_i8x16_bitmask(wasm_i8x16_eq(wasm_v128_load(block + 16 * i), needle))) << (16 * i);
+            }
+            return mask;
+#else
+            uint64_t mask = 0;
+            for (int i = 0; i < 64; ++i) {
+                if (block[i] == c) mask |= uint64_t(1) << i;
+            }
+            return mask;
+#endif
+        }
+    }
+
+    size_t CsvScanner::scan(const char* data, size_t len, bool final) {
+        terminators_.clear();
+        uint64_t in_quotes = 0;    // All ones while inside quotes across blocks
+        size_t complete = 0;
+        size_t last_row_terminator = 0;
+
+        char padded[64];
+        for (size_t base = 0; base < len; base += 64) {
+            const char* block = data + base;
+            size_t valid = len - base < 64 ? len - base : 64;
+            if (valid < 64) {
+                memset(padded, 0, sizeof(padded));
+                memcpy(padded, block, valid);
+                block = padded;
+            }
+
+            uint64_t quotes = match_mask(block, '"');
+            uint64_t inside = prefix_xor(quotes) ^ in_quotes;
+            in_quotes = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);
+
+            uint64_t newlines = match_mask(block, '\n') & ~inside;
+            uint64_t separators = (match_mask(block, delim_) & ~inside) | newlines;
+            if (valid < 64) separators &= (uint64_t(1) << valid) - 1;
+
+            while (separators) {
+                uint64_t bit = separators & (~separators + 1);
+                size_t at = base + __builtin_ctzll(separators);
+                bool row_end = (newlines & bit) != 0;
+                terminators_.push_back(static_cast<uint32_t>(at << 1 | (row_end ? 1 : 0)));
+                if (row_end) {
+                    complete = at + 1;
+                    last_row_terminator = terminators_.size();
+                }
+                separators &= separators - 1;
+            }
+        }
+
+        if (final && complete < len) {
+            terminators_.push_back(static_cast<uint32_t>(len << 1 | 1));
+            return len;
+        }
+
+        // Drop boundaries belonging to the trailing partial row
+        terminators_.resize(last_row_terminator);
+        return complete;
+    }
+
+    void CsvBatch::build(const char* data, const std::vector<uint32_t>& terminators, const std::vector<bool>& wanted) {
+        rows = 0;
+        row_starts.clear();
+        row_ends.clear();
+        starts.assign(wanted.size(), std::vector<uint32_t>());
+        ends.assign(wanted.size(), std::vector<uint32_t>());
+
+        size_t column = 0;
+        uint32_t field_start = 0;
+        uint32_t row_start = 0;
+        for (uint32_t terminator : terminators) {
+            uint32_t at = terminator >> 1;
+            bool row_end = terminator & 1;
+            uint32_t end = at;
+            if (row_end && end > field_start && data[end - 1] == '\r') --end;
+
+            if (row_end && column == 0 && end == row_start) {
+                // Blank line
+                field_start = row_start = at + 1;
+                continue;
+            }
+
+            if (column < wanted.size() && wanted[column]) {
+                starts[column].push_back(field_start);
+                ends[column].push_back(end);
+            }
+            ++column;
+            field_start = at + 1;
+
+            if (row_end) {
+                // Short rows read as empty fields
+                for (; column < wanted.size(); ++column) {
+                    if (!wanted[column]) continue;
+                    starts[column].push_back(end);
+                    ends[column].push_back(end);
+                }
+                row_starts.push_back(row_start);
+                row_ends.push_back(end);
+                ++rows;
+                column = 0;
+                row_start = at + 1;
+            }
+        }
+    }
+
+    std::string_view csv_unquote(std::string_view raw, std::string& scratch) {
+        if (raw.size() < 2 || raw.front() != '"' || raw.back() != '"') return raw;
+        std::string_view body = raw.substr(1, raw.size() - 2);
+        if (body.find('"') == std::string_view::npos) return body;
+
+        scratch.clear();
+        for (size_t i = 0; i < body.size(); ++i) {
+            scratch += body[i];
+            if (body[i] == '"' && i + 1 < body.size() && body[i + 1] == '"') ++i;
+        }
+        return scratch;
+    }
+
+    CsvQuery::CsvQuery(const FieldProgram& program, char delim, bool header, Sink sink)
+        : program_(program), delim_(delim), header_(header), sink_(std::move(sink)), scanner_(delim) {}
+
+    std::string_view CsvQuery::raw_field(const char* data, const FieldRef& ref, size_t row) const {
+        if (ref.index == 0) return std::string_view(data + batch_.row_starts[row], batch_.row_ends[row] - batch_.row_starts[row]);
+        size_t column = ref.index - 1;
+        return std::string_view(data + batch_.starts[column][row], batch_.ends[column][row] - batch_.starts[column][row]);
+    }
+
+    std::string_view CsvQuery::field(const char* data, const FieldRef& ref, size_t row, std::string& scratch) const {
+        std::string_view raw = raw_field(data, ref, row);
+        return ref.index == 0 ? raw : csv_unquote(raw, scratch);
+    }
+
+    // Resolve header names and work out which columns the program reads
+    bool CsvQuery::prepare(const char* data, std::string& error) {
+        if (header_) {
+            std::vector<std::string> names;
+            if (batch_.rows > 0) {
+                size_t start = batch_.row_starts[0];
+                for (uint32_t terminator : scanner_.terminators()) {
+                    size_t at = terminator >> 1;
+                    if (at < start) continue;    // Leading blank lines
+                    size_t end = (terminator & 1) && at > start && data[at - 1] == '\r' ? at - 1 : at;
+                    names.emplace_back(csv_unquote(std::string_view(data + start, end - start), scratch_));
+                    start = at + 1;
+                    if (terminator & 1) break;
+                }
+            }
+            if (!program_.resolve(names, error)) return false;
+        } else if (!program_.resolve(std::vector<std::string>(), error)) {
+            return false;
+        }
+
+        auto want = [this](const FieldRef& ref) {
+            if (ref.index == 0) return;
+            if (wanted_.size() < ref.index) wanted_.resize(ref.index, false);
+            wanted_[ref.index - 1] = true;
+        };
+        for (const Condition& condition : program_.where) want(condition.field);
+        for (const FieldRef& ref : program_.print) want(ref);
+        if (program_.action != FieldProgram::kPrint && program_.action != FieldProgram::kCount) want(program_.value);
+        if (program_.grouped) want(program_.key);
+
+        resolved_ = true;
+        return true;
+    }
+
+    size_t CsvQuery::feed(const char* data, size_t len, bool final, std::string& error) {
+        if (len > UINT32_MAX / 2) {
+            error = "chunk too large";
+            return 0;
+        }
+
+        size_t consumed = scanner_.scan(data, len, final);
+        if (consumed == 0) return 0;
+
+        size_t first_row = 0;
+        if (!resolved_) {
+            // The header (or the first batch) decides which columns to keep
+            batch_.build(data, scanner_.terminators(), std::vector<bool>());
+            if (!prepare(data, error)) return 0;
+            if (header_ && batch_.rows > 0) first_row = 1;
+        }
+        batch_.build(data, scanner_.terminators(), wanted_);
+
+        // Filter column by column into the selection vector
+        selected_.assign(batch_.rows, 1);
+        for (size_t row = 0; row < first_row && row < batch_.rows; ++row) selected_[row] = 0;
+        for (const Condition& condition : program_.where) {
+            for (size_t row = first_row; row < batch_.rows; ++row) {
+                if (selected_[row] && !test(condition, field(data, condition.field, row, scratch_))) selected_[row] = 0;
+            }
+        }
+
+        const bool counting = program_.action == FieldProgram::kCount;
+        std::string line;
+        std::string key_scratch;
+        for (size_t row = first_row; row < batch_.rows; ++row) {
+            if (!selected_[row]) continue;
+
+            if (program_.action == FieldProgram::kPrint) {
+                line.clear();
+                for (size_t i = 0; i < program_.print.size(); ++i) {
+                    if (i) line += delim_;
+                    std::string_view raw = raw_field(data, program_.print[i], row);
+                    line.append(raw.data(), raw.size());
+                }
+                line += '\n';
+                sink_(line);
+                continue;
+            }
+
+            std::string_view value = counting ? std::string_view() : field(data, program_.value, row, scratch_);
+            if (program_.grouped) {
+                accumulate(groups_[field(data, program_.key, row, key_scratch)], value, counting);
+            } else {
+                accumulate(total_, value, counting);
+            }
+        }
+
+        return consumed;
+    }
+
+    void CsvQuery::finish() {
+        if (program_.action == FieldProgram::kPrint) return;
+        if (!program_.grouped) {
+            sink_(format_result(total_, program_.action) + "\n");
+            return;
+        }
+        std::string line;
+        for (const auto& entry : groups_.entries()) {
+            // Keys were unquoted for grouping; quote them again where needed
+            const std::string& key = entry.first;
+            if (key.find_first_of(std::string("\"\r\n") + delim_) == std::string::npos) {
+                line = key;
+            } else {
+                line = "\"";
+                for (char c : key) {
+                    if (c == '"') line += '"';
+                    line += c;
+                }
+                line += '"';
+            }
+            line += delim_;
+            line += format_result(entry.second, program_.action);
+            line += '\n';
+            sink_(line);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "field_program.hpp"
+#include "flat_map.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lib {
+    // Finds field and row boundaries in RFC 4180 CSV, 64 bytes at a time:
+    // a prefix XOR over the quote bits gives an in-quotes mask, so delimiters
+    // and newlines inside quoted fields (including embedded newlines) are
+    // ignored without a per-byte state machine
+    class CsvScanner {
+    public:
+        explicit CsvScanner(char delim) : delim_(delim) {}
+
+        // Scan [data, data + len) and return the length of the prefix made of
+        // complete rows. With `final`, the end of the data also ends a row.
+        size_t scan(const char* data, size_t len, bool final);
+
+        // Boundaries from the last scan: offset << 1, with the low bit set
+        // when the boundary ends a row
+        const std::vector<uint32_t>& terminators() const { return terminators_; }
+
+    private:
+        char delim_;
+        std::vector<uint32_t> terminators_;
+    };
+
+    // A batch of rows stored column-major: each requested column keeps its
+    // fields' start and end offsets side by side, and no row is materialized
+    struct CsvBatch {
+        size_t rows = 0;
+        std::vector<uint32_t> row_starts;
+        std::vector<uint32_t> row_ends;
+        std::vector<std::vector<uint32_t>> starts;    // Indexed by 0-based column
+        std::vector<std::vector<uint32_t>> ends;
+
+        // Fill from a scan, keeping only columns set in `wanted`
+        void build(const char* data, const std::vector<uint32_t>& terminators, const std::vector<bool>& wanted);
+    };
+
+    // The contents of a field with its quotes removed and doubled quotes
+    // collapsed; uses `scratch` only when the field needs unescaping
+    std::string_view csv_unquote(std::string_view raw, std::string& scratch);
+
+    // Runs a FieldProgram over CSV fed in chunks. Column filters are
+    // evaluated a column at a time into a selection vector before any
+    // projection or aggregation touches the selected rows.
+    class CsvQuery {
+    public:
+        using Sink = std::function<void(std::string_view)>;
+
+        CsvQuery(const FieldProgram& program, char delim, bool header, Sink sink);
+
+        // Process the complete rows in [data, data + len) and return how many
+        // bytes were consumed; the caller re-feeds the rest with more data
+        size_t feed(const char* data, size_t len, bool final, std::string& error);
+
+        // Emit aggregate results once all input has been fed
+        void finish();
+
+    private:
+        FieldProgram program_;
+        char delim_;
+        bool header_;
+        bool resolved_ = false;
+        Sink sink_;
+        CsvScanner scanner_;
+        CsvBatch batch_;
+        std::vector<bool> wanted_;
+        std::vector<uint8_t> selected_;
+        std::string scratch_;
+        Aggregate total_;
+        FlatHashMap<Aggregate> groups_;
+
+        bool prepare(const char* data, std::string& error);
+        std::string_view field(const char* data, const FieldRef& ref, size_t row, std::string& scratch) const;
+        std::string_view raw_field(const char* data, const FieldRef& ref, size_t row) const;
+    };
+}
@@ -0,0 +1,859 @@
+#include "deflate.hpp"
+#include "entropy.hpp"
+#include "file_io.hpp"
+#include <algorithm>
+#include <cstring>
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <atomic>
+#include <thread>
+#endif
+
+namespace lib {
+    static const size_t kWindowSize = 32 * 1024;
+    static const size_t kChunkSize = 128 * 1024;
+    static const size_t kBatchChunks = 16;              // Chunks buffered before compressing a batch
+    static const size_t kMinMatch = 3;
+    static const size_t kMaxMatch = 258;
+    static const size_t kTooFar = 4096;
+    static const size_t kBlockSymbols = 16 * 1024;
+    static const size_t kMaxStored = 65535;
+    static const int kHashLog = 15;
+    static const int kMaxCodeBits = 15;
+    static const int kMaxCodeLengthBits = 7;
+    static const size_t kLiteralSymbols = 286;
+    static const size_t kDistanceSymbols = 30;
+    static const size_t kCodeLengthSymbols = 19;
+    static const uint16_t kEndOfBlock = 256;
+    static const int kLiteralBits = 11;                 // Index bits of the primary tables
+    static const int kDistanceBits = 8;
+    static const size_t kFlushSize = 256 * 1024;        // Inflater output between flushes
+#ifdef __EMSCRIPTEN_PTHREADS__
+    static const size_t kMaxWorkers = 4;
+#endif
+
+    static const uint16_t kLengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                             31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const uint16_t kDistanceBase[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,    65,    97,    129,
+                                               193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static const uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    static const uint8_t kCodeLengthOrder[kCodeLengthSymbols] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    enum EntryKind : uint8_t { kInvalid, kLiteral, kPair, kLength, kEnd, kSubtable, kDistance };
+
+    namespace {
+        struct Level {
+            int chain;              // Chain entries examined per position
+            size_t nice;            // Stop searching at a match this long
+            bool lazy;              // Check one position ahead before taking a match
+        };
+
+        const Level kLevels[10] = {{0, 0, false},    {4, 8, false},     {8, 16, false},   {32, 32, false},
+                                   {16, 16, true},   {32, 32, true},    {128, 128, true}, {256, 128, true},
+                                   {1024, 258, true}, {4096, 258, true}};
+
+        // Length and distance codes, and the fixed Huffman code
+        struct CodeTables {
+            uint8_t length_code[kMaxMatch + 1];
+            uint8_t distance_code[512];         // distance - 1 below 256, else 256 + ((distance - 1) >> 7)
+            uint8_t fixed_literal_lengths[288];
+            uint16_t fixed_literal_codes[288];
+            uint8_t fixed_distance_lengths[kDistanceSymbols];
+            uint16_t fixed_distance_codes[kDistanceSymbols];
+
+            CodeTables();
+        };
+
+        struct Symbol {
+            uint16_t value;         // Literal, or match length
+            uint16_t distance;      // 0 for a literal
+        };
+
+        struct Run {
+            uint8_t symbol;         // Code length, or 16-18 for a repeat
+            uint8_t extra;
+        };
+    }
+
+    static uint16_t reverse_bits(uint32_t code, int bits) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < bits; ++i) {
+            reversed = (reversed << 1) | (code & 1);
+            code >>= 1;
+        }
+        return static_cast<uint16_t>(reversed);
+    }
+
+    // Canonical codes for `lengths`, bit-reversed since deflate sends
+    // Huffman codes starting from their most significant bit
+    static void assign_codes(const uint8_t* lengths, size_t symbols, uint16_t* codes) {
+        uint32_t count[kMaxCodeBits + 1] = {};
+        for (size_t s = 0; s < symbols; ++s) count[lengths[s]]++;
+        count[0] = 0;
+        uint32_t next[kMaxCodeBits + 1] = {};
+        uint32_t code = 0;
+        for (int bits = 1; bits <= kMaxCodeBits; ++bits) {
+            code = (code + count[bits - 1]) << 1;
+            next[bits] = code;
+        }
+        for (size_t s = 0; s < symbols; ++s) codes[s] = lengths[s] ? reverse_bits(next[lengths[s]]++, lengths[s]) : 0;
+    }
+
+    CodeTables::CodeTables() {
+        for (int code = 0; code < 28; ++code) {
+            for (int length = kLengthBase[code]; length < kLengthBase[code] + (1 << kLengthExtra[code]) && length < 258; ++length) {
+                length_code[length] = static_cast<uint8_t>(code);
+            }
+        }
+        length_code[258] = 28;
+        for (int code = 0; code < static_cast<int>(kDistanceSymbols); ++code) {
+            for (int distance = kDistanceBase[code]; distance < kDistanceBase[code] + (1 << kDistanceExtra[code]); ++distance) {
+                int index = distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7);
+                distance_code[index] = static_cast<uint8_t>(code);
+            }
+        }
+
+        for (int s = 0; s < 288; ++s) fixed_literal_lengths[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+        assign_codes(fixed_literal_lengths, 288, fixed_literal_codes);
+        for (size_t s = 0; s < kDistanceSymbols; ++s) fixed_distance_lengths[s] = 5;
+        assign_codes(fixed_distance_lengths, kDistanceSymbols, fixed_distance_codes);
+    }
+
+    static const CodeTables kCodes;
+
+    // Length of the common prefix of a and b, reading no further than `limit`
+    static inline size_t match_length(const uint8_t* a, const uint8_t* b, const uint8_t* limit) {
+        const uint8_t* start = a;
+        while (a + 8 <= limit) {
+            uint64_t diff = read64(a) ^ read64(b);
+            if (diff) return a - start + (__builtin_ctzll(diff) >> 3);
+            a += 8;
+            b += 8;
+        }
+        while (a < limit && *a == *b) {
+            ++a;
+            ++b;
+        }
+        return a - start;
+    }
+
+    static inline int distance_code(size_t distance) {
+        return distance <= 256 ? kCodes.distance_code[distance - 1] : kCodes.distance_code[256 + ((distance - 1) >> 7)];
+    }
+
+    // A code needs two symbols for every decoder to accept it; Huffman
+    // gives a lone symbol no bits, so it and a partner get one bit each
+    static void ensure_two_codes(const uint32_t* counts, uint8_t* lengths, size_t symbols) {
+        size_t used = 0;
+        for (size_t s = 0; s < symbols; ++s) used += counts[s] != 0;
+        if (used >= 2) return;
+        for (size_t s = 0; s < symbols; ++s) lengths[s] = counts[s] ? 1 : 0;
+        for (size_t s = 0; s < symbols && used < 2; ++s) {
+            if (!lengths[s]) {
+                lengths[s] = 1;
+                ++used;
+            }
+        }
+    }
+
+    // Code lengths of the literal/length and distance codes, run-length
+    // coded with symbols 16 (repeat the previous length), 17 and 18 (zeros)
+    static void code_length_runs(const uint8_t* lengths, size_t count, std::vector<Run>& runs) {
+        runs.clear();
+        for (size_t i = 0; i < count;) {
+            uint8_t length = lengths[i];
+            size_t run = 1;
+            while (i + run < count && lengths[i + run] == length) ++run;
+            i += run;
+
+            if (length == 0) {
+                while (run >= 11) {
+                    size_t take = run < 138 ? run : 138;
+                    runs.push_back({18, static_cast<uint8_t>(take - 11)});
+                    run -= take;
+                }
+                if (run >= 3) {
+                    runs.push_back({17, static_cast<uint8_t>(run - 3)});
+                    run = 0;
+                }
+            } else {
+                runs.push_back({length, 0});
+                --run;
+                while (run >= 3) {
+                    size_t take = run < 6 ? run : 6;
+                    runs.push_back({16, static_cast<uint8_t>(take - 3)});
+                    run -= take;
+                }
+            }
+            for (; run > 0; --run) runs.push_back({length, 0});
+        }
+    }
+
+    namespace {
+        // Compresses one chunk into a series of blocks
+        class ChunkDeflater {
+        public:
+            ChunkDeflater(const Level& level, const uint8_t* base, size_t history, size_t end, std::string& out)
+                : level_(level), base_(base), end_(end), writer_(out), out_(out), head_(size_t(1) << kHashLog, 0), prev_(end, 0) {
+                for (size_t p = 0; p < history; ++p) insert(p);
+            }
+
+            void compress(size_t start, bool last);
+
+        private:
+            const Level& level_;
+            const uint8_t* base_;
+            size_t end_;
+            BitWriter writer_;
+            std::string& out_;
+            std::vector<uint32_t> head_;        // Hash -> position + 1
+            std::vector<uint32_t> prev_;        // Position -> previous position + 1 with the same hash
+            std::vector<Symbol> symbols_;
+            uint32_t literal_counts_[kLiteralSymbols];
+            uint32_t distance_counts_[kDistanceSymbols];
+            std::vector<Run> runs_;
+
+            uint32_t hash(size_t p) const {
+                uint32_t sequence = base_[p] | base_[p + 1] << 8 | base_[p + 2] << 16;
+                return (sequence * 2654435761U) >> (32 - kHashLog);
+            }
+
+            void insert(size_t p) {
+                if (p + kMinMatch > end_) return;
+                uint32_t h = hash(p);
+                prev_[p] = head_[h];
+                head_[h] = static_cast<uint32_t>(p + 1);
+            }
+
+            // Longest match for position p (before p is inserted); 0 if none
+            size_t find_match(size_t p, size_t& distance) const;
+
+            void add_literal(size_t p) {
+                symbols_.push_back({base_[p], 0});
+                literal_counts_[base_[p]]++;
+            }
+
+            void add_match(size_t length, size_t distance) {
+                symbols_.push_back({static_cast<uint16_t>(length), static_cast<uint16_t>(distance)});
+                literal_counts_[257 + kCodes.length_code[length]]++;
+                distance_counts_[distance_code(distance)]++;
+            }
+
+            void reset_counts() {
+                symbols_.clear();
+                memset(literal_counts_, 0, sizeof(literal_counts_));
+                memset(distance_counts_, 0, sizeof(distance_counts_));
+            }
+
+            void write_block(size_t start, size_t end, bool final);
+            void write_stored(size_t start, size_t end, bool final);
+            void write_symbols(const uint8_t* literal_lengths, const uint16_t* literal_codes, const uint8_t* distance_lengths,
+                               const uint16_t* distance_codes);
+        };
+    }
+
+    size_t ChunkDeflater::find_match(size_t p, size_t& distance) const {
+        if (p + kMinMatch > end_) return 0;
+        size_t limit = end_ - p < kMaxMatch ? end_ - p : kMaxMatch;
+        size_t best = kMinMatch - 1;
+        int chain = level_.chain;
+        for (uint32_t candidate = head_[hash(p)]; candidate && chain-- > 0;) {
+            size_t c = candidate - 1;
+            if (p - c > kWindowSize) break;
+            if (base_[c + best] == base_[p + best]) {
+                size_t length = match_length(base_ + p, base_ + c, base_ + p + limit);
+                if (length > best) {
+                    best = length;
+                    distance = p - c;
+                    if (length >= level_.nice || length == limit) break;
+                }
+            }
+            candidate = prev_[c];
+        }
+        // A minimum-length match from far back costs more than its literals
+        if (best < kMinMatch || (best == kMinMatch && distance > kTooFar)) return 0;
+        return best;
+    }
+
+    void ChunkDeflater::compress(size_t start, bool last) {
+        reset_counts();
+        symbols_.reserve(kBlockSymbols + 2);
+        size_t block_start = start;
+        bool ended = false;
+        for (size_t p = start; p < end_;) {
+            size_t distance = 0;
+            size_t length = find_match(p, distance);
+            insert(p);
+
+            // Lazy matching: a longer match one byte on wins over this one
+            while (level_.lazy && length && length < level_.nice && p + 1 < end_) {
+                size_t next_distance = 0;
+                size_t next = find_match(p + 1, next_distance);
+                if (next <= length) break;
+                add_literal(p);
+                insert(++p);
+                length = next;
+                distance = next_distance;
+            }
+
+            if (length) {
+                add_match(length, distance);
+                for (size_t q = p + 1; q < p + length; ++q) insert(q);
+                p += length;
+            } else {
+                add_literal(p);
+                ++p;
+            }
+
+            if (symbols_.size() >= kBlockSymbols) {
+                ended = last && p == end_;
+                write_block(block_start, p, ended);
+                block_start = p;
+                reset_counts();
+            }
+        }
+        if (!symbols_.empty() || (last && !ended)) write_block(block_start, end_, last);
+
+        if (last) {
+            writer_.finish();
+        } else {
+            // Sync flush: an empty stored block ends the chunk on a byte boundary
+            writer_.add(0, 3);
+            writer_.finish();
+            out_.append("\x00\x00\xff\xff", 4);
+        }
+    }
+
+    void ChunkDeflater::write_symbols(const uint8_t* literal_lengths, const uint16_t* literal_codes, const uint8_t* distance_lengths,
+                                      const uint16_t* distance_codes) {
+        for (const Symbol& symbol : symbols_) {
+            if (!symbol.distance) {
+                writer_.add(literal_codes[symbol.value], literal_lengths[symbol.value]);
+                continue;
+            }
+            int code = kCodes.length_code[symbol.value];
+            writer_.add(literal_codes[257 + code], literal_lengths[257 + code]);
+            if (kLengthExtra[code]) writer_.add(symbol.value - kLengthBase[code], kLengthExtra[code]);
+            code = distance_code(symbol.distance);
+            writer_.add(distance_codes[code], distance_lengths[code]);
+            if (kDistanceExtra[code]) writer_.add(symbol.distance - kDistanceBase[code], kDistanceExtra[code]);
+        }
+        writer_.add(literal_codes[kEndOfBlock], literal_lengths[kEndOfBlock]);
+    }
+
+    void ChunkDeflater::write_stored(size_t start, size_t end, bool final) {
+        do {
+            size_t len = end - start < kMaxStored ? end - start : kMaxStored;
+            writer_.add(final && start + len == end ? 1 : 0, 3);
+            writer_.finish();
+            char header[4] = {static_cast<char>(len), static_cast<char>(len >> 8), static_cast<char>(~len),
+                              static_cast<char>(~len >> 8)};
+            out_.append(header, sizeof(header));
+            out_.append(reinterpret_cast<const char*>(base_ + start), len);
+            start += len;
+        } while (start < end);
+    }
+
+    // Write symbols_ (covering input [start, end)) as whichever block type
+    // is smallest
+    void ChunkDeflater::write_block(size_t start, size_t end, bool final) {
+        literal_counts_[kEndOfBlock] = 1;
+
+        uint8_t literal_lengths[kLiteralSymbols];
+        uint8_t distance_lengths[kDistanceSymbols];
+        huffman_code_lengths(literal_counts_, kLiteralSymbols, kMaxCodeBits, literal_lengths);
+        huffman_code_lengths(distance_counts_, kDistanceSymbols, kMaxCodeBits, distance_lengths);
+        ensure_two_codes(literal_counts_, literal_lengths, kLiteralSymbols);
+        ensure_two_codes(distance_counts_, distance_lengths, kDistanceSymbols);
+
+        size_t literal_count = kLiteralSymbols;
+        while (literal_count > 257 && !literal_lengths[literal_count - 1]) --literal_count;
+        size_t distance_count = kDistanceSymbols;
+        while (distance_count > 1 && !distance_lengths[distance_count - 1]) --distance_count;
+
+        uint8_t lengths[kLiteralSymbols + kDistanceSymbols];
+        memcpy(lengths, literal_lengths, literal_count);
+        memcpy(lengths + literal_count, distance_lengths, distance_count);
+        code_length_runs(lengths, literal_count + distance_count, runs_);
+
+        uint32_t run_counts[kCodeLengthSymbols] = {};
+        for (const Run& run : runs_) run_counts[run.symbol]++;
+        uint8_t run_lengths[kCodeLengthSymbols];
+        huffman_code_lengths(run_counts, kCodeLengthSymbols, kMaxCodeLengthBits, run_lengths);
+        ensure_two_codes(run_counts, run_lengths, kCodeLengthSymbols);
+        size_t run_code_count = kCodeLengthSymbols;
+        while (run_code_count > 4 && !run_lengths[kCodeLengthOrder[run_code_count - 1]]) --run_code_count;
+
+        // Sizes in bits of each block type
+        uint64_t extra_bits = 0;
+        for (size_t code = 0; code < 29; ++code) extra_bits += uint64_t(literal_counts_[257 + code]) * kLengthExtra[code];
+        for (size_t code = 0; code < kDistanceSymbols; ++code) extra_bits += uint64_t(distance_counts_[code]) * kDistanceExtra[code];
+        uint64_t dynamic_bits = 3 + 14 + 3 * run_code_count + extra_bits;
+        uint64_t fixed_bits = 3 + extra_bits;
+        for (size_t s = 0; s < kLiteralSymbols; ++s) {
+            dynamic_bits += uint64_t(literal_counts_[s]) * literal_lengths[s];
+            fixed_bits += uint64_t(literal_counts_[s]) * kCodes.fixed_literal_lengths[s];
+        }
+        for (size_t s = 0; s < kDistanceSymbols; ++s) {
+            dynamic_bits += uint64_t(distance_counts_[s]) * distance_lengths[s];
+            fixed_bits += uint64_t(distance_counts_[s]) * 5;
+        }
+        for (size_t s = 0; s < kCodeLengthSymbols; ++s) dynamic_bits += uint64_t(run_counts[s]) * run_lengths[s];
+        for (const Run& run : runs_) dynamic_bits += run.symbol == 16 ? 2 : run.symbol == 17 ? 3 : run.symbol == 18 ? 7 : 0;
+        uint64_t stored_bits = ((end - start) / kMaxStored + 1) * (3 + 7 + 32) + 8 * uint64_t(end - start);
+
+        if (stored_bits < fixed_bits && stored_bits < dynamic_bits) {
+            write_stored(start, end, final);
+        } else if (fixed_bits <= dynamic_bits) {
+            writer_.add(final ? 1 : 0, 1);
+            writer_.add(1, 2);
+            write_symbols(kCodes.fixed_literal_lengths, kCodes.fixed_literal_codes, kCodes.fixed_distance_lengths,
+                          kCodes.fixed_distance_codes);
+        } else {
+            writer_.add(final ? 1 : 0, 1);
+            writer_.add(2, 2);
+            writer_.add(literal_count - 257, 5);
+            writer_.add(distance_count - 1, 5);
+            writer_.add(run_code_count - 4, 4);
+            for (size_t i = 0; i < run_code_count; ++i) writer_.add(run_lengths[kCodeLengthOrder[i]], 3);
+            uint16_t run_codes[kCodeLengthSymbols];
+            assign_codes(run_lengths, kCodeLengthSymbols, run_codes);
+            for (const Run& run : runs_) {
+                writer_.add(run_codes[run.symbol], run_lengths[run.symbol]);
+                if (run.symbol >= 16) writer_.add(run.extra, run.symbol == 16 ? 2 : run.symbol == 17 ? 3 : 7);
+            }
+
+            uint16_t literal_codes[kLiteralSymbols];
+            uint16_t distance_codes[kDistanceSymbols];
+            assign_codes(literal_lengths, kLiteralSymbols, literal_codes);
+            assign_codes(distance_lengths, kDistanceSymbols, distance_codes);
+            write_symbols(literal_lengths, literal_codes, distance_lengths, distance_codes);
+        }
+    }
+
+    Deflater::Deflater(int level) : level_(level < 1 ? 1 : level > kMaxLevel ? kMaxLevel : level) {}
+
+    void Deflater::update(const uint8_t* data, size_t len, std::string& out) {
+        window_.insert(window_.end(), data, data + len);
+        if (window_.size() - history_ >= kBatchChunks * kChunkSize) write_chunks(out, false);
+    }
+
+    void Deflater::finish(std::string& out) {
+        write_chunks(out, true);
+        window_.clear();
+        history_ = 0;
+    }
+
+    // Compress the buffered chunks, all of them if `last`, else the full
+    // ones; chunk boundaries fall every kChunkSize bytes of the stream
+    void Deflater::write_chunks(std::string& out, bool last) {
+        size_t pending = window_.size() - history_;
+        size_t count = last ? std::max<size_t>(1, (pending + kChunkSize - 1) / kChunkSize) : pending / kChunkSize;
+        if (!count) return;
+
+        std::vector<std::string> outputs(count);
+        auto compress = [&](size_t i) {
+            size_t start = history_ + i * kChunkSize;
+            size_t end = std::min(start + kChunkSize, window_.size());
+            size_t from = start > kWindowSize ? start - kWindowSize : 0;
+            ChunkDeflater chunk(kLevels[level_], window_.data() + from, start - from, end - from, outputs[i]);
+            chunk.compress(start - from, last && i + 1 == count);
+        };
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+        std::atomic<size_t> next{0};
+        auto worker = [&]() {
+            for (size_t i = next++; i < count; i = next++) compress(i);
+        };
+        size_t workers = std::min<size_t>({std::thread::hardware_concurrency(), kMaxWorkers, count});
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < workers; ++i) threads.emplace_back(worker);
+        worker();
+        for (std::thread& thread : threads) thread.join();
+#else
+        for (size_t i = 0; i < count; ++i) compress(i);
+#endif
+
+        for (const std::string& output : outputs) out += output;
+
+        // Keep the last 32 KB as history for the next chunk
+        size_t done = std::min(history_ + count * kChunkSize, window_.size());
+        size_t keep_from = done > kWindowSize ? done - kWindowSize : 0;
+        window_.erase(window_.begin(), window_.begin() + keep_from);
+        history_ = done - keep_from;
+    }
+
+    // Decoding tables for a canonical code: entry i of the primary table
+    // decodes codes whose first `primary_bits` bits (in stream order) are
+    // i; longer codes continue in subtables appended after it. False if
+    // the lengths are over-subscribed. Unused entries are kInvalid with
+    // the maximum code length, so decoding waits for enough input before
+    // rejecting them.
+    static bool build_table(const uint8_t* lengths, size_t symbols, int primary_bits, InflateEntry (*entry)(size_t),
+                            std::vector<InflateEntry>& table) {
+        uint32_t count[kMaxCodeBits + 1] = {};
+        for (size_t s = 0; s < symbols; ++s) count[lengths[s]]++;
+        count[0] = 0;
+        int left = 1;
+        for (int bits = 1; bits <= kMaxCodeBits; ++bits) {
+            left = (left << 1) - static_cast<int>(count[bits]);
+            if (left < 0) return false;
+        }
+
+        uint16_t codes[288];
+        assign_codes(lengths, symbols, codes);
+
+        const InflateEntry invalid = {0, kMaxCodeBits, kInvalid, 0};
+        size_t primary = size_t(1) << primary_bits;
+        size_t mask = primary - 1;
+        table.assign(primary, invalid);
+
+        // One subtable per primary prefix of longer codes, wide enough for
+        // the longest of them
+        uint8_t longest[1 << kLiteralBits] = {};
+        for (size_t s = 0; s < symbols; ++s) {
+            if (lengths[s] > primary_bits) longest[codes[s] & mask] = std::max(longest[codes[s] & mask], lengths[s]);
+        }
+        for (size_t i = 0; i < primary; ++i) {
+            if (!longest[i]) continue;
+            uint8_t bits = static_cast<uint8_t>(longest[i] - primary_bits);
+            table[i] = {static_cast<uint16_t>(table.size()), 0, kSubtable, bits};
+            table.resize(table.size() + (size_t(1) << bits), invalid);
+        }
+
+        for (size_t s = 0; s < symbols; ++s) {
+            int len = lengths[s];
+            if (!len) continue;
+            InflateEntry e = entry(s);
+            e.bits = static_cast<uint8_t>(len);
+            if (len <= primary_bits) {
+                for (size_t i = codes[s]; i < primary; i += size_t(1) << len) table[i] = e;
+            } else {
+                const InflateEntry sub = table[codes[s] & mask];
+                for (size_t i = codes[s] >> primary_bits; i < (size_t(1) << sub.extra); i += size_t(1) << (len - primary_bits)) {
+                    table[sub.value + i] = e;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Let primary entries for a short literal code decode the literal after
+    // it too when that one's code also fits in the index bits
+    static void pair_literals(std::vector<InflateEntry>& table) {
+        const std::vector<InflateEntry> single(table.begin(), table.begin() + (1 << kLiteralBits));
+        for (size_t i = 0; i < single.size(); ++i) {
+            const InflateEntry& first = single[i];
+            if (first.kind != kLiteral || first.bits >= kLiteralBits) continue;
+            const InflateEntry& second = single[i >> first.bits];
+            if (second.kind != kLiteral || first.bits + second.bits > kLiteralBits) continue;
+            table[i] = {static_cast<uint16_t>(first.value | second.value << 8), static_cast<uint8_t>(first.bits + second.bits), kPair, 0};
+        }
+    }
+
+    static InflateEntry literal_entry(size_t symbol) {
+        if (symbol < kEndOfBlock) return {static_cast<uint16_t>(symbol), 0, kLiteral, 0};
+        if (symbol == kEndOfBlock) return {0, 0, kEnd, 0};
+        if (symbol < kLiteralSymbols) return {kLengthBase[symbol - 257], 0, kLength, kLengthExtra[symbol - 257]};
+        return {0, 0, kInvalid, 0};
+    }
+
+    static InflateEntry distance_entry(size_t symbol) {
+        if (symbol < kDistanceSymbols) return {kDistanceBase[symbol], 0, kDistance, kDistanceExtra[symbol]};
+        return {0, 0, kInvalid, 0};
+    }
+
+    static InflateEntry code_length_entry(size_t symbol) { return {static_cast<uint16_t>(symbol), 0, kLiteral, 0}; }
+
+    namespace {
+        struct FixedTables {
+            std::vector<InflateEntry> literals;
+            std::vector<InflateEntry> distances;
+
+            FixedTables() {
+                uint8_t distance_lengths[32];
+                memset(distance_lengths, 5, sizeof(distance_lengths));
+                build_table(kCodes.fixed_literal_lengths, 288, kLiteralBits, literal_entry, literals);
+                pair_literals(literals);
+                build_table(distance_lengths, 32, kDistanceBits, distance_entry, distances);
+            }
+        };
+    }
+
+    static const FixedTables kFixedTables;
+
+    // The next bits of input from bit position `bit`, zero past the end:
+    // at least 57 of them are valid when available
+    static inline uint64_t peek_bits(const std::vector<uint8_t>& input, size_t bit) {
+        size_t byte = bit >> 3;
+        size_t left = input.size() - byte;
+        uint64_t value = 0;
+        memcpy(&value, input.data() + byte, left < 8 ? left : 8);
+        return value >> (bit & 7);
+    }
+
+    void Inflater::reset() {
+        state_ = kHeader;
+        final_ = false;
+        stored_left_ = 0;
+        input_.clear();
+        bit_ = 0;
+        filled_ = flushed_ = 0;
+    }
+
+    bool Inflater::update(const uint8_t* data, size_t len, std::string& out, std::string& error) {
+        // Slack after the window lets match copies overrun
+        if (window_.empty()) window_.resize(kWindowSize + kFlushSize + kMaxMatch + 8);
+        if (bit_ >= 8) {
+            input_.erase(input_.begin(), input_.begin() + (bit_ >> 3));
+            bit_ &= 7;
+        }
+        input_.insert(input_.end(), data, data + len);
+
+        bool progress = true;
+        while (progress && state_ != kDone) {
+            progress = false;
+            if (filled_ >= kWindowSize + kFlushSize) flush(out);
+            switch (state_) {
+                case kHeader:
+                    if (!read_header(error, progress)) return false;
+                    break;
+                case kStored: copy_stored(progress); break;
+                case kHuffman:
+                    if (!decode_huffman(error, progress)) return false;
+                    break;
+                case kDone: break;
+            }
+        }
+        flush(out);
+        return true;
+    }
+
+    void Inflater::flush(std::string& out) {
+        out.append(reinterpret_cast<const char*>(window_.data() + flushed_), filled_ - flushed_);
+        if (filled_ > kWindowSize) {
+            memmove(window_.data(), window_.data() + filled_ - kWindowSize, kWindowSize);
+            filled_ = kWindowSize;
+        }
+        flushed_ = filled_;
+    }
+
+    bool Inflater::read_header(std::string& error, bool& progress) {
+        size_t total = input_.size() * 8;
+        if (bit_ + 3 > total) return true;
+        uint64_t bits = peek_bits(input_, bit_);
+        bool final = bits & 1;
+        switch ((bits >> 1) & 3) {
+            case 0: {
+                size_t byte = (bit_ + 3 + 7) >> 3;
+                if (byte + 4 > input_.size()) return true;
+                size_t len = input_[byte] | input_[byte + 1] << 8;
+                size_t complement = input_[byte + 2] | input_[byte + 3] << 8;
+                if (len != (~complement & 0xffff)) {
+                    error = "invalid stored block lengths";
+                    return false;
+                }
+                bit_ = (byte + 4) * 8;
+                stored_left_ = len;
+                state_ = kStored;
+                break;
+            }
+            case 1:
+                bit_ += 3;
+                literals_ = kFixedTables.literals;
+                distances_ = kFixedTables.distances;
+                state_ = kHuffman;
+                break;
+            case 2:
+                if (!read_dynamic_header(error, progress)) return false;
+                if (state_ != kHuffman) return true;
+                break;
+            default: error = "invalid block type"; return false;
+        }
+        final_ = final;
+        progress = true;
+        return true;
+    }
+
+    // Parse a dynamic block's code descriptions; nothing is consumed until
+    // all of them have arrived
+    bool Inflater::read_dynamic_header(std::string& error, bool& progress) {
+        size_t total = input_.size() * 8;
+        size_t bit = bit_ + 3;
+        auto take = [&](int count, uint32_t& value) {
+            if (bit + count > total) return false;
+            value = static_cast<uint32_t>(peek_bits(input_, bit) & ((uint64_t(1) << count) - 1));
+            bit += count;
+            return true;
+        };
+
+        uint32_t literal_count, distance_count, run_code_count;
+        if (!take(5, literal_count) || !take(5, distance_count) || !take(4, run_code_count)) return true;
+        literal_count += 257;
+        distance_count += 1;
+        run_code_count += 4;
+        if (literal_count > kLiteralSymbols || distance_count > kDistanceSymbols) {
+            error = "too many length or distance symbols";
+            return false;
+        }
+
+        uint8_t run_lengths[kCodeLengthSymbols] = {};
+        for (uint32_t i = 0; i < run_code_count; ++i) {
+            uint32_t length;
+            if (!take(3, length)) return true;
+            run_lengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(length);
+        }
+        std::vector<InflateEntry> run_table;
+        if (!build_table(run_lengths, kCodeLengthSymbols, kMaxCodeLengthBits, code_length_entry, run_table)) {
+            error = "invalid code lengths set";
+            return false;
+        }
+
+        uint8_t lengths[kLiteralSymbols + kDistanceSymbols];
+        for (uint32_t i = 0; i < literal_count + distance_count;) {
+            const InflateEntry& e = run_table[peek_bits(input_, bit) & ((1 << kMaxCodeLengthBits) - 1)];
+            if (bit + e.bits > total) return true;
+            if (e.kind == kInvalid) {
+                error = "invalid code lengths set";
+                return false;
+            }
+            bit += e.bits;
+            if (e.value < 16) {
+                lengths[i++] = static_cast<uint8_t>(e.value);
+                continue;
+            }
+
+            uint32_t repeat;
+            uint8_t length = 0;
+            if (e.value == 16) {
+                if (!take(2, repeat)) return true;
+                if (i == 0) {
+                    error = "invalid bit length repeat";
+                    return false;
+                }
+                length = lengths[i - 1];
+                repeat += 3;
+            } else if (e.value == 17) {
+                if (!take(3, repeat)) return true;
+                repeat += 3;
+            } else {
+                if (!take(7, repeat)) return true;
+                repeat += 11;
+            }
+            if (i + repeat > literal_count + distance_count) {
+                error = "invalid bit length repeat";
+                return false;
+            }
+            for (; repeat > 0; --repeat) lengths[i++] = length;
+        }
+
+        if (!lengths[kEndOfBlock]) {
+            error = "invalid code -- missing end-of-block";
+            return false;
+        }
+        if (!build_table(lengths, literal_count, kLiteralBits, literal_entry, literals_)) {
+            error = "invalid literal/lengths set";
+            return false;
+        }
+        pair_literals(literals_);
+        if (!build_table(lengths + literal_count, distance_count, kDistanceBits, distance_entry, distances_)) {
+            error = "invalid distances set";
+            return false;
+        }
+        bit_ = bit;
+        state_ = kHuffman;
+        progress = true;
+        return true;
+    }
+
+    void Inflater::copy_stored(bool& progress) {
+        size_t byte = bit_ >> 3;
+        size_t len = std::min({stored_left_, input_.size() - byte, kWindowSize + kFlushSize - filled_});
+        memcpy(window_.data() + filled_, input_.data() + byte, len);
+        filled_ += len;
+        bit_ += len * 8;
+        stored_left_ -= len;
+        if (!stored_left_) state_ = final_ ? kDone : kHeader;
+        progress = len > 0 || !stored_left_;
+    }
+
+    bool Inflater::decode_huffman(std::string& error, bool& progress) {
+        const size_t total = input_.size() * 8;
+        const size_t limit = kWindowSize + kFlushSize;
+        const InflateEntry* literals = literals_.data();
+        const InflateEntry* distances = distances_.data();
+        uint8_t* window = window_.data();
+        size_t bit = bit_;
+        size_t filled = filled_;
+
+        while (filled < limit) {
+            // A length/distance pair takes at most 48 bits, all of them in
+            // one peek
+            uint64_t bits = peek_bits(input_, bit);
+            InflateEntry e = literals[bits & ((1 << kLiteralBits) - 1)];
+            if (e.kind == kSubtable) e = literals[e.value + ((bits >> kLiteralBits) & ((1U << e.extra) - 1))];
+            if (bit + e.bits > total) break;
+
+            if (e.kind == kLiteral) {
+                window[filled++] = static_cast<uint8_t>(e.value);
+                bit += e.bits;
+                continue;
+            }
+            if (e.kind == kPair) {
+                window[filled] = static_cast<uint8_t>(e.value);
+                window[filled + 1] = static_cast<uint8_t>(e.value >> 8);
+                filled += 2;
+                bit += e.bits;
+                continue;
+            }
+            if (e.kind == kEnd) {
+                bit += e.bits;
+                state_ = kHeader;
+                if (final_) {
+                    state_ = kDone;
+                    bit = (bit + 7) & ~size_t(7);
+                }
+                break;
+            }
+            if (e.kind != kLength) {
+                error = "invalid literal/length code";
+                return false;
+            }
+
+            size_t used = e.bits + e.extra;
+            size_t length = e.value + ((bits >> e.bits) & ((1U << e.extra) - 1));
+            uint64_t distance_bits = bits >> used;
+            InflateEntry d = distances[distance_bits & ((1 << kDistanceBits) - 1)];
+            if (d.kind == kSubtable) d = distances[d.value + ((distance_bits >> kDistanceBits) & ((1U << d.extra) - 1))];
+            used += d.bits + d.extra;
+            if (bit + used > total) break;
+            if (d.kind != kDistance) {
+                error = "invalid distance code";
+                return false;
+            }
+            size_t distance = d.value + ((distance_bits >> d.bits) & ((1U << d.extra) - 1));
+            if (distance > filled) {
+                error = "invalid distance too far back";
+                return false;
+            }
+
+            // Copies may run up to 7 bytes past the match, into the slack
+            // at the end of the window
+            uint8_t* dst = window + filled;
+            const uint8_t* src = dst - distance;
+            if (distance >= 8) {
+                for (size_t i = 0; i < length; i += 8) memcpy(dst + i, src + i, 8);
+            } else {
+                for (size_t i = 0; i < length; ++i) dst[i] = src[i];
+            }
+            filled += length;
+            bit += used;
+        }
+
+        progress = bit != bit_ || state_ != kHuffman;
+        bit_ = bit;
+        filled_ = filled;
+        return true;
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lib {
+    // Raw deflate (RFC 1951), the compressed data inside gzip and zip.
+    //
+    // Like pigz, input is cut into 128 KB chunks that are compressed
+    // independently, each primed with the 32 KB before it as history and
+    // ended with an empty stored block so the next one starts on a byte
+    // boundary. Chunks therefore compress in parallel on worker threads
+    // where the build has them, and the output is the same either way.
+    //
+    // Within a chunk, matches come from hash chains searched deeper as the
+    // level rises, with lazy matching from level 4 up (as in zlib), and
+    // each run of about 16K symbols becomes a stored, fixed or dynamic
+    // Huffman block, whichever is smallest.
+    class Deflater {
+    public:
+        static const int kMaxLevel = 9;
+
+        explicit Deflater(int level = 6);
+
+        // Append compressed output for `data` to `out`; chunks are written
+        // once enough input has been buffered
+        void update(const uint8_t* data, size_t len, std::string& out);
+
+        // Flush the last chunk and end the stream
+        void finish(std::string& out);
+
+    private:
+        int level_;
+        std::vector<uint8_t> window_;       // Up to 32 KB of history, then the pending chunks
+        size_t history_ = 0;                // Bytes of window_ that are history
+
+        void write_chunks(std::string& out, bool last);
+    };
+
+    // Entry of the inflater's decoding tables
+    struct InflateEntry {
+        uint16_t value;         // Literal(s), length or distance base, or subtable offset
+        uint8_t bits;           // Code bits consumed (in total, for subtable entries)
+        uint8_t kind;
+        uint8_t extra;          // Extra bits after the code, or subtable index bits
+    };
+
+    // Streaming raw deflate decoder. Huffman codes decode through lookup
+    // tables indexed by the next 11 bits of input (8 for distances), with
+    // second-level tables for longer codes; literal/length entries may hold
+    // two literals at once when both codes fit in the index.
+    class Inflater {
+    public:
+        // Decode as much of the input seen so far as possible into `out`
+        bool update(const uint8_t* data, size_t len, std::string& out, std::string& error);
+
+        // True once the final block has ended
+        bool done() const { return state_ == kDone; }
+
+        // Input that followed the end of the stream, once done()
+        const uint8_t* rest() const { return input_.data() + (bit_ >> 3); }
+        size_t rest_size() const { return input_.size() - (bit_ >> 3); }
+
+        // Start over on a new stream
+        void reset();
+
+    private:
+        enum State { kHeader, kStored, kHuffman, kDone };
+
+        State state_ = kHeader;
+        bool final_ = false;
+        size_t stored_left_ = 0;
+        std::vector<uint8_t> input_;
+        size_t bit_ = 0;                    // Bit position in input_
+        std::vector<uint8_t> window_;       // 32 KB of history, then output not yet flushed
+        size_t filled_ = 0;
+        size_t flushed_ = 0;
+        std::vector<InflateEntry> literals_;   // Literal/length table for the current block
+        std::vector<InflateEntry> distances_;
+
+        bool read_header(std::string& error, bool& progress);
+        bool read_dynamic_header(std::string& error, bool& progress);
+        bool decode_huffman(std::string& error, bool& progress);
+        void copy_stored(bool& progress);
+        void flush(std::string& out);
+    };
+}
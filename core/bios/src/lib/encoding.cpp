@@ -0,0 +1,270 @@
+#include "encoding.hpp"
+#include <cstring>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+namespace lib {
+    static const char kBase64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static const char kHexDigits[] = "0123456789abcdef";
+
+    // Sextet for each byte: 0-63, 64 for whitespace, 65 for '=', 255 for invalid
+    static const uint8_t kWhitespace = 64;
+    static const uint8_t kPad = 65;
+    static const uint8_t kInvalid = 255;
+
+    static const struct Base64Table {
+        uint8_t values[256];
+        Base64Table() {
+            memset(values, kInvalid, sizeof(values));
+            for (int i = 0; i < 64; ++i) values[static_cast<uint8_t>(kBase64Alphabet[i])] = static_cast<uint8_t>(i);
+            values[static_cast<uint8_t>(' ')] = values[static_cast<uint8_t>('\t')] = kWhitespace;
+            values[static_cast<uint8_t>('\r')] = values[static_cast<uint8_t>('\n')] = kWhitespace;
+            values[static_cast<uint8_t>('=')] = kPad;
+        }
+    } kBase64Table;
+
+#ifdef __wasm_simd128__
+    // Encode 12 bytes (reading 16) into 16 characters
+    static inline void base64_encode_block(const uint8_t* in, char* out) {
+        v128_t bytes = wasm_i8x16_swizzle(wasm_v128_load(in), wasm_i8x16_make(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+
+        // Each 32-bit lane now holds b1 b0 b2 b1; pull out the four sextets
+        v128_t indices = wasm_v128_or(
+            wasm_v128_or(wasm_v128_and(wasm_u32x4_shr(bytes, 10), wasm_i32x4_splat(0x0000003f)),
+                         wasm_v128_and(wasm_i32x4_shl(bytes, 4), wasm_i32x4_splat(0x00003f00))),
+            wasm_v128_or(wasm_v128_and(wasm_u32x4_shr(bytes, 6), wasm_i32x4_splat(0x003f0000)),
+                         wasm_v128_and(wasm_i32x4_shl(bytes, 8), wasm_i32x4_splat(0x3f000000))));
+
+        // Map sextets to ASCII by adding a per-range offset: 0-25 'A', 26-51 'a',
+        // 52-61 '0', 62 '+', 63 '/'
+        v128_t reduced = wasm_u8x16_sub_sat(indices, wasm_i8x16_splat(51));
+        v128_t upper = wasm_i8x16_gt(wasm_i8x16_splat(26), indices);
+        reduced = wasm_v128_or(reduced, wasm_v128_and(upper, wasm_i8x16_splat(13)));
+        const v128_t offsets = wasm_i8x16_make(71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 65, 0, 0);
+        wasm_v128_store(out, wasm_i8x16_add(indices, wasm_i8x16_swizzle(offsets, reduced)));
+    }
+
+    // Decode 16 characters into 12 bytes; false if any character is not in
+    // the alphabet (including whitespace and padding)
+    static inline bool base64_decode_block(const char* in, uint8_t* out) {
+        v128_t chars = wasm_v128_load(in);
+        v128_t hi_nibbles = wasm_v128_and(wasm_u8x16_shr(chars, 4), wasm_i8x16_splat(0x0f));
+        v128_t lo_nibbles = wasm_v128_and(chars, wasm_i8x16_splat(0x0f));
+
+        // A character is valid when its nibbles' class bits don't intersect
+        const v128_t lut_lo = wasm_i8x16_make(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+        const v128_t lut_hi = wasm_i8x16_make(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        v128_t lo = wasm_i8x16_swizzle(lut_lo, lo_nibbles);
+        v128_t hi = wasm_i8x16_swizzle(lut_hi, hi_nibbles);
+        if (wasm_v128_any_true(wasm_v128_and(lo, hi))) return false;
+
+        const v128_t lut_roll = wasm_i8x16_make(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        v128_t slash = wasm_i8x16_eq(chars, wasm_i8x16_splat('/'));
+        v128_t sextets = wasm_i8x16_add(chars, wasm_i8x16_swizzle(lut_roll, wasm_i8x16_add(slash, hi_nibbles)));
+
+        // Pack pairs of sextets into 12-bit values, then pairs of those into 24 bits
+        v128_t pairs = wasm_v128_or(wasm_i16x8_shl(wasm_v128_and(sextets, wasm_i16x8_splat(0x00ff)), 6), wasm_u16x8_shr(sextets, 8));
+        v128_t triples = wasm_v128_or(wasm_i32x4_shl(wasm_v128_and(pairs, wasm_i32x4_splat(0x0000ffff)), 12), wasm_u32x4_shr(pairs, 16));
+        v128_t packed = wasm_i8x16_swizzle(triples, wasm_i8x16_make(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+        uint8_t block[16];
+        wasm_v128_store(block, packed);
+        memcpy(out, block, 12);
+        return true;
+    }
+#endif
+
+    size_t base64_encode(const uint8_t* in, size_t len, char* out) {
+        size_t i = 0;
+        char* start = out;
+
+#ifdef __wasm_simd128__
+        for (; i + 16 <= len; i += 12, out += 16) base64_encode_block(in + i, out);
+#endif
+
+        for (; i + 3 <= len; i += 3) {
+            uint32_t triple = in[i] << 16 | in[i + 1] << 8 | in[i + 2];
+            *out++ = kBase64Alphabet[triple >> 18];
+            *out++ = kBase64Alphabet[(triple >> 12) & 63];
+            *out++ = kBase64Alphabet[(triple >> 6) & 63];
+            *out++ = kBase64Alphabet[triple & 63];
+        }
+
+        if (i < len) {
+            uint32_t triple = in[i] << 16 | (i + 1 < len ? in[i + 1] << 8 : 0);
+            *out++ = kBase64Alphabet[triple >> 18];
+            *out++ = kBase64Alphabet[(triple >> 12) & 63];
+            *out++ = i + 1 < len ? kBase64Alphabet[(triple >> 6) & 63] : '=';
+            *out++ = '=';
+        }
+
+        return out - start;
+    }
+
+    void Base64Encoder::update(const uint8_t* in, size_t len, std::string& out) {
+        // Top up a partial triple from the previous chunk first
+        while (carried_ > 0 && carried_ < 3 && len > 0) {
+            if (carried_ == 2) {
+                uint8_t triple[3] = {carry_[0], carry_[1], *in};
+                size_t at = out.size();
+                out.resize(at + 4);
+                base64_encode(triple, 3, &out[at]);
+                carried_ = 0;
+            } else {
+                carry_[carried_++] = *in;
+            }
+            ++in;
+            --len;
+        }
+
+        size_t whole = len / 3 * 3;
+        size_t at = out.size();
+        out.resize(at + base64_encoded_size(whole));
+        base64_encode(in, whole, &out[at]);
+
+        for (size_t i = whole; i < len; ++i) carry_[carried_++] = in[i];
+    }
+
+    void Base64Encoder::finish(std::string& out) {
+        if (carried_ == 0) return;
+        size_t at = out.size();
+        out.resize(at + 4);
+        base64_encode(carry_, carried_, &out[at]);
+        carried_ = 0;
+    }
+
+    bool Base64Decoder::update(const char* in, size_t len, std::string& out) {
+        size_t at = out.size();
+        out.resize(at + len / 4 * 3 + 3);
+        uint8_t* dest = reinterpret_cast<uint8_t*>(&out[0]) + at;
+
+        size_t i = 0;
+        while (i < len) {
+#ifdef __wasm_simd128__
+            // Whole quartets of clean input go sixteen characters at a time
+            if (count_ == 0 && !padding_) {
+                while (i + 16 <= len && base64_decode_block(in + i, dest)) {
+                    i += 16;
+                    dest += 12;
+                }
+                if (i >= len) break;
+            }
+#endif
+            uint8_t value = kBase64Table.values[static_cast<uint8_t>(in[i++])];
+            if (value == kWhitespace) continue;
+            if (value == kInvalid) return false;
+            if (value == kPad) {
+                if (count_ < 2 || ++padding_ + count_ > 4) return false;
+                continue;
+            }
+            if (padding_) return false;
+
+            quad_ = quad_ << 6 | value;
+            if (++count_ == 4) {
+                *dest++ = static_cast<uint8_t>(quad_ >> 16);
+                *dest++ = static_cast<uint8_t>(quad_ >> 8);
+                *dest++ = static_cast<uint8_t>(quad_);
+                count_ = 0;
+            }
+        }
+
+        // A quartet completed by padding flushes its bytes right away
+        if (padding_ && count_ + padding_ == 4) {
+            if (count_ == 2) {
+                *dest++ = static_cast<uint8_t>(quad_ >> 4);
+            } else {
+                *dest++ = static_cast<uint8_t>(quad_ >> 10);
+                *dest++ = static_cast<uint8_t>(quad_ >> 2);
+            }
+            count_ = -1;    // Stream is complete; only whitespace may follow
+        }
+
+        out.resize(dest - reinterpret_cast<uint8_t*>(&out[0]));
+        return true;
+    }
+
+    bool Base64Decoder::finish(std::string& out) {
+        if (count_ == -1 || count_ == 0) {
+            return padding_ == 0 || count_ == -1;
+        }
+        if (padding_) return false;    // Incomplete padding
+
+        // Unpadded tail
+        if (count_ == 1) return false;
+        if (count_ == 2) {
+            out += static_cast<char>(quad_ >> 4);
+        } else {
+            out += static_cast<char>(quad_ >> 10);
+            out += static_cast<char>(quad_ >> 2);
+        }
+        count_ = 0;
+        return true;
+    }
+
+    void hex_encode(const uint8_t* in, size_t len, char* out) {
+        size_t i = 0;
+
+#ifdef __wasm_simd128__
+        const v128_t digits = wasm_v128_load(kHexDigits);
+        for (; i + 16 <= len; i += 16, out += 32) {
+            v128_t bytes = wasm_v128_load(in + i);
+            v128_t hi = wasm_i8x16_swizzle(digits, wasm_u8x16_shr(bytes, 4));
+            v128_t lo = wasm_i8x16_swizzle(digits, wasm_v128_and(bytes, wasm_i8x16_splat(0x0f)));
+            wasm_v128_store(out, wasm_i8x16_shuffle(hi, lo, 0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23));
+            wasm_v128_store(out + 16, wasm_i8x16_shuffle(hi, lo, 8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31));
+        }
+#endif
+
+        for (; i < len; ++i) {
+            *out++ = kHexDigits[in[i] >> 4];
+            *out++ = kHexDigits[in[i] & 0x0f];
+        }
+    }
+
+    static inline int hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+#ifdef __wasm_simd128__
+    // Convert 16 hex characters to nibble values; false if any is not a hex digit
+    static inline bool hex_nibbles(const char* in, v128_t& nibbles) {
+        v128_t chars = wasm_v128_load(in);
+        v128_t digit = wasm_i8x16_sub(chars, wasm_i8x16_splat('0'));
+        v128_t letter = wasm_i8x16_sub(wasm_v128_or(chars, wasm_i8x16_splat(0x20)), wasm_i8x16_splat('a'));
+        v128_t is_digit = wasm_u8x16_le(digit, wasm_i8x16_splat(9));
+        v128_t is_letter = wasm_u8x16_le(letter, wasm_i8x16_splat(5));
+        if (!wasm_i8x16_all_true(wasm_v128_or(is_digit, is_letter))) return false;
+        nibbles = wasm_v128_bitselect(digit, wasm_i8x16_add(letter, wasm_i8x16_splat(10)), is_digit);
+        return true;
+    }
+#endif
+
+    bool hex_decode(const char* in, size_t len, uint8_t* out) {
+        if (len % 2) return false;
+        size_t i = 0;
+
+#ifdef __wasm_simd128__
+        for (; i + 32 <= len; i += 32, out += 16) {
+            v128_t first, second;
+            if (!hex_nibbles(in + i, first) || !hex_nibbles(in + i + 16, second)) return false;
+            // Each 16-bit lane holds (high nibble, low nibble); fold to one byte and narrow
+            v128_t a = wasm_v128_or(wasm_i16x8_shl(wasm_v128_and(first, wasm_i16x8_splat(0x00ff)), 4), wasm_u16x8_shr(first, 8));
+            v128_t b = wasm_v128_or(wasm_i16x8_shl(wasm_v128_and(second, wasm_i16x8_splat(0x00ff)), 4), wasm_u16x8_shr(second, 8));
+            wasm_v128_store(out, wasm_u8x16_narrow_i16x8(a, b));
+        }
+#endif
+
+        for (; i < len; i += 2) {
+            int hi = hex_value(in[i]);
+            int lo = hex_value(in[i + 1]);
+            if (hi < 0 || lo < 0) return false;
+            *out++ = static_cast<uint8_t>(hi << 4 | lo);
+        }
+        return true;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace lib {
+    // Base64 (RFC 4648, standard alphabet, padded) and hex codecs. The bulk
+    // of each input goes through 16-byte SIMD table-lookup kernels; the
+    // scalar code only handles tails, whitespace and padding.
+
+    inline size_t base64_encoded_size(size_t len) { return (len + 2) / 3 * 4; }
+
+    // Encode `len` bytes into `out`, which must hold base64_encoded_size(len)
+    size_t base64_encode(const uint8_t* in, size_t len, char* out);
+
+    // Streaming encoder: feed any chunk sizes, then finish() to pad
+    class Base64Encoder {
+    public:
+        void update(const uint8_t* in, size_t len, std::string& out);
+        void finish(std::string& out);
+
+    private:
+        uint8_t carry_[2];
+        size_t carried_ = 0;
+    };
+
+    // Streaming decoder that skips whitespace and accepts missing padding
+    class Base64Decoder {
+    public:
+        // Append decoded bytes to `out`; false on invalid input
+        bool update(const char* in, size_t len, std::string& out);
+        bool finish(std::string& out);
+
+    private:
+        uint32_t quad_ = 0;
+        int count_ = 0;        // Sextets collected toward the current quartet
+        int padding_ = 0;      // '=' seen; only '=' and whitespace may follow
+    };
+
+    // Encode `len` bytes as lowercase hex into `out`, which must hold 2 * len
+    void hex_encode(const uint8_t* in, size_t len, char* out);
+
+    // Decode an even number of hex digits into `out` (len / 2 bytes); false on invalid input
+    bool hex_decode(const char* in, size_t len, uint8_t* out);
+}
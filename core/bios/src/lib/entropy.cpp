@@ -0,0 +1,51 @@
+#include "entropy.hpp"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace lib {
+    int huffman_code_lengths(const uint32_t* counts, size_t symbols, int max_bits, uint8_t* lengths) {
+        std::vector<uint32_t> scaled(counts, counts + symbols);
+        while (true) {
+            // Plain Huffman over the present symbols
+            std::vector<std::pair<uint64_t, int>> heap;
+            std::vector<int> parent;
+            for (size_t s = 0; s < symbols; ++s) {
+                if (!scaled[s]) continue;
+                heap.push_back({scaled[s], static_cast<int>(parent.size())});
+                parent.push_back(-1);
+            }
+            auto greater = [](const std::pair<uint64_t, int>& a, const std::pair<uint64_t, int>& b) { return a > b; };
+            std::make_heap(heap.begin(), heap.end(), greater);
+            while (heap.size() > 1) {
+                std::pop_heap(heap.begin(), heap.end(), greater);
+                auto a = heap.back();
+                heap.pop_back();
+                std::pop_heap(heap.begin(), heap.end(), greater);
+                auto b = heap.back();
+                heap.pop_back();
+                int node = static_cast<int>(parent.size());
+                parent.push_back(-1);
+                parent[a.second] = node;
+                parent[b.second] = node;
+                heap.push_back({a.first + b.first, node});
+                std::push_heap(heap.begin(), heap.end(), greater);
+            }
+
+            // Depths, walking down from the root (the last node)
+            std::vector<uint8_t> depth(parent.size(), 0);
+            for (size_t i = parent.size(); i-- > 1;) depth[i - 1] = depth[parent[i - 1]] + 1;
+            int longest = 0;
+            for (size_t s = 0, leaf = 0; s < symbols; ++s) {
+                lengths[s] = scaled[s] ? depth[leaf++] : 0;
+                longest = std::max<int>(longest, lengths[s]);
+            }
+            if (longest <= max_bits) return longest;
+
+            // Too deep: flatten the distribution and try again
+            for (uint32_t& count : scaled) {
+                if (count) count = (count + 1) / 2;
+            }
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace lib {
+    // Little-endian bit writer for the entropy-coded streams of zstd and
+    // deflate: bits fill each byte from its least significant end
+    class BitWriter {
+    public:
+        explicit BitWriter(std::string& out) : out_(out) {}
+
+        void add(uint64_t value, int bits) {
+            container_ |= (value & ((uint64_t(1) << bits) - 1)) << count_;
+            count_ += bits;
+            if (count_ >= 32) flush();
+        }
+
+        // Pad the last byte with zeros
+        void finish() {
+            flush();
+            if (count_ > 0) out_ += static_cast<char>(container_);
+            container_ = 0;
+            count_ = 0;
+        }
+
+        // End a stream that is read backward, which starts at its highest
+        // set bit
+        void close() {
+            add(1, 1);
+            finish();
+        }
+
+    private:
+        std::string& out_;
+        uint64_t container_ = 0;
+        int count_ = 0;
+
+        void flush() {
+            for (; count_ >= 8; count_ -= 8) {
+                out_ += static_cast<char>(container_);
+                container_ >>= 8;
+            }
+        }
+    };
+
+    // Huffman code lengths for `counts[0..symbols)`, none longer than
+    // `max_bits`; symbols with no count get length 0. With two or more
+    // symbols present the code is complete. Returns the longest length.
+    int huffman_code_lengths(const uint32_t* counts, size_t symbols, int max_bits, uint8_t* lengths);
+}
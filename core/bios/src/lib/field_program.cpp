@@ -0,0 +1,250 @@
+#include "field_program.hpp"
+#include "search.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace lib {
+    bool parse_number(std::string_view text, double& value) {
+        size_t i = 0, n = text.size();
+        while (i < n && text[i] == ' ') ++i;
+        while (n > i && text[n - 1] == ' ') --n;
+        if (i == n) return false;
+
+        bool negative = false;
+        if (text[i] == '-' || text[i] == '+') negative = text[i++] == '-';
+
+        double result = 0;
+        bool digits = false;
+        while (i < n && isdigit(static_cast<unsigned char>(text[i]))) {
+            result = result * 10 + (text[i++] - '0');
+            digits = true;
+        }
+        if (i < n && text[i] == '.') {
+            double scale = 0.1;
+            for (++i; i < n && isdigit(static_cast<unsigned char>(text[i])); ++i, scale *= 0.1) {
+                result += (text[i] - '0') * scale;
+                digits = true;
+            }
+        }
+        if (!digits) return false;
+        if (i < n && (text[i] == 'e' || text[i] == 'E')) {
+            ++i;
+            bool negative_exponent = false;
+            if (i < n && (text[i] == '-' || text[i] == '+')) negative_exponent = text[i++] == '-';
+            int exponent = 0;
+            bool exponent_digits = false;
+            while (i < n && isdigit(static_cast<unsigned char>(text[i]))) {
+                exponent = exponent * 10 + (text[i++] - '0');
+                exponent_digits = true;
+            }
+            if (!exponent_digits) return false;
+            result *= std::pow(10.0, negative_exponent ? -exponent : exponent);
+        }
+        if (i != n) return false;
+
+        value = negative ? -result : result;
+        return true;
+    }
+
+    static std::vector<std::string> tokenize_program(const std::string& source) {
+        std::vector<std::string> tokens;
+        size_t i = 0;
+        while (i < source.size()) {
+            char c = source[i];
+            if (c == ' ' || c == '\t' || c == ',') {
+                ++i;
+            } else if (c == '"' || c == '\'') {
+                size_t end = source.find(c, i + 1);
+                if (end == std::string::npos) end = source.size();
+                // Keep the opening quote so string literals stay distinguishable
+                tokens.push_back(source.substr(i, end - i));
+                i = end + 1;
+            } else if (strchr("=!<>~", c)) {
+                size_t start = i;
+                while (i < source.size() && strchr("=!<>~", source[i])) ++i;
+                tokens.push_back(source.substr(start, i - start));
+            } else {
+                size_t start = i;
+                while (i < source.size() && !strchr(" \t,=!<>~\"'", source[i])) ++i;
+                tokens.push_back(source.substr(start, i - start));
+            }
+        }
+        return tokens;
+    }
+
+    static bool parse_ref(const std::string& token, FieldRef& ref) {
+        if (token.size() < 2 || token[0] != '$') return false;
+        std::string rest = token.substr(1);
+        if (std::all_of(rest.begin(), rest.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)); })) {
+            ref.index = std::strtoul(rest.c_str(), nullptr, 10);
+        } else {
+            ref.name = rest;
+        }
+        return true;
+    }
+
+    static bool resolve_ref(FieldRef& ref, const std::vector<std::string>& header, std::string& error) {
+        if (ref.name.empty()) return true;
+        for (size_t i = 0; i < header.size(); ++i) {
+            if (header[i] == ref.name) {
+                ref.index = i + 1;
+                return true;
+            }
+        }
+        error = "unknown field $" + ref.name;
+        return false;
+    }
+
+    bool FieldProgram::resolve(const std::vector<std::string>& header, std::string& error) {
+        bool ok = resolve_ref(value, header, error) && resolve_ref(key, header, error);
+        for (FieldRef& ref : print) ok = ok && resolve_ref(ref, header, error);
+        for (Condition& condition : where) ok = ok && resolve_ref(condition.field, header, error);
+        return ok;
+    }
+
+    bool parse_program(const std::string& source, FieldProgram& program, std::string& error) {
+        std::vector<std::string> tokens = tokenize_program(source);
+        size_t pos = 0;
+
+        if (pos < tokens.size() && tokens[pos] == "where") {
+            ++pos;
+            for (;;) {
+                Condition condition;
+                if (pos + 3 > tokens.size() || !parse_ref(tokens[pos], condition.field)) {
+                    error = "expected condition after where";
+                    return false;
+                }
+
+                static const std::pair<const char*, Condition::Op> ops[] = {
+                    {"==", Condition::kEq}, {"=", Condition::kEq}, {"!=", Condition::kNe}, {"<", Condition::kLt},
+                    {"<=", Condition::kLe}, {">", Condition::kGt}, {">=", Condition::kGe},
+                    {"~", Condition::kContains}, {"!~", Condition::kNotContains}};
+                bool found = false;
+                for (const auto& op : ops) {
+                    if (tokens[pos + 1] == op.first) {
+                        condition.op = op.second;
+                        found = true;
+                    }
+                }
+                if (!found) {
+                    error = "unknown operator " + tokens[pos + 1];
+                    return false;
+                }
+
+                const std::string& literal = tokens[pos + 2];
+                if (!literal.empty() && (literal[0] == '"' || literal[0] == '\'')) {
+                    condition.text = literal.substr(1);
+                } else {
+                    condition.text = literal;
+                    condition.numeric = parse_number(literal, condition.number);
+                }
+                program.where.push_back(condition);
+
+                pos += 3;
+                if (pos < tokens.size() && tokens[pos] == "and") {
+                    ++pos;
+                    continue;
+                }
+                break;
+            }
+        }
+
+        if (pos >= tokens.size()) {
+            error = "missing action";
+            return false;
+        }
+
+        const std::string& action = tokens[pos++];
+        if (action == "print") {
+            program.action = FieldProgram::kPrint;
+            FieldRef ref;
+            while (pos < tokens.size() && parse_ref(tokens[pos], ref)) {
+                program.print.push_back(ref);
+                ref = FieldRef();
+                ++pos;
+            }
+            if (program.print.empty()) program.print.push_back(FieldRef());
+        } else if (action == "count" || action == "sum" || action == "avg" || action == "min" || action == "max") {
+            program.action = action == "count" ? FieldProgram::kCount
+                : action == "sum" ? FieldProgram::kSum
+                : action == "avg" ? FieldProgram::kAvg
+                : action == "min" ? FieldProgram::kMin : FieldProgram::kMax;
+            if (program.action != FieldProgram::kCount) {
+                if (pos >= tokens.size() || !parse_ref(tokens[pos++], program.value)) {
+                    error = "expected field after " + action;
+                    return false;
+                }
+            }
+            if (pos < tokens.size() && tokens[pos] == "by") {
+                if (pos + 1 >= tokens.size() || !parse_ref(tokens[pos + 1], program.key)) {
+                    error = "expected field after by";
+                    return false;
+                }
+                program.grouped = true;
+                pos += 2;
+            }
+        } else {
+            error = "unknown action " + action;
+            return false;
+        }
+
+        if (pos != tokens.size()) {
+            error = "unexpected " + tokens[pos];
+            return false;
+        }
+        return true;
+    }
+
+    bool test(const Condition& condition, std::string_view value) {
+        double number;
+        int order;
+        if (condition.op == Condition::kContains || condition.op == Condition::kNotContains) {
+            bool found = lib::find_literal(value, condition.text) != std::string_view::npos;
+            return found == (condition.op == Condition::kContains);
+        }
+        if (condition.numeric && parse_number(value, number)) {
+            order = number < condition.number ? -1 : number > condition.number ? 1 : 0;
+        } else {
+            int compared = value.compare(condition.text);
+            order = compared < 0 ? -1 : compared > 0 ? 1 : 0;
+        }
+        switch (condition.op) {
+            case Condition::kEq: return order == 0;
+            case Condition::kNe: return order != 0;
+            case Condition::kLt: return order < 0;
+            case Condition::kLe: return order <= 0;
+            case Condition::kGt: return order > 0;
+            case Condition::kGe: return order >= 0;
+            default: return false;
+        }
+    }
+
+    void accumulate(Aggregate& aggregate, std::string_view value, bool counting) {
+        ++aggregate.count;
+        double number;
+        if (counting || !parse_number(value, number)) return;
+        ++aggregate.numbers;
+        aggregate.sum += number;
+        if (number < aggregate.min) aggregate.min = number;
+        if (number > aggregate.max) aggregate.max = number;
+    }
+
+    std::string format_result(const Aggregate& aggregate, FieldProgram::Action action) {
+        double result = 0;
+        switch (action) {
+            case FieldProgram::kCount: result = static_cast<double>(aggregate.count); break;
+            case FieldProgram::kSum: result = aggregate.sum; break;
+            case FieldProgram::kAvg: result = aggregate.numbers ? aggregate.sum / aggregate.numbers : 0; break;
+            case FieldProgram::kMin: result = aggregate.numbers ? aggregate.min : 0; break;
+            case FieldProgram::kMax: result = aggregate.numbers ? aggregate.max : 0; break;
+            default: break;
+        }
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.15g", result);
+        return buffer;
+    }
+}
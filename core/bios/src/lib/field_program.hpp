@@ -0,0 +1,63 @@
+#pragma once
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lib {
+    // A one-line record program, shared by the `fields` and `csv` commands:
+    //
+    //   [where COND [and COND]...] ACTION
+    //
+    //   COND    $F OP VALUE, with OP one of == != < <= > >= ~ (contains) !~
+    //   ACTION  print $F[, $F]... | count [by $F] | sum|avg|min|max $F [by $F]
+    //
+    // Fields are $1, $2, ... ($0 is the whole record), or $name when the
+    // input has a header row.
+
+    struct FieldRef {
+        size_t index = 0;
+        std::string name;    // Resolved against the header when set
+    };
+
+    struct Condition {
+        enum Op { kEq, kNe, kLt, kLe, kGt, kGe, kContains, kNotContains };
+
+        FieldRef field;
+        Op op = kEq;
+        std::string text;
+        double number = 0;
+        bool numeric = false;
+    };
+
+    struct FieldProgram {
+        enum Action { kPrint, kCount, kSum, kAvg, kMin, kMax };
+
+        std::vector<Condition> where;
+        Action action = kPrint;
+        std::vector<FieldRef> print;
+        FieldRef value;
+        bool grouped = false;
+        FieldRef key;
+
+        // Replace $name references with indices into `header`
+        bool resolve(const std::vector<std::string>& header, std::string& error);
+    };
+
+    struct Aggregate {
+        double sum = 0;
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        long count = 0;       // Records seen
+        long numbers = 0;     // Records with a numeric value
+    };
+
+    bool parse_program(const std::string& source, FieldProgram& program, std::string& error);
+
+    // Parse a decimal number, allowing surrounding spaces, without copying
+    bool parse_number(std::string_view text, double& value);
+
+    bool test(const Condition& condition, std::string_view value);
+    void accumulate(Aggregate& aggregate, std::string_view value, bool counting);
+    std::string format_result(const Aggregate& aggregate, FieldProgram::Action action);
+}
@@ -0,0 +1,332 @@
+#include "file_copy.hpp"
+#include "block_file.hpp"
+#include "file_events.hpp"
+#include "zip.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <algorithm>
+#include <thread>
+#endif
+
+namespace lib {
+    static const size_t kCopyBufferSize = 1024 * 1024;
+#ifdef __EMSCRIPTEN_PTHREADS__
+    static const size_t kMaxWorkers = 4;
+#endif
+
+    namespace {
+        struct CopyJob {
+            std::string source;
+            std::string target;
+            struct stat st;
+        };
+
+        // Everything a copy has to do, gathered before any data moves
+        struct CopyPlan {
+            std::vector<CopyJob> files;
+            std::vector<CopyJob> directories;   // Parents before children
+        };
+    }
+
+    static std::string child_path(const std::string& dir, const char* name) {
+        return dir.back() == '/' ? dir + name : dir + "/" + name;
+    }
+
+    static bool same_file(const struct stat& a, const struct stat& b) {
+        return a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+    }
+
+    // Whether `path` is the directory `dir` or would be created inside it,
+    // going by identity rather than spelling, so "./d/sub" and "d/../d"
+    // are caught too: the part of `path` that exists is resolved and each
+    // directory up from it compared with `dir`
+    static bool within(const std::string& path, const struct stat& dir) {
+        std::string existing = path;
+        struct stat st;
+        while (stat(existing.c_str(), &st) != 0) {
+            size_t slash = existing.find_last_of('/');
+            if (slash == std::string::npos) {
+                existing = ".";
+            } else {
+                existing.erase(slash == 0 ? 1 : slash);
+            }
+        }
+        char* resolved = realpath(existing.c_str(), nullptr);
+        if (!resolved) return false;
+        std::string current = resolved;
+        free(resolved);
+        for (;;) {
+            if (stat(current.c_str(), &st) == 0 && same_file(st, dir)) return true;
+            if (current == "/") return false;
+            size_t slash = current.find_last_of('/');
+            current.erase(slash == 0 ? 1 : slash);
+        }
+    }
+
+    static void set_times(const std::string& path, const struct stat& st) {
+        struct timespec times[2] = {st.st_atim, st.st_mtim};
+        utimensat(AT_FDCWD, path.c_str(), times, AT_SYMLINK_NOFOLLOW);
+    }
+
+    static bool plan_copy(const std::string& source, const std::string& target, bool recursive, CopyPlan& plan, std::string& error) {
+        struct stat st;
+        if (lstat(source.c_str(), &st) != 0) {
+            error = "cannot stat " + source;
+            return false;
+        }
+
+        if (S_ISLNK(st.st_mode)) {
+            std::vector<char> link(st.st_size + 1);
+            ssize_t length = readlink(source.c_str(), link.data(), link.size());
+            ::unlink(target.c_str());
+            if (length < 0 || symlink(std::string(link.data(), length).c_str(), target.c_str()) != 0) {
+                error = "cannot create symlink " + target;
+                return false;
+            }
+            return true;
+        }
+
+        if (!S_ISDIR(st.st_mode)) {
+            plan.files.push_back(CopyJob{source, target, st});
+            return true;
+        }
+
+        if (!recursive) {
+            error = "-r not specified; omitting directory " + source;
+            return false;
+        }
+        struct stat existing;
+        if (mkdir(target.c_str(), 0700) != 0 && !(errno == EEXIST && stat(target.c_str(), &existing) == 0 && S_ISDIR(existing.st_mode))) {
+            error = "cannot create directory " + target;
+            return false;
+        }
+        plan.directories.push_back(CopyJob{source, target, st});
+
+        DIR* dir = opendir(source.c_str());
+        if (!dir) {
+            error = "cannot open directory " + source;
+            return false;
+        }
+        std::vector<std::string> names;
+        while (struct dirent* entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) names.push_back(entry->d_name);
+        }
+        closedir(dir);
+
+        for (const std::string& name : names) {
+            if (!plan_copy(child_path(source, name.c_str()), child_path(target, name.c_str()), true, plan, error)) return false;
+        }
+        return true;
+    }
+
+    static bool copy_contents(const CopyJob& job, std::vector<char>& buffer, std::string& error) {
+        int in = open(job.source.c_str(), O_RDONLY);
+        if (in < 0) {
+            error = "cannot open " + job.source;
+            return false;
+        }
+        // Truncating the target would empty the source if they are one file,
+        // whatever the paths look like (hard links, "./f", symlinks)
+        struct stat source_st, target_st;
+        if (fstat(in, &source_st) == 0 && stat(job.target.c_str(), &target_st) == 0 && same_file(source_st, target_st)) {
+            close(in);
+            error = job.source + " and " + job.target + " are the same file";
+            return false;
+        }
+        int out = open(job.target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (out < 0) {
+            close(in);
+            error = "cannot create " + job.target;
+            return false;
+        }
+
+        bool ok = true;
+        while (ok) {
+            ssize_t got = read(in, buffer.data(), buffer.size());
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) {
+                ok = got == 0;
+                break;
+            }
+            for (ssize_t written = 0; written < got;) {
+                ssize_t put = write(out, buffer.data() + written, got - written);
+                if (put < 0 && errno == EINTR) continue;
+                if (put <= 0) {
+                    ok = false;
+                    break;
+                }
+                written += put;
+            }
+        }
+        close(in);
+        if (close(out) != 0) ok = false;
+        if (!ok) {
+            error = "failed to copy " + job.source + " to " + job.target;
+            return false;
+        }
+
+        chmod(job.target.c_str(), job.st.st_mode & 07777);
+        set_times(job.target, job.st);
+        return true;
+    }
+
+    static bool run_copy(const CopyPlan& plan, std::string& error) {
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+        std::mutex error_lock;
+
+        auto worker = [&]() {
+            std::vector<char> buffer(kCopyBufferSize);
+            std::string message;
+            for (size_t i = next++; i < plan.files.size() && !failed; i = next++) {
+                if (copy_contents(plan.files[i], buffer, message)) continue;
+                std::lock_guard<std::mutex> guard(error_lock);
+                if (!failed.exchange(true)) error = message;
+            }
+        };
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+        size_t workers = std::min<size_t>({std::thread::hardware_concurrency(), kMaxWorkers, plan.files.size()});
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < workers; ++i) threads.emplace_back(worker);
+        worker();
+        for (std::thread& thread : threads) thread.join();
+#else
+        worker();
+#endif
+
+        // Directories last, deepest first, so their mtimes survive the copy
+        for (auto it = plan.directories.rbegin(); it != plan.directories.rend(); ++it) {
+            chmod(it->target.c_str(), it->st.st_mode & 07777);
+            set_times(it->target, it->st);
+        }
+        // Bytes are copied as they are stored; a plain file landing in a
+        // directory with compression on is compressed here, off the workers,
+        // which must not share the block cache
+        for (const CopyJob& job : plan.files) {
+            std::string message;
+            if (!failed && !apply_compression(job.target, message)) {
+                failed = true;
+                error = message;
+            }
+            file_changed(job.target);
+        }
+        return !failed;
+    }
+
+    bool copy_path(const std::string& source, const std::string& target, bool recursive, std::string& error) {
+        std::string member;
+        if (zip_lookup(target, member)) {
+            error = "cannot copy to " + target + ": read-only zip mount";
+            return false;
+        }
+
+        struct stat st, existing;
+        if (lstat(source.c_str(), &st) == 0) {
+            if (S_ISDIR(st.st_mode) && within(target, st)) {
+                error = "cannot copy " + source + " into itself";
+                return false;
+            }
+            if (!S_ISDIR(st.st_mode) && stat(target.c_str(), &existing) == 0 && same_file(st, existing)) {
+                error = source + " and " + target + " are the same file";
+                return false;
+            }
+        }
+
+        CopyPlan plan;
+        bool planned = plan_copy(source, target, recursive, plan, error);
+        std::string copy_error;
+        bool copied = run_copy(plan, copy_error);
+        if (planned && !copied) error = copy_error;
+        return planned && copied;
+    }
+
+    // Regular files at or under `path`, for telling the indexes about a rename
+    static void list_files(const std::string& path, std::vector<std::string>& files) {
+        struct stat st;
+        if (lstat(path.c_str(), &st) != 0) return;
+        if (!S_ISDIR(st.st_mode)) {
+            if (S_ISREG(st.st_mode)) files.push_back(path);
+            return;
+        }
+
+        DIR* dir = opendir(path.c_str());
+        if (!dir) return;
+        std::vector<std::string> children;
+        while (struct dirent* entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) children.push_back(child_path(path, entry->d_name));
+        }
+        closedir(dir);
+        for (const std::string& child : children) list_files(child, files);
+    }
+
+    static bool remove_tree(const std::string& path) {
+        struct stat st;
+        if (lstat(path.c_str(), &st) != 0) return false;
+        if (!S_ISDIR(st.st_mode)) return ::unlink(path.c_str()) == 0;
+
+        DIR* dir = opendir(path.c_str());
+        if (!dir) return false;
+        std::vector<std::string> children;
+        while (struct dirent* entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) children.push_back(child_path(path, entry->d_name));
+        }
+        closedir(dir);
+
+        bool ok = true;
+        for (const std::string& child : children) ok = remove_tree(child) && ok;
+        return ok && rmdir(path.c_str()) == 0;
+    }
+
+    bool move_path(const std::string& source, const std::string& target, std::string& error) {
+        std::string member;
+        for (const std::string* path : {&source, &target}) {
+            if (zip_lookup(*path, member)) {
+                error = "cannot move " + source + ": " + *path + " is in a read-only zip mount";
+                return false;
+            }
+        }
+
+        struct stat st, existing;
+        if (lstat(source.c_str(), &st) == 0) {
+            if (lstat(target.c_str(), &existing) == 0 && same_file(st, existing)) return true;
+            if (S_ISDIR(st.st_mode) && within(target, st)) {
+                error = "cannot move " + source + " into itself";
+                return false;
+            }
+        }
+
+        std::vector<std::string> moved;
+        list_files(source, moved);
+
+        if (rename(source.c_str(), target.c_str()) != 0) {
+            if (errno != EXDEV) {
+                error = "cannot move " + source + " to " + target + ": " + strerror(errno);
+                return false;
+            }
+            // Different mounts: copy, then delete the original
+            if (!copy_path(source, target, true, error)) return false;
+            if (!remove_tree(source)) {
+                error = "copied but could not remove " + source;
+                return false;
+            }
+        }
+
+        for (const std::string& path : moved) {
+            file_removed(path);
+            file_changed(target + path.substr(source.size()));
+        }
+        return true;
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+
+namespace lib {
+    // Copy `source` to `target`, keeping modes and modification times.
+    // Directories are copied only when `recursive`; symlinks are recreated
+    // rather than followed. File contents stream through large buffers, one
+    // per worker, and under pthreads the files of a tree are copied in
+    // parallel once its directories exist. A file copied onto itself, or a
+    // directory into itself, is refused, however the paths are spelled, as
+    // is a target inside a zip mount, which is read-only.
+    // Plain files copied into a directory with block compression on are
+    // stored compressed.
+    bool copy_path(const std::string& source, const std::string& target, bool recursive, std::string& error);
+
+    // Move `source` to `target` with rename(), falling back to copying and
+    // deleting when they are on different mounts. Neither may be in a zip
+    // mount.
+    bool move_path(const std::string& source, const std::string& target, std::string& error);
+}
@@ -0,0 +1,22 @@
+#include "file_events.hpp"
+#include "file_io.hpp"
+#include "line_index.hpp"
+#include "path_index.hpp"
+#include "trigram_index.hpp"
+
+namespace lib {
+    // The search and path indexes are keyed by absolute path
+    void file_changed(const std::string& path) {
+        LineIndex::invalidate(path);
+        std::string full = absolute_path(path);
+        if (TrigramIndex* index = search_index()) index->update(full);
+        if (PathIndex* paths = path_index(false)) paths->add(full);
+    }
+
+    void file_removed(const std::string& path) {
+        LineIndex::invalidate(path);
+        std::string full = absolute_path(path);
+        if (TrigramIndex* index = search_index()) index->update(full);
+        if (PathIndex* paths = path_index(false)) paths->remove(full);
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+
+namespace lib {
+    // Keep data derived from file contents (line indexes, the search index)
+    // in step with the filesystem. Anything that writes or removes a file
+    // reports it here; indexes added later hook in the same way.
+    void file_changed(const std::string& path);
+    void file_removed(const std::string& path);
+}
@@ -0,0 +1,57 @@
+#include "file_io.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lib {
+    static const char* const kSystemDirectories[] = {"/dev", "/proc", "/.bios"};
+
+    bool write_all(int fd, const char* data, size_t len) {
+        while (len > 0) {
+            ssize_t put = ::write(fd, data, len);
+            if (put < 0 && errno == EINTR) continue;
+            if (put <= 0) return false;
+            data += put;
+            len -= put;
+        }
+        return true;
+    }
+
+    void set_mtime(const std::string& path, int64_t mtime) {
+        struct timespec times[2];
+        times[0].tv_sec = 0;
+        times[0].tv_nsec = UTIME_OMIT;
+        times[1].tv_sec = static_cast<time_t>(mtime / 1000000000);
+        times[1].tv_nsec = static_cast<long>(mtime % 1000000000);
+        utimensat(AT_FDCWD, path.c_str(), times, AT_SYMLINK_NOFOLLOW);
+    }
+
+    std::string absolute_path(const std::string& path) {
+        std::string full = path;
+        if (full.empty() || full[0] != '/') {
+            char cwd[4096];
+            full = std::string(getcwd(cwd, sizeof(cwd)) ? cwd : "/") + "/" + full;
+        }
+        std::string result;
+        for (size_t start = 0; start <= full.size();) {
+            size_t slash = full.find('/', start);
+            if (slash == std::string::npos) slash = full.size();
+            std::string part = full.substr(start, slash - start);
+            if (part == "..") {
+                result.resize(result.rfind('/') == std::string::npos ? 0 : result.rfind('/'));
+            } else if (!part.empty() && part != ".") {
+                result += "/" + part;
+            }
+            start = slash + 1;
+        }
+        return result.empty() ? "/" : result;
+    }
+
+    bool system_directory(const std::string& path) {
+        for (const char* dir : kSystemDirectories) {
+            if (path == dir) return true;
+        }
+        return false;
+    }
+}
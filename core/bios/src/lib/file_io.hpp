@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace lib {
+    // Helpers shared by the on-disk formats and the code that writes files.
+    //
+    // Integers are stored little-endian everywhere; compilers fold these
+    // byte-wise forms into single loads and stores on little-endian targets.
+    inline uint16_t read16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+    inline uint32_t read32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24; }
+    inline uint64_t read64(const uint8_t* p) { return read32(p) | uint64_t(read32(p + 4)) << 32; }
+
+    inline void put16(uint8_t* p, uint16_t value) {
+        p[0] = static_cast<uint8_t>(value);
+        p[1] = static_cast<uint8_t>(value >> 8);
+    }
+
+    inline void put32(uint8_t* p, uint32_t value) {
+        for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+
+    inline void put64(uint8_t* p, uint64_t value) {
+        put32(p, static_cast<uint32_t>(value));
+        put32(p + 4, static_cast<uint32_t>(value >> 32));
+    }
+
+    inline void put32(std::string& out, uint32_t value) {
+        char bytes[4];
+        put32(reinterpret_cast<uint8_t*>(bytes), value);
+        out.append(bytes, sizeof(bytes));
+    }
+
+    inline void put64(std::string& out, uint64_t value) {
+        char bytes[8];
+        put64(reinterpret_cast<uint8_t*>(bytes), value);
+        out.append(bytes, sizeof(bytes));
+    }
+
+    // Write all of `data` to `fd`, retrying short writes and EINTR
+    bool write_all(int fd, const char* data, size_t len);
+
+    // Set the modification time of `path` (not of a symlink's target) to
+    // `mtime` nanoseconds, leaving its access time alone
+    void set_mtime(const std::string& path, int64_t mtime);
+
+    // Absolute form of `path` with ".", ".." and repeated slashes resolved
+    // by name, against the working directory when relative
+    std::string absolute_path(const std::string& path);
+
+    // Whether `path` is one of the directories that hold no user files
+    // (/dev, /proc and the BIOS's own /.bios), which tree-wide walks skip
+    bool system_directory(const std::string& path);
+}
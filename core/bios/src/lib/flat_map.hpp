@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace lib {
+    // FNV-1a over a byte range
+    inline uint64_t hash_bytes(std::string_view data) {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : data) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Open-addressing hash map from string keys to V. Entries live in one
+    // vector in insertion order; the probe table holds only their indices
+    // and hashes, so lookups by string_view never allocate.
+    template <typename V>
+    class FlatHashMap {
+    public:
+        using Entry = std::pair<std::string, V>;
+
+        FlatHashMap() : slots_(16) {}
+
+        V* find(std::string_view key) {
+            uint64_t hash = hash_bytes(key);
+            size_t mask = slots_.size() - 1;
+            for (size_t i = hash & mask;; i = (i + 1) & mask) {
+                const Slot& slot = slots_[i];
+                if (slot.index == 0) return nullptr;
+                if (slot.hash == hash && entries_[slot.index - 1].first == key) return &entries_[slot.index - 1].second;
+            }
+        }
+
+        // Find `key`, inserting a default-constructed value if it's missing
+        V& operator[](std::string_view key) {
+            uint64_t hash = hash_bytes(key);
+            size_t mask = slots_.size() - 1;
+            size_t i = hash & mask;
+            for (;; i = (i + 1) & mask) {
+                const Slot& slot = slots_[i];
+                if (slot.index == 0) break;
+                if (slot.hash == hash && entries_[slot.index - 1].first == key) return entries_[slot.index - 1].second;
+            }
+
+            entries_.emplace_back(std::string(key), V());
+            slots_[i] = {hash, static_cast<uint32_t>(entries_.size())};
+            // Keep the load factor at or below 1/2
+            if (entries_.size() * 2 > slots_.size()) grow();
+            return entries_.back().second;
+        }
+
+        size_t size() const { return entries_.size(); }
+        std::vector<Entry>& entries() { return entries_; }
+        const std::vector<Entry>& entries() const { return entries_; }
+
+        void clear() {
+            entries_.clear();
+            slots_.assign(16, Slot());
+        }
+
+    private:
+        struct Slot {
+            uint64_t hash = 0;
+            uint32_t index = 0;    // 1-based entry index, 0 when empty
+        };
+
+        std::vector<Entry> entries_;
+        std::vector<Slot> slots_;
+
+        void grow() {
+            std::vector<Slot> slots(slots_.size() * 2);
+            size_t mask = slots.size() - 1;
+            for (const Slot& slot : slots_) {
+                if (slot.index == 0) continue;
+                size_t i = slot.hash & mask;
+                while (slots[i].index != 0) i = (i + 1) & mask;
+                slots[i] = slot;
+            }
+            slots_.swap(slots);
+        }
+    };
+}
@@ -0,0 +1,647 @@
+#include "fts.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+namespace lib {
+    static const char kManifestMagic[4] = {'F', 'T', 'S', 'M'};
+    static const char kSegmentMagic[4] = {'F', 'T', 'S', 'S'};
+    static const uint32_t kVersion = 1;
+    static const size_t kMaxTokenLength = 64;
+    // Merge the two newest segments while the older holds at most this many
+    // times the newer's documents, or while there are too many segments
+    static const size_t kMergeFactor = 4;
+    static const size_t kMaxSegments = 16;
+    // A segment is rewritten once fewer than 1 in this many documents are live
+    static const size_t kMaxDeletedRatio = 2;
+    static const float kK1 = 1.2f;
+    static const float kB = 0.75f;
+
+    void tokenize(std::string_view text, std::vector<std::string>& tokens) {
+        tokens.clear();
+        std::string token;
+        for (size_t i = 0; i <= text.size(); ++i) {
+            uint8_t c = i < text.size() ? static_cast<uint8_t>(text[i]) : ' ';
+            bool word = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80;
+            if (c >= 'A' && c <= 'Z') {
+                c += 'a' - 'A';
+                word = true;
+            }
+            if (word) {
+                if (token.size() < kMaxTokenLength) token += static_cast<char>(c);
+            } else if (!token.empty()) {
+                tokens.push_back(token);
+                token.clear();
+            }
+        }
+    }
+
+    static void put_varint(std::string& out, uint32_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>(value | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    static inline uint32_t get_varint(const uint8_t*& p) {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = *p++;
+            value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if (byte < 0x80) return value;
+        }
+    }
+
+    static std::string segment_path(uint32_t number) {
+        char name[32];
+        snprintf(name, sizeof(name), "/seg-%06u", number);
+        return std::string(FtsIndex::kDirectory) + name;
+    }
+
+    static std::string manifest_path() { return std::string(FtsIndex::kDirectory) + "/manifest"; }
+
+    static void make_index_directory() {
+        std::string dir = FtsIndex::kDirectory;
+        for (size_t slash = dir.find('/', 1); ; slash = dir.find('/', slash + 1)) {
+            mkdir(dir.substr(0, slash).c_str(), 0755);
+            if (slash == std::string::npos) break;
+        }
+    }
+
+    static inline float bm25(float idf, uint32_t tf, uint32_t length, float avg_length) {
+        float norm = kK1 * (1 - kB + kB * static_cast<float>(length) / avg_length);
+        return idf * static_cast<float>(tf) * (kK1 + 1) / (static_cast<float>(tf) + norm);
+    }
+
+    const FtsIndex::Term* FtsIndex::Segment::find(const std::string& term) const {
+        auto it = std::lower_bound(terms.begin(), terms.end(), term);
+        if (it == terms.end() || *it != term) return nullptr;
+        return &term_info[it - terms.begin()];
+    }
+
+    void FtsIndex::Segment::decode(const Term& term, uint32_t block, uint32_t* docs, uint32_t* tfs, uint32_t& count) const {
+        uint32_t left = term.df - block * kBlockSize;
+        count = left < kBlockSize ? left : kBlockSize;
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(postings.data()) + blocks[term.first_block + block].offset;
+        uint32_t doc = block == 0 ? 0 : blocks[term.first_block + block - 1].last_doc;
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t delta = get_varint(p);
+            doc = (block == 0 && i == 0) ? delta : doc + delta;
+            docs[i] = doc;
+            tfs[i] = get_varint(p);
+        }
+    }
+
+    // Walks one term's postings in a segment, decoding a block at a time
+    class FtsIndex::Cursor {
+    public:
+        static const uint32_t kEnd = UINT32_MAX;
+
+        Cursor(const Segment& segment, const Term& term, float idf, float avg_length)
+            : segment_(&segment), term_(&term), idf_(idf), avg_length_(avg_length) {
+            max_score_ = 0;
+            for (uint32_t b = 0; b < term.block_count; ++b) max_score_ = std::max(max_score_, block_bound(b));
+            load(0);
+        }
+
+        uint32_t doc() const { return doc_; }
+        float max_score() const { return max_score_; }
+        float score() const { return bm25(idf_, tfs_[pos_], segment_->lengths[doc_], avg_length_); }
+
+        void next() {
+            if (++pos_ < count_) {
+                doc_ = docs_[pos_];
+            } else {
+                load(block_ + 1);
+            }
+        }
+
+        // Move to the first document at or after `target`
+        void seek(uint32_t target) {
+            if (doc_ >= target) return;
+            uint32_t block = block_of(target);
+            if (block != block_) {
+                load(block);
+                if (doc_ == kEnd) return;
+            }
+            while (docs_[pos_] < target) ++pos_;
+            doc_ = docs_[pos_];
+        }
+
+        // The block that would hold `target`, found from the skip table alone
+        uint32_t block_of(uint32_t target) const {
+            uint32_t block = block_;
+            while (block < term_->block_count && skip(block).last_doc < target) ++block;
+            return block;
+        }
+
+        // Highest score any document in `block` can reach
+        float block_bound(uint32_t block) const {
+            if (block >= term_->block_count) return 0;
+            return bm25(idf_, skip(block).max_tf, skip(block).min_length, avg_length_);
+        }
+
+        uint32_t block_last(uint32_t block) const {
+            return block < term_->block_count ? skip(block).last_doc : kEnd;
+        }
+
+    private:
+        const Segment* segment_;
+        const Term* term_;
+        float idf_;
+        float avg_length_;
+        float max_score_;
+        uint32_t block_ = 0;
+        uint32_t pos_ = 0;
+        uint32_t count_ = 0;
+        uint32_t doc_ = kEnd;
+        uint32_t docs_[kBlockSize];
+        uint32_t tfs_[kBlockSize];
+
+        const Block& skip(uint32_t block) const { return segment_->blocks[term_->first_block + block]; }
+
+        void load(uint32_t block) {
+            block_ = block;
+            pos_ = 0;
+            if (block >= term_->block_count) {
+                doc_ = kEnd;
+                return;
+            }
+            segment_->decode(*term_, block, docs_, tfs_, count_);
+            doc_ = docs_[0];
+        }
+    };
+
+    FtsIndex::Segment FtsIndex::build(Documents& documents, uint32_t number) const {
+        Segment segment;
+        segment.number = number;
+        segment.keys = std::move(documents.keys);
+        segment.lengths = std::move(documents.lengths);
+        segment.deleted.assign(segment.keys.size(), false);
+        segment.live = segment.keys.size();
+        for (uint32_t doc = 0; doc < segment.keys.size(); ++doc) {
+            segment.key_ids[segment.keys[doc]] = doc;
+            segment.live_length += segment.lengths[doc];
+        }
+
+        for (auto& entry : documents.postings) {
+            const std::vector<Posting>& list = entry.second;
+            Term term{static_cast<uint32_t>(list.size()), static_cast<uint32_t>(segment.blocks.size()), 0};
+            for (size_t start = 0; start < list.size(); start += kBlockSize) {
+                size_t end = std::min(list.size(), start + kBlockSize);
+                Block block{list[end - 1].doc, static_cast<uint32_t>(segment.postings.size()), 0, UINT32_MAX};
+                uint32_t previous = start == 0 ? 0 : list[start - 1].doc;
+                for (size_t i = start; i < end; ++i) {
+                    put_varint(segment.postings, list[i].doc - previous);
+                    put_varint(segment.postings, list[i].tf);
+                    previous = list[i].doc;
+                    block.max_tf = std::max(block.max_tf, list[i].tf);
+                    block.min_length = std::min(block.min_length, segment.lengths[list[i].doc]);
+                }
+                segment.blocks.push_back(block);
+                ++term.block_count;
+            }
+            segment.terms.push_back(entry.first);
+            segment.term_info.push_back(term);
+        }
+        documents.postings.clear();
+        return segment;
+    }
+
+    // Append the live documents of `segment` to `documents`, renumbered
+    void FtsIndex::collect(const Segment& segment, Documents& documents) const {
+        std::vector<uint32_t> remap(segment.keys.size());
+        for (uint32_t doc = 0; doc < segment.keys.size(); ++doc) {
+            if (segment.deleted[doc]) continue;
+            remap[doc] = static_cast<uint32_t>(documents.keys.size());
+            documents.keys.push_back(segment.keys[doc]);
+            documents.lengths.push_back(segment.lengths[doc]);
+        }
+
+        uint32_t docs[kBlockSize];
+        uint32_t tfs[kBlockSize];
+        for (size_t t = 0; t < segment.terms.size(); ++t) {
+            const Term& term = segment.term_info[t];
+            std::vector<Posting>* list = nullptr;
+            for (uint32_t block = 0; block < term.block_count; ++block) {
+                uint32_t count;
+                segment.decode(term, block, docs, tfs, count);
+                for (uint32_t i = 0; i < count; ++i) {
+                    if (segment.deleted[docs[i]]) continue;
+                    if (!list) list = &documents.postings[segment.terms[t]];
+                    list->push_back(Posting{remap[docs[i]], tfs[i]});
+                }
+            }
+        }
+    }
+
+    bool FtsIndex::add(const std::string& key, std::string_view text, std::string& error) {
+        remove(key);
+
+        std::vector<std::string> tokens;
+        tokenize(text, tokens);
+        std::unordered_map<std::string, uint32_t> counts;
+        for (const std::string& token : tokens) ++counts[token];
+
+        uint32_t doc = static_cast<uint32_t>(pending_.keys.size());
+        pending_.keys.push_back(key);
+        pending_.lengths.push_back(static_cast<uint32_t>(tokens.size()));
+        pending_deleted_.push_back(false);
+        pending_ids_[key] = doc;
+        ++pending_live_;
+        for (const auto& entry : counts) pending_.postings[entry.first].push_back(Posting{doc, entry.second});
+
+        return pending_live_ < kFlushDocs || flush(error);
+    }
+
+    bool FtsIndex::remove(const std::string& key) {
+        auto pending = pending_ids_.find(key);
+        if (pending != pending_ids_.end()) {
+            pending_deleted_[pending->second] = true;
+            pending_ids_.erase(pending);
+            --pending_live_;
+            return true;
+        }
+
+        for (Segment& segment : segments_) {
+            auto it = segment.key_ids.find(key);
+            if (it == segment.key_ids.end()) continue;
+            segment.deleted[it->second] = true;
+            --segment.live;
+            segment.live_length -= segment.lengths[it->second];
+            segment.key_ids.erase(it);
+            dirty_ = true;
+            return true;
+        }
+        return false;
+    }
+
+    bool FtsIndex::commit(std::string& error) { return flush(error); }
+
+    bool FtsIndex::flush(std::string& error) {
+        if (pending_.keys.empty() && !dirty_) return true;
+
+        if (pending_live_ > 0) {
+            // Drop documents replaced while still buffered
+            if (pending_live_ < pending_.keys.size()) {
+                Documents live;
+                std::vector<uint32_t> remap(pending_.keys.size());
+                for (uint32_t doc = 0; doc < pending_.keys.size(); ++doc) {
+                    if (pending_deleted_[doc]) continue;
+                    remap[doc] = static_cast<uint32_t>(live.keys.size());
+                    live.keys.push_back(std::move(pending_.keys[doc]));
+                    live.lengths.push_back(pending_.lengths[doc]);
+                }
+                for (auto& entry : pending_.postings) {
+                    std::vector<Posting> kept;
+                    for (const Posting& posting : entry.second) {
+                        if (!pending_deleted_[posting.doc]) kept.push_back(Posting{remap[posting.doc], posting.tf});
+                    }
+                    if (!kept.empty()) live.postings.emplace(entry.first, std::move(kept));
+                }
+                pending_ = std::move(live);
+            }
+
+            segments_.push_back(build(pending_, next_segment_++));
+            if (!save_segment(segments_.back(), error)) return false;
+        }
+        pending_ = Documents();
+        pending_deleted_.clear();
+        pending_ids_.clear();
+        pending_live_ = 0;
+
+        std::vector<uint32_t> obsolete;
+        if (!merge(obsolete, error) || !save_manifest(error)) return false;
+        // Replaced segment files go only once the manifest no longer names them
+        for (uint32_t number : obsolete) ::remove(segment_path(number).c_str());
+        dirty_ = false;
+        return true;
+    }
+
+    bool FtsIndex::merge(std::vector<uint32_t>& obsolete, std::string& error) {
+        // Rewrite segments that are mostly deletions: they waste space and
+        // skew document frequencies
+        for (size_t i = 0; i < segments_.size();) {
+            Segment& segment = segments_[i];
+            if (segment.live * kMaxDeletedRatio >= segment.keys.size()) {
+                ++i;
+                continue;
+            }
+            obsolete.push_back(segment.number);
+            if (segment.live == 0) {
+                segments_.erase(segments_.begin() + i);
+                continue;
+            }
+            Documents documents;
+            collect(segment, documents);
+            segment = build(documents, next_segment_++);
+            if (!save_segment(segment, error)) return false;
+            ++i;
+        }
+
+        while (segments_.size() >= 2) {
+            Segment& older = segments_[segments_.size() - 2];
+            Segment& newer = segments_.back();
+            if (older.live > newer.live * kMergeFactor && segments_.size() <= kMaxSegments) break;
+
+            Documents documents;
+            collect(older, documents);
+            collect(newer, documents);
+            obsolete.push_back(older.number);
+            obsolete.push_back(newer.number);
+            Segment merged = build(documents, next_segment_++);
+            if (!save_segment(merged, error)) return false;
+            segments_.pop_back();
+            segments_.back() = std::move(merged);
+        }
+        return true;
+    }
+
+    std::vector<FtsIndex::Hit> FtsIndex::query(std::string_view query, size_t k, std::string& error) {
+        std::vector<Hit> hits;
+        if (!flush(error) || k == 0) return hits;
+
+        std::vector<std::string> terms;
+        tokenize(query, terms);
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+        size_t documents = 0;
+        size_t stored = 0;
+        uint64_t total_length = 0;
+        for (const Segment& segment : segments_) {
+            documents += segment.live;
+            stored += segment.keys.size();
+            total_length += segment.live_length;
+        }
+        if (documents == 0) return hits;
+        float avg_length = std::max(1.0f, static_cast<float>(total_length) / static_cast<float>(documents));
+
+        // Document frequencies count deleted documents until their segment
+        // is rewritten, so the document count they are weighed against does
+        // too. Counting only live documents would let df exceed it and turn
+        // the idf of a common term negative, which inverts its ranking and
+        // breaks the block bounds the search relies on.
+        std::vector<float> idfs;
+        for (const std::string& term : terms) {
+            uint32_t df = 0;
+            for (const Segment& segment : segments_) {
+                if (const Term* info = segment.find(term)) df += info->df;
+            }
+            float n = static_cast<float>(stored);
+            idfs.push_back(std::log(1.0f + (n - df + 0.5f) / (df + 0.5f)));
+        }
+
+        // Min-heap of the best k so far; its top is the score to beat
+        std::vector<std::pair<float, const std::string*>> heap;
+        auto worse = [](const std::pair<float, const std::string*>& a, const std::pair<float, const std::string*>& b) {
+            return a.first > b.first;
+        };
+
+        for (const Segment& segment : segments_) {
+            std::vector<Cursor> cursors;
+            cursors.reserve(terms.size());
+            for (size_t t = 0; t < terms.size(); ++t) {
+                if (const Term* info = segment.find(terms[t])) cursors.emplace_back(segment, *info, idfs[t], avg_length);
+            }
+            std::vector<Cursor*> order;
+            for (Cursor& cursor : cursors) order.push_back(&cursor);
+
+            while (true) {
+                order.erase(std::remove_if(order.begin(), order.end(), [](Cursor* c) { return c->doc() == Cursor::kEnd; }),
+                            order.end());
+                if (order.empty()) break;
+                std::sort(order.begin(), order.end(), [](Cursor* a, Cursor* b) { return a->doc() < b->doc(); });
+
+                bool full = heap.size() == k;
+                float threshold = full ? heap.front().first : 0;
+
+                // Pivot: the first document whose terms could together beat
+                // the threshold; every earlier document is out of reach
+                float bound = 0;
+                size_t pivot = order.size();
+                for (size_t i = 0; i < order.size(); ++i) {
+                    bound += order[i]->max_score();
+                    if (!full || bound > threshold) {
+                        pivot = i;
+                        break;
+                    }
+                }
+                if (pivot == order.size()) break;
+                uint32_t doc = order[pivot]->doc();
+                while (pivot + 1 < order.size() && order[pivot + 1]->doc() == doc) ++pivot;
+
+                // Refine with the bounds of the blocks that hold the pivot
+                if (full) {
+                    float block_bound = 0;
+                    for (size_t i = 0; i <= pivot; ++i) block_bound += order[i]->block_bound(order[i]->block_of(doc));
+                    if (block_bound <= threshold) {
+                        uint32_t target = pivot + 1 < order.size() ? order[pivot + 1]->doc() : Cursor::kEnd;
+                        for (size_t i = 0; i <= pivot; ++i) {
+                            uint32_t last = order[i]->block_last(order[i]->block_of(doc));
+                            if (last != Cursor::kEnd) target = std::min(target, last + 1);
+                        }
+                        for (size_t i = 0; i <= pivot; ++i) order[i]->seek(target);
+                        continue;
+                    }
+                }
+
+                if (order[0]->doc() == doc) {
+                    if (!segment.deleted[doc]) {
+                        float score = 0;
+                        for (size_t i = 0; i <= pivot; ++i) score += order[i]->score();
+                        if (!full) {
+                            heap.emplace_back(score, &segment.keys[doc]);
+                            std::push_heap(heap.begin(), heap.end(), worse);
+                        } else if (score > threshold) {
+                            std::pop_heap(heap.begin(), heap.end(), worse);
+                            heap.back() = std::make_pair(score, &segment.keys[doc]);
+                            std::push_heap(heap.begin(), heap.end(), worse);
+                        }
+                    }
+                    for (size_t i = 0; i <= pivot; ++i) order[i]->next();
+                } else {
+                    for (size_t i = 0; i < pivot; ++i) order[i]->seek(doc);
+                }
+            }
+        }
+
+        std::sort(heap.begin(), heap.end(), [](const std::pair<float, const std::string*>& a, const std::pair<float, const std::string*>& b) {
+            return a.first != b.first ? a.first > b.first : *a.second < *b.second;
+        });
+        for (const auto& entry : heap) hits.push_back(Hit{entry.first, *entry.second});
+        return hits;
+    }
+
+    size_t FtsIndex::document_count() const {
+        size_t count = pending_live_;
+        for (const Segment& segment : segments_) count += segment.live;
+        return count;
+    }
+
+    bool FtsIndex::save_segment(const Segment& segment, std::string& error) const {
+        make_index_directory();
+        std::string path = segment_path(segment.number);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            error = "cannot write " + path;
+            return false;
+        }
+
+        auto put32 = [&](uint32_t value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+        auto put_string = [&](const std::string& value) {
+            put32(static_cast<uint32_t>(value.size()));
+            out.write(value.data(), value.size());
+        };
+
+        out.write(kSegmentMagic, sizeof(kSegmentMagic));
+        put32(kVersion);
+        put32(static_cast<uint32_t>(segment.keys.size()));
+        for (const std::string& key : segment.keys) put_string(key);
+        out.write(reinterpret_cast<const char*>(segment.lengths.data()), segment.lengths.size() * sizeof(uint32_t));
+        put32(static_cast<uint32_t>(segment.terms.size()));
+        for (size_t t = 0; t < segment.terms.size(); ++t) {
+            put_string(segment.terms[t]);
+            out.write(reinterpret_cast<const char*>(&segment.term_info[t]), sizeof(Term));
+        }
+        put32(static_cast<uint32_t>(segment.blocks.size()));
+        out.write(reinterpret_cast<const char*>(segment.blocks.data()), segment.blocks.size() * sizeof(Block));
+        put_string(segment.postings);
+        out.close();
+
+        if (!out) {
+            error = "cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+
+    bool FtsIndex::load_segment(uint32_t number, Segment& segment, std::string& error) const {
+        std::string path = segment_path(number);
+        std::ifstream in(path, std::ios::binary);
+        bool ok = in.is_open();
+        auto get32 = [&]() { uint32_t value = 0; ok = ok && in.read(reinterpret_cast<char*>(&value), sizeof(value)); return value; };
+        auto get_string = [&](std::string& value) {
+            value.resize(get32());
+            ok = ok && in.read(&value[0], value.size());
+        };
+
+        char magic[4] = {};
+        ok = ok && in.read(magic, sizeof(magic)) && memcmp(magic, kSegmentMagic, sizeof(magic)) == 0;
+        ok = ok && get32() == kVersion;
+
+        segment.number = number;
+        segment.keys.resize(ok ? get32() : 0);
+        for (std::string& key : segment.keys) get_string(key);
+        segment.lengths.resize(segment.keys.size());
+        ok = ok && in.read(reinterpret_cast<char*>(segment.lengths.data()), segment.lengths.size() * sizeof(uint32_t));
+        segment.terms.resize(ok ? get32() : 0);
+        segment.term_info.resize(segment.terms.size());
+        for (size_t t = 0; ok && t < segment.terms.size(); ++t) {
+            get_string(segment.terms[t]);
+            ok = ok && in.read(reinterpret_cast<char*>(&segment.term_info[t]), sizeof(Term));
+        }
+        segment.blocks.resize(ok ? get32() : 0);
+        ok = ok && in.read(reinterpret_cast<char*>(segment.blocks.data()), segment.blocks.size() * sizeof(Block));
+        get_string(segment.postings);
+        if (!ok) {
+            error = "search segment " + path + " is missing or corrupt";
+            return false;
+        }
+
+        segment.deleted.assign(segment.keys.size(), false);
+        segment.live = segment.keys.size();
+        segment.live_length = 0;
+        for (uint32_t doc = 0; doc < segment.keys.size(); ++doc) {
+            segment.key_ids[segment.keys[doc]] = doc;
+            segment.live_length += segment.lengths[doc];
+        }
+        return true;
+    }
+
+    bool FtsIndex::save_manifest(std::string& error) const {
+        make_index_directory();
+        std::string temp = manifest_path() + ".tmp";
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            error = "cannot write " + temp;
+            return false;
+        }
+
+        auto put32 = [&](uint32_t value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+        out.write(kManifestMagic, sizeof(kManifestMagic));
+        put32(kVersion);
+        put32(next_segment_);
+        put32(static_cast<uint32_t>(segments_.size()));
+        for (const Segment& segment : segments_) {
+            put32(segment.number);
+            put32(static_cast<uint32_t>(segment.keys.size() - segment.live));
+            for (uint32_t doc = 0; doc < segment.keys.size(); ++doc) {
+                if (segment.deleted[doc]) put32(doc);
+            }
+        }
+        out.close();
+
+        if (!out || rename(temp.c_str(), manifest_path().c_str()) != 0) {
+            error = "cannot write " + manifest_path();
+            return false;
+        }
+        return true;
+    }
+
+    bool FtsIndex::load(std::string& error) {
+        segments_.clear();
+        std::ifstream in(manifest_path(), std::ios::binary);
+        if (!in.is_open()) return true;
+
+        bool ok = true;
+        auto get32 = [&]() { uint32_t value = 0; ok = ok && in.read(reinterpret_cast<char*>(&value), sizeof(value)); return value; };
+        char magic[4];
+        if (!in.read(magic, sizeof(magic)) || memcmp(magic, kManifestMagic, sizeof(magic)) != 0 || get32() != kVersion) {
+            error = "search manifest is corrupt";
+            return false;
+        }
+
+        next_segment_ = get32();
+        uint32_t count = get32();
+        for (uint32_t i = 0; ok && i < count; ++i) {
+            Segment segment;
+            if (!load_segment(get32(), segment, error)) return false;
+            uint32_t deleted = get32();
+            for (uint32_t d = 0; ok && d < deleted; ++d) {
+                uint32_t doc = get32();
+                if (!ok || doc >= segment.keys.size() || segment.deleted[doc]) break;
+                segment.deleted[doc] = true;
+                --segment.live;
+                segment.live_length -= segment.lengths[doc];
+                segment.key_ids.erase(segment.keys[doc]);
+            }
+            segments_.push_back(std::move(segment));
+        }
+        if (!ok) {
+            error = "search manifest is corrupt";
+            segments_.clear();
+            return false;
+        }
+        return true;
+    }
+
+    FtsIndex* fts_index() {
+        static FtsIndex* shared = nullptr;
+        if (!shared) {
+            shared = new FtsIndex();
+            std::string error;
+            if (!shared->load(error)) {
+                // Start over rather than fail every call; the next commit
+                // replaces the unreadable manifest
+                delete shared;
+                shared = new FtsIndex();
+            }
+        }
+        return shared;
+    }
+}
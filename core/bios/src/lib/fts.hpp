@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lib {
+    // Split text into lowercased words: runs of ASCII letters and digits
+    // plus any non-ASCII bytes, so UTF-8 words stay whole
+    void tokenize(std::string_view text, std::vector<std::string>& tokens);
+
+    // Ranked full-text search with BM25. Documents are identified by a key
+    // (a path, or anything the caller chooses) and replacing a key replaces
+    // its document.
+    //
+    // New documents collect in an in-memory buffer that is flushed into an
+    // immutable segment before a query or once kFlushDocs have been added.
+    // A segment's posting lists are cut into blocks of kBlockSize documents
+    // (varint doc deltas and term frequencies) with a skip table giving
+    // each block's last document, highest term frequency and shortest
+    // document, which lets queries skip blocks that cannot beat the current
+    // top-k (block-max WAND). Deleted documents are masked until a merge
+    // rewrites their segment, or the segment is rewritten on its own once
+    // most of it is deleted; merges keep segment sizes roughly geometric.
+    //
+    // Segments are saved as files under kDirectory, alongside a manifest
+    // listing them and their deletions.
+    class FtsIndex {
+    public:
+        static constexpr const char* kDirectory = "/.bios/fts";
+        static const uint32_t kBlockSize = 128;
+        static const size_t kFlushDocs = 256;
+
+        struct Hit {
+            float score;
+            std::string key;
+        };
+
+        // Load the saved index; an index that has never been saved loads empty
+        bool load(std::string& error);
+
+        // Add or replace the document for `key`; fails only if a flush of
+        // the buffer cannot be saved
+        bool add(const std::string& key, std::string_view text, std::string& error);
+
+        // Remove the document for `key`; false if it is not indexed. Like
+        // additions, removals are saved by the next commit
+        bool remove(const std::string& key);
+
+        // Flush buffered documents into a segment and save the manifest
+        bool commit(std::string& error);
+
+        // The `k` best documents for the words in `query`, best first
+        std::vector<Hit> query(std::string_view query, size_t k, std::string& error);
+
+        size_t document_count() const;
+        size_t segment_count() const { return segments_.size(); }
+
+    private:
+        struct Posting {
+            uint32_t doc;
+            uint32_t tf;
+        };
+
+        // Documents and their postings before they are packed into a segment
+        struct Documents {
+            std::vector<std::string> keys;
+            std::vector<uint32_t> lengths;
+            std::map<std::string, std::vector<Posting>> postings;
+        };
+
+        struct Term {
+            uint32_t df;
+            uint32_t first_block;
+            uint32_t block_count;
+        };
+
+        struct Block {
+            uint32_t last_doc;
+            uint32_t offset;        // Into Segment::postings
+            uint32_t max_tf;
+            uint32_t min_length;
+        };
+
+        struct Segment {
+            uint32_t number = 0;
+            std::vector<std::string> keys;
+            std::vector<uint32_t> lengths;
+            std::vector<bool> deleted;
+            std::unordered_map<std::string, uint32_t> key_ids;
+            size_t live = 0;
+            uint64_t live_length = 0;
+            std::vector<std::string> terms;     // Sorted
+            std::vector<Term> term_info;
+            std::vector<Block> blocks;
+            std::string postings;
+
+            const Term* find(const std::string& term) const;
+            void decode(const Term& term, uint32_t block, uint32_t* docs, uint32_t* tfs, uint32_t& count) const;
+        };
+
+        class Cursor;
+
+        std::vector<Segment> segments_;
+        Documents pending_;
+        std::vector<bool> pending_deleted_;
+        std::unordered_map<std::string, uint32_t> pending_ids_;
+        size_t pending_live_ = 0;
+        uint32_t next_segment_ = 1;
+        bool dirty_ = false;                // Deletions not yet in the manifest
+
+        Segment build(Documents& documents, uint32_t number) const;
+        void collect(const Segment& segment, Documents& documents) const;
+        bool flush(std::string& error);
+        bool merge(std::vector<uint32_t>& obsolete, std::string& error);
+        bool save_segment(const Segment& segment, std::string& error) const;
+        bool load_segment(uint32_t number, Segment& segment, std::string& error) const;
+        bool save_manifest(std::string& error) const;
+    };
+
+    // The index shared by the exports and commands, loaded on first use
+    FtsIndex* fts_index();
+}
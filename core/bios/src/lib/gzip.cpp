@@ -0,0 +1,144 @@
+#include "gzip.hpp"
+#include "file_io.hpp"
+#include "hash.hpp"
+#include <cstring>
+
+namespace lib {
+    static const uint8_t kMagic[3] = {0x1f, 0x8b, 8};     // ID1, ID2, CM = deflate
+    static const size_t kHeaderSize = 10;
+    static const size_t kTrailerSize = 8;
+    static const uint8_t kHeaderCrc = 0x02;
+    static const uint8_t kExtra = 0x04;
+    static const uint8_t kName = 0x08;
+    static const uint8_t kComment = 0x10;
+    static const uint8_t kReservedFlags = 0xe0;
+    static const uint8_t kUnixOs = 3;
+
+    GzipEncoder::GzipEncoder(int level) : level_(level < 1 ? 1 : level > kMaxLevel ? kMaxLevel : level), deflater_(level_) {}
+
+    void GzipEncoder::update(const uint8_t* data, size_t len, std::string& out) {
+        if (!started_) {
+            // No name or modification time; XFL notes the fastest and best levels
+            char header[kHeaderSize] = {static_cast<char>(kMagic[0]), static_cast<char>(kMagic[1]), static_cast<char>(kMagic[2]),
+                                        0, 0, 0, 0, 0, static_cast<char>(level_ == kMaxLevel ? 2 : level_ == 1 ? 4 : 0),
+                                        static_cast<char>(kUnixOs)};
+            out.append(header, sizeof(header));
+            started_ = true;
+        }
+        crc_ = crc32(crc_, data, len);
+        size_ += static_cast<uint32_t>(len);
+        deflater_.update(data, len, out);
+    }
+
+    void GzipEncoder::finish(std::string& out) {
+        update(nullptr, 0, out);
+        deflater_.finish(out);
+        put32(out, crc_);
+        put32(out, size_);
+    }
+
+    bool GzipDecoder::update(const uint8_t* data, size_t len, std::string& out, std::string& error) {
+        input_.insert(input_.end(), data, data + len);
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            switch (state_) {
+                case kHeader:
+                    if (!read_header(error, progress)) return false;
+                    break;
+                case kBody: {
+                    if (input_.empty()) break;
+                    size_t before = out.size();
+                    if (!inflater_.update(input_.data(), input_.size(), out, error)) return false;
+                    input_.clear();
+                    crc_ = crc32(crc_, reinterpret_cast<const uint8_t*>(out.data()) + before, out.size() - before);
+                    size_ += static_cast<uint32_t>(out.size() - before);
+                    if (inflater_.done()) {
+                        input_.assign(inflater_.rest(), inflater_.rest() + inflater_.rest_size());
+                        state_ = kTrailer;
+                        progress = true;
+                    }
+                    break;
+                }
+                case kTrailer:
+                    if (input_.size() < kTrailerSize) break;
+                    if (read32(input_.data()) != crc_) {
+                        error = "invalid compressed data--crc error";
+                        return false;
+                    }
+                    if (read32(input_.data() + 4) != size_) {
+                        error = "invalid compressed data--length error";
+                        return false;
+                    }
+                    input_.erase(input_.begin(), input_.begin() + kTrailerSize);
+                    state_ = kNext;
+                    progress = true;
+                    break;
+                case kNext:
+                    // Another member, or the end of the input
+                    if (input_.empty()) break;
+                    if (input_.size() < sizeof(kMagic) && !memcmp(input_.data(), kMagic, input_.size())) break;
+                    if (!is_gzip_member(input_.data(), input_.size())) {
+                        error = "trailing garbage after compressed data";
+                        return false;
+                    }
+                    state_ = kHeader;
+                    progress = true;
+                    break;
+            }
+        }
+        return true;
+    }
+
+    bool GzipDecoder::finish(std::string& error) const {
+        if (state_ == kNext && input_.empty()) return true;
+        error = "unexpected end of input";
+        return false;
+    }
+
+    // Parse a member header once all of it has arrived
+    bool GzipDecoder::read_header(std::string& error, bool& progress) {
+        size_t size = input_.size();
+        if (size < kHeaderSize) return true;
+        if (!is_gzip_member(input_.data(), size)) {
+            error = input_[0] == kMagic[0] && input_[1] == kMagic[1] ? "unknown compression method" : "not in gzip format";
+            return false;
+        }
+        uint8_t flags = input_[3];
+        if (flags & kReservedFlags) {
+            error = "unknown header flags";
+            return false;
+        }
+
+        size_t pos = kHeaderSize;
+        if (flags & kExtra) {
+            if (pos + 2 > size) return true;
+            pos += 2 + (input_[pos] | input_[pos + 1] << 8);
+            if (pos > size) return true;
+        }
+        for (uint8_t field : {kName, kComment}) {
+            if (!(flags & field)) continue;
+            const uint8_t* end = static_cast<const uint8_t*>(memchr(input_.data() + pos, 0, size - pos));
+            if (!end) return true;
+            pos = end - input_.data() + 1;
+        }
+        if (flags & kHeaderCrc) {
+            if (pos + 2 > size) return true;
+            if ((crc32(0, input_.data(), pos) & 0xffff) != static_cast<uint32_t>(input_[pos] | input_[pos + 1] << 8)) {
+                error = "header checksum mismatch";
+                return false;
+            }
+            pos += 2;
+        }
+
+        input_.erase(input_.begin(), input_.begin() + pos);
+        inflater_.reset();
+        crc_ = 0;
+        size_ = 0;
+        state_ = kBody;
+        progress = true;
+        return true;
+    }
+
+    bool is_gzip_member(const uint8_t* data, size_t len) { return len >= sizeof(kMagic) && !memcmp(data, kMagic, sizeof(kMagic)); }
+}
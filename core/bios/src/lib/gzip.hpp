@@ -0,0 +1,52 @@
+#pragma once
+#include "deflate.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lib {
+    // gzip file format (RFC 1952): a header, deflate data and a trailer
+    // holding the CRC-32 and length of the content, readable by gzip, zlib
+    // and browsers' DecompressionStream
+    class GzipEncoder {
+    public:
+        static const int kMaxLevel = Deflater::kMaxLevel;
+
+        explicit GzipEncoder(int level = 6);
+
+        void update(const uint8_t* data, size_t len, std::string& out);
+        void finish(std::string& out);
+
+    private:
+        int level_;
+        bool started_ = false;
+        Deflater deflater_;
+        uint32_t crc_ = 0;
+        uint32_t size_ = 0;
+    };
+
+    // Streaming gzip decoder; concatenated members decode as one stream,
+    // as with gzip -d
+    class GzipDecoder {
+    public:
+        bool update(const uint8_t* data, size_t len, std::string& out, std::string& error);
+
+        // Check that the input ended after a complete member
+        bool finish(std::string& error) const;
+
+    private:
+        enum State { kHeader, kBody, kTrailer, kNext };
+
+        State state_ = kHeader;
+        std::vector<uint8_t> input_;        // Header or trailer bytes seen so far
+        Inflater inflater_;
+        uint32_t crc_ = 0;
+        uint32_t size_ = 0;
+
+        bool read_header(std::string& error, bool& progress);
+    };
+
+    // True if `data` starts with a gzip member
+    bool is_gzip_member(const uint8_t* data, size_t len);
+}
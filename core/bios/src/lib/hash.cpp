@@ -0,0 +1,583 @@
+#include "hash.hpp"
+#include "encoding.hpp"
+#include "file_io.hpp"
+#include <algorithm>
+#include <cstring>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+namespace lib {
+    static inline uint32_t rotr32(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+    static inline uint64_t rotl64(uint64_t x, int n) { return (x << n) | (x >> (64 - n)); }
+
+    // SHA-256 (FIPS 180-4)
+
+    static const uint32_t kSha256Rounds[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+
+    static void sha256_compress(uint32_t state[8], const uint8_t* block) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = static_cast<uint32_t>(block[i * 4]) << 24 | static_cast<uint32_t>(block[i * 4 + 1]) << 16 |
+                   static_cast<uint32_t>(block[i * 4 + 2]) << 8 | block[i * 4 + 3];
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + kSha256Rounds[i] + w[i];
+            uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+    Sha256::Sha256() {
+        static const uint32_t kInitial[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+        };
+        memcpy(state_, kInitial, sizeof(state_));
+    }
+
+    void Sha256::update(const uint8_t* data, size_t len) {
+        if (len == 0) return;       // data may be null
+        total_ += len;
+        if (buffered_) {
+            size_t take = std::min(len, sizeof(block_) - buffered_);
+            memcpy(block_ + buffered_, data, take);
+            buffered_ += take;
+            data += take;
+            len -= take;
+            if (buffered_ < sizeof(block_)) return;
+            sha256_compress(state_, block_);
+            buffered_ = 0;
+        }
+
+        // Whole blocks straight from the caller's buffer
+        for (; len >= 64; data += 64, len -= 64) sha256_compress(state_, data);
+
+        memcpy(block_, data, len);
+        buffered_ = len;
+    }
+
+    void Sha256::finish(uint8_t* out) {
+        uint64_t bits = total_ * 8;
+        block_[buffered_++] = 0x80;
+        if (buffered_ > 56) {
+            memset(block_ + buffered_, 0, 64 - buffered_);
+            sha256_compress(state_, block_);
+            buffered_ = 0;
+        }
+        memset(block_ + buffered_, 0, 56 - buffered_);
+        for (int i = 0; i < 8; ++i) block_[56 + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+        sha256_compress(state_, block_);
+
+        for (int i = 0; i < 8; ++i) {
+            out[i * 4] = static_cast<uint8_t>(state_[i] >> 24);
+            out[i * 4 + 1] = static_cast<uint8_t>(state_[i] >> 16);
+            out[i * 4 + 2] = static_cast<uint8_t>(state_[i] >> 8);
+            out[i * 4 + 3] = static_cast<uint8_t>(state_[i]);
+        }
+    }
+
+    // XXH3-64 (xxHash 0.8), specialised for the default secret and seed 0.
+    // Inputs up to 240 bytes take dedicated short paths; longer ones run
+    // eight 64-bit accumulators over 64-byte stripes, scrambling after every
+    // 1 KB block.
+
+    static const uint64_t kPrime32_1 = 0x9E3779B1U;
+    static const uint64_t kPrime32_2 = 0x85EBCA77U;
+    static const uint64_t kPrime32_3 = 0xC2B2AE3DU;
+    static const uint64_t kPrime32_4 = 0x27D4EB2FU;
+    static const uint64_t kPrime32_5 = 0x165667B1U;
+    static const uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+    static const uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static const uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+    static const uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+    static const uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+    static const uint64_t kPrimeMx1 = 0x165667919E3779F9ULL;
+    static const uint64_t kPrimeMx2 = 0x9FB21C651E98DF25ULL;
+
+    alignas(16) static const uint8_t kXxh3Secret[192] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+
+    static const size_t kStripeLen = 64;
+    static const size_t kStripesPerBlock = (sizeof(kXxh3Secret) - kStripeLen) / 8;
+    static const size_t kSecretLimit = sizeof(kXxh3Secret) - kStripeLen;
+    static const size_t kBufferStripes = 4;
+
+    static inline uint64_t mul128_fold64(uint64_t lhs, uint64_t rhs) {
+        unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+    }
+
+    static inline uint64_t xxh64_avalanche(uint64_t h) {
+        h ^= h >> 33;
+        h *= kPrime64_2;
+        h ^= h >> 29;
+        h *= kPrime64_3;
+        return h ^ (h >> 32);
+    }
+
+    static inline uint64_t xxh3_avalanche(uint64_t h) {
+        h ^= h >> 37;
+        h *= kPrimeMx1;
+        return h ^ (h >> 32);
+    }
+
+    static inline uint64_t xxh3_rrmxmx(uint64_t h, uint64_t len) {
+        h ^= rotl64(h, 49) ^ rotl64(h, 24);
+        h *= kPrimeMx2;
+        h ^= (h >> 35) + len;
+        h *= kPrimeMx2;
+        return h ^ (h >> 28);
+    }
+
+    static inline uint64_t xxh3_mix16(const uint8_t* in, const uint8_t* secret) {
+        return mul128_fold64(read64(in) ^ read64(secret), read64(in + 8) ^ read64(secret + 8));
+    }
+
+    static uint64_t xxh3_short(const uint8_t* in, size_t len) {
+        const uint8_t* secret = kXxh3Secret;
+        if (len > 8) {
+            uint64_t lo = read64(in) ^ (read64(secret + 24) ^ read64(secret + 32));
+            uint64_t hi = read64(in + len - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+            return xxh3_avalanche(len + __builtin_bswap64(lo) + hi + mul128_fold64(lo, hi));
+        }
+        if (len >= 4) {
+            uint64_t combined = read32(in + len - 4) + (static_cast<uint64_t>(read32(in)) << 32);
+            return xxh3_rrmxmx(combined ^ (read64(secret + 8) ^ read64(secret + 16)), len);
+        }
+        if (len > 0) {
+            uint32_t combined = static_cast<uint32_t>(in[0]) << 16 | static_cast<uint32_t>(in[len >> 1]) << 24 |
+                                in[len - 1] | static_cast<uint32_t>(len) << 8;
+            return xxh64_avalanche(combined ^ static_cast<uint64_t>(read32(secret) ^ read32(secret + 4)));
+        }
+        return xxh64_avalanche(read64(secret + 56) ^ read64(secret + 64));
+    }
+
+    static uint64_t xxh3_medium(const uint8_t* in, size_t len) {
+        const uint8_t* secret = kXxh3Secret;
+        uint64_t acc = len * kPrime64_1;
+        if (len <= 128) {
+            if (len > 32) {
+                if (len > 64) {
+                    if (len > 96) {
+                        acc += xxh3_mix16(in + 48, secret + 96);
+                        acc += xxh3_mix16(in + len - 64, secret + 112);
+                    }
+                    acc += xxh3_mix16(in + 32, secret + 64);
+                    acc += xxh3_mix16(in + len - 48, secret + 80);
+                }
+                acc += xxh3_mix16(in + 16, secret + 32);
+                acc += xxh3_mix16(in + len - 32, secret + 48);
+            }
+            acc += xxh3_mix16(in, secret);
+            acc += xxh3_mix16(in + len - 16, secret + 16);
+            return xxh3_avalanche(acc);
+        }
+
+        size_t rounds = len / 16;
+        for (size_t i = 0; i < 8; ++i) acc += xxh3_mix16(in + 16 * i, secret + 16 * i);
+        acc = xxh3_avalanche(acc);
+        for (size_t i = 8; i < rounds; ++i) acc += xxh3_mix16(in + 16 * i, secret + 16 * (i - 8) + 3);
+        acc += xxh3_mix16(in + len - 16, secret + 136 - 17);
+        return xxh3_avalanche(acc);
+    }
+
+    static inline void xxh3_accumulate_stripe(uint64_t acc[8], const uint8_t* in, const uint8_t* secret) {
+#ifdef __wasm_simd128__
+        for (int i = 0; i < 4; ++i) {
+            v128_t data = wasm_v128_load(in + 16 * i);
+            v128_t key = wasm_v128_xor(data, wasm_v128_load(secret + 16 * i));
+            // Low half times high half of each keyed 64-bit lane
+            v128_t product = wasm_u64x2_extmul_low_u32x4(wasm_i32x4_shuffle(key, key, 0, 2, 0, 2),
+                                                          wasm_i32x4_shuffle(key, key, 1, 3, 1, 3));
+            v128_t sum = wasm_i64x2_add(wasm_v128_load(acc + 2 * i), wasm_i64x2_shuffle(data, data, 1, 0));
+            wasm_v128_store(acc + 2 * i, wasm_i64x2_add(sum, product));
+        }
+#else
+        for (int i = 0; i < 8; ++i) {
+            uint64_t data = read64(in + 8 * i);
+            uint64_t key = data ^ read64(secret + 8 * i);
+            acc[i ^ 1] += data;
+            acc[i] += (key & 0xffffffffULL) * (key >> 32);
+        }
+#endif
+    }
+
+    static inline void xxh3_scramble(uint64_t acc[8], const uint8_t* secret) {
+#ifdef __wasm_simd128__
+        for (int i = 0; i < 4; ++i) {
+            v128_t value = wasm_v128_load(acc + 2 * i);
+            value = wasm_v128_xor(value, wasm_u64x2_shr(value, 47));
+            value = wasm_v128_xor(value, wasm_v128_load(secret + 16 * i));
+            wasm_v128_store(acc + 2 * i, wasm_i64x2_mul(value, wasm_i64x2_splat(kPrime32_1)));
+        }
+#else
+        for (int i = 0; i < 8; ++i) {
+            uint64_t value = acc[i];
+            value ^= value >> 47;
+            value ^= read64(secret + 8 * i);
+            acc[i] = value * kPrime32_1;
+        }
+#endif
+    }
+
+    static inline void xxh3_accumulate(uint64_t acc[8], const uint8_t* in, const uint8_t* secret, size_t stripes) {
+        for (size_t i = 0; i < stripes; ++i) xxh3_accumulate_stripe(acc, in + i * kStripeLen, secret + i * 8);
+    }
+
+    static inline void xxh3_init_acc(uint64_t acc[8]) {
+        const uint64_t initial[8] = {
+            kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3, kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1,
+        };
+        memcpy(acc, initial, sizeof(initial));
+    }
+
+    static uint64_t xxh3_merge(const uint64_t acc[8], uint64_t start) {
+        const uint8_t* secret = kXxh3Secret + 11;
+        uint64_t result = start;
+        for (int i = 0; i < 4; ++i) {
+            result += mul128_fold64(acc[2 * i] ^ read64(secret + 16 * i), acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+        }
+        return xxh3_avalanche(result);
+    }
+
+    // Feed `stripes` stripes into `acc`, scrambling whenever a block fills
+    static void xxh3_consume(uint64_t acc[8], size_t& stripes_so_far, const uint8_t* in, size_t stripes) {
+        if (kStripesPerBlock - stripes_so_far <= stripes) {
+            size_t to_block_end = kStripesPerBlock - stripes_so_far;
+            xxh3_accumulate(acc, in, kXxh3Secret + stripes_so_far * 8, to_block_end);
+            xxh3_scramble(acc, kXxh3Secret + kSecretLimit);
+            xxh3_accumulate(acc, in + to_block_end * kStripeLen, kXxh3Secret, stripes - to_block_end);
+            stripes_so_far = stripes - to_block_end;
+        } else {
+            xxh3_accumulate(acc, in, kXxh3Secret + stripes_so_far * 8, stripes);
+            stripes_so_far += stripes;
+        }
+    }
+
+    uint64_t xxh3_64(const uint8_t* data, size_t len) {
+        if (len <= 16) return xxh3_short(data, len);
+        if (len <= 240) return xxh3_medium(data, len);
+
+        uint64_t acc[8];
+        xxh3_init_acc(acc);
+        const size_t block_len = kStripeLen * kStripesPerBlock;
+        size_t blocks = (len - 1) / block_len;
+        for (size_t n = 0; n < blocks; ++n) {
+            xxh3_accumulate(acc, data + n * block_len, kXxh3Secret, kStripesPerBlock);
+            xxh3_scramble(acc, kXxh3Secret + kSecretLimit);
+        }
+
+        size_t stripes = ((len - 1) - block_len * blocks) / kStripeLen;
+        xxh3_accumulate(acc, data + blocks * block_len, kXxh3Secret, stripes);
+        xxh3_accumulate_stripe(acc, data + len - kStripeLen, kXxh3Secret + kSecretLimit - 7);
+        return xxh3_merge(acc, len * kPrime64_1);
+    }
+
+    Xxh3::Xxh3() {
+        xxh3_init_acc(acc_);
+    }
+
+    void Xxh3::update(const uint8_t* data, size_t len) {
+        if (len == 0) return;
+        total_ += len;
+        if (buffered_ + len <= sizeof(buffer_)) {
+            memcpy(buffer_ + buffered_, data, len);
+            buffered_ += len;
+            return;
+        }
+
+        const uint8_t* end = data + len;
+        if (buffered_) {
+            size_t take = sizeof(buffer_) - buffered_;
+            memcpy(buffer_ + buffered_, data, take);
+            data += take;
+            xxh3_consume(acc_, stripes_, buffer_, kBufferStripes);
+            buffered_ = 0;
+        }
+
+        // Always leave input buffered so finish() sees the final stripe
+        if (end - data > static_cast<ptrdiff_t>(sizeof(buffer_))) {
+            do {
+                xxh3_consume(acc_, stripes_, data, kBufferStripes);
+                data += sizeof(buffer_);
+            } while (end - data > static_cast<ptrdiff_t>(sizeof(buffer_)));
+            // Keep the last consumed stripe for a short final tail
+            memcpy(buffer_ + sizeof(buffer_) - kStripeLen, data - kStripeLen, kStripeLen);
+        }
+
+        memcpy(buffer_, data, end - data);
+        buffered_ = end - data;
+    }
+
+    uint64_t Xxh3::digest() const {
+        if (total_ <= 240) return xxh3_64(buffer_, static_cast<size_t>(total_));
+
+        uint64_t acc[8];
+        memcpy(acc, acc_, sizeof(acc));
+        uint8_t last[kStripeLen];
+        const uint8_t* last_stripe;
+        if (buffered_ >= kStripeLen) {
+            size_t stripes = stripes_;
+            xxh3_consume(acc, stripes, buffer_, (buffered_ - 1) / kStripeLen);
+            last_stripe = buffer_ + buffered_ - kStripeLen;
+        } else {
+            // The final stripe straddles the previously consumed input
+            size_t catchup = kStripeLen - buffered_;
+            memcpy(last, buffer_ + sizeof(buffer_) - catchup, catchup);
+            memcpy(last + catchup, buffer_, buffered_);
+            last_stripe = last;
+        }
+        xxh3_accumulate_stripe(acc, last_stripe, kXxh3Secret + kSecretLimit - 7);
+        return xxh3_merge(acc, total_ * kPrime64_1);
+    }
+
+    void Xxh3::finish(uint8_t* out) {
+        uint64_t value = digest();
+        for (int i = 0; i < 8; ++i) out[i] = static_cast<uint8_t>(value >> (56 - 8 * i));
+    }
+
+    // XXH32 and XXH64: four lanes over 16- or 32-byte stripes, then the
+    // tail a word at a time
+
+    static inline uint32_t rotl32(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+    static inline uint32_t xxh32_round(uint32_t acc, uint32_t input) {
+        return rotl32(acc + input * static_cast<uint32_t>(kPrime32_2), 13) * static_cast<uint32_t>(kPrime32_1);
+    }
+
+    Xxh32::Xxh32(uint32_t seed) : seed_(seed) {
+        v_[0] = seed + static_cast<uint32_t>(kPrime32_1) + static_cast<uint32_t>(kPrime32_2);
+        v_[1] = seed + static_cast<uint32_t>(kPrime32_2);
+        v_[2] = seed;
+        v_[3] = seed - static_cast<uint32_t>(kPrime32_1);
+    }
+
+    void Xxh32::update(const uint8_t* data, size_t len) {
+        if (len == 0) return;
+        total_ += len;
+        if (buffered_ + len < sizeof(buffer_)) {
+            memcpy(buffer_ + buffered_, data, len);
+            buffered_ += len;
+            return;
+        }
+
+        if (buffered_) {
+            size_t take = sizeof(buffer_) - buffered_;
+            memcpy(buffer_ + buffered_, data, take);
+            for (int i = 0; i < 4; ++i) v_[i] = xxh32_round(v_[i], read32(buffer_ + 4 * i));
+            data += take;
+            len -= take;
+            buffered_ = 0;
+        }
+        for (; len >= sizeof(buffer_); data += sizeof(buffer_), len -= sizeof(buffer_)) {
+            for (int i = 0; i < 4; ++i) v_[i] = xxh32_round(v_[i], read32(data + 4 * i));
+        }
+        memcpy(buffer_, data, len);
+        buffered_ = len;
+    }
+
+    uint32_t Xxh32::digest() const {
+        uint32_t h = total_ >= sizeof(buffer_)
+            ? rotl32(v_[0], 1) + rotl32(v_[1], 7) + rotl32(v_[2], 12) + rotl32(v_[3], 18)
+            : seed_ + static_cast<uint32_t>(kPrime32_5);
+        h += static_cast<uint32_t>(total_);
+
+        const uint8_t* p = buffer_;
+        const uint8_t* end = buffer_ + buffered_;
+        for (; p + 4 <= end; p += 4) h = rotl32(h + read32(p) * static_cast<uint32_t>(kPrime32_3), 17) * static_cast<uint32_t>(kPrime32_4);
+        for (; p < end; ++p) h = rotl32(h + *p * static_cast<uint32_t>(kPrime32_5), 11) * static_cast<uint32_t>(kPrime32_1);
+
+        h ^= h >> 15;
+        h *= static_cast<uint32_t>(kPrime32_2);
+        h ^= h >> 13;
+        h *= static_cast<uint32_t>(kPrime32_3);
+        return h ^ (h >> 16);
+    }
+
+    static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+        return rotl64(acc + input * kPrime64_2, 31) * kPrime64_1;
+    }
+
+    static inline uint64_t xxh64_merge(uint64_t h, uint64_t v) {
+        h ^= xxh64_round(0, v);
+        return h * kPrime64_1 + kPrime64_4;
+    }
+
+    Xxh64::Xxh64(uint64_t seed) : seed_(seed) {
+        v_[0] = seed + kPrime64_1 + kPrime64_2;
+        v_[1] = seed + kPrime64_2;
+        v_[2] = seed;
+        v_[3] = seed - kPrime64_1;
+    }
+
+    void Xxh64::update(const uint8_t* data, size_t len) {
+        if (len == 0) return;
+        total_ += len;
+        if (buffered_ + len < sizeof(buffer_)) {
+            memcpy(buffer_ + buffered_, data, len);
+            buffered_ += len;
+            return;
+        }
+
+        if (buffered_) {
+            size_t take = sizeof(buffer_) - buffered_;
+            memcpy(buffer_ + buffered_, data, take);
+            for (int i = 0; i < 4; ++i) v_[i] = xxh64_round(v_[i], read64(buffer_ + 8 * i));
+            data += take;
+            len -= take;
+            buffered_ = 0;
+        }
+        for (; len >= sizeof(buffer_); data += sizeof(buffer_), len -= sizeof(buffer_)) {
+            for (int i = 0; i < 4; ++i) v_[i] = xxh64_round(v_[i], read64(data + 8 * i));
+        }
+        memcpy(buffer_, data, len);
+        buffered_ = len;
+    }
+
+    uint64_t Xxh64::digest() const {
+        uint64_t h;
+        if (total_ >= sizeof(buffer_)) {
+            h = rotl64(v_[0], 1) + rotl64(v_[1], 7) + rotl64(v_[2], 12) + rotl64(v_[3], 18);
+            for (int i = 0; i < 4; ++i) h = xxh64_merge(h, v_[i]);
+        } else {
+            h = seed_ + kPrime64_5;
+        }
+        h += total_;
+
+        const uint8_t* p = buffer_;
+        const uint8_t* end = buffer_ + buffered_;
+        for (; p + 8 <= end; p += 8) h = rotl64(h ^ xxh64_round(0, read64(p)), 27) * kPrime64_1 + kPrime64_4;
+        if (p + 4 <= end) {
+            h = rotl64(h ^ (read32(p) * kPrime64_1), 23) * kPrime64_2 + kPrime64_3;
+            p += 4;
+        }
+        for (; p < end; ++p) h = rotl64(h ^ (*p * kPrime64_5), 11) * kPrime64_1;
+        return xxh64_avalanche(h);
+    }
+
+    // CRC32C and the zlib CRC-32, slice-by-8: eight table lookups retire
+    // eight input bytes per step
+
+    namespace {
+        struct Crc32Tables {
+            uint32_t table[8][256];
+            explicit Crc32Tables(uint32_t polynomial) {
+                for (uint32_t i = 0; i < 256; ++i) {
+                    uint32_t crc = i;
+                    for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (polynomial & (0U - (crc & 1)));
+                    table[0][i] = crc;
+                }
+                for (uint32_t i = 0; i < 256; ++i) {
+                    for (int k = 1; k < 8; ++k) table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+                }
+            }
+        };
+    }
+
+    static const Crc32Tables kCrc32c(0x82F63B78U);
+    static const Crc32Tables kCrc32(0xEDB88320U);
+
+    static uint32_t crc32_slice8(const Crc32Tables& tables, uint32_t crc, const uint8_t* data, size_t len) {
+        const uint32_t (*t)[256] = tables.table;
+        crc = ~crc;
+        for (; len >= 8; data += 8, len -= 8) {
+            uint32_t lo = read32(data) ^ crc;
+            uint32_t hi = read32(data + 4);
+            crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+                  t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+        }
+        while (len--) crc = t[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    uint32_t crc32c(uint32_t crc, const uint8_t* data, size_t len) {
+        return crc32_slice8(kCrc32c, crc, data, len);
+    }
+
+    uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len) {
+        return crc32_slice8(kCrc32, crc, data, len);
+    }
+
+    bool Hasher::parse(const std::string& name, Algorithm& algorithm) {
+        if (name == "sha256") {
+            algorithm = kSha256;
+        } else if (name == "blake3") {
+            algorithm = kBlake3;
+        } else if (name == "xxh3") {
+            algorithm = kXxh3;
+        } else if (name == "crc32c") {
+            algorithm = kCrc32c;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    void Hasher::update(const uint8_t* data, size_t len) {
+        if (len == 0) return;
+        switch (algorithm_) {
+            case kSha256: sha256_.update(data, len); break;
+            case kBlake3: blake3_.update(data, len); break;
+            case kXxh3: xxh3_.update(data, len); break;
+            case kCrc32c: crc_ = crc32c(crc_, data, len); break;
+        }
+    }
+
+    std::string Hasher::hex_digest() {
+        uint8_t digest[32];
+        size_t size = 0;
+        switch (algorithm_) {
+            case kSha256: sha256_.finish(digest); size = Sha256::kDigestSize; break;
+            case kBlake3: blake3_.finish(digest); size = Blake3::kDigestSize; break;
+            case kXxh3: xxh3_.finish(digest); size = Xxh3::kDigestSize; break;
+            case kCrc32c:
+                for (int i = 0; i < 4; ++i) digest[i] = static_cast<uint8_t>(crc_ >> (24 - 8 * i));
+                size = 4;
+                break;
+        }
+
+        std::string hex(size * 2, '\0');
+        hex_encode(digest, size, &hex[0]);
+        return hex;
+    }
+}
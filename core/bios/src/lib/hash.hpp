@@ -0,0 +1,135 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace lib {
+    // Streaming digests. Each hasher takes update() calls of any size and
+    // writes its digest in canonical byte order from finish(); digests are
+    // printed as lowercase hex, matching sha256sum, b3sum and xxhsum.
+
+    class Sha256 {
+    public:
+        static const size_t kDigestSize = 32;
+
+        Sha256();
+        void update(const uint8_t* data, size_t len);
+        void finish(uint8_t* out);
+
+    private:
+        uint32_t state_[8];
+        uint8_t block_[64];
+        size_t buffered_ = 0;
+        uint64_t total_ = 0;
+    };
+
+    // BLAKE3 in its default 256-bit hash mode. Whole subtrees of chunks are
+    // hashed four at a time across SIMD lanes (and across worker threads in
+    // pthread builds); only the partial chunk at the end of each update()
+    // goes through the one-block-at-a-time path.
+    class Blake3 {
+    public:
+        static const size_t kDigestSize = 32;
+
+        Blake3();
+        void update(const uint8_t* data, size_t len);
+        void finish(uint8_t* out);
+
+    private:
+        // The chunk currently being filled
+        uint32_t chunk_cv_[8];
+        uint64_t chunk_counter_ = 0;
+        uint8_t block_[64];
+        size_t block_len_ = 0;
+        size_t blocks_compressed_ = 0;
+
+        // Chaining values of completed subtrees, merged lazily so the last
+        // one can still become the root
+        uint32_t cv_stack_[54][8];
+        size_t stack_len_ = 0;
+
+        void push_cv(const uint32_t cv[8], uint64_t chunk_counter);
+        void merge_cv_stack(uint64_t total_chunks);
+        void update_chunk(const uint8_t* data, size_t len);
+    };
+
+    // XXH3, 64-bit variant with the default secret and seed 0
+    class Xxh3 {
+    public:
+        static const size_t kDigestSize = 8;
+
+        Xxh3();
+        void update(const uint8_t* data, size_t len);
+        void finish(uint8_t* out);
+        uint64_t digest() const;
+
+    private:
+        uint64_t acc_[8];
+        uint8_t buffer_[256];
+        size_t buffered_ = 0;
+        size_t stripes_ = 0;       // Stripes consumed in the current block
+        uint64_t total_ = 0;
+    };
+
+    // XXH32 and XXH64 with a seed: the checksums of the LZ4 and Zstandard
+    // frame formats
+    class Xxh32 {
+    public:
+        explicit Xxh32(uint32_t seed = 0);
+        void update(const uint8_t* data, size_t len);
+        uint32_t digest() const;
+
+    private:
+        uint32_t seed_;
+        uint32_t v_[4];
+        uint8_t buffer_[16];
+        size_t buffered_ = 0;
+        uint64_t total_ = 0;
+    };
+
+    class Xxh64 {
+    public:
+        explicit Xxh64(uint64_t seed = 0);
+        void update(const uint8_t* data, size_t len);
+        uint64_t digest() const;
+
+    private:
+        uint64_t seed_;
+        uint64_t v_[4];
+        uint8_t buffer_[32];
+        size_t buffered_ = 0;
+        uint64_t total_ = 0;
+    };
+
+    // One-shot XXH3-64 of a buffer
+    uint64_t xxh3_64(const uint8_t* data, size_t len);
+
+    // Extend a CRC32C (Castagnoli) over `len` bytes; start from crc = 0
+    uint32_t crc32c(uint32_t crc, const uint8_t* data, size_t len);
+
+    // Extend the CRC-32 of gzip and zip (zlib's crc32) over `len` bytes;
+    // start from crc = 0
+    uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len);
+
+    // Any of the above, chosen by name at runtime
+    class Hasher {
+    public:
+        enum Algorithm { kSha256, kBlake3, kXxh3, kCrc32c };
+
+        explicit Hasher(Algorithm algorithm) : algorithm_(algorithm) {}
+
+        // Parse "sha256", "blake3", "xxh3" or "crc32c"; false if unknown
+        static bool parse(const std::string& name, Algorithm& algorithm);
+
+        void update(const uint8_t* data, size_t len);
+        // Finish and return the digest as lowercase hex
+        std::string hex_digest();
+
+    private:
+        Algorithm algorithm_;
+        Sha256 sha256_;
+        Blake3 blake3_;
+        Xxh3 xxh3_;
+        uint32_t crc_ = 0;
+    };
+}
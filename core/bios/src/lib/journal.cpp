@@ -0,0 +1,264 @@
+#include "journal.hpp"
+#include "block_file.hpp"
+#include "file_events.hpp"
+#include "file_io.hpp"
+#include "hash.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace lib {
+    static const size_t kRecordHeader = 8;      // CRC-32C and length ahead of each record
+    static const uint8_t kWrite = 1;
+    static const uint8_t kDelete = 2;
+    static const uint8_t kCommit = 3;
+
+    // Append a record with `body` following its type byte
+    static void add_record(std::string& log, uint8_t type, const std::string& body) {
+        size_t start = log.size();
+        log.append(kRecordHeader, '\0');
+        log += static_cast<char>(type);
+        log += body;
+        uint32_t len = static_cast<uint32_t>(log.size() - start - kRecordHeader);
+        for (int i = 0; i < 4; ++i) log[start + 4 + i] = static_cast<char>(len >> (8 * i));
+        uint32_t crc = crc32c(0, reinterpret_cast<const uint8_t*>(log.data()) + start + 4, len + 4);
+        for (int i = 0; i < 4; ++i) log[start + i] = static_cast<char>(crc >> (8 * i));
+    }
+
+    static bool apply(const std::string& path, bool removed, const std::string& content, std::string& error) {
+        if (removed) {
+            // Already gone when a replayed batch deletes it again
+            if (::remove(path.c_str()) != 0 && errno != ENOENT) {
+                error = path + ": cannot delete";
+                return false;
+            }
+            file_removed(path);
+            return true;
+        }
+        if (!store_file(path, content.data(), content.size(), error)) return false;
+        file_changed(path);
+        return true;
+    }
+
+    // fsync `path`, file or directory; one that no longer exists has
+    // nothing to lose
+    static bool sync_path(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return errno == ENOENT;
+        bool ok = fsync(fd) == 0;
+        close(fd);
+        return ok;
+    }
+
+    Journal::~Journal() {
+        if (fd_ >= 0) close(fd_);
+    }
+
+    // mkdir -p for the directories above the log
+    static void make_parent_directories(const std::string& path) {
+        for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+            mkdir(path.substr(0, slash).c_str(), 0755);
+        }
+    }
+
+    bool Journal::open(const std::string& path, std::string& error) {
+        path_ = path;
+        make_parent_directories(path);
+        replay();
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd_ < 0) {
+            error = path + ": cannot open";
+            return false;
+        }
+        return checkpoint(error);
+    }
+
+    // Batches are applied whole once their commit record is read. A change
+    // that cannot be applied (its directory has since gone) is passed over,
+    // since it would fail the same way on every replay.
+    void Journal::replay() {
+        std::ifstream in(path_, std::ios::binary);
+        if (!in.is_open()) return;
+        std::string log((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(log.data());
+        const uint8_t* end = p + log.size();
+
+        struct Logged {
+            std::string path;
+            bool removed;
+            std::string content;
+        };
+        std::vector<Logged> batch;
+        while (static_cast<size_t>(end - p) >= kRecordHeader) {
+            uint32_t crc = read32(p);
+            uint32_t len = read32(p + 4);
+            if (len == 0 || len > static_cast<size_t>(end - p) - kRecordHeader || crc32c(0, p + 4, len + 4) != crc) break;
+            const uint8_t* body = p + kRecordHeader + 1;
+            size_t size = len - 1;
+            uint8_t type = p[kRecordHeader];
+            p += kRecordHeader + len;
+
+            if (type == kCommit) {
+                if (size != 4 || read32(body) != batch.size()) break;
+                std::string skipped;
+                for (const Logged& change : batch) {
+                    apply(change.path, change.removed, change.content, skipped);
+                    applied_.insert(change.path);
+                }
+                batch.clear();
+                continue;
+            }
+            uint32_t path_len = size >= 4 ? read32(body) : 0;
+            if ((type != kWrite && type != kDelete) || size < 4 || path_len > size - 4) break;
+            const char* text = reinterpret_cast<const char*>(body);
+            batch.push_back({std::string(text + 4, path_len), type == kDelete, std::string(text + 4 + path_len, size - 4 - path_len)});
+        }
+    }
+
+    void Journal::queue(const std::string& name, bool removed, const char* data, size_t len) {
+        const std::string path = absolute_path(name);
+        auto it = pending_.find(path);
+        if (it != pending_.end()) {
+            pending_bytes_ -= it->second.content.size();
+            ++coalesced_;
+        }
+        Change& change = pending_[path];
+        change.removed = removed;
+        change.content.assign(data, len);
+        pending_bytes_ += len;
+        ++writes_;
+    }
+
+    void Journal::write(const std::string& path, const char* data, size_t len) {
+        queue(path, false, data, len);
+    }
+
+    void Journal::remove(const std::string& path) {
+        queue(path, true, nullptr, 0);
+    }
+
+    bool Journal::queued(const std::string& path, const std::string*& content) const {
+        auto it = pending_.find(absolute_path(path));
+        if (it == pending_.end()) return false;
+        content = it->second.removed ? nullptr : &it->second.content;
+        return true;
+    }
+
+    bool Journal::commit(std::string& error) {
+        if (pending_.empty()) return true;
+
+        std::string log;
+        log.reserve(pending_bytes_ + pending_.size() * 64);
+        for (const auto& entry : pending_) {
+            std::string body;
+            put32(body, static_cast<uint32_t>(entry.first.size()));
+            body += entry.first;
+            body += entry.second.content;
+            add_record(log, entry.second.removed ? kDelete : kWrite, body);
+        }
+        std::string count;
+        put32(count, static_cast<uint32_t>(pending_.size()));
+        add_record(log, kCommit, count);
+
+        // One write and one sync for the whole batch. On failure the
+        // partial batch is cut off and the changes stay queued.
+        if (!write_all(fd_, log.data(), log.size()) || fsync(fd_) != 0) {
+            error = path_ + ": write error";
+            if (ftruncate(fd_, static_cast<off_t>(log_bytes_)) != 0) error += ", and cannot cut off the partial batch";
+            return false;
+        }
+        log_bytes_ += log.size();
+        ++commits_;
+
+        std::map<std::string, Change> batch;
+        batch.swap(pending_);
+        pending_bytes_ = 0;
+        bool ok = true;
+        for (const auto& entry : batch) {
+            std::string failed;
+            if (!apply(entry.first, entry.second.removed, entry.second.content, failed) && ok) {
+                error = failed;
+                ok = false;
+            }
+            applied_.insert(entry.first);
+        }
+        if (log_bytes_ > kCheckpointBytes) {
+            std::string failed;
+            if (!checkpoint(failed) && ok) {
+                error = failed;
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    bool Journal::checkpoint(std::string& error) {
+        // The applied files must be on disk before the log that could
+        // replay them is gone: each file's content, then the directories
+        // holding the entries that were made or removed
+        std::set<std::string> directories;
+        for (const std::string& path : applied_) {
+            if (!sync_path(path)) {
+                error = path + ": cannot sync";
+                return false;
+            }
+            directories.insert(path.substr(0, path.rfind('/') == 0 ? 1 : path.rfind('/')));
+        }
+        for (const std::string& dir : directories) {
+            if (!sync_path(dir)) {
+                error = dir + ": cannot sync";
+                return false;
+            }
+        }
+        applied_.clear();
+
+        if (ftruncate(fd_, 0) != 0 || fsync(fd_) != 0) {
+            error = path_ + ": cannot truncate";
+            return false;
+        }
+        log_bytes_ = 0;
+        return true;
+    }
+
+    Journal::Stats Journal::stats() const {
+        return {pending_.size(), pending_bytes_, writes_, coalesced_, commits_, log_bytes_};
+    }
+
+    static Journal* current = nullptr;
+
+    Journal* journal() {
+        return current;
+    }
+
+    bool journal_enable(std::string& error) {
+        if (current) return true;
+        Journal* opened = new Journal();
+        if (!opened->open(Journal::kPath, error)) {
+            delete opened;
+            return false;
+        }
+        current = opened;
+        return true;
+    }
+
+    bool journal_disable(std::string& error) {
+        if (!current) return true;
+        // Stay on if the queue could not even be logged
+        bool ok = current->commit(error);
+        if (current->stats().pending) return false;
+        delete current;
+        current = nullptr;
+        return ok;
+    }
+
+    bool journal_recover(std::string& error) {
+        struct stat st;
+        if (current || stat(Journal::kPath, &st) != 0) return true;
+        Journal replayed;
+        return replayed.open(Journal::kPath, error);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+
+namespace lib {
+    // Crash-consistent file writes. While the journal is on, writes and
+    // deletes are queued rather than applied; a later write to a queued
+    // path replaces the queued change. Paths are made absolute and
+    // normalized first, so every spelling of a file shares one entry.
+    // commit() appends the whole queue to kPath as checksummed records
+    // closed by a commit record, syncs the log once, and only then applies
+    // the changes to the files. After a crash, open() re-applies every
+    // batch whose commit record made it to the log and cuts off the torn
+    // rest, so a file ends up with either its old content or its new
+    // content, never part of a write.
+    //
+    //   record: u32 CRC-32C of the rest, u32 length, u8 type, then for a
+    //   write or delete a u32 path length, the path and the content; for a
+    //   commit the u32 number of changes in the batch
+    //
+    // Applied batches stay in the log until checkpoint() empties it, which
+    // commit() does itself once the log passes kCheckpointBytes. The files
+    // they changed, and their directories, are synced first, so that the
+    // log is only dropped once its batches are durable without it.
+    class Journal {
+    public:
+        static constexpr const char* kPath = "/.bios/journal.log";
+        static const size_t kCheckpointBytes = 16 * 1024 * 1024;
+
+        struct Stats {
+            size_t pending;             // Queued changes
+            size_t pending_bytes;
+            uint64_t writes;            // Changes queued since open()
+            uint64_t coalesced;         // Of those, ones replaced before their commit
+            uint64_t commits;
+            uint64_t log_bytes;
+        };
+
+        Journal() = default;
+        ~Journal();
+
+        Journal(const Journal&) = delete;
+        Journal& operator=(const Journal&) = delete;
+
+        // Replay the log at `path`, creating it if it does not exist, and
+        // empty it
+        bool open(const std::string& path, std::string& error);
+
+        void write(const std::string& path, const char* data, size_t len);
+        void remove(const std::string& path);
+
+        // Whether `path` has a queued change; `content` is null for a queued
+        // delete
+        bool queued(const std::string& path, const std::string*& content) const;
+
+        // Log, sync and apply the queued changes. False if the log cannot
+        // be written (nothing is applied) or a change cannot be applied
+        // (the rest still are).
+        bool commit(std::string& error);
+
+        // Sync the files applied since the last checkpoint, then empty the
+        // log; every logged batch has already been applied. The log is kept
+        // if a file cannot be synced.
+        bool checkpoint(std::string& error);
+
+        Stats stats() const;
+
+    private:
+        struct Change {
+            bool removed;
+            std::string content;
+        };
+
+        std::string path_;
+        int fd_ = -1;
+        std::map<std::string, Change> pending_;
+        size_t pending_bytes_ = 0;
+        uint64_t writes_ = 0;
+        uint64_t coalesced_ = 0;
+        uint64_t commits_ = 0;
+        uint64_t log_bytes_ = 0;
+        std::set<std::string> applied_;     // Paths changed since the last checkpoint
+
+        void queue(const std::string& name, bool removed, const char* data, size_t len);
+        void replay();
+    };
+
+    // The journal, or nullptr when writes go straight to their files
+    Journal* journal();
+
+    // Turn the journal on, replaying kPath first. Turning it off commits
+    // whatever is queued.
+    bool journal_enable(std::string& error);
+    bool journal_disable(std::string& error);
+
+    // Apply the batches left in kPath by an earlier run, without turning
+    // the journal on
+    bool journal_recover(std::string& error);
+}
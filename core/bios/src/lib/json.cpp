@@ -0,0 +1,403 @@
+#include "json.hpp"
+#include <cstring>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+namespace lib {
+    namespace {
+        // Per-64-byte-block character class bitmasks
+        struct BlockMasks {
+            uint64_t backslash;
+            uint64_t quote;
+            uint64_t op;            // { } [ ] : ,
+            uint64_t whitespace;
+        };
+
+#ifdef __wasm_simd128__
+        inline uint64_t eq_mask(const v128_t blocks[4], v128_t c) {
+            return static_cast<uint64_t>(wasm_i8x16_bitmask(wasm_i8x16_eq(blocks[0], c))) |
+                   static_cast<uint64_t>(wasm_i8x16_bitmask(wasm_i8x16_eq(blocks[1], c))) << 16 |
+                   static_cast<uint64_t>(wasm_i8x16_bitmask(wasm_i8x16_eq(blocks[2], c))) << 32 |
+                   static_cast<uint64_t>(wasm_i8x16_bitmask(wasm_i8x16_eq(blocks[3], c))) << 48;
+        }
+
+        // Classify by nibble lookup: each byte's low and high nibbles select
+        // bit sets from two tables, and a byte is in a class when both agree
+        inline BlockMasks classify(const char* block) {
+            v128_t blocks[4];
+            for (int i = 0; i < 4; ++i) blocks[i] = wasm_v128_load(block + 16 * i);
+
+            // Bit 0: { } [ ]  bit 1: :  bit 3: ,  bit 2: \t \n \r  bit 4: space.
+            // Each class gets its own bit so no other byte can match both tables.
+            const v128_t low_table = wasm_i8x16_make(16, 0, 0, 0, 0, 0, 0, 0, 0, 4, 6, 1, 8, 5, 0, 0);
+            const v128_t high_table = wasm_i8x16_make(4, 0, 24, 2, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+            const v128_t low_nibble = wasm_i8x16_splat(0x0f);
+            const v128_t op_bits = wasm_i8x16_splat(1 | 2 | 8);
+            const v128_t whitespace_bits = wasm_i8x16_splat(4 | 16);
+            const v128_t zero = wasm_i8x16_splat(0);
+
+            uint64_t op = 0, whitespace = 0;
+            for (int i = 0; i < 4; ++i) {
+                v128_t lo = wasm_i8x16_swizzle(low_table, wasm_v128_and(blocks[i], low_nibble));
+                v128_t hi = wasm_i8x16_swizzle(high_table, wasm_u8x16_shr(blocks[i], 4));
+                v128_t classes = wasm_v128_and(lo, hi);
+                uint64_t not_op = wasm_i8x16_bitmask(wasm_i8x16_eq(wasm_v128_and(classes, op_bits), zero));
+                uint64_t not_whitespace = wasm_i8x16_bitmask(wasm_i8x16_eq(wasm_v128_and(classes, whitespace_bits), zero));
+                op |= (not_op ^ 0xffff) << (16 * i);
+                whitespace |= (not_whitespace ^ 0xffff) << (16 * i);
+            }
+
+            return {eq_mask(blocks, wasm_i8x16_splat('\\')), eq_mask(blocks, wasm_i8x16_splat('"')), op, whitespace};
+        }
+#else
+        inline BlockMasks classify(const char* block) {
+            BlockMasks masks = {0, 0, 0, 0};
+            for (int i = 0; i < 64; ++i) {
+                uint64_t bit = uint64_t(1) << i;
+                switch (block[i]) {
+                    case '\\': masks.backslash |= bit; break;
+                    case '"': masks.quote |= bit; break;
+                    case '{': case '}': case '[': case ']': case ':': case ',': masks.op |= bit; break;
+                    case ' ': case '\t': case '\n': case '\r': masks.whitespace |= bit; break;
+                    default: break;
+                }
+            }
+            return masks;
+        }
+#endif
+
+        // Prefix XOR: bit i of the result is the parity of bits 0..i
+        inline uint64_t prefix_xor(uint64_t bits) {
+            bits ^= bits << 1;
+            bits ^= bits << 2;
+            bits ^= bits << 4;
+            bits ^= bits << 8;
+            bits ^= bits << 16;
+            bits ^= bits << 32;
+            return bits;
+        }
+    }
+
+    bool JsonDocument::index(const char* data, size_t len, std::string& error) {
+        data_ = data;
+        len_ = len;
+        positions_.clear();
+        if (len > UINT32_MAX) {
+            error = "document too large";
+            return false;
+        }
+        positions_.reserve(len / 8 + 16);
+
+        uint64_t prev_escaped = 0;     // First byte of the next block is escaped
+        uint64_t prev_in_string = 0;   // All ones while inside a string across blocks
+        uint64_t prev_scalar = 0;      // Last byte of the previous block was a scalar
+
+        char padded[64];
+        for (size_t base = 0; base < len; base += 64) {
+            const char* block = data + base;
+            if (len - base < 64) {
+                memset(padded, ' ', sizeof(padded));
+                memcpy(padded, block, len - base);
+                block = padded;
+            }
+
+            BlockMasks masks = classify(block);
+
+            // Find escaped bytes: a backslash run starting on an even bit
+            // escapes the byte after it when its length is odd (simdjson's
+            // carry trick), with the state carried between blocks
+            const uint64_t even_bits = 0x5555555555555555ull;
+            uint64_t backslash = masks.backslash & ~prev_escaped;
+            uint64_t follows_escape = backslash << 1 | prev_escaped;
+            uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+            uint64_t sequences_on_even = odd_starts + backslash;
+            prev_escaped = sequences_on_even < backslash ? 1 : 0;
+            uint64_t escaped = (even_bits ^ (sequences_on_even << 1)) & follows_escape;
+
+            uint64_t quote = masks.quote & ~escaped;
+            uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+            prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+            uint64_t op = masks.op & ~in_string;
+            uint64_t scalar = ~(masks.op | masks.whitespace | quote | in_string);
+            uint64_t scalar_starts = scalar & ~(scalar << 1 | prev_scalar);
+            prev_scalar = scalar >> 63;
+
+            uint64_t structural = op | (quote & in_string) | scalar_starts;
+            if (len - base < 64) structural &= (uint64_t(1) << (len - base)) - 1;
+
+            while (structural) {
+                positions_.push_back(static_cast<uint32_t>(base + __builtin_ctzll(structural)));
+                structural &= structural - 1;
+            }
+        }
+
+        if (prev_in_string) {
+            error = "unterminated string";
+            return false;
+        }
+        if (positions_.empty()) {
+            error = "empty document";
+            return false;
+        }
+        return true;
+    }
+
+    // Advance `i` from the start of a value to the entry just past it
+    bool JsonDocument::skip(size_t& i) const {
+        char c = at(i);
+        if (c != '{' && c != '[') {
+            ++i;
+            return true;
+        }
+
+        size_t depth = 0;
+        for (; i < positions_.size(); ++i) {
+            char d = at(i);
+            if (d == '{' || d == '[') {
+                ++depth;
+            } else if (d == '}' || d == ']') {
+                if (--depth == 0) {
+                    ++i;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    std::string_view JsonDocument::text(size_t i) const {
+        size_t start = positions_[i];
+        char c = data_[start];
+
+        if (c == '"') {
+            size_t end = start + 1;
+            while (end < len_ && data_[end] != '"') end += data_[end] == '\\' ? 2 : 1;
+            return std::string_view(data_ + start, (end < len_ ? end + 1 : len_) - start);
+        }
+        if (c == '{' || c == '[') {
+            size_t next = i;
+            if (!skip(next)) return std::string_view(data_ + start, len_ - start);
+            return std::string_view(data_ + start, positions_[next - 1] + 1 - start);
+        }
+
+        size_t end = start;
+        while (end < len_ && !strchr(" \t\r\n,:]}", data_[end])) ++end;
+        return std::string_view(data_ + start, end - start);
+    }
+
+    bool JsonDocument::key_equals(size_t i, std::string_view key) const {
+        std::string_view raw = text(i);
+        if (raw.size() < 2) return false;
+        std::string_view body = raw.substr(1, raw.size() - 2);
+        if (body.find('\\') == std::string_view::npos) return body == key;
+
+        std::string decoded;
+        return json_unescape(body, decoded) && decoded == key;
+    }
+
+    void JsonDocument::walk(size_t i, const std::vector<Step>& steps, size_t step,
+                            std::vector<std::string_view>& results, bool& ok) const {
+        if (!ok) return;
+        if (step == steps.size()) {
+            results.push_back(text(i));
+            return;
+        }
+
+        const Step& current = steps[step];
+        char c = at(i);
+
+        if (current.type == Step::kKey) {
+            if (c != '{') return;
+            size_t k = i + 1;
+            while (k < positions_.size() && at(k) != '}') {
+                // key : value [,]
+                if (at(k) != '"' || k + 2 >= positions_.size() || at(k + 1) != ':') {
+                    ok = false;
+                    return;
+                }
+                size_t value = k + 2;
+                if (key_equals(k, current.key)) {
+                    walk(value, steps, step + 1, results, ok);
+                    return;
+                }
+                k = value;
+                if (!skip(k) || k >= positions_.size()) {
+                    ok = false;
+                    return;
+                }
+                if (at(k) == ',') ++k;
+            }
+            return;
+        }
+
+        if (c != '[') return;
+        size_t k = i + 1;
+        size_t n = 0;
+        while (k < positions_.size() && at(k) != ']') {
+            if (current.type == Step::kEach) {
+                walk(k, steps, step + 1, results, ok);
+            } else if (n == current.index) {
+                walk(k, steps, step + 1, results, ok);
+                return;
+            }
+            if (!skip(k) || k >= positions_.size()) {
+                ok = false;
+                return;
+            }
+            if (at(k) == ',') ++k;
+            ++n;
+        }
+    }
+
+    // Read the JSON string starting at the quote at `expr[quote]` into
+    // `key`, decoded, and set `end` just past its closing quote. A quote
+    // or bracket escaped inside it does not end it.
+    static bool quoted_key(std::string_view expr, size_t quote, std::string& key, size_t& end, std::string& error) {
+        size_t close = quote + 1;
+        while (close < expr.size() && expr[close] != '"') close += expr[close] == '\\' ? 2 : 1;
+        if (close >= expr.size()) {
+            error = "unterminated key";
+            return false;
+        }
+        if (!json_unescape(expr.substr(quote + 1, close - quote - 1), key)) {
+            error = "invalid escape in key";
+            return false;
+        }
+        end = close + 1;
+        return true;
+    }
+
+    bool JsonDocument::query(std::string_view expr, std::vector<std::string_view>& results, std::string& error) const {
+        std::vector<Step> steps;
+        size_t pos = 0;
+        while (pos < expr.size()) {
+            char c = expr[pos];
+            if (c == '.' && (pos + 1 == expr.size() || expr[pos + 1] == '[')) {
+                ++pos;
+            } else if (c == '.' && expr[pos + 1] == '"') {
+                Step key = {Step::kKey, ""};
+                if (!quoted_key(expr, pos + 1, key.key, pos, error)) return false;
+                steps.push_back(std::move(key));
+            } else if (c == '.') {
+                size_t end = pos + 1;
+                while (end < expr.size() && expr[end] != '.' && expr[end] != '[') ++end;
+                steps.push_back({Step::kKey, std::string(expr.substr(pos + 1, end - pos - 1))});
+                pos = end;
+            } else if (c == '[' && pos + 1 < expr.size() && expr[pos + 1] == '"') {
+                Step key = {Step::kKey, ""};
+                if (!quoted_key(expr, pos + 1, key.key, pos, error)) return false;
+                if (pos >= expr.size() || expr[pos] != ']') {
+                    error = "unterminated [";
+                    return false;
+                }
+                steps.push_back(std::move(key));
+                ++pos;
+            } else if (c == '[') {
+                size_t end = expr.find(']', pos);
+                if (end == std::string_view::npos) {
+                    error = "unterminated [";
+                    return false;
+                }
+                std::string_view inside = expr.substr(pos + 1, end - pos - 1);
+                if (inside.empty()) {
+                    steps.push_back({Step::kEach, ""});
+                } else {
+                    Step index = {Step::kIndex, ""};
+                    for (char d : inside) {
+                        if (d < '0' || d > '9') {
+                            error = "invalid index";
+                            return false;
+                        }
+                        index.index = index.index * 10 + (d - '0');
+                    }
+                    steps.push_back(index);
+                }
+                pos = end + 1;
+            } else {
+                error = "path must start with .";
+                return false;
+            }
+        }
+
+        bool ok = true;
+        walk(0, steps, 0, results, ok);
+        if (!ok) error = "malformed document";
+        return ok;
+    }
+
+    static void append_utf8(std::string& out, uint32_t cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xc0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xe0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        } else {
+            out += static_cast<char>(0xf0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+    }
+
+    static bool parse_hex4(std::string_view body, size_t pos, uint32_t& value) {
+        if (pos + 4 > body.size()) return false;
+        value = 0;
+        for (size_t i = pos; i < pos + 4; ++i) {
+            char c = body[i];
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= c - '0';
+            else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    bool json_unescape(std::string_view body, std::string& out) {
+        out.clear();
+        out.reserve(body.size());
+        for (size_t i = 0; i < body.size(); ++i) {
+            char c = body[i];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (++i >= body.size()) return false;
+            switch (body[i]) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t cp;
+                    if (!parse_hex4(body, i + 1, cp)) return false;
+                    i += 4;
+                    // Combine a surrogate pair
+                    if (cp >= 0xd800 && cp < 0xdc00 && i + 2 < body.size() && body[i + 1] == '\\' && body[i + 2] == 'u') {
+                        uint32_t low;
+                        if (parse_hex4(body, i + 3, low) && low >= 0xdc00 && low < 0xe000) {
+                            cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                            i += 6;
+                        }
+                    }
+                    append_utf8(out, cp);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lib {
+    // Two-stage JSON reader. index() makes one pass over the input and
+    // records the offsets of structural characters, string starts and the
+    // first byte of every other scalar; query() then walks those offsets to
+    // the requested values without building a DOM or decoding anything it
+    // skips. Like other on-demand parsers, only the parts of the document
+    // that a query touches are checked for well-formedness.
+    class JsonDocument {
+    public:
+        // Build the structural index; the input must outlive the document
+        bool index(const char* data, size_t len, std::string& error);
+
+        // Evaluate a path such as `.items[3].name`, `.["a key"]` or `.list[]`
+        // and append the raw JSON text of every matching value to `results`.
+        // Quoted keys are JSON strings, so `.["a\"]b"]` names the key a"]b.
+        bool query(std::string_view expr, std::vector<std::string_view>& results, std::string& error) const;
+
+        size_t structurals() const { return positions_.size(); }
+
+    private:
+        struct Step {
+            enum Type { kKey, kIndex, kEach } type;
+            std::string key;
+            size_t index = 0;
+        };
+
+        const char* data_ = nullptr;
+        size_t len_ = 0;
+        std::vector<uint32_t> positions_;
+
+        char at(size_t i) const { return data_[positions_[i]]; }
+        bool skip(size_t& i) const;
+        std::string_view text(size_t i) const;
+        bool key_equals(size_t i, std::string_view key) const;
+        void walk(size_t i, const std::vector<Step>& steps, size_t step, std::vector<std::string_view>& results, bool& ok) const;
+    };
+
+    // Decode the body of a JSON string (without quotes) to UTF-8
+    bool json_unescape(std::string_view body, std::string& out);
+}
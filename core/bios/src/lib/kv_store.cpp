@@ -0,0 +1,786 @@
+#include "kv_store.hpp"
+#include "file_io.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lib {
+    static const char kManifestMagic[4] = {'K', 'V', 'M', 'F'};
+    static const uint32_t kTableMagic = 0x5453564b;     // "KVST"
+    static const uint32_t kVersion = 1;
+    static const size_t kBlockTarget = 4096;            // Data block size before the next key starts a new one
+    static const size_t kFooterSize = 44;
+    static const size_t kBloomBitsPerKey = 10;
+    static const int kBloomProbes = 7;
+    static const int kMaxHeight = 12;
+    static const size_t kRecordHeader = 8;              // CRC-32C and length ahead of each log record
+    static const uint8_t kPut = 1;
+    static const uint8_t kDelete = 2;
+
+    static void put_varint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>(value | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    // Bounds-checked, since tables and logs come from the FS
+    static bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; p < end && shift < 64; shift += 7) {
+            uint8_t byte = *p++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (byte < 0x80) return true;
+        }
+        return false;
+    }
+
+    static bool get_string(const uint8_t*& p, const uint8_t* end, std::string& out) {
+        uint64_t len;
+        if (!get_varint(p, end, len) || len > static_cast<uint64_t>(end - p)) return false;
+        out.assign(reinterpret_cast<const char*>(p), static_cast<size_t>(len));
+        p += len;
+        return true;
+    }
+
+    static bool read_at(int fd, uint64_t offset, uint8_t* data, size_t len) {
+        while (len > 0) {
+            ssize_t got = pread(fd, data, len, static_cast<off_t>(offset));
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+            data += got;
+            len -= got;
+            offset += got;
+        }
+        return true;
+    }
+
+    static inline uint64_t key_hash(const std::string& key) {
+        return xxh3_64(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+    }
+
+    // Entry as it sits in a table block or comes out of a cursor
+    namespace {
+        struct KvEntry {
+            std::string key;
+            std::string value;
+            bool deleted = false;
+        };
+    }
+
+    // Skiplist ordered by key; each key appears once, holding its latest
+    // value or a deletion marker
+    struct KvStore::Memtable {
+        struct Node {
+            std::string key;
+            std::string value;
+            bool deleted;
+            std::vector<Node*> next;
+        };
+
+        Node head;
+        int height = 1;
+        size_t entries = 0;
+        size_t bytes = 0;
+        uint32_t seed = 0x2545f491;
+
+        Memtable() { head.next.assign(kMaxHeight, nullptr); }
+
+        ~Memtable() {
+            Node* node = head.next[0];
+            while (node) {
+                Node* next = node->next[0];
+                delete node;
+                node = next;
+            }
+        }
+
+        // Each level up holds a quarter of the nodes of the one below
+        int random_height() {
+            int level = 1;
+            while (level < kMaxHeight) {
+                seed ^= seed << 13;
+                seed ^= seed >> 17;
+                seed ^= seed << 5;
+                if (seed & 3) break;
+                ++level;
+            }
+            return level;
+        }
+
+        // First node with key >= `key`; fills `prev` with the last node
+        // before it on each level when given
+        Node* seek(const std::string& key, Node** prev) {
+            Node* node = &head;
+            for (int level = kMaxHeight - 1; level >= 0; --level) {
+                while (node->next[level] && node->next[level]->key < key) node = node->next[level];
+                if (prev) prev[level] = node;
+            }
+            return node->next[0];
+        }
+
+        void set(const std::string& key, const std::string& value, bool deleted) {
+            Node* prev[kMaxHeight];
+            Node* found = seek(key, prev);
+            if (found && found->key == key) {
+                bytes = bytes - found->value.size() + value.size();
+                found->value = value;
+                found->deleted = deleted;
+                return;
+            }
+            int level = random_height();
+            if (level > height) height = level;
+            Node* node = new Node{key, value, deleted, std::vector<Node*>(level)};
+            for (int i = 0; i < level; ++i) {
+                node->next[i] = prev[i]->next[i];
+                prev[i]->next[i] = node;
+            }
+            ++entries;
+            bytes += key.size() + value.size() + sizeof(Node) + level * sizeof(Node*);
+        }
+    };
+
+    // An immutable sorted table; its index and filter stay in memory and
+    // blocks are read on demand
+    struct KvStore::Table {
+        struct Block {
+            std::string last_key;
+            uint64_t offset;
+            uint32_t size;          // Including the trailing CRC
+        };
+
+        uint32_t number = 0;
+        std::string path;
+        int fd = -1;
+        std::vector<Block> blocks;
+        std::vector<uint8_t> bloom;
+        uint64_t entries = 0;
+        uint64_t bytes = 0;
+
+        ~Table() {
+            if (fd >= 0) close(fd);
+        }
+
+        bool open(std::string& error) {
+            fd = ::open(path.c_str(), O_RDONLY);
+            struct stat st;
+            uint8_t footer[kFooterSize];
+            if (fd < 0 || fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < kFooterSize ||
+                !read_at(fd, st.st_size - kFooterSize, footer, sizeof(footer)) || read32(footer + 40) != kTableMagic) {
+                error = path + ": not a table";
+                return false;
+            }
+            bytes = static_cast<uint64_t>(st.st_size);
+            uint64_t index_offset = read64(footer);
+            uint64_t index_size = read64(footer + 8);
+            uint64_t bloom_offset = read64(footer + 16);
+            uint64_t bloom_size = read64(footer + 24);
+            entries = read64(footer + 32);
+            uint64_t limit = bytes - kFooterSize;
+            if (index_offset > limit || index_size > limit - index_offset || bloom_offset > limit || bloom_size > limit - bloom_offset) {
+                error = path + ": corrupt footer";
+                return false;
+            }
+
+            std::vector<uint8_t> index(static_cast<size_t>(index_size));
+            bloom.resize(static_cast<size_t>(bloom_size));
+            if (!read_at(fd, index_offset, index.data(), index.size()) || !read_at(fd, bloom_offset, bloom.data(), bloom.size())) {
+                error = path + ": cannot read index";
+                return false;
+            }
+            const uint8_t* p = index.data();
+            const uint8_t* end = p + index.size();
+            while (p < end) {
+                Block block;
+                uint64_t offset, size;
+                if (!get_string(p, end, block.last_key) || !get_varint(p, end, offset) || !get_varint(p, end, size) ||
+                    offset > index_offset || size > index_offset - offset || size < 4) {
+                    error = path + ": corrupt index";
+                    return false;
+                }
+                block.offset = offset;
+                block.size = static_cast<uint32_t>(size);
+                blocks.push_back(std::move(block));
+            }
+            return true;
+        }
+
+        bool may_contain(uint64_t hash) const {
+            if (bloom.empty()) return true;
+            uint64_t bits = bloom.size() * 8;
+            uint64_t delta = hash >> 33 | hash << 31;
+            for (int i = 0; i < kBloomProbes; ++i, hash += delta) {
+                uint64_t bit = hash % bits;
+                if (!(bloom[bit >> 3] & (1 << (bit & 7)))) return false;
+            }
+            return true;
+        }
+
+        // The block that would hold `key`: the first whose last key is >= it
+        size_t find_block(const std::string& key) const {
+            return std::lower_bound(blocks.begin(), blocks.end(), key,
+                                    [](const Block& block, const std::string& k) { return block.last_key < k; }) -
+                   blocks.begin();
+        }
+
+        bool read_block(size_t index, std::vector<KvEntry>& out, std::string& error) const {
+            const Block& block = blocks[index];
+            std::vector<uint8_t> data(block.size);
+            if (!read_at(fd, block.offset, data.data(), data.size())) {
+                error = path + ": cannot read block";
+                return false;
+            }
+            size_t body = data.size() - 4;
+            if (crc32c(0, data.data(), body) != read32(&data[body])) {
+                error = path + ": block checksum mismatch";
+                return false;
+            }
+            out.clear();
+            const uint8_t* p = data.data();
+            const uint8_t* end = p + body;
+            while (p < end) {
+                KvEntry entry;
+                if (!get_string(p, end, entry.key) || p >= end) {
+                    error = path + ": corrupt block";
+                    return false;
+                }
+                entry.deleted = *p++ == kDelete;
+                if (!get_string(p, end, entry.value)) {
+                    error = path + ": corrupt block";
+                    return false;
+                }
+                out.push_back(std::move(entry));
+            }
+            return true;
+        }
+
+        // 1 if found (a deletion sets `deleted`), 0 if not, -1 on error
+        int get(const std::string& key, uint64_t hash, std::string& value, bool& deleted, std::string& error) const {
+            if (!may_contain(hash)) return 0;
+            size_t index = find_block(key);
+            if (index == blocks.size()) return 0;
+            std::vector<KvEntry> entries;
+            if (!read_block(index, entries, error)) return -1;
+            auto it = std::lower_bound(entries.begin(), entries.end(), key,
+                                       [](const KvEntry& entry, const std::string& k) { return entry.key < k; });
+            if (it == entries.end() || it->key != key) return 0;
+            value = it->value;
+            deleted = it->deleted;
+            return 1;
+        }
+    };
+
+    // Writes a table from entries added in key order
+    namespace {
+        class TableWriter {
+        public:
+            bool open(const std::string& path, std::string& error) {
+                path_ = path;
+                fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd_ < 0) {
+                    error = path + ": cannot create";
+                    return false;
+                }
+                return true;
+            }
+
+            ~TableWriter() {
+                if (fd_ >= 0) close(fd_);
+            }
+
+            bool add(const std::string& key, const std::string& value, bool deleted, std::string& error) {
+                put_varint(block_, key.size());
+                block_ += key;
+                block_ += static_cast<char>(deleted ? kDelete : kPut);
+                put_varint(block_, value.size());
+                block_ += value;
+                last_key_ = key;
+                hashes_.push_back(key_hash(key));
+                if (block_.size() >= kBlockTarget) return end_block(error);
+                return true;
+            }
+
+            bool finish(std::string& error) {
+                if (!block_.empty() && !end_block(error)) return false;
+
+                uint64_t index_offset = offset_;
+                if (!append(index_, error)) return false;
+
+                // Ten bits per key with seven probes: about 1% false positives
+                size_t bits = hashes_.size() * kBloomBitsPerKey;
+                if (bits < 64) bits = 64;
+                std::string bloom((bits + 7) / 8, '\0');
+                bits = bloom.size() * 8;
+                for (uint64_t hash : hashes_) {
+                    uint64_t delta = hash >> 33 | hash << 31;
+                    for (int i = 0; i < kBloomProbes; ++i, hash += delta) {
+                        uint64_t bit = hash % bits;
+                        bloom[bit >> 3] = static_cast<char>(bloom[bit >> 3] | (1 << (bit & 7)));
+                    }
+                }
+                uint64_t bloom_offset = offset_;
+                if (!append(bloom, error)) return false;
+
+                std::string footer;
+                put64(footer, index_offset);
+                put64(footer, index_.size());
+                put64(footer, bloom_offset);
+                put64(footer, bloom.size());
+                put64(footer, hashes_.size());
+                put32(footer, kTableMagic);
+                if (!append(footer, error)) return false;
+                if (close(fd_) != 0) {
+                    fd_ = -1;
+                    error = path_ + ": write error";
+                    return false;
+                }
+                fd_ = -1;
+                return true;
+            }
+
+        private:
+            std::string path_;
+            int fd_ = -1;
+            uint64_t offset_ = 0;
+            std::string block_;
+            std::string last_key_;
+            std::string index_;
+            std::vector<uint64_t> hashes_;
+
+            bool append(const std::string& data, std::string& error) {
+                if (!write_all(fd_, data.data(), data.size())) {
+                    error = path_ + ": write error";
+                    return false;
+                }
+                offset_ += data.size();
+                return true;
+            }
+
+            bool end_block(std::string& error) {
+                put32(block_, crc32c(0, reinterpret_cast<const uint8_t*>(block_.data()), block_.size()));
+                put_varint(index_, last_key_.size());
+                index_ += last_key_;
+                put_varint(index_, offset_);
+                put_varint(index_, block_.size());
+                bool ok = append(block_, error);
+                block_.clear();
+                return ok;
+            }
+        };
+
+        // Walks one source in key order, from the memtable or a table
+        class Cursor {
+        public:
+            explicit Cursor(KvStore::Memtable* memtable) : memtable_(memtable) {}
+            explicit Cursor(const KvStore::Table* table) : table_(table) {}
+
+            bool seek(const std::string& key, std::string& error) {
+                if (memtable_) {
+                    node_ = memtable_->seek(key, nullptr);
+                    return true;
+                }
+                block_ = table_->find_block(key);
+                if (!load(error)) return false;
+                while (valid() && current().key < key) ++pos_;
+                return true;
+            }
+
+            bool valid() const { return memtable_ ? node_ != nullptr : pos_ < entries_.size(); }
+
+            const std::string& key() const { return memtable_ ? node_->key : entries_[pos_].key; }
+            const std::string& value() const { return memtable_ ? node_->value : entries_[pos_].value; }
+            bool deleted() const { return memtable_ ? node_->deleted : entries_[pos_].deleted; }
+
+            bool next(std::string& error) {
+                if (memtable_) {
+                    node_ = node_->next[0];
+                    return true;
+                }
+                if (++pos_ < entries_.size()) return true;
+                ++block_;
+                return load(error);
+            }
+
+        private:
+            KvStore::Memtable* memtable_ = nullptr;
+            KvStore::Memtable::Node* node_ = nullptr;
+            const KvStore::Table* table_ = nullptr;
+            size_t block_ = 0;
+            std::vector<KvEntry> entries_;
+            size_t pos_ = 0;
+
+            const KvEntry& current() const { return entries_[pos_]; }
+
+            bool load(std::string& error) {
+                entries_.clear();
+                pos_ = 0;
+                // Skip empty blocks, which a table never has but costs nothing to allow
+                while (block_ < table_->blocks.size()) {
+                    if (!table_->read_block(block_, entries_, error)) return false;
+                    if (!entries_.empty()) return true;
+                    ++block_;
+                }
+                return true;
+            }
+        };
+
+        // Merges cursors ordered newest first; for a key in several sources
+        // the newest wins. Calls `emit(key, value, deleted)` until it
+        // returns false.
+        template <typename Emit>
+        bool merge(std::vector<Cursor>& cursors, const std::string& start, std::string& error, Emit emit) {
+            for (Cursor& cursor : cursors) {
+                if (!cursor.seek(start, error)) return false;
+            }
+            while (true) {
+                Cursor* newest = nullptr;
+                for (Cursor& cursor : cursors) {
+                    if (cursor.valid() && (!newest || cursor.key() < newest->key())) newest = &cursor;
+                }
+                if (!newest) return true;
+                std::string key = newest->key();
+                if (!emit(key, newest->value(), newest->deleted())) return true;
+                for (Cursor& cursor : cursors) {
+                    if (cursor.valid() && cursor.key() == key && !cursor.next(error)) return false;
+                }
+            }
+        }
+    }
+
+    KvStore::~KvStore() {
+        std::string error;
+        finish_compaction(true, error);
+        if (wal_ >= 0) close(wal_);
+        delete memtable_;
+        delete compacted_;
+        for (Table* table : tables_) delete table;
+    }
+
+    std::string KvStore::table_path(uint32_t number) const {
+        char name[32];
+        snprintf(name, sizeof(name), "/%06u.sst", number);
+        return dir_ + name;
+    }
+
+    bool KvStore::open(const std::string& dir, std::string& error) {
+        dir_ = dir;
+        while (dir_.size() > 1 && dir_.back() == '/') dir_.pop_back();
+        for (size_t slash = dir_.find('/', 1); ; slash = dir_.find('/', slash + 1)) {
+            mkdir(dir_.substr(0, slash).c_str(), 0755);
+            if (slash == std::string::npos) break;
+        }
+        memtable_ = new Memtable();
+
+        std::ifstream in(dir_ + "/MANIFEST", std::ios::binary);
+        if (in.is_open()) {
+            char header[16];
+            if (!in.read(header, sizeof(header)) || memcmp(header, kManifestMagic, sizeof(kManifestMagic)) != 0 ||
+                read32(reinterpret_cast<uint8_t*>(header) + 4) != kVersion) {
+                error = dir_ + "/MANIFEST: corrupt";
+                return false;
+            }
+            next_table_ = read32(reinterpret_cast<uint8_t*>(header) + 8);
+            uint32_t count = read32(reinterpret_cast<uint8_t*>(header) + 12);
+            for (uint32_t i = 0; i < count; ++i) {
+                char number[4];
+                if (!in.read(number, sizeof(number))) {
+                    error = dir_ + "/MANIFEST: corrupt";
+                    return false;
+                }
+                Table* table = new Table();
+                table->number = read32(reinterpret_cast<uint8_t*>(number));
+                table->path = table_path(table->number);
+                tables_.push_back(table);
+                if (!table->open(error)) return false;
+            }
+        }
+
+        // Tables not in the manifest were being written when the store
+        // last stopped
+        if (DIR* listing = opendir(dir_.c_str())) {
+            while (struct dirent* entry = readdir(listing)) {
+                unsigned number;
+                char tail[8];
+                if (sscanf(entry->d_name, "%u.%7s", &number, tail) != 2 || strcmp(tail, "sst") != 0) continue;
+                bool live = false;
+                for (Table* table : tables_) live = live || table->number == number;
+                if (!live) ::remove((dir_ + "/" + entry->d_name).c_str());
+            }
+            closedir(listing);
+        }
+
+        if (!replay_log(error)) return false;
+        wal_ = ::open((dir_ + "/wal.log").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (wal_ < 0) {
+            error = dir_ + "/wal.log: cannot open";
+            return false;
+        }
+        return true;
+    }
+
+    // A torn record at the end of the log is where the last write stopped
+    bool KvStore::replay_log(std::string& error) {
+        std::ifstream in(dir_ + "/wal.log", std::ios::binary);
+        if (!in.is_open()) return true;
+        std::string log((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(log.data());
+        const uint8_t* end = p + log.size();
+        size_t good = 0;
+        while (static_cast<size_t>(end - p) >= kRecordHeader) {
+            uint32_t crc = read32(p);
+            uint32_t len = read32(p + 4);
+            if (len > static_cast<size_t>(end - p) - kRecordHeader || crc32c(0, p + 4, len + 4) != crc) break;
+            const uint8_t* body = p + kRecordHeader;
+            const uint8_t* body_end = body + len;
+            std::string key, value;
+            uint8_t type = len ? *body++ : 0;
+            if ((type != kPut && type != kDelete) || !get_string(body, body_end, key) || !get_string(body, body_end, value)) break;
+            memtable_->set(key, value, type == kDelete);
+            p = body_end;
+            good = p - reinterpret_cast<const uint8_t*>(log.data());
+        }
+        if (good < log.size() && truncate((dir_ + "/wal.log").c_str(), static_cast<off_t>(good)) != 0) {
+            error = dir_ + "/wal.log: cannot truncate";
+            return false;
+        }
+        return true;
+    }
+
+    bool KvStore::save_manifest(std::string& error) {
+        std::string data(kManifestMagic, sizeof(kManifestMagic));
+        put32(data, kVersion);
+        put32(data, next_table_);
+        put32(data, static_cast<uint32_t>(tables_.size()));
+        for (Table* table : tables_) put32(data, table->number);
+
+        std::string path = dir_ + "/MANIFEST";
+        std::string temp = path + ".tmp";
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), data.size());
+        out.close();
+        if (!out || rename(temp.c_str(), path.c_str()) != 0) {
+            error = "cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+
+    bool KvStore::write(uint8_t type, const std::string& key, const std::string& value, std::string& error) {
+        if (!finish_compaction(false, error)) return false;
+
+        std::string record(kRecordHeader, '\0');
+        record += static_cast<char>(type);
+        put_varint(record, key.size());
+        record += key;
+        put_varint(record, value.size());
+        record += value;
+        uint32_t len = static_cast<uint32_t>(record.size() - kRecordHeader);
+        for (int i = 0; i < 4; ++i) record[4 + i] = static_cast<char>(len >> (8 * i));
+        uint32_t crc = crc32c(0, reinterpret_cast<const uint8_t*>(record.data()) + 4, len + 4);
+        for (int i = 0; i < 4; ++i) record[i] = static_cast<char>(crc >> (8 * i));
+        if (!write_all(wal_, record.data(), record.size())) {
+            error = dir_ + "/wal.log: write error";
+            return false;
+        }
+
+        memtable_->set(key, value, type == kDelete);
+        if (memtable_->bytes >= kMemtableLimit) return flush(error);
+        return true;
+    }
+
+    bool KvStore::put(const std::string& key, const std::string& value, std::string& error) {
+        return write(kPut, key, value, error);
+    }
+
+    bool KvStore::remove(const std::string& key, std::string& error) {
+        return write(kDelete, key, std::string(), error);
+    }
+
+    bool KvStore::get(const std::string& key, std::string& value, std::string& error) {
+        if (!finish_compaction(false, error)) return false;
+
+        Memtable::Node* node = memtable_->seek(key, nullptr);
+        if (node && node->key == key) {
+            if (node->deleted) return false;
+            value = node->value;
+            return true;
+        }
+        uint64_t hash = key_hash(key);
+        for (Table* table : tables_) {
+            bool deleted = false;
+            int found = table->get(key, hash, value, deleted, error);
+            if (found < 0) return false;
+            if (found) return !deleted;
+        }
+        return false;
+    }
+
+    bool KvStore::scan(const std::string& start, const std::string& end, size_t limit,
+                       std::vector<std::pair<std::string, std::string>>& out, std::string& error) {
+        if (!finish_compaction(false, error)) return false;
+
+        std::vector<Cursor> cursors;
+        cursors.emplace_back(memtable_);
+        for (Table* table : tables_) cursors.emplace_back(table);
+        return merge(cursors, start, error, [&](const std::string& key, const std::string& value, bool deleted) {
+            if (out.size() >= limit || (!end.empty() && key >= end)) return false;
+            if (!deleted) out.emplace_back(key, value);
+            return true;
+        });
+    }
+
+    bool KvStore::flush(std::string& error) {
+        if (!finish_compaction(false, error)) return false;
+        if (memtable_->entries == 0) return true;
+
+        uint32_t number = next_table_++;
+        TableWriter writer;
+        if (!writer.open(table_path(number), error)) return false;
+        for (Memtable::Node* node = memtable_->head.next[0]; node; node = node->next[0]) {
+            if (!writer.add(node->key, node->value, node->deleted, error)) return false;
+        }
+        if (!writer.finish(error)) return false;
+
+        Table* table = new Table();
+        table->number = number;
+        table->path = table_path(number);
+        if (!table->open(error)) {
+            delete table;
+            return false;
+        }
+        tables_.insert(tables_.begin(), table);
+        if (!save_manifest(error)) return false;
+
+        // The table now holds everything the log did
+        if (ftruncate(wal_, 0) != 0) {
+            error = dir_ + "/wal.log: cannot truncate";
+            return false;
+        }
+        delete memtable_;
+        memtable_ = new Memtable();
+
+        if (tables_.size() >= kCompactTables && compacting_ == 0) start_compaction();
+        return true;
+    }
+
+    // Merge the current tables into a new one. They are the oldest data in
+    // the store, so deletions can be dropped rather than carried forward.
+    void KvStore::start_compaction() {
+        compacting_ = tables_.size();
+        std::vector<const Table*> inputs(tables_.begin(), tables_.end());
+        uint32_t number = next_table_++;
+        std::string path = table_path(number);
+
+        auto run = [this, inputs, number, path]() {
+            std::string error;
+            TableWriter writer;
+            std::vector<Cursor> cursors;
+            for (const Table* table : inputs) cursors.emplace_back(table);
+            bool ok = writer.open(path, error) &&
+                      merge(cursors, std::string(), error,
+                            [&](const std::string& key, const std::string& value, bool deleted) {
+                                return deleted || writer.add(key, value, false, error);
+                            }) &&
+                      error.empty() && writer.finish(error);
+            Table* table = nullptr;
+            if (ok) {
+                table = new Table();
+                table->number = number;
+                table->path = path;
+                if (!table->open(error)) {
+                    delete table;
+                    table = nullptr;
+                }
+            }
+            if (!table) ::remove(path.c_str());
+            compacted_ = table;
+            compact_error_ = error;
+#ifdef __EMSCRIPTEN_PTHREADS__
+            compact_done_ = true;
+#endif
+        };
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+        compact_done_ = false;
+        compactor_ = std::thread(run);
+#else
+        run();
+#endif
+    }
+
+    // Install a finished compaction: the merged table replaces its inputs,
+    // below anything flushed since it started
+    bool KvStore::finish_compaction(bool wait, std::string& error) {
+        if (compacting_ == 0) return true;
+#ifdef __EMSCRIPTEN_PTHREADS__
+        if (!wait && !compact_done_) return true;
+        compactor_.join();
+#else
+        (void)wait;
+#endif
+        size_t inputs = compacting_;
+        compacting_ = 0;
+        Table* merged = compacted_;
+        compacted_ = nullptr;
+        if (!merged) {
+            error = compact_error_;
+            return false;
+        }
+
+        std::vector<Table*> old(tables_.end() - inputs, tables_.end());
+        tables_.erase(tables_.end() - inputs, tables_.end());
+        tables_.push_back(merged);
+        if (!save_manifest(error)) return false;
+        for (Table* table : old) {
+            ::remove(table->path.c_str());
+            delete table;
+        }
+        return true;
+    }
+
+    bool KvStore::compact(std::string& error) {
+        if (!finish_compaction(true, error) || !flush(error) || !finish_compaction(true, error)) return false;
+        if (tables_.size() > 1) {
+            start_compaction();
+            return finish_compaction(true, error);
+        }
+        return true;
+    }
+
+    KvStore::Stats KvStore::stats() {
+        std::string error;
+        finish_compaction(false, error);
+        Stats stats = {memtable_->entries, memtable_->bytes, tables_.size(), 0, 0, compacting_ != 0};
+        for (Table* table : tables_) {
+            stats.table_entries += table->entries;
+            stats.table_bytes += table->bytes;
+        }
+        return stats;
+    }
+
+    KvStore* kv_store(const std::string& dir, std::string& error) {
+        static std::map<std::string, KvStore*> stores;
+        std::string key = dir;
+        while (key.size() > 1 && key.back() == '/') key.pop_back();
+        auto it = stores.find(key);
+        if (it != stores.end()) return it->second;
+
+        KvStore* store = new KvStore();
+        if (!store->open(key, error)) {
+            delete store;
+            return nullptr;
+        }
+        stores[key] = store;
+        return store;
+    }
+}
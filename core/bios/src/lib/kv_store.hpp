@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <atomic>
+#include <thread>
+#endif
+
+namespace lib {
+    // Log-structured key-value store kept in one directory of the FS.
+    //
+    // Writes append to a write-ahead log (wal.log) and go into a skiplist
+    // memtable; past kMemtableLimit the memtable is written out as an
+    // immutable sorted table (NNNNNN.sst) and the log starts over. A table
+    // is a run of ~4 KB data blocks, each with a CRC-32C, then an index of
+    // each block's last key, a bloom filter over the keys, and a footer, so
+    // a lookup reads at most one block from each table whose filter passes.
+    // MANIFEST lists the live tables, newest first, and is replaced whole.
+    //
+    // Once kCompactTables tables have built up they are merged into one,
+    // dropping overwritten values and deletions, on a worker thread where
+    // the build has them; the result is installed by the next call.
+    class KvStore {
+    public:
+        static const size_t kMemtableLimit = 4 * 1024 * 1024;
+        static const size_t kCompactTables = 4;
+
+        struct Stats {
+            size_t memtable_entries;
+            size_t memtable_bytes;
+            size_t tables;
+            uint64_t table_entries;
+            uint64_t table_bytes;
+            bool compacting;
+        };
+
+        KvStore() = default;
+        ~KvStore();
+
+        KvStore(const KvStore&) = delete;
+        KvStore& operator=(const KvStore&) = delete;
+
+        // Load the tables and replay the log of the store in `dir`,
+        // creating it if it does not exist
+        bool open(const std::string& dir, std::string& error);
+
+        // False with an empty `error` when `key` is not present
+        bool get(const std::string& key, std::string& value, std::string& error);
+        bool put(const std::string& key, const std::string& value, std::string& error);
+        bool remove(const std::string& key, std::string& error);
+
+        // Up to `limit` live pairs with start <= key < end (no upper bound
+        // when `end` is empty), in key order
+        bool scan(const std::string& start, const std::string& end, size_t limit,
+                  std::vector<std::pair<std::string, std::string>>& out, std::string& error);
+
+        // Write the memtable out as a table now
+        bool flush(std::string& error);
+
+        // Merge every table into one and wait for it
+        bool compact(std::string& error);
+
+        Stats stats();
+        const std::string& dir() const { return dir_; }
+
+        struct Table;
+        struct Memtable;
+
+    private:
+        std::string dir_;
+        int wal_ = -1;
+        Memtable* memtable_ = nullptr;
+        std::vector<Table*> tables_;            // Newest first
+        uint32_t next_table_ = 1;
+
+        // The tables being merged are the oldest `compacting_` of tables_
+        size_t compacting_ = 0;
+        Table* compacted_ = nullptr;
+        std::string compact_error_;
+#ifdef __EMSCRIPTEN_PTHREADS__
+        std::thread compactor_;
+        std::atomic<bool> compact_done_{false};
+#endif
+
+        bool write(uint8_t type, const std::string& key, const std::string& value, std::string& error);
+        bool replay_log(std::string& error);
+        bool save_manifest(std::string& error);
+        void start_compaction();
+        bool finish_compaction(bool wait, std::string& error);
+        std::string table_path(uint32_t number) const;
+    };
+
+    // The store for `dir`, opened on first use and shared by the kv
+    // command and the exports; nullptr with `error` set if it cannot be
+    // opened
+    KvStore* kv_store(const std::string& dir, std::string& error);
+}
@@ -0,0 +1,192 @@
+#include "line_index.hpp"
+#include "block_file.hpp"
+#include "file_io.hpp"
+#include "hash.hpp"
+#include "search.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+namespace lib {
+    static const char kMagic[4] = {'L', 'I', 'D', 'X'};
+    static const uint32_t kVersion = 1;
+    static const size_t kScanBlockSize = 1024 * 1024;
+    static const size_t kReadBlockSize = 64 * 1024;
+
+    struct IndexHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t interval;
+        uint32_t path_len;
+        uint64_t size;
+        int64_t mtime;
+        uint64_t inode;
+        uint64_t lines;
+        uint64_t samples;
+    };
+
+    // Keyed on the absolute path, so every spelling of a file, and the
+    // invalidations file_events passes, find the same index
+    static std::string index_path_for(const std::string& path) {
+        std::string full = absolute_path(path);
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx",
+                 static_cast<unsigned long long>(xxh3_64(reinterpret_cast<const uint8_t*>(full.data()), full.size())));
+        return std::string(LineIndex::kDirectory) + "/" + name;
+    }
+
+    // mkdir -p for the index directory
+    static void make_index_directory() {
+        std::string dir = LineIndex::kDirectory;
+        for (size_t slash = dir.find('/', 1); ; slash = dir.find('/', slash + 1)) {
+            mkdir(dir.substr(0, slash).c_str(), 0755);
+            if (slash == std::string::npos) break;
+        }
+    }
+
+    bool LineIndex::open(const std::string& path, std::string& error) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            error = "cannot open " + path;
+            return false;
+        }
+
+        path_ = absolute_path(path);
+        size_ = static_cast<uint64_t>(st.st_size);
+        mtime_ = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        inode_ = static_cast<uint64_t>(st.st_ino);
+
+        std::string index_path = index_path_for(path_);
+        if (load(index_path)) return true;
+        if (!build(error)) return false;
+        save(index_path);
+        return true;
+    }
+
+    bool LineIndex::load(const std::string& index_path) {
+        std::ifstream file(index_path, std::ios::binary);
+        IndexHeader header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+        if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || header.interval != kInterval) return false;
+        if (header.size != size_ || header.mtime != mtime_ || header.inode != inode_) return false;
+        if (header.samples != (header.lines + kInterval - 1) / kInterval) return false;
+
+        // The name is a hash, so confirm the index belongs to this path
+        std::string indexed_path(header.path_len, '\0');
+        if (!file.read(&indexed_path[0], indexed_path.size()) || indexed_path != path_) return false;
+
+        samples_.resize(header.samples);
+        if (!file.read(reinterpret_cast<char*>(samples_.data()), samples_.size() * sizeof(uint64_t))) return false;
+        lines_ = header.lines;
+        return true;
+    }
+
+    bool LineIndex::build(std::string& error) {
+        BlockReader file;
+        if (!file.open(path_, error)) return false;
+
+        std::string block;
+        uint64_t newlines = 0;
+        uint64_t offset = 0;
+        uint64_t next_sample = kInterval;     // Newline count that starts the next sampled line
+        char last = '\n';
+        samples_.assign(1, 0);
+
+        while (offset < file.size()) {
+            block.clear();
+            if (!file.read(offset, kScanBlockSize, block, error)) return false;
+            size_t got = block.size();
+            const char* data = block.data();
+
+            // Most blocks hold no sampled line start and only need counting
+            size_t count = count_byte(data, got, '\n');
+            if (newlines + count < next_sample) {
+                newlines += count;
+            } else {
+                const char* cursor = data;
+                const char* end = data + got;
+                while (const char* nl = find_byte(cursor, end - cursor, '\n')) {
+                    if (++newlines == next_sample) {
+                        samples_.push_back(offset + (nl - data) + 1);
+                        next_sample += kInterval;
+                    }
+                    cursor = nl + 1;
+                }
+            }
+
+            last = data[got - 1];
+            offset += got;
+        }
+
+        lines_ = newlines + (last != '\n' ? 1 : 0);
+        samples_.resize((lines_ + kInterval - 1) / kInterval);
+        return true;
+    }
+
+    void LineIndex::save(const std::string& index_path) const {
+        make_index_directory();
+        std::ofstream file(index_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return;    // The index is only a cache
+
+        IndexHeader header;
+        memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.interval = kInterval;
+        header.path_len = static_cast<uint32_t>(path_.size());
+        header.size = size_;
+        header.mtime = mtime_;
+        header.inode = inode_;
+        header.lines = lines_;
+        header.samples = samples_.size();
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(path_.data(), path_.size());
+        file.write(reinterpret_cast<const char*>(samples_.data()), samples_.size() * sizeof(uint64_t));
+    }
+
+    bool LineIndex::read_lines(uint64_t first, uint64_t count, std::string& out, std::string& error) const {
+        if (first >= lines_ || count == 0) return true;
+
+        BlockReader file;
+        if (!file.open(path_, error)) return false;
+        uint64_t offset = samples_[first / kInterval];
+
+        std::string block;
+        uint64_t skip = first % kInterval;
+        while (offset < file.size() && count > 0) {
+            block.clear();
+            if (!file.read(offset, kReadBlockSize, block, error)) return false;
+            size_t got = block.size();
+            offset += got;
+            const char* cursor = block.data();
+            const char* end = cursor + got;
+
+            // Walk from the sampled line to the first requested one
+            if (skip > 0) {
+                size_t newlines = count_byte(cursor, got, '\n');
+                if (newlines < skip) {
+                    skip -= newlines;
+                    continue;
+                }
+                for (; skip > 0; --skip) cursor = find_byte(cursor, end - cursor, '\n') + 1;
+            }
+
+            while (count > 0 && cursor < end) {
+                const char* nl = find_byte(cursor, end - cursor, '\n');
+                if (!nl) {
+                    out.append(cursor, end);
+                    break;
+                }
+                out.append(cursor, nl + 1);
+                cursor = nl + 1;
+                --count;
+            }
+        }
+        return true;
+    }
+
+    void LineIndex::invalidate(const std::string& path) {
+        remove(index_path_for(path).c_str());
+    }
+}
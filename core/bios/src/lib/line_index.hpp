@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lib {
+    // Sampled line offsets for random access into large text files. The
+    // offset of every kInterval-th line start is kept, so reaching any line
+    // costs one seek plus a scan of at most kInterval lines.
+    //
+    // Indexes are saved under kDirectory, named by the XXH3 of the file's
+    // path, and carry the file's size, mtime and inode: an index that no
+    // longer matches its file is rebuilt on the next open().
+    class LineIndex {
+    public:
+        static constexpr const char* kDirectory = "/.bios/lines";
+        static const uint32_t kInterval = 1024;
+
+        // Load the saved index for `path`, or build and save a new one
+        bool open(const std::string& path, std::string& error);
+
+        uint64_t line_count() const { return lines_; }
+
+        // Append lines [first, first + count) (0-based) to `out`, each with
+        // its newline if the file has one
+        bool read_lines(uint64_t first, uint64_t count, std::string& out, std::string& error) const;
+
+        // Forget the saved index for `path`; call after writing the file
+        static void invalidate(const std::string& path);
+
+    private:
+        std::string path_;
+        uint64_t size_ = 0;
+        int64_t mtime_ = 0;
+        uint64_t inode_ = 0;
+        uint64_t lines_ = 0;
+        std::vector<uint64_t> samples_;     // samples_[i] = offset of line i * kInterval
+
+        bool load(const std::string& index_path);
+        bool build(std::string& error);
+        void save(const std::string& index_path) const;
+    };
+}
@@ -0,0 +1,53 @@
+#include "line_reader.hpp"
+#include "search.hpp"
+
+namespace lib {
+    LineReader::LineReader(const std::string& path) : path_(path) {
+        std::string error;
+        open_ = file_.open(path, error);
+    }
+
+    bool LineReader::next(std::string_view& line, bool& terminated) {
+        for (;;) {
+            const char* start = buffer_.data() + pos_;
+            const char* nl = find_byte(start + scanned_, buffer_.size() - pos_ - scanned_, '\n');
+            if (nl) {
+                line = std::string_view(start, nl - start);
+                pos_ += line.size() + 1;
+                scanned_ = 0;
+                terminated = true;
+                return true;
+            }
+            scanned_ = buffer_.size() - pos_;
+            if (!fill()) {
+                if (pos_ >= buffer_.size()) return false;
+                line = std::string_view(buffer_.data() + pos_, buffer_.size() - pos_);
+                pos_ = buffer_.size();
+                scanned_ = 0;
+                terminated = false;
+                return true;
+            }
+        }
+    }
+
+    bool LineReader::at_end() {
+        return pos_ >= buffer_.size() && !fill();
+    }
+
+    bool LineReader::fill() {
+        if (!open_ || offset_ >= file_.size() || failed()) return false;
+        buffer_.erase(0, pos_);
+        pos_ = 0;
+        size_t before = buffer_.size();
+        if (!file_.read(offset_, kBlockSize, buffer_, error_)) {
+            if (error_.empty()) error_ = "failed to read " + path_;
+            return false;
+        }
+        if (buffer_.size() == before) {
+            error_ = "unexpected end of " + path_;
+            return false;
+        }
+        offset_ += buffer_.size() - before;
+        return true;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "block_file.hpp"
+#include <string>
+#include <string_view>
+
+namespace lib {
+    // Reads a file one line at a time through a fixed-size block buffer, so
+    // input is never loaded whole; block-compressed files decode a block at
+    // a time. Returned lines are views into the buffer and stay valid until
+    // the next call to next().
+    class LineReader {
+    public:
+        static constexpr size_t kBlockSize = 64 * 1024;
+
+        explicit LineReader(const std::string& path);
+
+        bool is_open() const { return open_; }
+
+        // Fetch the next line without its newline; `terminated` is false for a
+        // final line that had none. False at the end of the file, and also
+        // when the file cannot be read or decoded, which failed() tells
+        // apart.
+        bool next(std::string_view& line, bool& terminated);
+
+        // Whether reading stopped on an error rather than at the end, and
+        // what it was
+        bool failed() const { return !error_.empty(); }
+        const std::string& error() const { return error_; }
+
+        // True once every line has been returned
+        bool at_end();
+
+    private:
+        BlockReader file_;
+        bool open_ = false;
+        uint64_t offset_ = 0;   // Of the next byte to read from the file
+        std::string buffer_;
+        size_t pos_ = 0;
+        size_t scanned_ = 0;    // Bytes after pos_ already known to hold no newline
+        std::string path_;
+        std::string error_;
+
+        bool fill();
+    };
+}
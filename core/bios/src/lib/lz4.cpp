@@ -0,0 +1,401 @@
+#include "lz4.hpp"
+#include "file_io.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace lib {
+    static const uint32_t kFrameMagic = 0x184D2204;
+    static const uint32_t kSkippableMagic = 0x184D2A50;     // Low four bits are free
+    static const size_t kBlockSize = 256 * 1024;
+    static const uint8_t kBlockSizeId = 5;                  // 256 KB in the frame descriptor
+    static const size_t kWindowSize = 64 * 1024;
+    static const size_t kMaxOffset = 65535;
+    static const size_t kMinMatch = 4;
+    // The last match must start at least kMatchFindLimit bytes before the end
+    // of a block and the last kLastLiterals bytes are always literals
+    static const size_t kMatchFindLimit = 12;
+    static const size_t kLastLiterals = 5;
+    static const int kHashLog = 16;
+    static const int kSkipTrigger = 6;
+
+    static inline uint32_t hash4(uint32_t sequence) { return (sequence * 2654435761U) >> (32 - kHashLog); }
+
+    // Length of the common prefix of a and b, reading no further than `limit`
+    static inline size_t match_length(const uint8_t* a, const uint8_t* b, const uint8_t* limit) {
+        const uint8_t* start = a;
+        while (a + 8 <= limit) {
+            uint64_t diff = read64(a) ^ read64(b);
+            if (diff) return a - start + (__builtin_ctzll(diff) >> 3);
+            a += 8;
+            b += 8;
+        }
+        while (a < limit && *a == *b) {
+            ++a;
+            ++b;
+        }
+        return a - start;
+    }
+
+    static void put_length(std::string& out, size_t length) {
+        for (; length >= 255; length -= 255) out += static_cast<char>(255);
+        out += static_cast<char>(length);
+    }
+
+    static void emit_sequence(std::string& out, const uint8_t* literals, size_t literal_length, size_t offset, size_t length) {
+        size_t token = out.size();
+        out += '\0';
+        uint8_t literal_code = static_cast<uint8_t>(std::min<size_t>(literal_length, 15));
+        if (literal_length >= 15) put_length(out, literal_length - 15);
+        out.append(reinterpret_cast<const char*>(literals), literal_length);
+        if (length == 0) {
+            out[token] = static_cast<char>(literal_code << 4);
+            return;
+        }
+
+        out += static_cast<char>(offset & 0xff);
+        out += static_cast<char>(offset >> 8);
+        size_t match_code = length - kMinMatch;
+        if (match_code >= 15) put_length(out, match_code - 15);
+        out[token] = static_cast<char>(literal_code << 4 | std::min<size_t>(match_code, 15));
+    }
+
+    Lz4Encoder::Lz4Encoder(int level) : level_(level < 1 ? 1 : level > kMaxLevel ? kMaxLevel : level) {}
+
+    void Lz4Encoder::update(const uint8_t* data, size_t len, std::string& out) {
+        if (!started_) {
+            // Magic, then a descriptor: version 1, linked blocks, content
+            // checksum, 256 KB blocks, and a byte of its own XXH32
+            put32(out, kFrameMagic);
+            uint8_t descriptor[2] = {0x44, static_cast<uint8_t>(kBlockSizeId << 4)};
+            Xxh32 header;
+            header.update(descriptor, sizeof(descriptor));
+            out.append(reinterpret_cast<const char*>(descriptor), sizeof(descriptor));
+            out += static_cast<char>((header.digest() >> 8) & 0xff);
+            table_.assign(1 << kHashLog, 0);
+            if (level_ > 1) chain_.assign(kWindowSize, 0);
+            started_ = true;
+        }
+
+        while (len > 0) {
+            size_t take = std::min(len, kBlockSize - (window_.size() - history_));
+            window_.insert(window_.end(), data, data + take);
+            checksum_.update(data, take);
+            data += take;
+            len -= take;
+            if (window_.size() - history_ == kBlockSize) write_block(out);
+        }
+    }
+
+    void Lz4Encoder::finish(std::string& out) {
+        update(nullptr, 0, out);
+        if (window_.size() > history_) write_block(out);
+        put32(out, 0);
+        put32(out, checksum_.digest());
+    }
+
+    void Lz4Encoder::write_block(std::string& out) {
+        const uint8_t* base = window_.data();
+        const size_t start = history_;
+        const size_t end = window_.size();
+        const uint8_t* match_end = base + end - kLastLiterals;
+        const uint32_t origin = static_cast<uint32_t>(window_start_);
+        const size_t depth = level_ > 1 ? size_t(1) << (level_ - 1) : 0;
+
+        std::string block;
+        size_t anchor = start;
+        if (end - start > kMatchFindLimit) {
+            const size_t limit = end - kMatchFindLimit;
+            size_t ip = start;
+            size_t inserted = start;
+
+            // Record `pos` as the newest occurrence of its hash
+            auto insert = [&](size_t pos) {
+                uint32_t h = hash4(read32(base + pos));
+                uint32_t position = origin + static_cast<uint32_t>(pos);
+                if (depth) chain_[position & (kWindowSize - 1)] = table_[h];
+                table_[h] = position + 1;
+            };
+
+            while (ip < limit) {
+                size_t offset = 0;
+                size_t length = 0;
+
+                if (depth) {
+                    // Walk the chain for the longest match within the window
+                    for (; inserted < ip; ++inserted) insert(inserted);
+                    uint32_t position = origin + static_cast<uint32_t>(ip);
+                    uint32_t candidate = table_[hash4(read32(base + ip))];
+                    for (size_t tries = 0; candidate && tries < depth; ++tries) {
+                        size_t distance = position - (candidate - 1);
+                        if (distance == 0 || distance > kMaxOffset || distance > ip) break;
+                        const uint8_t* ref = base + ip - distance;
+                        if (read32(ref) == read32(base + ip)) {
+                            size_t found = kMinMatch + match_length(base + ip + kMinMatch, ref + kMinMatch, match_end);
+                            if (found > length) {
+                                length = found;
+                                offset = distance;
+                                if (base + ip + length == match_end) break;     // Cannot get longer
+                            }
+                        }
+                        candidate = chain_[(candidate - 1) & (kWindowSize - 1)];
+                    }
+                    insert(ip);
+                    inserted = ip + 1;
+                    if (!length) {
+                        ++ip;
+                        continue;
+                    }
+                } else {
+                    // Skip ahead faster the longer nothing matches
+                    size_t searches = size_t(1) << kSkipTrigger;
+                    while (true) {
+                        uint32_t sequence = read32(base + ip);
+                        uint32_t h = hash4(sequence);
+                        uint32_t candidate = table_[h];
+                        uint32_t position = origin + static_cast<uint32_t>(ip);
+                        table_[h] = position + 1;
+                        size_t distance = position - (candidate - 1);
+                        if (candidate && distance > 0 && distance <= kMaxOffset && distance <= ip &&
+                            read32(base + ip - distance) == sequence) {
+                            offset = distance;
+                            break;
+                        }
+                        ip += searches++ >> kSkipTrigger;
+                        if (ip >= limit) break;
+                    }
+                    if (!offset) break;
+                    length = kMinMatch + match_length(base + ip + kMinMatch, base + ip - offset + kMinMatch, match_end);
+                }
+
+                // Pull the match start back over equal literals
+                while (ip > anchor && ip - offset > 0 && base[ip - 1] == base[ip - offset - 1]) {
+                    --ip;
+                    ++length;
+                }
+
+                emit_sequence(block, base + anchor, ip - anchor, offset, length);
+                ip += length;
+                anchor = ip;
+                if (!depth && ip < limit) {
+                    uint32_t h = hash4(read32(base + ip - 2));
+                    table_[h] = origin + static_cast<uint32_t>(ip - 2) + 1;
+                }
+            }
+        }
+        emit_sequence(block, base + anchor, end - anchor, 0, 0);
+
+        // Store the block raw if compression did not pay
+        size_t raw = end - start;
+        if (block.size() >= raw) {
+            put32(out, static_cast<uint32_t>(raw) | 0x80000000U);
+            out.append(reinterpret_cast<const char*>(base + start), raw);
+        } else {
+            put32(out, static_cast<uint32_t>(block.size()));
+            out += block;
+        }
+
+        // Keep the last 64 KB as history for the next block
+        size_t keep = std::min(end, kWindowSize);
+        size_t drop = end - keep;
+        window_.erase(window_.begin(), window_.begin() + drop);
+        window_start_ += drop;
+        history_ = keep;
+    }
+
+    // Decode one compressed block, appending at most `max_output` bytes to
+    // `window`, whose existing bytes are history that matches may reach into
+    static bool decode_block(const uint8_t* src, size_t len, std::vector<uint8_t>& window, size_t max_output) {
+        size_t start = window.size();
+        window.resize(start + max_output);
+        uint8_t* base = window.data();
+        size_t op = start;
+        const size_t op_end = start + max_output;
+        const uint8_t* ip = src;
+        const uint8_t* end = src + len;
+
+        auto read_length = [&](size_t& length) {
+            uint8_t byte;
+            do {
+                if (ip >= end) return false;
+                byte = *ip++;
+                length += byte;
+            } while (byte == 255);
+            return true;
+        };
+
+        while (ip < end) {
+            uint8_t token = *ip++;
+            size_t literals = token >> 4;
+            if (literals == 15 && !read_length(literals)) return false;
+            if (literals > static_cast<size_t>(end - ip) || literals > op_end - op) return false;
+            memcpy(base + op, ip, literals);
+            ip += literals;
+            op += literals;
+            if (ip == end) break;       // The last sequence has no match
+
+            if (end - ip < 2) return false;
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            size_t length = token & 15;
+            if (length == 15 && !read_length(length)) return false;
+            length += kMinMatch;
+            if (offset == 0 || offset > op || length > op_end - op) return false;
+
+            uint8_t* dst = base + op;
+            const uint8_t* ref = dst - offset;
+            if (offset >= length) {
+                memcpy(dst, ref, length);
+            } else {
+                for (size_t i = 0; i < length; ++i) dst[i] = ref[i];
+            }
+            op += length;
+        }
+
+        window.resize(op);
+        return true;
+    }
+
+    bool Lz4Decoder::step(std::string& out, std::string& error, bool& progress) {
+        const uint8_t* in = input_.data() + consumed_;
+        size_t available = input_.size() - consumed_;
+        progress = false;
+
+        switch (state_) {
+            case kMagic: {
+                if (available < 4) return true;
+                uint32_t magic = read32(in);
+                if (magic == kFrameMagic) {
+                    consumed_ += 4;
+                    state_ = kHeader;
+                } else if ((magic & 0xFFFFFFF0U) == kSkippableMagic) {
+                    if (available < 8) return true;
+                    skip_ = read32(in + 4);
+                    consumed_ += 8;
+                    state_ = kSkip;
+                } else {
+                    error = "not an LZ4 frame";
+                    return false;
+                }
+                break;
+            }
+
+            case kHeader: {
+                if (available < 2) return true;
+                uint8_t flags = in[0];
+                size_t length = 3 + ((flags & 0x08) ? 8 : 0) + ((flags & 0x01) ? 4 : 0);
+                if (available < length) return true;
+
+                uint8_t size_id = (in[1] >> 4) & 7;
+                if ((flags >> 6) != 1 || size_id < 4) {
+                    error = "unsupported LZ4 frame header";
+                    return false;
+                }
+                Xxh32 header;
+                header.update(in, length - 1);
+                if (((header.digest() >> 8) & 0xff) != in[length - 1]) {
+                    error = "LZ4 frame header checksum mismatch";
+                    return false;
+                }
+
+                block_checksum_ = flags & 0x10;
+                content_checksum_ = flags & 0x04;
+                max_block_ = size_t(1) << (8 + 2 * size_id);
+                window_.clear();
+                checksum_ = Xxh32();
+                consumed_ += length;
+                state_ = kBlock;
+                break;
+            }
+
+            case kBlock: {
+                if (available < 4) return true;
+                uint32_t size = read32(in);
+                if (size == 0) {
+                    consumed_ += 4;
+                    state_ = content_checksum_ ? kChecksum : kMagic;
+                    break;
+                }
+
+                bool raw = size & 0x80000000U;
+                size &= 0x7FFFFFFFU;
+                if (size > max_block_) {
+                    error = "corrupt LZ4 block";
+                    return false;
+                }
+                size_t length = 4 + size + (block_checksum_ ? 4 : 0);
+                if (available < length) return true;
+
+                if (block_checksum_) {
+                    Xxh32 block;
+                    block.update(in + 4, size);
+                    if (block.digest() != read32(in + 4 + size)) {
+                        error = "LZ4 block checksum mismatch";
+                        return false;
+                    }
+                }
+
+                size_t before = window_.size();
+                if (raw) {
+                    window_.insert(window_.end(), in + 4, in + 4 + size);
+                } else if (!decode_block(in + 4, size, window_, max_block_)) {
+                    error = "corrupt LZ4 block";
+                    return false;
+                }
+                out.append(reinterpret_cast<const char*>(window_.data() + before), window_.size() - before);
+                checksum_.update(window_.data() + before, window_.size() - before);
+                if (window_.size() > kWindowSize) window_.erase(window_.begin(), window_.end() - kWindowSize);
+                consumed_ += length;
+                break;
+            }
+
+            case kChecksum: {
+                if (available < 4) return true;
+                if (read32(in) != checksum_.digest()) {
+                    error = "LZ4 content checksum mismatch";
+                    return false;
+                }
+                consumed_ += 4;
+                state_ = kMagic;
+                break;
+            }
+
+            case kSkip: {
+                size_t take = std::min(available, skip_);
+                consumed_ += take;
+                skip_ -= take;
+                if (skip_ == 0) state_ = kMagic;
+                if (take == 0 && skip_ > 0) return true;
+                break;
+            }
+        }
+
+        progress = true;
+        return true;
+    }
+
+    bool Lz4Decoder::update(const uint8_t* data, size_t len, std::string& out, std::string& error) {
+        if (consumed_ > 0 && consumed_ * 2 >= input_.size()) {
+            input_.erase(input_.begin(), input_.begin() + consumed_);
+            consumed_ = 0;
+        }
+        input_.insert(input_.end(), data, data + len);
+
+        bool progress = true;
+        while (progress) {
+            if (!step(out, error, progress)) return false;
+        }
+        return true;
+    }
+
+    bool Lz4Decoder::finish(std::string& error) const {
+        if (consumed_ != input_.size() || state_ != kMagic) {
+            error = "truncated LZ4 frame";
+            return false;
+        }
+        return true;
+    }
+
+    bool is_lz4_frame(const uint8_t* data, size_t len) {
+        return len >= 4 && read32(data) == kFrameMagic;
+    }
+}
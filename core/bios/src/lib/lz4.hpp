@@ -0,0 +1,71 @@
+#pragma once
+#include "hash.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lib {
+    // LZ4 frame format, readable by the lz4 tool. Input is cut into 256 KB
+    // blocks that may refer back into the previous 64 KB, and each frame
+    // ends with an XXH32 of its content.
+    //
+    // Level 1 is LZ4's fast greedy parser, which skips ahead faster the
+    // longer it goes without a match; levels 2-12 search hash chains of
+    // increasing depth for longer matches (LZ4-HC style). The output format
+    // is the same at every level.
+    class Lz4Encoder {
+    public:
+        static const int kMaxLevel = 12;
+
+        explicit Lz4Encoder(int level = 1);
+
+        // Append compressed output for `data` to `out`; a block is written
+        // whenever enough input has been buffered
+        void update(const uint8_t* data, size_t len, std::string& out);
+
+        // Flush the last block and end the frame
+        void finish(std::string& out);
+
+    private:
+        int level_;
+        bool started_ = false;
+        std::vector<uint8_t> window_;       // Up to 64 KB of history, then the pending block
+        size_t history_ = 0;                // Bytes of window_ that are history
+        uint64_t window_start_ = 0;         // Stream position of window_[0]
+        std::vector<uint32_t> table_;       // Hash -> stream position + 1
+        std::vector<uint32_t> chain_;       // Position -> previous position + 1 with the same hash
+        Xxh32 checksum_;
+
+        void write_block(std::string& out);
+    };
+
+    // Streaming decoder for LZ4 frames (and skippable frames), including
+    // linked blocks and the optional block and content checksums
+    class Lz4Decoder {
+    public:
+        // Decode as much of the input seen so far as possible into `out`
+        bool update(const uint8_t* data, size_t len, std::string& out, std::string& error);
+
+        // Check that the input ended on a frame boundary
+        bool finish(std::string& error) const;
+
+    private:
+        enum State { kMagic, kHeader, kBlock, kChecksum, kSkip };
+
+        State state_ = kMagic;
+        std::vector<uint8_t> input_;
+        size_t consumed_ = 0;
+        size_t skip_ = 0;
+        bool block_checksum_ = false;
+        bool content_checksum_ = false;
+        size_t max_block_ = 0;
+        std::vector<uint8_t> window_;       // Decoded history for linked blocks
+        Xxh32 checksum_;
+
+        bool step(std::string& out, std::string& error, bool& progress);
+    };
+
+    // True if `data` starts with an LZ4 frame
+    bool is_lz4_frame(const uint8_t* data, size_t len);
+}
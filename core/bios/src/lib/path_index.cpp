@@ -0,0 +1,312 @@
+#include "path_index.hpp"
+#include "file_io.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <thread>
+#endif
+
+namespace lib {
+    // Scores follow fzf's: a base per matched character, bonuses for where
+    // it matched, and penalties for gaps between matches
+    static const int kScoreMatch = 16;
+    static const int kScoreGapStart = -3;
+    static const int kScoreGapExtension = -1;
+    static const int kBonusDelimiter = 9;       // After '/'
+    static const int kBonusBoundary = 8;        // After '_', '-', '.' or ' '
+    static const int kBonusCamel = 7;           // fooBar, foo1
+    static const int kBonusConsecutive = 4;
+    static const int kBonusFirstCharMultiplier = 2;
+    static const int kBonusBasename = 2;
+#ifdef __EMSCRIPTEN_PTHREADS__
+    // Paths per worker below which threads cost more than they save
+    static const size_t kPathsPerWorker = 16384;
+#endif
+
+    static inline uint8_t fold(uint8_t c) { return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c; }
+
+    // Letters and digits get a bit each and common separators share the
+    // rest; other bytes fold onto the last bits
+    static inline uint64_t char_bit(uint8_t c) {
+        c = fold(c);
+        if (c >= 'a' && c <= 'z') return 1ull << (c - 'a');
+        if (c >= '0' && c <= '9') return 1ull << (26 + c - '0');
+        switch (c) {
+            case '.': return 1ull << 36;
+            case '_': return 1ull << 37;
+            case '-': return 1ull << 38;
+            case '/': return 1ull << 39;
+            case ' ': return 1ull << 40;
+            default: return 1ull << (41 + c % 23);
+        }
+    }
+
+    static uint64_t char_mask(std::string_view text) {
+        uint64_t mask = 0;
+        for (char c : text) mask |= char_bit(static_cast<uint8_t>(c));
+        return mask;
+    }
+
+    // First byte in [data, data + len) equal to `c` (already folded) ignoring
+    // ASCII case, or nullptr
+    static const char* find_folded(const char* data, size_t len, uint8_t c) {
+        size_t i = 0;
+#ifdef __wasm_simd128__
+        // Letters differ from their upper case only in bit 5, so setting it
+        // matches both
+        const v128_t needle = wasm_i8x16_splat(static_cast<int8_t>(c));
+        const v128_t case_bit = wasm_i8x16_splat(c >= 'a' && c <= 'z' ? 0x20 : 0);
+        for (; i + 16 <= len; i += 16) {
+            v128_t block = wasm_v128_or(wasm_v128_load(data + i), case_bit);
+            uint32_t mask = wasm_i8x16_bitmask(wasm_i8x16_eq(block, needle));
+            if (mask) return data + i + __builtin_ctz(mask);
+        }
+#endif
+        for (; i < len; ++i) {
+            if (fold(static_cast<uint8_t>(data[i])) == c) return data + i;
+        }
+        return nullptr;
+    }
+
+    static int boundary_bonus(const char* path, size_t i) {
+        uint8_t previous = i == 0 ? '/' : static_cast<uint8_t>(path[i - 1]);
+        uint8_t current = static_cast<uint8_t>(path[i]);
+        if (previous == '/') return kBonusDelimiter;
+        if (previous == '_' || previous == '-' || previous == '.' || previous == ' ') return kBonusBoundary;
+        if (previous >= 'a' && previous <= 'z' && current >= 'A' && current <= 'Z') return kBonusCamel;
+        if (!(previous >= '0' && previous <= '9') && current >= '0' && current <= '9') return kBonusCamel;
+        return 0;
+    }
+
+    // fzf's v1 algorithm: the earliest match found going forward, narrowed
+    // to the shortest window ending there by matching backward, then scored
+    // left to right. -1 if `query` (folded) is not a subsequence.
+    static int score_path(const char* path, size_t length, size_t basename, std::string_view query) {
+        const char* cursor = path;
+        const char* end = path + length;
+        for (char c : query) {
+            const char* hit = find_folded(cursor, end - cursor, static_cast<uint8_t>(c));
+            if (!hit) return -1;
+            cursor = hit + 1;
+        }
+
+        size_t stop = cursor - path;
+        size_t start = stop;
+        for (size_t q = query.size(); q > 0; --start) {
+            if (fold(static_cast<uint8_t>(path[start - 1])) == static_cast<uint8_t>(query[q - 1])) --q;
+        }
+
+        int score = 0;
+        int run_bonus = 0;
+        bool in_gap = false;
+        size_t q = 0;
+        for (size_t i = start; i < stop; ++i) {
+            if (fold(static_cast<uint8_t>(path[i])) != static_cast<uint8_t>(query[q])) {
+                score += in_gap ? kScoreGapExtension : kScoreGapStart;
+                in_gap = true;
+                continue;
+            }
+
+            int bonus = boundary_bonus(path, i);
+            if (i > start && !in_gap) {
+                // A run keeps the bonus of the boundary that started it
+                bonus = std::max(bonus, std::max(run_bonus, kBonusConsecutive));
+            } else {
+                run_bonus = bonus;
+            }
+            if (q == 0) bonus *= kBonusFirstCharMultiplier;
+            if (i >= basename) bonus += kBonusBasename;
+
+            score += kScoreMatch + bonus;
+            in_gap = false;
+            ++q;
+        }
+        return score;
+    }
+
+    uint32_t PathIndex::find_id(std::string_view path) const {
+        uint64_t hash = xxh3_64(reinterpret_cast<const uint8_t*>(path.data()), path.size());
+        auto range = ids_.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            const Entry& entry = entries_[it->second];
+            if (std::string_view(arena_.data() + entry.offset, entry.length) == path) return it->second;
+        }
+        return UINT32_MAX;
+    }
+
+    void PathIndex::intern(std::string_view path) {
+        size_t slash = path.rfind('/');
+        Entry entry;
+        entry.offset = static_cast<uint32_t>(arena_.size());
+        entry.length = static_cast<uint32_t>(path.size());
+        entry.basename = slash == std::string_view::npos ? 0 : static_cast<uint32_t>(slash + 1);
+        entry.live = true;
+        entry.mask = char_mask(path);
+
+        arena_.append(path.data(), path.size());
+        ids_.emplace(xxh3_64(reinterpret_cast<const uint8_t*>(path.data()), path.size()),
+                     static_cast<uint32_t>(entries_.size()));
+        entries_.push_back(entry);
+        ++live_;
+    }
+
+    void PathIndex::add(const std::string& path) {
+        if (find_id(path) == UINT32_MAX) intern(path);
+    }
+
+    void PathIndex::remove(const std::string& path) {
+        uint32_t id = find_id(path);
+        if (id == UINT32_MAX) return;
+
+        uint64_t hash = xxh3_64(reinterpret_cast<const uint8_t*>(path.data()), path.size());
+        auto range = ids_.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == id) {
+                ids_.erase(it);
+                break;
+            }
+        }
+        entries_[id].live = false;
+        --live_;
+        dead_bytes_ += entries_[id].length;
+        if (dead_bytes_ > arena_.size() / 2) compact();
+    }
+
+    // Rewrite the arena without removed paths
+    void PathIndex::compact() {
+        std::string arena;
+        std::vector<Entry> entries;
+        arena.reserve(arena_.size() - dead_bytes_);
+        entries.reserve(live_);
+        ids_.clear();
+        for (const Entry& entry : entries_) {
+            if (!entry.live) continue;
+            Entry moved = entry;
+            moved.offset = static_cast<uint32_t>(arena.size());
+            arena.append(arena_, entry.offset, entry.length);
+            ids_.emplace(xxh3_64(reinterpret_cast<const uint8_t*>(arena.data() + moved.offset), moved.length),
+                         static_cast<uint32_t>(entries.size()));
+            entries.push_back(moved);
+        }
+        arena_ = std::move(arena);
+        entries_ = std::move(entries);
+        dead_bytes_ = 0;
+    }
+
+    void PathIndex::walk(const std::string& dir) {
+        DIR* handle = opendir(dir.c_str());
+        if (!handle) return;
+
+        std::vector<std::string> subdirs;
+        while (struct dirent* entry = readdir(handle)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            std::string path = dir.back() == '/' ? dir + entry->d_name : dir + "/" + entry->d_name;
+
+            struct stat st;
+            if (lstat(path.c_str(), &st) != 0) continue;
+            if (S_ISDIR(st.st_mode)) {
+                if (!system_directory(path)) subdirs.push_back(path);
+            } else if (S_ISREG(st.st_mode)) {
+                intern(path);
+            }
+        }
+        closedir(handle);
+
+        for (const std::string& subdir : subdirs) walk(subdir);
+    }
+
+    void PathIndex::build(const std::string& root) {
+        arena_.clear();
+        entries_.clear();
+        ids_.clear();
+        live_ = 0;
+        dead_bytes_ = 0;
+        walk(root);
+    }
+
+    // Orders better matches first
+    bool PathIndex::better(const Ranked& a, const Ranked& b) {
+        if (a.score != b.score) return a.score > b.score;
+        if (a.length != b.length) return a.length < b.length;
+        return a.id < b.id;
+    }
+
+    // Keep the best `limit` of entries [begin, end) in a heap whose top is
+    // the worst kept
+    void PathIndex::scan(size_t begin, size_t end, std::string_view query, uint64_t query_mask, size_t limit,
+                         std::vector<Ranked>& heap) const {
+        for (size_t id = begin; id < end; ++id) {
+            const Entry& entry = entries_[id];
+            if (!entry.live || (entry.mask & query_mask) != query_mask) continue;
+
+            int score = score_path(arena_.data() + entry.offset, entry.length, entry.basename, query);
+            if (score < 0) continue;
+            Ranked ranked{score, entry.length, static_cast<uint32_t>(id)};
+            if (heap.size() < limit) {
+                heap.push_back(ranked);
+                std::push_heap(heap.begin(), heap.end(), better);
+            } else if (better(ranked, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), better);
+                heap.back() = ranked;
+                std::push_heap(heap.begin(), heap.end(), better);
+            }
+        }
+    }
+
+    std::vector<PathIndex::Match> PathIndex::find(std::string_view query, size_t limit) const {
+        std::vector<Match> matches;
+        if (limit == 0) return matches;
+
+        std::string folded(query);
+        for (char& c : folded) c = static_cast<char>(fold(static_cast<uint8_t>(c)));
+        uint64_t query_mask = char_mask(folded);
+
+        std::vector<Ranked> heap;
+#ifdef __EMSCRIPTEN_PTHREADS__
+        size_t workers = std::min<size_t>(std::thread::hardware_concurrency(), entries_.size() / kPathsPerWorker);
+        if (workers > 1) {
+            // Each worker keeps its own top `limit`; the union holds the overall best
+            std::vector<std::vector<Ranked>> heaps(workers);
+            std::vector<std::thread> threads;
+            size_t per_worker = (entries_.size() + workers - 1) / workers;
+            for (size_t w = 0; w < workers; ++w) {
+                size_t begin = std::min(entries_.size(), w * per_worker);
+                size_t end = std::min(entries_.size(), begin + per_worker);
+                threads.emplace_back(&PathIndex::scan, this, begin, end, std::string_view(folded), query_mask, limit,
+                                     std::ref(heaps[w]));
+            }
+            for (std::thread& thread : threads) thread.join();
+            for (const std::vector<Ranked>& partial : heaps) heap.insert(heap.end(), partial.begin(), partial.end());
+        } else {
+            scan(0, entries_.size(), folded, query_mask, limit, heap);
+        }
+#else
+        scan(0, entries_.size(), folded, query_mask, limit, heap);
+#endif
+
+        std::sort(heap.begin(), heap.end(), better);
+        if (heap.size() > limit) heap.resize(limit);
+        for (const Ranked& ranked : heap) {
+            const Entry& entry = entries_[ranked.id];
+            matches.push_back(Match{ranked.score, std::string(arena_, entry.offset, entry.length)});
+        }
+        return matches;
+    }
+
+    PathIndex* path_index(bool build) {
+        static PathIndex* shared = nullptr;
+        if (!shared && build) {
+            shared = new PathIndex();
+            shared->build("/");
+        }
+        return shared;
+    }
+}
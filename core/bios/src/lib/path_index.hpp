@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lib {
+    // Every file path under a root, interned into one contiguous arena, for
+    // fzf-style fuzzy matching: the query's characters must appear in order
+    // (ASCII case-insensitively), and matches score higher at word and path
+    // boundaries, in runs, and in the file name.
+    //
+    // Each path carries a 64-bit character-set mask, so most paths are
+    // rejected by a single AND before any scanning.
+    class PathIndex {
+    public:
+        struct Match {
+            int score;
+            std::string path;
+        };
+
+        // Replace the index with every regular file under `root`
+        void build(const std::string& root);
+
+        // Keep the index in step with file writes and removals
+        void add(const std::string& path);
+        void remove(const std::string& path);
+
+        // The `limit` best matches for `query`, best first; ties go to the
+        // shorter path
+        std::vector<Match> find(std::string_view query, size_t limit) const;
+
+        size_t size() const { return live_; }
+
+    private:
+        struct Entry {
+            uint32_t offset;        // Into arena_
+            uint32_t length;
+            uint32_t basename;      // Offset of the file name within the path
+            bool live;
+            uint64_t mask;
+        };
+
+        struct Ranked {
+            int score;
+            uint32_t length;
+            uint32_t id;
+        };
+
+        std::string arena_;
+        std::vector<Entry> entries_;
+        std::unordered_multimap<uint64_t, uint32_t> ids_;   // Path hash -> entry
+        size_t live_ = 0;
+        size_t dead_bytes_ = 0;
+
+        uint32_t find_id(std::string_view path) const;
+        void intern(std::string_view path);
+        void compact();
+        void walk(const std::string& dir);
+        void scan(size_t begin, size_t end, std::string_view query, uint64_t query_mask, size_t limit,
+                  std::vector<Ranked>& heap) const;
+        static bool better(const Ranked& a, const Ranked& b);
+    };
+
+    // The index shared by the exports and commands, built over "/" on first
+    // use; with `build` false, nullptr until then
+    PathIndex* path_index(bool build = true);
+}
@@ -0,0 +1,590 @@
+#include "regex.hpp"
+#include "search.hpp"
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+
+namespace lib {
+    // Upper bound on instructions, so `{n,m}` expansion can't blow up
+    static const size_t kMaxProgram = 1 << 16;
+
+    // A byte of a word for `\b \B \< \>`, the same set as `\w`
+    static bool is_word(char c) {
+        return isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    struct Regex::Node {
+        enum Type { kEmpty, kChar, kAny, kClass, kCat, kAlt, kRepeat, kGroup, kBol, kEol, kWord };
+
+        Type type = kEmpty;
+        uint8_t c = 0;       // Byte, or for kWord the assertion
+        int index = 0;       // Class index or capture group
+        int min = 0;
+        int max = 0;         // -1 for unbounded
+        std::vector<Node> children;
+    };
+
+    class Regex::Parser {
+    public:
+        Parser(Regex& regex, std::string_view pattern, int flags)
+            : regex_(regex), pattern_(pattern), extended_(flags & kExtended), fold_(flags & kIgnoreCase) {}
+
+        bool parse(Node& root, std::string& error) {
+            root = parse_alternation();
+            if (error_.empty() && pos_ < pattern_.size()) error_ = "unmatched )";
+            error = error_;
+            return error_.empty();
+        }
+
+    private:
+        Regex& regex_;
+        std::string_view pattern_;
+        size_t pos_ = 0;
+        bool extended_;
+        bool fold_;
+        std::string error_;
+
+        // Return the operator at the cursor, if any, without consuming it.
+        // Operators that are escaped in BRE are two bytes wide.
+        char peek_operator(size_t& width) const {
+            if (pos_ >= pattern_.size()) return 0;
+            char c = pattern_[pos_];
+            if (c == '*') {
+                width = 1;
+                return c;
+            }
+            if (extended_ && strchr("()|+?{", c)) {
+                width = 1;
+                return c;
+            }
+            if (!extended_ && c == '\\' && pos_ + 1 < pattern_.size() && strchr("()|+?{", pattern_[pos_ + 1])) {
+                width = 2;
+                return pattern_[pos_ + 1];
+            }
+            return 0;
+        }
+
+        Node parse_alternation() {
+            Node first = parse_concatenation();
+            size_t width;
+            if (peek_operator(width) != '|') return first;
+
+            Node alt;
+            alt.type = Node::kAlt;
+            alt.children.push_back(std::move(first));
+            while (error_.empty() && peek_operator(width) == '|') {
+                pos_ += width;
+                alt.children.push_back(parse_concatenation());
+            }
+            return alt;
+        }
+
+        Node parse_concatenation() {
+            Node cat;
+            cat.type = Node::kCat;
+            size_t width;
+            while (error_.empty() && pos_ < pattern_.size()) {
+                char op = peek_operator(width);
+                if (op == '|' || op == ')') break;
+                cat.children.push_back(parse_repeat());
+            }
+            return cat;
+        }
+
+        bool parse_count(int& value) {
+            if (pos_ >= pattern_.size() || !isdigit(static_cast<unsigned char>(pattern_[pos_]))) return false;
+            value = 0;
+            while (pos_ < pattern_.size() && isdigit(static_cast<unsigned char>(pattern_[pos_]))) {
+                value = value * 10 + (pattern_[pos_++] - '0');
+                if (value > 1000) {
+                    error_ = "repeat count too large";
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        Node parse_repeat() {
+            Node atom = parse_atom();
+            size_t width;
+            char op;
+            while (error_.empty() && (op = peek_operator(width)) && strchr("*+?{", op)) {
+                size_t start = pos_;
+                pos_ += width;
+
+                Node repeat;
+                repeat.type = Node::kRepeat;
+                if (op == '*') {
+                    repeat.min = 0;
+                    repeat.max = -1;
+                } else if (op == '+') {
+                    repeat.min = 1;
+                    repeat.max = -1;
+                } else if (op == '?') {
+                    repeat.min = 0;
+                    repeat.max = 1;
+                } else {
+                    if (!parse_count(repeat.min)) {
+                        if (!error_.empty()) return atom;
+                        if (extended_) {
+                            // A brace that doesn't start a count is a literal in ERE
+                            pos_ = start;
+                            break;
+                        }
+                        error_ = "invalid repeat count";
+                        return atom;
+                    }
+                    repeat.max = repeat.min;
+                    if (pos_ < pattern_.size() && pattern_[pos_] == ',') {
+                        ++pos_;
+                        if (!parse_count(repeat.max)) repeat.max = -1;
+                    }
+                    std::string_view close = extended_ ? "}" : "\\}";
+                    if (pattern_.substr(pos_, close.size()) != close || (repeat.max >= 0 && repeat.max < repeat.min)) {
+                        error_ = "invalid repeat count";
+                        return atom;
+                    }
+                    pos_ += close.size();
+                }
+
+                repeat.children.push_back(std::move(atom));
+                atom = std::move(repeat);
+            }
+            return atom;
+        }
+
+        Node literal(uint8_t c) {
+            Node node;
+            if (fold_ && isalpha(c)) {
+                std::bitset<256> set;
+                set.set(tolower(c));
+                set.set(toupper(c));
+                return class_node(set);
+            }
+            node.type = Node::kChar;
+            node.c = c;
+            return node;
+        }
+
+        Node class_node(const std::bitset<256>& set) {
+            Node node;
+            node.type = Node::kClass;
+            node.index = static_cast<int>(regex_.classes_.size());
+            regex_.classes_.push_back(set);
+            return node;
+        }
+
+        static void add_shorthand(std::bitset<256>& set, char kind) {
+            for (int c = 0; c < 256; ++c) {
+                bool in = false;
+                switch (tolower(kind)) {
+                    case 'd': in = isdigit(c); break;
+                    case 'w': in = isalnum(c) || c == '_'; break;
+                    case 's': in = isspace(c); break;
+                }
+                if (isupper(kind)) in = !in;
+                if (in) set.set(c);
+            }
+        }
+
+        Node parse_class() {
+            std::bitset<256> set;
+            bool negate = false;
+            if (pos_ < pattern_.size() && pattern_[pos_] == '^') {
+                negate = true;
+                ++pos_;
+            }
+
+            bool first = true;
+            while (pos_ < pattern_.size() && (first || pattern_[pos_] != ']')) {
+                first = false;
+                uint8_t lo = static_cast<uint8_t>(pattern_[pos_++]);
+
+                if (lo == '[' && pos_ < pattern_.size() && pattern_[pos_] == ':') {
+                    size_t end = pattern_.find(":]", pos_);
+                    if (end == std::string_view::npos) {
+                        error_ = "unterminated character class";
+                        return Node();
+                    }
+                    std::string_view name = pattern_.substr(pos_ + 1, end - pos_ - 1);
+                    for (int c = 0; c < 256; ++c) {
+                        if ((name == "alpha" && isalpha(c)) || (name == "digit" && isdigit(c)) ||
+                            (name == "alnum" && isalnum(c)) || (name == "space" && isspace(c)) ||
+                            (name == "upper" && isupper(c)) || (name == "lower" && islower(c)) ||
+                            (name == "punct" && ispunct(c)) || (name == "xdigit" && isxdigit(c))) {
+                            set.set(c);
+                        }
+                    }
+                    pos_ = end + 2;
+                    continue;
+                }
+
+                if (lo == '\\' && pos_ < pattern_.size() && strchr("dwsDWS", pattern_[pos_])) {
+                    add_shorthand(set, pattern_[pos_++]);
+                    continue;
+                }
+
+                uint8_t hi = lo;
+                if (pos_ + 1 < pattern_.size() && pattern_[pos_] == '-' && pattern_[pos_ + 1] != ']') {
+                    hi = static_cast<uint8_t>(pattern_[pos_ + 1]);
+                    pos_ += 2;
+                }
+                for (int c = lo; c <= hi; ++c) set.set(c);
+            }
+
+            if (pos_ >= pattern_.size()) {
+                error_ = "unterminated character class";
+                return Node();
+            }
+            ++pos_;
+
+            if (fold_) {
+                for (int c = 0; c < 256; ++c) {
+                    if (set.test(c) && isalpha(c)) {
+                        set.set(tolower(c));
+                        set.set(toupper(c));
+                    }
+                }
+            }
+            if (negate) set.flip();
+            return class_node(set);
+        }
+
+        Node parse_atom() {
+            size_t width;
+            char op = peek_operator(width);
+
+            if (op == '(') {
+                pos_ += width;
+                Node group;
+                group.type = Node::kGroup;
+                group.index = static_cast<int>(regex_.groups_++);
+                if (group.index >= static_cast<int>(kMaxGroups)) {
+                    error_ = "too many groups";
+                    return group;
+                }
+                group.children.push_back(parse_alternation());
+                if (peek_operator(width) != ')') {
+                    if (error_.empty()) error_ = "unmatched (";
+                    return group;
+                }
+                pos_ += width;
+                return group;
+            }
+            if (op == '*' || op == '+' || op == '?') {
+                // A leading repeat operator applies to nothing; take it literally
+                pos_ += width;
+                return literal(static_cast<uint8_t>(op));
+            }
+
+            char c = pattern_[pos_++];
+            Node node;
+            switch (c) {
+                case '.':
+                    node.type = Node::kAny;
+                    return node;
+                case '^':
+                    node.type = Node::kBol;
+                    return node;
+                case '$':
+                    node.type = Node::kEol;
+                    return node;
+                case '[':
+                    return parse_class();
+                case '\\':
+                    break;
+                default:
+                    return literal(static_cast<uint8_t>(c));
+            }
+
+            if (pos_ >= pattern_.size()) {
+                error_ = "trailing backslash";
+                return node;
+            }
+            c = pattern_[pos_++];
+            if (strchr("dwsDWS", c)) {
+                std::bitset<256> set;
+                add_shorthand(set, c);
+                return class_node(set);
+            }
+            if (c >= '1' && c <= '9') {
+                error_ = "backreferences are not supported";
+                return node;
+            }
+            if (strchr("bB<>", c)) {
+                node.type = Node::kWord;
+                node.c = static_cast<uint8_t>(c);
+                return node;
+            }
+            if (c == 'n') return literal('\n');
+            if (c == 't') return literal('\t');
+            return literal(static_cast<uint8_t>(c));
+        }
+    };
+
+    void Regex::emit(const Node& node) {
+        if (program_.size() > kMaxProgram) return;
+
+        switch (node.type) {
+            case Node::kEmpty:
+                break;
+            case Node::kChar:
+                program_.push_back({kChar, node.c, 0, 0});
+                break;
+            case Node::kAny:
+                program_.push_back({kAny, 0, 0, 0});
+                break;
+            case Node::kClass:
+                program_.push_back({kClass, 0, node.index, 0});
+                break;
+            case Node::kBol:
+                program_.push_back({kBol, 0, 0, 0});
+                break;
+            case Node::kEol:
+                program_.push_back({kEol, 0, 0, 0});
+                break;
+            case Node::kWord:
+                program_.push_back({kWord, node.c, 0, 0});
+                break;
+            case Node::kCat:
+                for (const Node& child : node.children) emit(child);
+                break;
+            case Node::kGroup:
+                program_.push_back({kSave, 0, 2 * node.index, 0});
+                emit(node.children[0]);
+                program_.push_back({kSave, 0, 2 * node.index + 1, 0});
+                break;
+            case Node::kAlt: {
+                // split L1, next; L1: a; jmp end; next: split L2, ...
+                std::vector<size_t> jumps;
+                for (size_t i = 0; i < node.children.size(); ++i) {
+                    size_t split = program_.size();
+                    bool last = i + 1 == node.children.size();
+                    if (!last) program_.push_back({kSplit, 0, 0, 0});
+                    emit(node.children[i]);
+                    if (!last) {
+                        jumps.push_back(program_.size());
+                        program_.push_back({kJmp, 0, 0, 0});
+                        program_[split].x = static_cast<int>(split + 1);
+                        program_[split].y = static_cast<int>(program_.size());
+                    }
+                }
+                for (size_t jump : jumps) program_[jump].x = static_cast<int>(program_.size());
+                break;
+            }
+            case Node::kRepeat: {
+                const Node& body = node.children[0];
+                for (int i = 0; i < node.min; ++i) emit(body);
+
+                if (node.max < 0) {
+                    // L: split body, end; body; jmp L
+                    size_t split = program_.size();
+                    program_.push_back({kSplit, 0, 0, 0});
+                    emit(body);
+                    program_.push_back({kJmp, 0, static_cast<int>(split), 0});
+                    program_[split].x = static_cast<int>(split + 1);
+                    program_[split].y = static_cast<int>(program_.size());
+                } else {
+                    std::vector<size_t> splits;
+                    for (int i = node.min; i < node.max; ++i) {
+                        splits.push_back(program_.size());
+                        program_.push_back({kSplit, 0, 0, 0});
+                        emit(body);
+                    }
+                    for (size_t split : splits) {
+                        program_[split].x = static_cast<int>(split + 1);
+                        program_[split].y = static_cast<int>(program_.size());
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    bool Regex::compile(std::string_view pattern, int flags, std::string* error) {
+        program_.clear();
+        classes_.clear();
+        literal_text_.clear();
+        groups_ = 1;
+
+        Node root;
+        std::string message;
+        Parser parser(*this, pattern, flags);
+        if (!parser.parse(root, message)) {
+            if (error) *error = message;
+            return false;
+        }
+
+        // A concatenation of plain bytes is searched for directly; otherwise
+        // keep its leading bytes as a prefix to skip ahead with
+        const std::vector<Node>& parts = root.type == Node::kCat ? root.children : std::vector<Node>{root};
+        literal_ = true;
+        for (const Node& part : parts) {
+            if (part.type != Node::kChar) {
+                literal_ = false;
+                break;
+            }
+            literal_text_ += static_cast<char>(part.c);
+        }
+        if (literal_) return true;
+
+        program_.push_back({kSave, 0, 0, 0});
+        emit(root);
+        program_.push_back({kSave, 0, 1, 0});
+        program_.push_back({kMatch, 0, 0, 0});
+
+        if (program_.size() > kMaxProgram) {
+            if (error) *error = "pattern too large";
+            return false;
+        }
+        return true;
+    }
+
+    // Follows jumps, splits, saves and assertions from `pc` to the
+    // instructions that consume a byte (or match), in priority order. An
+    // explicit stack rather than recursion, as programs can be long enough
+    // to overflow the small wasm stack.
+    void Regex::add_thread(std::vector<int>& pcs, std::vector<size_t>& caps, std::vector<uint32_t>& seen, std::vector<Work>& stack,
+                           uint32_t generation, int pc, size_t* thread_caps, size_t sp, std::string_view text) const {
+        stack.clear();
+        stack.push_back({pc, -1, 0});
+        while (!stack.empty()) {
+            Work work = stack.back();
+            stack.pop_back();
+            if (work.slot >= 0) {
+                thread_caps[work.slot] = work.value;
+                continue;
+            }
+            pc = work.pc;
+            if (seen[pc] == generation) continue;
+            seen[pc] = generation;
+
+            const Inst& inst = program_[pc];
+            switch (inst.op) {
+                case kJmp:
+                    stack.push_back({inst.x, -1, 0});
+                    break;
+                case kSplit:
+                    // Pushed in reverse, so x is followed first
+                    stack.push_back({inst.y, -1, 0});
+                    stack.push_back({inst.x, -1, 0});
+                    break;
+                case kSave:
+                    // Restored once everything reached through pc + 1 is done
+                    stack.push_back({0, inst.x, thread_caps[inst.x]});
+                    thread_caps[inst.x] = sp;
+                    stack.push_back({pc + 1, -1, 0});
+                    break;
+                case kBol:
+                    if (sp == 0) stack.push_back({pc + 1, -1, 0});
+                    break;
+                case kEol:
+                    if (sp == text.size()) stack.push_back({pc + 1, -1, 0});
+                    break;
+                case kWord: {
+                    bool before = sp > 0 && is_word(text[sp - 1]);
+                    bool after = sp < text.size() && is_word(text[sp]);
+                    bool holds = false;
+                    switch (inst.c) {
+                        case 'b': holds = before != after; break;
+                        case 'B': holds = before == after; break;
+                        case '<': holds = !before && after; break;
+                        case '>': holds = before && !after; break;
+                    }
+                    if (holds) stack.push_back({pc + 1, -1, 0});
+                    break;
+                }
+                default:
+                    pcs.push_back(pc);
+                    caps.insert(caps.end(), thread_caps, thread_caps + 2 * groups_);
+                    break;
+            }
+        }
+    }
+
+    bool Regex::search(std::string_view text, size_t from, Match& match) const {
+        for (size_t i = 0; i < kMaxGroups; ++i) match.start[i] = match.end[i] = std::string_view::npos;
+
+        if (literal_) {
+            size_t at = find_literal(text, literal_text_, from);
+            if (at == std::string_view::npos) return false;
+            match.start[0] = at;
+            match.end[0] = at + literal_text_.size();
+            return true;
+        }
+
+        const size_t ncap = 2 * groups_;
+        const size_t len = text.size();
+        std::vector<int> clist, nlist;
+        std::vector<size_t> ccaps, ncaps;
+        std::vector<uint32_t> seen(program_.size(), 0);
+        std::vector<size_t> scratch(ncap);
+        std::vector<Work> stack;
+        uint32_t generation = 1;
+        bool matched = false;
+        std::vector<size_t> best(ncap, std::string_view::npos);
+
+        for (size_t sp = from;; ++sp) {
+            if (!matched) {
+                if (clist.empty()) {
+                    // Nothing in flight: jump to the next place the required prefix occurs
+                    if (!literal_text_.empty()) {
+                        sp = find_literal(text, literal_text_, sp);
+                        if (sp == std::string_view::npos) break;
+                    }
+                    ++generation;
+                }
+                std::fill(scratch.begin(), scratch.end(), std::string_view::npos);
+                add_thread(clist, ccaps, seen, stack, generation, 0, scratch.data(), sp, text);
+            }
+            if (clist.empty()) {
+                if (matched || sp >= len) break;
+                continue;
+            }
+
+            ++generation;
+            nlist.clear();
+            ncaps.clear();
+            for (size_t t = 0; t < clist.size(); ++t) {
+                const Inst& inst = program_[clist[t]];
+                size_t* thread_caps = &ccaps[t * ncap];
+                bool step = false;
+                switch (inst.op) {
+                    case kChar:
+                        step = sp < len && static_cast<uint8_t>(text[sp]) == inst.c;
+                        break;
+                    case kAny:
+                        step = sp < len && text[sp] != '\n';
+                        break;
+                    case kClass:
+                        step = sp < len && classes_[inst.x].test(static_cast<uint8_t>(text[sp]));
+                        break;
+                    case kMatch:
+                        matched = true;
+                        best.assign(thread_caps, thread_caps + ncap);
+                        // Lower-priority threads can't produce a preferred match
+                        t = clist.size();
+                        break;
+                    default:
+                        break;
+                }
+                if (step) {
+                    std::copy(thread_caps, thread_caps + ncap, scratch.begin());
+                    add_thread(nlist, ncaps, seen, stack, generation, clist[t] + 1, scratch.data(), sp + 1, text);
+                }
+            }
+
+            clist.swap(nlist);
+            ccaps.swap(ncaps);
+            if (sp >= len) break;
+        }
+
+        if (!matched) return false;
+        for (size_t i = 0; i < groups_; ++i) {
+            match.start[i] = best[2 * i];
+            match.end[i] = best[2 * i + 1];
+            if (match.end[i] == std::string_view::npos) match.start[i] = std::string_view::npos;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lib {
+    // A regular expression compiled for a Pike VM, which runs in
+    // O(pattern * text) time with no backtracking. Supports literals, `.`,
+    // bracket classes, `^`, `$`, `*`, `+`, `?`, `{n,m}`, alternation, groups,
+    // the `\d \w \s` shorthands and the `\b \B \< \>` word assertions.
+    // Basic (BRE) syntax treats `( ) | + ? { }` as literals unless escaped;
+    // extended (ERE) syntax is the reverse.
+    // Patterns without operators skip the VM and use lib::find_literal.
+    class Regex {
+    public:
+        enum Flags {
+            kExtended = 1 << 0,
+            kIgnoreCase = 1 << 1
+        };
+
+        static constexpr size_t kMaxGroups = 10;
+
+        struct Match {
+            size_t start[kMaxGroups];
+            size_t end[kMaxGroups];
+            bool matched(size_t group) const { return start[group] != std::string_view::npos; }
+        };
+
+        Regex() = default;
+
+        // Compile `pattern`; returns false and sets `error` on bad syntax
+        bool compile(std::string_view pattern, int flags, std::string* error = nullptr);
+
+        // Search `text` for the leftmost match starting at or after `from`.
+        // Anchors refer to the whole of `text`, not to `from`.
+        bool search(std::string_view text, size_t from, Match& match) const;
+
+        bool is_literal() const { return literal_; }
+        size_t groups() const { return groups_; }
+
+    private:
+        enum Op : uint8_t { kChar, kAny, kClass, kSplit, kJmp, kSave, kBol, kEol, kWord, kMatch };
+
+        struct Inst {
+            Op op;
+            uint8_t c;    // Byte, or for kWord one of "bB<>"
+            int x;    // Jump target, class index or save slot
+            int y;    // Second split target
+        };
+
+        // Pending step of add_thread: follow `pc`, or when `slot` is set,
+        // put back the capture a kSave overwrote
+        struct Work {
+            int pc;
+            int slot;
+            size_t value;
+        };
+
+        struct Node;
+        class Parser;
+
+        std::vector<Inst> program_;
+        std::vector<std::bitset<256>> classes_;
+        std::string literal_text_;    // Whole pattern when literal_, else the required prefix
+        bool literal_ = false;
+        size_t groups_ = 1;
+
+        void emit(const Node& node);
+        void add_thread(std::vector<int>& pcs, std::vector<size_t>& caps, std::vector<uint32_t>& seen, std::vector<Work>& stack,
+                        uint32_t generation, int pc, size_t* thread_caps, size_t sp, std::string_view text) const;
+    };
+}
@@ -0,0 +1,110 @@
+#include "search.hpp"
+#include <cstring>
+#include <cstdint>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+namespace lib {
+    const char* find_byte(const char* data, size_t len, char byte) {
+#ifdef __wasm_simd128__
+        const v128_t needle = wasm_i8x16_splat(byte);
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16) {
+            uint32_t mask = wasm_i8x16_bitmask(wasm_i8x16_eq(wasm_v128_load(data + i), needle));
+            if (mask) return data + i + __builtin_ctz(mask);
+        }
+        return static_cast<const char*>(memchr(data + i, byte, len - i));
+#else
+        return static_cast<const char*>(memchr(data, byte, len));
+#endif
+    }
+
+    size_t count_byte(const char* data, size_t len, char byte) {
+        size_t count = 0;
+        size_t i = 0;
+#ifdef __wasm_simd128__
+        const v128_t needle = wasm_i8x16_splat(byte);
+        for (; i + 16 <= len; i += 16) {
+            v128_t block = wasm_v128_load(data + i);
+            count += __builtin_popcount(wasm_i8x16_bitmask(wasm_i8x16_eq(block, needle)));
+        }
+#endif
+        for (; i < len; ++i) {
+            if (data[i] == byte) ++count;
+        }
+        return count;
+    }
+
+    size_t find_literal(std::string_view haystack, std::string_view needle, size_t from) {
+        const size_t n = needle.size();
+        if (from > haystack.size()) return std::string_view::npos;
+        if (n == 0) return from;
+        if (n > haystack.size() - from) return std::string_view::npos;
+        if (n == 1) {
+            const char* hit = find_byte(haystack.data() + from, haystack.size() - from, needle[0]);
+            return hit ? static_cast<size_t>(hit - haystack.data()) : std::string_view::npos;
+        }
+
+        const char* data = haystack.data();
+        const size_t last = haystack.size() - n;    // Last valid start position
+        size_t i = from;
+
+#ifdef __wasm_simd128__
+        // Compare the needle's first and last bytes against 16 candidate
+        // positions at once and only memcmp where both agree
+        const v128_t first = wasm_i8x16_splat(needle[0]);
+        const v128_t tail = wasm_i8x16_splat(needle[n - 1]);
+        for (; i + 16 <= last + 1; i += 16) {
+            v128_t block_first = wasm_v128_load(data + i);
+            v128_t block_last = wasm_v128_load(data + i + n - 1);
+            uint32_t mask = wasm_i8x16_bitmask(wasm_v128_and(wasm_i8x16_eq(block_first, first), wasm_i8x16_eq(block_last, tail)));
+            while (mask) {
+                size_t bit = __builtin_ctz(mask);
+                if (memcmp(data + i + bit + 1, needle.data() + 1, n - 2) == 0) return i + bit;
+                mask &= mask - 1;
+            }
+        }
+#endif
+
+        while (i <= last) {
+            const char* hit = find_byte(data + i, last - i + 1, needle[0]);
+            if (!hit) break;
+            i = static_cast<size_t>(hit - data);
+            if (memcmp(hit + 1, needle.data() + 1, n - 1) == 0) return i;
+            ++i;
+        }
+
+        return std::string_view::npos;
+    }
+
+    void split_fields(std::string_view record, char delim, std::vector<std::string_view>& fields) {
+        fields.clear();
+        const char* data = record.data();
+        const size_t len = record.size();
+        size_t start = 0;
+        size_t i = 0;
+
+#ifdef __wasm_simd128__
+        // Take delimiter positions sixteen bytes at a time from a bitmask
+        const v128_t needle = wasm_i8x16_splat(delim);
+        for (; i + 16 <= len; i += 16) {
+            uint32_t mask = wasm_i8x16_bitmask(wasm_i8x16_eq(wasm_v128_load(data + i), needle));
+            while (mask) {
+                size_t at = i + __builtin_ctz(mask);
+                fields.emplace_back(data + start, at - start);
+                start = at + 1;
+                mask &= mask - 1;
+            }
+        }
+#endif
+        for (; i < len; ++i) {
+            if (data[i] == delim) {
+                fields.emplace_back(data + start, i - start);
+                start = i + 1;
+            }
+        }
+        fields.emplace_back(data + start, len - start);
+    }
+}
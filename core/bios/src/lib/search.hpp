@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace lib {
+    // Find the first occurrence of `byte` in [data, data + len), or nullptr
+    const char* find_byte(const char* data, size_t len, char byte);
+
+    // Count occurrences of `byte` in [data, data + len)
+    size_t count_byte(const char* data, size_t len, char byte);
+
+    // Find `needle` in `haystack` starting at `from`, or npos
+    size_t find_literal(std::string_view haystack, std::string_view needle, size_t from = 0);
+
+    // Split `record` on `delim` into views of its fields, replacing `fields`
+    void split_fields(std::string_view record, char delim, std::vector<std::string_view>& fields);
+}
@@ -0,0 +1,313 @@
+#include "snapshot.hpp"
+#include "block_file.hpp"
+#include "file_events.hpp"
+#include "file_io.hpp"
+#include "lz4.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace lib {
+    static const char kMagic[4] = {'F', 'S', 'I', 'M'};
+    static const uint32_t kVersion = 1;
+    static const size_t kHeaderSize = 24;
+    static const size_t kEntrySize = 48;
+    static const uint8_t kCompressed = 1;
+    static const uint64_t kMaxReserve = 64 * 1024 * 1024;   // Sizes come from the image, so are not trusted
+
+    namespace {
+        struct Entry {
+            char type;
+            uint8_t flags;
+            uint32_t mode;
+            int64_t mtime;
+            std::string name;
+            uint64_t data_offset;
+            uint64_t stored;
+            uint64_t size;
+        };
+
+        struct Snapshot {
+            bool compress;
+            std::vector<Entry> entries;
+            std::string data;
+            std::string error;
+        };
+    }
+
+    // Add the children of `dir` (named `prefix` in the image), each
+    // directory before what it holds
+    static bool add_directory(Snapshot& snapshot, const std::string& dir, const std::string& prefix) {
+        DIR* listing = opendir(dir.c_str());
+        if (!listing) {
+            snapshot.error = "cannot open " + dir;
+            return false;
+        }
+        std::vector<std::string> names;
+        while (struct dirent* entry = readdir(listing)) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) names.push_back(entry->d_name);
+        }
+        closedir(listing);
+        std::sort(names.begin(), names.end());
+
+        std::string content;
+        for (const std::string& name : names) {
+            std::string path = dir.back() == '/' ? dir + name : dir + "/" + name;
+            struct stat st;
+            if (system_directory(path) || lstat(path.c_str(), &st) != 0) continue;
+
+            Entry entry{0, 0, static_cast<uint32_t>(st.st_mode & 07777),
+                        static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec,
+                        prefix.empty() ? name : prefix + "/" + name, snapshot.data.size(), 0, 0};
+            if (S_ISDIR(st.st_mode)) {
+                entry.type = 'd';
+            } else if (S_ISLNK(st.st_mode)) {
+                entry.type = 'l';
+                std::vector<char> target(static_cast<size_t>(st.st_size) + 1);
+                ssize_t got = readlink(path.c_str(), target.data(), target.size());
+                if (got < 0) {
+                    snapshot.error = "cannot read link " + path;
+                    return false;
+                }
+                snapshot.data.append(target.data(), static_cast<size_t>(got));
+                entry.size = entry.stored = static_cast<uint64_t>(got);
+            } else if (S_ISREG(st.st_mode)) {
+                // Block-compressed files are stored by content
+                entry.type = 'f';
+                if (!load_file(path, content, snapshot.error)) return false;
+                entry.size = content.size();
+                std::string packed;
+                if (snapshot.compress && !content.empty()) {
+                    Lz4Encoder encoder(1);
+                    encoder.update(reinterpret_cast<const uint8_t*>(content.data()), content.size(), packed);
+                    encoder.finish(packed);
+                }
+                if (!packed.empty() && packed.size() < content.size()) {
+                    entry.flags = kCompressed;
+                    snapshot.data += packed;
+                } else {
+                    snapshot.data += content;
+                }
+                entry.stored = snapshot.data.size() - entry.data_offset;
+            } else {
+                continue;
+            }
+            std::string child = entry.name;
+            snapshot.entries.push_back(std::move(entry));
+            if (S_ISDIR(st.st_mode) && !add_directory(snapshot, path, child)) return false;
+        }
+        return true;
+    }
+
+    bool fs_snapshot(const std::string& root, bool compress, std::string& image, std::string& error) {
+        struct stat st;
+        if (stat(root.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            error = root + ": not a directory";
+            return false;
+        }
+        Snapshot snapshot;
+        snapshot.compress = compress;
+        if (!add_directory(snapshot, root, "")) {
+            error = snapshot.error;
+            return false;
+        }
+
+        std::string names;
+        for (const Entry& entry : snapshot.entries) names += entry.name;
+        image.assign(kMagic, sizeof(kMagic));
+        image.reserve(kHeaderSize + snapshot.entries.size() * kEntrySize + names.size() + snapshot.data.size());
+        put32(image, kVersion);
+        put32(image, static_cast<uint32_t>(snapshot.entries.size()));
+        put32(image, static_cast<uint32_t>(names.size()));
+        put64(image, snapshot.data.size());
+        uint32_t name_offset = 0;
+        for (const Entry& entry : snapshot.entries) {
+            image += entry.type;
+            image += static_cast<char>(entry.flags);
+            image.append(2, '\0');
+            put32(image, entry.mode);
+            put64(image, static_cast<uint64_t>(entry.mtime));
+            put32(image, name_offset);
+            put32(image, static_cast<uint32_t>(entry.name.size()));
+            put64(image, entry.data_offset);
+            put64(image, entry.stored);
+            put64(image, entry.size);
+            name_offset += static_cast<uint32_t>(entry.name.size());
+        }
+        image += names;
+        image += snapshot.data;
+        return true;
+    }
+
+    // A relative name with no empty, "." or ".." components
+    static bool safe_name(const std::string& name) {
+        if (name.empty() || name[0] == '/') return false;
+        for (size_t start = 0; start <= name.size();) {
+            size_t slash = name.find('/', start);
+            if (slash == std::string::npos) slash = name.size();
+            std::string part = name.substr(start, slash - start);
+            if (part.empty() || part == "." || part == "..") return false;
+            start = slash + 1;
+        }
+        return true;
+    }
+
+    // Create `path` as a directory unless it is one; never take a symlink
+    // in its place, which could lead the entries below it anywhere
+    static bool make_directory(const std::string& path, std::string& error) {
+        if (mkdir(path.c_str(), 0755) == 0) return true;
+        struct stat st;
+        if (errno == EEXIST && lstat(path.c_str(), &st) == 0) {
+            if (S_ISDIR(st.st_mode)) return true;
+            if (S_ISLNK(st.st_mode)) {
+                error = "refusing to restore through symlink " + path;
+                return false;
+            }
+        }
+        error = "cannot create " + path;
+        return false;
+    }
+
+    // Check (or create) each directory above `name`, so no entry is written
+    // through a symlink, including one an earlier entry of the image made
+    static bool make_parents(const std::string& base, const std::string& name, std::unordered_set<std::string>& made,
+                             std::string& error) {
+        for (size_t slash = name.find('/'); slash != std::string::npos; slash = name.find('/', slash + 1)) {
+            std::string parent = name.substr(0, slash);
+            if (made.count(parent)) continue;
+            if (!make_directory(base + parent, error)) return false;
+            made.insert(parent);
+        }
+        return true;
+    }
+
+    bool fs_restore(const uint8_t* image, size_t len, const std::string& root, size_t& entries, std::string& error) {
+        entries = 0;
+        if (len < kHeaderSize || memcmp(image, kMagic, sizeof(kMagic)) != 0 || read32(image + 4) != kVersion) {
+            error = "not a snapshot image";
+            return false;
+        }
+        uint64_t count = read32(image + 8);
+        uint64_t names_size = read32(image + 12);
+        uint64_t data_size = read64(image + 16);
+        if ((len - kHeaderSize) / kEntrySize < count || len - kHeaderSize - count * kEntrySize < names_size ||
+            len - kHeaderSize - count * kEntrySize - names_size != data_size) {
+            error = "truncated snapshot image";
+            return false;
+        }
+        const uint8_t* table = image + kHeaderSize;
+        const char* names = reinterpret_cast<const char*>(table + count * kEntrySize);
+        const uint8_t* data = table + count * kEntrySize + names_size;
+
+        for (size_t slash = root.find('/', 1); ; slash = root.find('/', slash + 1)) {
+            mkdir(root.substr(0, slash).c_str(), 0755);
+            if (slash == std::string::npos) break;
+        }
+        std::string base = root.back() == '/' ? root : root + "/";
+
+        // Directory modes and times are set last: a read-only directory
+        // still has to take its entries, and creating them moves its time
+        struct Directory {
+            std::string path;
+            uint32_t mode;
+            int64_t mtime;
+        };
+        std::vector<Directory> directories;
+        std::unordered_set<std::string> made;      // Names known to be directories
+        std::unordered_map<std::string, bool> policies;     // compression_enabled() by directory
+        std::string content;
+        for (uint64_t i = 0; i < count; ++i) {
+            const uint8_t* p = table + i * kEntrySize;
+            char type = static_cast<char>(p[0]);
+            uint8_t flags = p[1];
+            uint32_t mode = read32(p + 4);
+            int64_t mtime = static_cast<int64_t>(read64(p + 8));
+            uint64_t name_offset = read32(p + 16);
+            uint64_t name_len = read32(p + 20);
+            uint64_t offset = read64(p + 24);
+            uint64_t stored = read64(p + 32);
+            uint64_t size = read64(p + 40);
+            if (name_offset > names_size || name_len > names_size - name_offset || offset > data_size ||
+                stored > data_size - offset) {
+                error = "corrupt snapshot entry";
+                return false;
+            }
+            std::string name(names + name_offset, name_len);
+            if (!safe_name(name)) {
+                error = "refusing to restore " + name;
+                return false;
+            }
+            std::string path = base + name;
+            const char* bytes = reinterpret_cast<const char*>(data + offset);
+            if (!make_parents(base, name, made, error)) return false;
+
+            if (type == 'd') {
+                if (!make_directory(path, error)) return false;
+                made.insert(name);
+                directories.push_back({path, mode, mtime});
+            } else if (type == 'l') {
+                made.erase(name);
+                unlink(path.c_str());
+                if (symlink(std::string(bytes, stored).c_str(), path.c_str()) != 0) {
+                    error = "cannot create symlink " + path;
+                    return false;
+                }
+                set_mtime(path, mtime);
+            } else if (type == 'f') {
+                if (flags & kCompressed) {
+                    Lz4Decoder decoder;
+                    content.clear();
+                    content.reserve(static_cast<size_t>(size < kMaxReserve ? size : kMaxReserve));
+                    if (!decoder.update(data + offset, static_cast<size_t>(stored), content, error) || !decoder.finish(error) ||
+                        content.size() != size) {
+                        error = name + ": " + (error.empty() ? "size mismatch" : error);
+                        return false;
+                    }
+                    bytes = content.data();
+                } else if (stored != size) {
+                    error = "corrupt snapshot entry";
+                    return false;
+                }
+                // Straight from the image, without a stream per file; a
+                // symlink in the way is replaced rather than written through
+                struct stat st;
+                if (lstat(path.c_str(), &st) == 0 && S_ISLNK(st.st_mode)) unlink(path.c_str());
+                // Files in a directory with compression on go through store_file
+                std::string parent = path.substr(0, path.rfind('/'));
+                auto policy = policies.find(parent);
+                if (policy == policies.end()) policy = policies.emplace(parent, compression_enabled(path)).first;
+                bool ok;
+                if (policy->second) {
+                    ok = store_file(path, bytes, static_cast<size_t>(size), error, 1);
+                } else {
+                    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                    ok = fd >= 0 && write_all(fd, bytes, static_cast<size_t>(size));
+                    if (fd >= 0) close(fd);
+                }
+                if (!ok) {
+                    error = "cannot write " + path;
+                    return false;
+                }
+                chmod(path.c_str(), mode);
+                set_mtime(path, mtime);
+                file_changed(path);
+            } else {
+                error = "corrupt snapshot entry";
+                return false;
+            }
+            ++entries;
+        }
+        for (auto it = directories.rbegin(); it != directories.rend(); ++it) {
+            chmod(it->path.c_str(), it->mode);
+            set_mtime(it->path, it->mtime);
+        }
+        return true;
+    }
+}
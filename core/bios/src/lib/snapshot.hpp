@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace lib {
+    // Whole directory trees as one image, for booting into a prebuilt
+    // state without a write per file:
+    //
+    //   "FSIM" u32 version, u32 entries, u32 names size, u64 data size,
+    //   then a table of 48-byte entries, each directory ahead of what it
+    //   holds: u8 type ('d', 'f' or 'l'), u8 flags (1 if the data is an
+    //   LZ4 frame), u16 unused, u32 mode, i64 mtime in nanoseconds, u32
+    //   name offset, u32 name length, u64 data offset, u64 stored length,
+    //   u64 size; then the names (relative to the root) and the data (file
+    //   contents and link targets) they point into
+    //
+    // Restoring is one pass over the table, writing each file straight
+    // from the image with no per-file call from JavaScript. Files land
+    // block-compressed where their directory's policy says so.
+
+    // Image of the tree under `root`; with `compress`, each file that LZ4
+    // shrinks is stored compressed. /dev, /proc and /.bios are left out.
+    bool fs_snapshot(const std::string& root, bool compress, std::string& image, std::string& error);
+
+    // Recreate the tree in `image` under `root`, which is created if
+    // missing, overwriting files already there. `entries` is set to the
+    // number restored. Names with ".." components are refused, as is any
+    // entry that would be written through a symlink.
+    bool fs_restore(const uint8_t* image, size_t len, const std::string& root, size_t& entries, std::string& error);
+}
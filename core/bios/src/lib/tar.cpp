@@ -0,0 +1,763 @@
+#include "tar.hpp"
+#include "block_file.hpp"
+#include "file_events.hpp"
+#include "file_io.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace lib {
+    static const size_t kTarBlock = 512;
+    static const size_t kRecordSize = 20 * kTarBlock;       // Archives are padded to whole records, as tar does
+    static const size_t kPieceSize = 1024 * 1024;           // File data handed to the sink at a time
+    static const size_t kIoBufferSize = 1024 * 1024;
+    static const size_t kMaxLongValue = 16 * 1024 * 1024;   // Largest pax header or GNU long name accepted
+    static const uint64_t kMaxOctalSize = 077777777777ULL;  // Largest size an 11-digit header field holds
+#ifdef __EMSCRIPTEN_PTHREADS__
+    static const size_t kMaxQueued = 16 * 1024 * 1024;      // File data waiting for the writer thread
+#endif
+
+    namespace {
+        // Offset and length of a ustar header field
+        struct Field {
+            size_t offset;
+            size_t size;
+        };
+
+        const Field kNameField = {0, 100};
+        const Field kModeField = {100, 8};
+        const Field kUidField = {108, 8};
+        const Field kGidField = {116, 8};
+        const Field kSizeField = {124, 12};
+        const Field kMtimeField = {136, 12};
+        const Field kChecksumField = {148, 8};
+        const size_t kTypeOffset = 156;
+        const Field kLinkField = {157, 100};
+        const Field kMagicField = {257, 6};
+        const Field kVersionField = {263, 2};
+        const Field kPrefixField = {345, 155};
+
+        // Filesystem work for one member, in archive order
+        struct TarOp {
+            enum Kind { kDirectory, kFile, kData, kClose, kSymlink, kHardlink };
+
+            Kind kind;
+            std::string path;       // Relative to the destination
+            std::string data;       // File data, or the link target
+            uint32_t mode;
+            int64_t mtime;          // Nanoseconds
+        };
+    }
+
+    static std::string field_string(const uint8_t* block, const Field& field) {
+        const char* start = reinterpret_cast<const char*>(block + field.offset);
+        return std::string(start, strnlen(start, field.size));
+    }
+
+    // Octal, or base-256 when the top bit of the first byte is set (GNU
+    // tar's encoding for values that do not fit)
+    static uint64_t parse_number(const uint8_t* block, const Field& field) {
+        const uint8_t* p = block + field.offset;
+        if (p[0] & 0x80) {
+            if (p[0] == 0xff) return 0;     // Negative
+            uint64_t value = p[0] & 0x7f;
+            for (size_t i = 1; i < field.size; ++i) value = value << 8 | p[i];
+            return value;
+        }
+        size_t i = 0;
+        while (i < field.size && (p[i] == ' ' || p[i] == 0)) ++i;
+        uint64_t value = 0;
+        for (; i < field.size && p[i] >= '0' && p[i] <= '7'; ++i) value = value * 8 + (p[i] - '0');
+        return value;
+    }
+
+    static bool valid_checksum(const uint8_t* block) {
+        uint32_t unsigned_sum = 0;
+        int32_t signed_sum = 0;     // Some old tars summed signed chars
+        for (size_t i = 0; i < kTarBlock; ++i) {
+            uint8_t byte = i >= kChecksumField.offset && i < kChecksumField.offset + kChecksumField.size ? ' ' : block[i];
+            unsigned_sum += byte;
+            signed_sum += static_cast<int8_t>(byte);
+        }
+        uint64_t stored = parse_number(block, kChecksumField);
+        return stored == unsigned_sum || static_cast<int64_t>(stored) == signed_sum;
+    }
+
+    // `name` relative to the destination: empty and "." components are
+    // dropped (and with them any leading '/'); false if it climbs out
+    // with ".."
+    static bool member_path(const std::string& name, std::string& path) {
+        path.clear();
+        for (size_t start = 0; start <= name.size();) {
+            size_t slash = name.find('/', start);
+            if (slash == std::string::npos) slash = name.size();
+            std::string part = name.substr(start, slash - start);
+            if (part == "..") return false;
+            if (!part.empty() && part != ".") {
+                if (!path.empty()) path += '/';
+                path += part;
+            }
+            start = slash + 1;
+        }
+        return true;
+    }
+
+    static std::string join_path(const std::string& dir, const std::string& name) {
+        if (dir.empty()) return name;
+        return dir.back() == '/' ? dir + name : dir + "/" + name;
+    }
+
+    // Header times in nanoseconds, clamped to what that can hold
+    static int64_t nanoseconds(int64_t seconds) {
+        const int64_t limit = INT64_MAX / 1000000000;
+        return (seconds > limit ? limit : seconds < -limit ? -limit : seconds) * 1000000000;
+    }
+
+    // Applies TarOps to the filesystem, on its own thread under pthreads
+    struct TarExtractor::Sink {
+        std::string dest;
+        std::atomic<bool> failed{false};
+        std::string error;                          // Set by the writer before `failed`
+        bool closed = false;
+        int fd = -1;
+        std::string current;                        // Full path of the open file
+        uint32_t current_mode = 0;
+        int64_t current_mtime = 0;
+        std::unordered_set<std::string> made;       // Relative directories known to exist
+        std::vector<TarOp> directories;             // Get their modes and times last
+        std::vector<std::string> written;
+#ifdef __EMSCRIPTEN_PTHREADS__
+        std::mutex lock;
+        std::condition_variable ready;              // Ops queued, or closing
+        std::condition_variable room;               // Queue drained below kMaxQueued
+        std::deque<TarOp> queue;
+        size_t queued = 0;
+        bool closing = false;
+        std::thread thread;
+#endif
+
+        explicit Sink(const std::string& destination) : dest(destination) {
+#ifdef __EMSCRIPTEN_PTHREADS__
+            thread = std::thread([this]() { run(); });
+#endif
+        }
+
+        void push(TarOp&& op) {
+#ifdef __EMSCRIPTEN_PTHREADS__
+            std::unique_lock<std::mutex> guard(lock);
+            room.wait(guard, [this]() { return queued < kMaxQueued; });
+            queued += op.data.size();
+            queue.push_back(std::move(op));
+            guard.unlock();
+            ready.notify_one();
+#else
+            if (!failed) apply(op);
+#endif
+        }
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+        void run() {
+            while (true) {
+                TarOp op;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    ready.wait(guard, [this]() { return !queue.empty() || closing; });
+                    if (queue.empty()) return;
+                    op = std::move(queue.front());
+                    queue.pop_front();
+                    queued -= op.data.size();
+                }
+                room.notify_one();
+                if (!failed) apply(op);
+            }
+        }
+#endif
+
+        // Wait for the queued work, then fix up directories and report
+        // the files written
+        bool close(std::string& message) {
+            if (!closed) {
+                closed = true;
+#ifdef __EMSCRIPTEN_PTHREADS__
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    closing = true;
+                }
+                ready.notify_one();
+                thread.join();
+#endif
+                if (fd >= 0) ::close(fd);
+                for (auto it = directories.rbegin(); it != directories.rend(); ++it) {
+                    std::string full = join_path(dest, it->path);
+                    chmod(full.c_str(), it->mode);
+                    set_mtime(full, it->mtime);
+                }
+                // Files are written plain as they stream in; those in a
+                // directory with compression on are rewritten once done
+                std::string reason;
+                for (const std::string& path : written) {
+                    if (!failed && !apply_compression(path, reason)) fail(reason);
+                    file_changed(path);
+                }
+            }
+            if (failed) message = error;
+            return !failed;
+        }
+
+        bool fail(const std::string& message) {
+            error = message;
+            failed = true;
+            return false;
+        }
+
+        // Create `full` as a directory unless it is one; never follow a
+        // symlink in its place
+        bool make_directory(const std::string& full) {
+            if (mkdir(full.c_str(), 0755) == 0) return true;
+            struct stat st;
+            if (errno == EEXIST && lstat(full.c_str(), &st) == 0) {
+                if (S_ISDIR(st.st_mode)) return true;
+                if (S_ISLNK(st.st_mode)) return fail("refusing to extract through symlink " + full);
+            }
+            return fail("cannot create directory " + full);
+        }
+
+        bool make_parents(const std::string& path) {
+            for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+                std::string parent = path.substr(0, slash);
+                if (made.count(parent)) continue;
+                if (!make_directory(join_path(dest, parent))) return false;
+                made.insert(parent);
+            }
+            return true;
+        }
+
+        // Hard links fall back to copies where the filesystem has no link()
+        bool copy_file(const std::string& source, const std::string& target) {
+            int in = open(source.c_str(), O_RDONLY);
+            if (in < 0) return false;
+            int out = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+            if (out < 0) {
+                ::close(in);
+                return false;
+            }
+            std::vector<char> buffer(kIoBufferSize);
+            bool ok = true;
+            while (ok) {
+                ssize_t got = read(in, buffer.data(), buffer.size());
+                if (got < 0 && errno == EINTR) continue;
+                if (got <= 0) {
+                    ok = got == 0;
+                    break;
+                }
+                ok = write_all(out, buffer.data(), got);
+            }
+            ::close(in);
+            if (::close(out) != 0) ok = false;
+            struct stat st;
+            if (ok && stat(source.c_str(), &st) == 0) chmod(target.c_str(), st.st_mode & 07777);
+            return ok;
+        }
+
+        bool apply(TarOp& op) {
+            std::string full = join_path(dest, op.path);
+            switch (op.kind) {
+                case TarOp::kDirectory:
+                    if (!make_parents(op.path) || !make_directory(full)) return false;
+                    made.insert(op.path);
+                    op.data.clear();
+                    directories.push_back(std::move(op));
+                    return true;
+                case TarOp::kFile:
+                    if (!make_parents(op.path)) return false;
+                    ::unlink(full.c_str());
+                    fd = open(full.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+                    if (fd < 0) return fail("cannot create " + full);
+                    current = full;
+                    current_mode = op.mode;
+                    current_mtime = op.mtime;
+                    return true;
+                case TarOp::kData:
+                    if (!write_all(fd, op.data.data(), op.data.size())) return fail("cannot write " + current);
+                    return true;
+                case TarOp::kClose: {
+                    int closing_fd = fd;
+                    fd = -1;
+                    if (::close(closing_fd) != 0) return fail("cannot write " + current);
+                    chmod(current.c_str(), current_mode);
+                    set_mtime(current, current_mtime);
+                    written.push_back(current);
+                    return true;
+                }
+                case TarOp::kSymlink:
+                    if (!make_parents(op.path)) return false;
+                    ::unlink(full.c_str());
+                    if (symlink(op.data.c_str(), full.c_str()) != 0) return fail("cannot create symlink " + full);
+                    set_mtime(full, op.mtime);
+                    return true;
+                case TarOp::kHardlink: {
+                    if (!make_parents(op.path)) return false;
+                    std::string target = join_path(dest, op.data);
+                    ::unlink(full.c_str());
+                    if (link(target.c_str(), full.c_str()) != 0 && !copy_file(target, full)) {
+                        return fail("cannot link " + full + " to " + target);
+                    }
+                    written.push_back(full);
+                    return true;
+                }
+            }
+            return true;
+        }
+    };
+
+    TarExtractor::TarExtractor(const std::string& dest, std::vector<std::string>* names) : names_(names) {
+        if (!dest.empty()) sink_ = new Sink(dest);
+    }
+
+    TarExtractor::~TarExtractor() {
+        if (sink_) {
+            std::string error;
+            sink_->close(error);
+            delete sink_;
+        }
+    }
+
+    bool TarExtractor::update(const uint8_t* data, size_t len, std::string& error) {
+        // A tar header starts with a name, never with gzip's first magic byte
+        if (len && format_ == kUnknown) format_ = data[0] == 0x1f ? kGzip : kPlain;
+
+        bool ok;
+        if (format_ == kGzip) {
+            decoded_.clear();
+            ok = gunzip_.update(data, len, decoded_, error) &&
+                 parse(reinterpret_cast<const uint8_t*>(decoded_.data()), decoded_.size(), error);
+        } else {
+            ok = parse(data, len, error);
+        }
+
+        // A failed write stops the extraction at the next piece of input
+        if (ok && sink_ && sink_->failed) ok = sink_->close(error);
+        return ok;
+    }
+
+    bool TarExtractor::finish(std::string& error) {
+        if (format_ == kGzip && !gunzip_.finish(error)) return false;
+        if (state_ != kEnd && !(state_ == kHeader && block_fill_ == 0)) {
+            error = "unexpected end of archive";
+            return false;
+        }
+        return !sink_ || sink_->close(error);
+    }
+
+    bool TarExtractor::parse(const uint8_t* data, size_t len, std::string& error) {
+        while (len > 0 && state_ != kEnd) {
+            size_t take;
+            if (state_ == kHeader) {
+                take = std::min(len, kTarBlock - block_fill_);
+                memcpy(block_ + block_fill_, data, take);
+                block_fill_ += take;
+                if (block_fill_ == kTarBlock) {
+                    block_fill_ = 0;
+                    if (!read_header(error)) return false;
+                }
+            } else if (state_ == kPadding) {
+                take = std::min(len, padding_);
+                padding_ -= take;
+                if (!padding_) state_ = kHeader;
+            } else {
+                take = remaining_ < len ? static_cast<size_t>(remaining_) : len;
+                if (state_ == kData && writing_) {
+                    piece_.append(reinterpret_cast<const char*>(data), take);
+                    if (piece_.size() >= kPieceSize) {
+                        sink_->push(TarOp{TarOp::kData, std::string(), std::move(piece_), 0, 0});
+                        piece_.clear();
+                    }
+                } else if (state_ == kLongValue) {
+                    long_value_.append(reinterpret_cast<const char*>(data), take);
+                }
+                remaining_ -= take;
+                if (!remaining_) end_member();
+            }
+            data += take;
+            len -= take;
+        }
+        return true;
+    }
+
+    bool TarExtractor::read_header(std::string& error) {
+        if (std::all_of(block_, block_ + kTarBlock, [](uint8_t byte) { return byte == 0; })) {
+            // Two zero blocks end the archive
+            if (++zero_blocks_ == 2) state_ = kEnd;
+            return true;
+        }
+        zero_blocks_ = 0;
+        if (!valid_checksum(block_)) {
+            error = "invalid tar header (bad checksum)";
+            return false;
+        }
+
+        char type = static_cast<char>(block_[kTypeOffset]);
+        uint64_t size = has_pax_size_ ? pax_size_ : parse_number(block_, kSizeField);
+        remaining_ = size;
+        padding_ = static_cast<size_t>((kTarBlock - size % kTarBlock) % kTarBlock);
+        writing_ = false;
+
+        // Extended headers and GNU long names describe the next member
+        if (type == 'x' || type == 'L' || type == 'K') {
+            if (size > kMaxLongValue) {
+                error = "extended header too large";
+                return false;
+            }
+            long_type_ = type;
+            long_value_.clear();
+            state_ = kLongValue;
+            if (!remaining_) end_member();
+            return true;
+        }
+
+        std::string name = pax_path_;
+        if (name.empty()) {
+            name = field_string(block_, kNameField);
+            std::string prefix = field_string(block_, kPrefixField);
+            // POSIX ustar only: GNU tar keeps other data where the prefix goes
+            if (!memcmp(block_ + kMagicField.offset, "ustar\0", kMagicField.size) && !prefix.empty()) name = prefix + "/" + name;
+        }
+        std::string link = pax_link_.empty() ? field_string(block_, kLinkField) : pax_link_;
+        uint32_t mode = static_cast<uint32_t>(parse_number(block_, kModeField) & 07777);
+        int64_t mtime = has_pax_mtime_ ? pax_mtime_ : nanoseconds(static_cast<int64_t>(parse_number(block_, kMtimeField) & INT64_MAX));
+        pax_path_.clear();
+        pax_link_.clear();
+        has_pax_size_ = has_pax_mtime_ = false;
+
+        bool regular = type == '0' || type == '\0' || type == '7';
+        state_ = kSkip;
+        if (regular || type == '1' || type == '2' || type == '5') {
+            std::string path;
+            if (!member_path(name, path)) {
+                error = name + ": member name contains '..'";
+                return false;
+            }
+            if (!path.empty()) {
+                ++members_;
+                if (regular) bytes_ += size;
+                if (names_) names_->push_back(type == '5' ? path + "/" : path);
+            }
+
+            if (sink_ && !path.empty()) {
+                if (regular) {
+                    sink_->push(TarOp{TarOp::kFile, path, std::string(), mode, mtime});
+                    writing_ = true;
+                    state_ = kData;
+                } else if (type == '5') {
+                    sink_->push(TarOp{TarOp::kDirectory, path, std::string(), mode, mtime});
+                } else if (type == '2') {
+                    sink_->push(TarOp{TarOp::kSymlink, path, link, mode, mtime});
+                } else {
+                    std::string target;
+                    if (!member_path(link, target) || target.empty()) {
+                        error = name + ": invalid hard link target " + link;
+                        return false;
+                    }
+                    sink_->push(TarOp{TarOp::kHardlink, path, target, mode, mtime});
+                }
+            }
+        }
+        if (!remaining_) end_member();
+        return true;
+    }
+
+    void TarExtractor::end_member() {
+        if (state_ == kData) {
+            if (!piece_.empty()) sink_->push(TarOp{TarOp::kData, std::string(), std::move(piece_), 0, 0});
+            piece_.clear();
+            sink_->push(TarOp{TarOp::kClose, std::string(), std::string(), 0, 0});
+        } else if (state_ == kLongValue) {
+            if (long_type_ == 'x') {
+                read_pax(long_value_);
+            } else {
+                // GNU long names are NUL-terminated
+                std::string value(long_value_.c_str());
+                (long_type_ == 'L' ? pax_path_ : pax_link_) = value;
+            }
+        }
+        state_ = padding_ ? kPadding : kHeader;
+    }
+
+    // pax records are "<length> <key>=<value>\n", the length counting the
+    // whole record
+    void TarExtractor::read_pax(const std::string& records) {
+        for (size_t pos = 0; pos < records.size();) {
+            size_t length = 0;
+            size_t i = pos;
+            for (; i < records.size() && records[i] >= '0' && records[i] <= '9'; ++i) length = length * 10 + (records[i] - '0');
+            if (i >= records.size() || records[i] != ' ' || length <= i - pos + 1 || pos + length > records.size()) return;
+            std::string record = records.substr(i + 1, pos + length - i - 2);
+            pos += length;
+
+            size_t equals = record.find('=');
+            if (equals == std::string::npos) continue;
+            std::string key = record.substr(0, equals);
+            std::string value = record.substr(equals + 1);
+            if (key == "path") {
+                pax_path_ = value;
+            } else if (key == "linkpath") {
+                pax_link_ = value;
+            } else if (key == "size") {
+                has_pax_size_ = true;
+                pax_size_ = strtoull(value.c_str(), nullptr, 10);
+            } else if (key == "mtime") {
+                // Seconds with an optional fraction
+                has_pax_mtime_ = true;
+                char* end;
+                pax_mtime_ = nanoseconds(strtoll(value.c_str(), &end, 10));
+                if (*end == '.') {
+                    int64_t scale = 100000000;
+                    for (++end; *end >= '0' && *end <= '9' && scale > 0; ++end, scale /= 10) pax_mtime_ += (*end - '0') * scale;
+                }
+            }
+        }
+    }
+
+    namespace {
+        // Writes members to an archive file, through gzip if asked
+        class TarPacker {
+        public:
+            TarPacker(int fd, bool gzip, std::vector<std::string>* names) : fd_(fd), gzip_(gzip), names_(names), buffer_(kIoBufferSize) {
+                struct stat st;
+                if (fstat(fd, &st) == 0) {
+                    archive_device_ = st.st_dev;
+                    archive_inode_ = st.st_ino;
+                }
+            }
+
+            bool add(const std::string& source, const std::string& name, std::string& error);
+            bool finish(std::string& error);
+
+        private:
+            int fd_;
+            bool gzip_;
+            std::vector<std::string>* names_;
+            GzipEncoder encoder_;
+            std::string out_;
+            std::vector<char> buffer_;
+            uint64_t raw_ = 0;                  // Uncompressed archive bytes so far
+            dev_t archive_device_ = 0;
+            ino_t archive_inode_ = 0;
+
+            void emit(const char* data, size_t len) {
+                raw_ += len;
+                if (gzip_) {
+                    encoder_.update(reinterpret_cast<const uint8_t*>(data), len, out_);
+                } else {
+                    out_.append(data, len);
+                }
+            }
+
+            void pad() {
+                static const char zeros[kTarBlock] = {};
+                size_t padding = (kTarBlock - raw_ % kTarBlock) % kTarBlock;
+                emit(zeros, padding);
+            }
+
+            bool flush(std::string& error, bool force) {
+                if (out_.size() < kIoBufferSize && !force) return true;
+                if (!write_all(fd_, out_.data(), out_.size())) {
+                    error = "cannot write archive";
+                    return false;
+                }
+                out_.clear();
+                return true;
+            }
+
+            void write_header(const std::string& name, const std::string& link, char type, uint32_t mode, uint64_t size,
+                              int64_t mtime);
+        };
+    }
+
+    // Zero-padded octal filling all but the field's last byte, which is
+    // left NUL; formatted apart so a value too wide keeps its low digits
+    static void put_octal(char* block, const Field& field, uint64_t value) {
+        char digits[24];        // 22 octal digits of a u64 and the NUL
+        int width = static_cast<int>(field.size - 1);
+        int len = snprintf(digits, sizeof(digits), "%0*llo", width, static_cast<unsigned long long>(value));
+        memcpy(block + field.offset, digits + (len - width), field.size - 1);
+        block[field.offset + field.size - 1] = '\0';
+    }
+
+    static void add_pax_record(std::string& records, const std::string& key, const std::string& value) {
+        size_t body = key.size() + value.size() + 3;        // ' ', '=' and '\n'
+        size_t digits = 1;
+        while (std::to_string(body + digits).size() > digits) ++digits;
+        records += std::to_string(body + digits) + " " + key + "=" + value + "\n";
+    }
+
+    void TarPacker::write_header(const std::string& name, const std::string& link, char type, uint32_t mode, uint64_t size,
+                                 int64_t mtime) {
+        // Long names split into prefix and name at a '/' if they can,
+        // else go in a pax record, as do long link targets and huge sizes
+        std::string short_name = name, prefix, records;
+        if (name.size() > kNameField.size) {
+            short_name.clear();
+            size_t from = name.size() - kNameField.size - 1;
+            for (size_t slash = name.find('/', from); slash != std::string::npos; slash = name.find('/', slash + 1)) {
+                if (slash == 0 || slash > kPrefixField.size || slash + 1 == name.size()) continue;
+                prefix = name.substr(0, slash);
+                short_name = name.substr(slash + 1);
+                break;
+            }
+            if (short_name.empty()) {
+                add_pax_record(records, "path", name);
+                short_name = name.substr(0, kNameField.size);
+                prefix.clear();
+            }
+        }
+        if (link.size() > kLinkField.size) add_pax_record(records, "linkpath", link);
+        if (size > kMaxOctalSize) add_pax_record(records, "size", std::to_string(size));
+        if (!records.empty()) {
+            size_t slash = short_name.rfind('/');
+            std::string base = slash == std::string::npos ? short_name : short_name.substr(slash + 1);
+            write_header(("PaxHeaders/" + base).substr(0, kNameField.size), std::string(), 'x', 0644, records.size(), mtime);
+            emit(records.data(), records.size());
+            pad();
+        }
+
+        char block[kTarBlock] = {};
+        memcpy(block + kNameField.offset, short_name.data(), std::min(short_name.size(), kNameField.size));
+        put_octal(block, kModeField, mode);
+        put_octal(block, kUidField, 0);
+        put_octal(block, kGidField, 0);
+        put_octal(block, kSizeField, size > kMaxOctalSize ? 0 : size);
+        put_octal(block, kMtimeField, mtime > 0 ? static_cast<uint64_t>(mtime / 1000000000) : 0);
+        block[kTypeOffset] = type;
+        memcpy(block + kLinkField.offset, link.data(), std::min(link.size(), kLinkField.size));
+        memcpy(block + kMagicField.offset, "ustar", kMagicField.size);
+        memcpy(block + kVersionField.offset, "00", kVersionField.size);
+        memcpy(block + kPrefixField.offset, prefix.data(), std::min(prefix.size(), kPrefixField.size));
+
+        memset(block + kChecksumField.offset, ' ', kChecksumField.size);
+        uint32_t sum = 0;
+        for (size_t i = 0; i < kTarBlock; ++i) sum += static_cast<uint8_t>(block[i]);
+        snprintf(block + kChecksumField.offset, kChecksumField.size - 1, "%06o", sum);
+        emit(block, sizeof(block));
+    }
+
+    bool TarPacker::add(const std::string& source, const std::string& name, std::string& error) {
+        struct stat st;
+        if (lstat(source.c_str(), &st) != 0) {
+            error = "cannot stat " + source;
+            return false;
+        }
+        int64_t mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        uint32_t mode = st.st_mode & 07777;
+
+        if (S_ISDIR(st.st_mode)) {
+            if (!name.empty()) {
+                write_header(name + "/", std::string(), '5', mode, 0, mtime);
+                if (names_) names_->push_back(name + "/");
+            }
+            DIR* dir = opendir(source.c_str());
+            if (!dir) {
+                error = "cannot open directory " + source;
+                return false;
+            }
+            std::vector<std::string> children;
+            while (struct dirent* entry = readdir(dir)) {
+                if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) children.push_back(entry->d_name);
+            }
+            closedir(dir);
+            std::sort(children.begin(), children.end());
+            for (const std::string& child : children) {
+                if (!add(join_path(source, child), name.empty() ? child : name + "/" + child, error)) return false;
+            }
+            return flush(error, false);
+        }
+
+        if (S_ISLNK(st.st_mode)) {
+            std::vector<char> target(st.st_size + 1);
+            ssize_t length = readlink(source.c_str(), target.data(), target.size());
+            if (length < 0) {
+                error = "cannot read link " + source;
+                return false;
+            }
+            write_header(name, std::string(target.data(), length), '2', mode, 0, mtime);
+            if (names_) names_->push_back(name);
+            return flush(error, false);
+        }
+
+        // Sockets, devices and FIFOs are left out, as is the archive itself
+        if (!S_ISREG(st.st_mode) || (st.st_dev == archive_device_ && st.st_ino == archive_inode_)) return true;
+
+        // Block-compressed files are archived by content
+        BlockReader in;
+        if (!in.open(source, error)) return false;
+        uint64_t size = in.size();
+        write_header(name, std::string(), '0', mode, size, mtime);
+        if (names_) names_->push_back(name);
+        for (uint64_t offset = 0; offset < size;) {
+            size_t len = size - offset < buffer_.size() ? static_cast<size_t>(size - offset) : buffer_.size();
+            if (!in.read(offset, len, buffer_.data(), error)) {
+                error = source + ": file shrank while being archived";
+                return false;
+            }
+            emit(buffer_.data(), len);
+            offset += len;
+            if (!flush(error, false)) return false;
+        }
+        pad();
+        return flush(error, false);
+    }
+
+    bool TarPacker::finish(std::string& error) {
+        // Two zero blocks, then up to a whole record
+        static const char zeros[kTarBlock] = {};
+        emit(zeros, kTarBlock);
+        emit(zeros, kTarBlock);
+        while (raw_ % kRecordSize) emit(zeros, kTarBlock);
+        if (gzip_) encoder_.finish(out_);
+        return flush(error, true);
+    }
+
+    bool tar_create(const std::string& base, const std::vector<std::string>& paths, const std::string& archive, bool gzip,
+                    std::vector<std::string>* names, std::string& error) {
+        int fd = open(archive.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            error = "cannot create " + archive;
+            return false;
+        }
+
+        TarPacker packer(fd, gzip, names);
+        bool ok = true;
+        for (const std::string& path : paths) {
+            std::string name = path;
+            while (!name.empty() && name.front() == '/') name.erase(0, 1);
+            while (name.size() > 1 && name.back() == '/') name.pop_back();
+            std::string source = base.empty() || (!path.empty() && path.front() == '/') ? path : join_path(base, path);
+            if (!packer.add(source, name, error)) {
+                ok = false;
+                break;
+            }
+        }
+        if (ok) ok = packer.finish(error);
+        if (close(fd) != 0 && ok) {
+            error = "cannot write " + archive;
+            ok = false;
+        }
+        if (ok) ok = apply_compression(archive, error);
+        if (ok) file_changed(archive);
+        return ok;
+    }
+}
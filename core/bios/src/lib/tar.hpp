@@ -0,0 +1,80 @@
+#pragma once
+#include "gzip.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lib {
+    // Streaming tar unpacker (ustar, pax extended headers and GNU long
+    // names), fed a plain or gzip-compressed archive in pieces of any size.
+    // Regular files, directories, symlinks and hard links are created under
+    // `dest` with their modes and modification times; other member types
+    // are skipped. A leading '/' is dropped from member names, names with
+    // ".." components are refused, and nothing is written through a
+    // symlink inside `dest`.
+    //
+    // Under pthreads the filesystem work runs on a writer thread fed
+    // through a bounded queue, so decompressing and parsing the archive
+    // overlap with creating files.
+    class TarExtractor {
+    public:
+        // Member names are appended to `names` when given; with an empty
+        // `dest` the archive is only listed
+        explicit TarExtractor(const std::string& dest, std::vector<std::string>* names = nullptr);
+        ~TarExtractor();
+
+        TarExtractor(const TarExtractor&) = delete;
+        TarExtractor& operator=(const TarExtractor&) = delete;
+
+        bool update(const uint8_t* data, size_t len, std::string& error);
+
+        // Check that the archive is complete and wait for its files to be
+        // written
+        bool finish(std::string& error);
+
+        size_t members() const { return members_; }
+        uint64_t bytes() const { return bytes_; }
+
+    private:
+        enum State { kHeader, kData, kLongValue, kSkip, kPadding, kEnd };
+        enum Format { kUnknown, kPlain, kGzip };
+        struct Sink;
+
+        Sink* sink_ = nullptr;
+        std::vector<std::string>* names_;
+        Format format_ = kUnknown;
+        GzipDecoder gunzip_;
+        std::string decoded_;
+        State state_ = kHeader;
+        uint8_t block_[512];
+        size_t block_fill_ = 0;
+        int zero_blocks_ = 0;
+        uint64_t remaining_ = 0;            // Bytes left in the current member
+        size_t padding_ = 0;                // Then this much up to the next block
+        bool writing_ = false;              // The current member's data goes to the sink
+        std::string piece_;                 // File data not yet handed to the sink
+        char long_type_ = 0;                // 'x', 'L' or 'K' while collecting long_value_
+        std::string long_value_;
+        std::string pax_path_, pax_link_;   // Overrides for the next member
+        bool has_pax_size_ = false;
+        uint64_t pax_size_ = 0;
+        bool has_pax_mtime_ = false;
+        int64_t pax_mtime_ = 0;             // Nanoseconds
+        size_t members_ = 0;
+        uint64_t bytes_ = 0;
+
+        bool parse(const uint8_t* data, size_t len, std::string& error);
+        bool read_header(std::string& error);
+        void read_pax(const std::string& records);
+        void end_member();
+    };
+
+    // Write a tar archive of `paths` (relative to `base` unless absolute)
+    // to `archive`, gzip-compressed when `gzip`. Directories are archived
+    // recursively and symlinks as links; names too long for ustar get pax
+    // records. Member names are the paths as given, less any leading '/',
+    // and are appended to `names` when given.
+    bool tar_create(const std::string& base, const std::vector<std::string>& paths, const std::string& archive, bool gzip,
+                    std::vector<std::string>* names, std::string& error);
+}
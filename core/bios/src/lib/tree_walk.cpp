@@ -0,0 +1,236 @@
+#include "tree_walk.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <mutex>
+#include <sys/stat.h>
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <thread>
+#endif
+
+namespace lib {
+#ifdef __EMSCRIPTEN_PTHREADS__
+    static const size_t kMaxWorkers = 8;
+#endif
+
+    static char entry_type(mode_t mode) {
+        if (S_ISREG(mode)) return 'f';
+        if (S_ISDIR(mode)) return 'd';
+        if (S_ISLNK(mode)) return 'l';
+        return 'o';
+    }
+
+    static int64_t mtime_of(const struct stat& st) {
+        return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    }
+
+    bool WalkFilter::matches(const WalkEntry& entry) const {
+        if (type && entry.type != type) return false;
+        if (newer && entry.mtime <= newer_than) return false;
+        if (size_op) {
+            uint64_t units = (entry.size + size_unit - 1) / size_unit;
+            if (size_op == '+' ? units <= size : size_op == '-' ? units >= size : units != size) return false;
+        }
+        if (!name.empty()) {
+            std::string base = entry.path;
+            while (base.size() > 1 && base.back() == '/') base.pop_back();
+            size_t slash = base.rfind('/');
+            if (slash != std::string::npos && base.size() > 1) base.erase(0, slash + 1);
+            if (fnmatch(name.c_str(), base.c_str(), 0) != 0) return false;
+        }
+        return true;
+    }
+
+    bool parse_walk_filter(const std::vector<std::string>& args, size_t first, WalkFilter& filter, std::string& error) {
+        for (size_t i = first; i < args.size(); i += 2) {
+            const std::string& predicate = args[i];
+            if (i + 1 >= args.size()) {
+                error = "missing argument to " + predicate;
+                return false;
+            }
+            const std::string& value = args[i + 1];
+
+            if (predicate == "-name") {
+                filter.name = value;
+            } else if (predicate == "-type") {
+                if (value != "f" && value != "d" && value != "l") {
+                    error = "unknown type: " + value;
+                    return false;
+                }
+                filter.type = value[0];
+            } else if (predicate == "-size") {
+                // [+-]N[ckMG]: N units of 512 bytes unless suffixed
+                const char* text = value.c_str();
+                filter.size_op = *text == '+' || *text == '-' ? *text++ : '=';
+                char* end;
+                filter.size = std::strtoull(text, &end, 10);
+                if (end == text) {
+                    error = "invalid size: " + value;
+                    return false;
+                }
+                switch (*end) {
+                    case '\0': filter.size_unit = 512; break;
+                    case 'c': filter.size_unit = 1; break;
+                    case 'k': filter.size_unit = 1024; break;
+                    case 'M': filter.size_unit = 1024 * 1024; break;
+                    case 'G': filter.size_unit = 1024 * 1024 * 1024; break;
+                    default:
+                        error = "invalid size: " + value;
+                        return false;
+                }
+                if (*end && end[1]) {
+                    error = "invalid size: " + value;
+                    return false;
+                }
+            } else if (predicate == "-newer") {
+                struct stat st;
+                if (stat(value.c_str(), &st) != 0) {
+                    error = "cannot stat " + value;
+                    return false;
+                }
+                filter.newer = true;
+                filter.newer_than = mtime_of(st);
+            } else {
+                error = "unknown predicate: " + predicate;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    namespace {
+        struct WorkQueue {
+            std::mutex lock;
+            std::deque<std::string> directories;
+        };
+
+        struct Walk {
+            const WalkFilter* filter;
+            bool collect;
+            std::vector<WorkQueue> queues;
+            std::atomic<size_t> pending{0};     // Directories queued or being read
+            std::vector<std::vector<WalkEntry>> matches;
+            std::vector<WalkTotals> totals;
+
+            Walk(const WalkFilter& f, bool c, size_t workers)
+                : filter(&f), collect(c), queues(workers), matches(workers), totals(workers) {}
+        };
+
+        void visit(Walk& walk, size_t self, WalkEntry&& entry) {
+            WalkTotals& totals = walk.totals[self];
+            if (entry.type == 'd') {
+                ++totals.directories;
+            } else {
+                ++totals.files;
+                totals.bytes += entry.size;
+            }
+            if (walk.collect && walk.filter->matches(entry)) walk.matches[self].push_back(std::move(entry));
+        }
+
+        void read_directory(Walk& walk, size_t self, const std::string& dir) {
+            DIR* handle = opendir(dir.c_str());
+            if (!handle) return;
+
+            std::vector<std::string> subdirs;
+            while (struct dirent* entry = readdir(handle)) {
+                if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+                std::string path = dir.back() == '/' ? dir + entry->d_name : dir + "/" + entry->d_name;
+
+                struct stat st;
+                if (lstat(path.c_str(), &st) != 0) continue;
+                char type = entry_type(st.st_mode);
+                if (type == 'd') subdirs.push_back(path);
+                visit(walk, self, WalkEntry{std::move(path), type, static_cast<uint64_t>(st.st_size), mtime_of(st)});
+            }
+            closedir(handle);
+
+            if (subdirs.empty()) return;
+            walk.pending.fetch_add(subdirs.size());
+            WorkQueue& queue = walk.queues[self];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            for (std::string& subdir : subdirs) queue.directories.push_back(std::move(subdir));
+        }
+
+        // Newest directory from our own deque, else the oldest from another's
+        bool take(Walk& walk, size_t self, std::string& dir) {
+            size_t workers = walk.queues.size();
+            for (size_t i = 0; i < workers; ++i) {
+                WorkQueue& queue = walk.queues[(self + i) % workers];
+                std::lock_guard<std::mutex> guard(queue.lock);
+                if (queue.directories.empty()) continue;
+                if (i == 0) {
+                    dir = std::move(queue.directories.back());
+                    queue.directories.pop_back();
+                } else {
+                    dir = std::move(queue.directories.front());
+                    queue.directories.pop_front();
+                }
+                return true;
+            }
+            return false;
+        }
+
+        void work(Walk& walk, size_t self) {
+            std::string dir;
+            while (walk.pending.load() > 0) {
+                if (!take(walk, self, dir)) {
+#ifdef __EMSCRIPTEN_PTHREADS__
+                    std::this_thread::yield();
+#endif
+                    continue;
+                }
+                read_directory(walk, self, dir);
+                walk.pending.fetch_sub(1);
+            }
+        }
+    }
+
+    bool walk_tree(const std::string& root, const WalkFilter& filter, std::vector<WalkEntry>* matches, WalkTotals& totals,
+                   std::string& error) {
+        struct stat st;
+        if (lstat(root.c_str(), &st) != 0) {
+            error = "cannot access " + root;
+            return false;
+        }
+
+        size_t workers = 1;
+#ifdef __EMSCRIPTEN_PTHREADS__
+        workers = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), kMaxWorkers));
+        if (!S_ISDIR(st.st_mode)) workers = 1;
+#endif
+        Walk walk(filter, matches != nullptr, workers);
+        char type = entry_type(st.st_mode);
+        visit(walk, 0, WalkEntry{root, type, static_cast<uint64_t>(st.st_size), mtime_of(st)});
+        if (type == 'd') {
+            walk.queues[0].directories.push_back(root);
+            walk.pending = 1;
+        }
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+        std::vector<std::thread> threads;
+        for (size_t self = 1; self < workers; ++self) threads.emplace_back(work, std::ref(walk), self);
+        work(walk, 0);
+        for (std::thread& thread : threads) thread.join();
+#else
+        work(walk, 0);
+#endif
+
+        for (size_t self = 0; self < workers; ++self) {
+            totals.files += walk.totals[self].files;
+            totals.directories += walk.totals[self].directories;
+            totals.bytes += walk.totals[self].bytes;
+            if (matches) {
+                for (WalkEntry& entry : walk.matches[self]) matches->push_back(std::move(entry));
+            }
+        }
+        if (matches) {
+            std::sort(matches->begin(), matches->end(), [](const WalkEntry& a, const WalkEntry& b) { return a.path < b.path; });
+        }
+        return true;
+    }
+}
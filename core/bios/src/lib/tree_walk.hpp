@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lib {
+    struct WalkEntry {
+        std::string path;
+        char type;          // 'f' file, 'd' directory, 'l' symlink, 'o' other
+        uint64_t size;
+        int64_t mtime;      // Nanoseconds
+    };
+
+    // find(1)-style predicates; an empty filter matches everything
+    struct WalkFilter {
+        std::string name;           // Glob on the file name (-name)
+        char type = 0;              // -type f|d|l
+        char size_op = 0;           // -size: '+' larger, '-' smaller, '=' equal
+        uint64_t size = 0;          // In size_unit units, rounded up as find does
+        uint64_t size_unit = 512;
+        bool newer = false;         // -newer: modified after newer_than
+        int64_t newer_than = 0;
+
+        bool matches(const WalkEntry& entry) const;
+    };
+
+    struct WalkTotals {
+        uint64_t files = 0;
+        uint64_t directories = 0;
+        uint64_t bytes = 0;         // Apparent size of everything but directories
+    };
+
+    // Parse predicates (-name, -type, -size, -newer) from args[first..]
+    bool parse_walk_filter(const std::vector<std::string>& args, size_t first, WalkFilter& filter, std::string& error);
+
+    // Visit everything under `root` (symlinks are not followed), appending
+    // the entries that pass `filter` to `matches` when given, sorted by
+    // path, and counting every entry in `totals`.
+    //
+    // Directories are spread over worker threads, each with its own deque:
+    // a worker takes the newest directory from its own deque and, when that
+    // runs dry, steals the oldest from another's, so deep and wide trees
+    // both keep every worker busy. Without pthreads a single worker walks
+    // the same way.
+    bool walk_tree(const std::string& root, const WalkFilter& filter, std::vector<WalkEntry>* matches, WalkTotals& totals,
+                   std::string& error);
+}
@@ -0,0 +1,440 @@
+#include "trigram_index.hpp"
+#include "block_file.hpp"
+#include "file_io.hpp"
+#include "search.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <sys/stat.h>
+
+namespace lib {
+    static const char kMagic[4] = {'T', 'G', 'I', 'X'};
+    static const uint32_t kVersion = 1;
+    // Files above this size, or with a NUL in their first block, are not indexed
+    static const uint64_t kMaxFileSize = 16 * 1024 * 1024;
+    static const size_t kBinaryProbe = 8192;
+    // Journal entries after which an update rewrites the snapshot
+    static const size_t kMaxJournal = 256;
+
+    static inline uint8_t fold(uint8_t c) { return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c; }
+
+    static std::string snapshot_path() { return std::string(TrigramIndex::kDirectory) + "/index"; }
+    static std::string journal_path() { return std::string(TrigramIndex::kDirectory) + "/journal"; }
+
+    static void make_index_directory() {
+        std::string dir = TrigramIndex::kDirectory;
+        for (size_t slash = dir.find('/', 1); ; slash = dir.find('/', slash + 1)) {
+            mkdir(dir.substr(0, slash).c_str(), 0755);
+            if (slash == std::string::npos) break;
+        }
+    }
+
+    static int64_t mtime_of(const struct stat& st) {
+        return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    }
+
+    static void put_varint(std::string& out, uint32_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>(value | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    static inline uint32_t get_varint(const uint8_t*& p) {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = *p++;
+            value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if (byte < 0x80) return value;
+        }
+    }
+
+    static void decode(const std::string& bytes, uint32_t count, std::vector<uint32_t>& ids) {
+        ids.resize(count);
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(bytes.data());
+        uint32_t id = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            id += get_varint(p);
+            ids[i] = id;
+        }
+    }
+
+    // Distinct folded trigrams of `data`. A 2^24-bit set marks trigrams
+    // already seen, and is cleared again through the returned list.
+    static void collect_trigrams(std::string_view data, std::vector<uint32_t>& grams) {
+        static std::vector<uint64_t> seen((1 << 24) / 64);
+        grams.clear();
+        uint32_t gram = 0;
+        for (size_t i = 0; i < data.size(); ++i) {
+            gram = ((gram << 8) | fold(static_cast<uint8_t>(data[i]))) & 0xffffff;
+            if (i < 2) continue;
+            uint64_t bit = 1ull << (gram & 63);
+            if (seen[gram >> 6] & bit) continue;
+            seen[gram >> 6] |= bit;
+            grams.push_back(gram);
+        }
+        for (uint32_t g : grams) seen[g >> 6] = 0;
+    }
+
+    static bool read_whole(const std::string& path, std::string& content) {
+        std::string error;
+        return load_file(path, content, error);
+    }
+
+    bool TrigramIndex::contains(const std::string& path) const {
+        if (root_.empty() || path.compare(0, strlen(kDirectory), kDirectory) == 0) return false;
+        if (root_ == "/") return !path.empty() && path[0] == '/';
+        return path.size() > root_.size() && path.compare(0, root_.size(), root_) == 0 && path[root_.size()] == '/';
+    }
+
+    void TrigramIndex::add_file(const std::string& path, uint64_t size, int64_t mtime) {
+        if (size > kMaxFileSize) return;
+        std::string content;
+        if (!read_whole(path, content)) return;
+        if (memchr(content.data(), '\0', std::min(content.size(), kBinaryProbe))) return;
+
+        uint32_t id = static_cast<uint32_t>(files_.size());
+        files_.push_back(File{path, size, mtime, true});
+        ids_[path] = id;
+        ++live_;
+
+        std::vector<uint32_t> grams;
+        collect_trigrams(content, grams);
+        for (uint32_t gram : grams) {
+            Postings& list = postings_[gram];
+            put_varint(list.bytes, id - list.last);
+            list.last = id;
+            ++list.count;
+        }
+    }
+
+    void TrigramIndex::drop_file(const std::string& path) {
+        auto it = ids_.find(path);
+        if (it == ids_.end()) return;
+        files_[it->second].live = false;
+        --live_;
+        ids_.erase(it);
+    }
+
+    // Bring one path in line with the filesystem
+    void TrigramIndex::apply(const std::string& path) {
+        drop_file(path);
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            add_file(path, static_cast<uint64_t>(st.st_size), mtime_of(st));
+        }
+    }
+
+    void TrigramIndex::walk(const std::string& dir) {
+        DIR* handle = opendir(dir.c_str());
+        if (!handle) return;
+
+        std::vector<std::string> subdirs;
+        while (struct dirent* entry = readdir(handle)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            std::string path = dir.back() == '/' ? dir + entry->d_name : dir + "/" + entry->d_name;
+
+            struct stat st;
+            if (lstat(path.c_str(), &st) != 0) continue;
+            if (S_ISDIR(st.st_mode)) {
+                if (path != kDirectory) subdirs.push_back(path);
+            } else if (S_ISREG(st.st_mode)) {
+                add_file(path, static_cast<uint64_t>(st.st_size), mtime_of(st));
+            }
+        }
+        closedir(handle);
+
+        for (const std::string& subdir : subdirs) walk(subdir);
+    }
+
+    bool TrigramIndex::build(const std::string& root, std::string& error) {
+        struct stat st;
+        if (stat(root.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            error = "not a directory: " + root;
+            return false;
+        }
+
+        // Absolute, as the paths file_changed and file_removed report are
+        root_ = absolute_path(root);
+        files_.clear();
+        ids_.clear();
+        postings_.clear();
+        live_ = 0;
+        walk(root_);
+        return save(error);
+    }
+
+    bool TrigramIndex::save(std::string& error) {
+        // Renumber live files densely, dropping tombstones from every list
+        std::vector<uint32_t> remap(files_.size(), UINT32_MAX);
+        std::vector<File> files;
+        files.reserve(live_);
+        for (size_t id = 0; id < files_.size(); ++id) {
+            if (!files_[id].live) continue;
+            remap[id] = static_cast<uint32_t>(files.size());
+            files.push_back(std::move(files_[id]));
+        }
+
+        if (files.size() != files_.size()) {
+            std::vector<uint32_t> ids;
+            for (auto it = postings_.begin(); it != postings_.end();) {
+                decode(it->second.bytes, it->second.count, ids);
+                Postings list;
+                for (uint32_t id : ids) {
+                    if (remap[id] == UINT32_MAX) continue;
+                    put_varint(list.bytes, remap[id] - list.last);
+                    list.last = remap[id];
+                    ++list.count;
+                }
+                if (list.count == 0) {
+                    it = postings_.erase(it);
+                } else {
+                    it->second = std::move(list);
+                    ++it;
+                }
+            }
+        }
+        files_ = std::move(files);
+        ids_.clear();
+        for (size_t id = 0; id < files_.size(); ++id) ids_[files_[id].path] = static_cast<uint32_t>(id);
+
+        make_index_directory();
+        std::string temp = snapshot_path() + ".tmp";
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            error = "cannot write " + temp;
+            return false;
+        }
+
+        auto put32 = [&](uint32_t value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+        auto put64 = [&](uint64_t value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+        auto put_string = [&](const std::string& value) {
+            put32(static_cast<uint32_t>(value.size()));
+            out.write(value.data(), value.size());
+        };
+
+        out.write(kMagic, sizeof(kMagic));
+        put32(kVersion);
+        put_string(root_);
+        put32(static_cast<uint32_t>(files_.size()));
+        for (const File& file : files_) {
+            put_string(file.path);
+            put64(file.size);
+            put64(static_cast<uint64_t>(file.mtime));
+        }
+        put32(static_cast<uint32_t>(postings_.size()));
+        for (const auto& entry : postings_) {
+            put32(entry.first);
+            put32(entry.second.count);
+            put32(entry.second.last);
+            put_string(entry.second.bytes);
+        }
+        out.close();
+
+        if (!out || rename(temp.c_str(), snapshot_path().c_str()) != 0) {
+            error = "cannot write " + snapshot_path();
+            return false;
+        }
+        ::remove(journal_path().c_str());
+        journaled_ = 0;
+        return true;
+    }
+
+    bool TrigramIndex::load(std::string& error) {
+        std::ifstream in(snapshot_path(), std::ios::binary);
+        if (!in.is_open()) {
+            error = "no search index; build one with `search --index <root>`";
+            return false;
+        }
+
+        bool ok = true;
+        auto get32 = [&]() { uint32_t value = 0; ok = ok && in.read(reinterpret_cast<char*>(&value), sizeof(value)); return value; };
+        auto get64 = [&]() { uint64_t value = 0; ok = ok && in.read(reinterpret_cast<char*>(&value), sizeof(value)); return value; };
+        auto get_string = [&](std::string& value) {
+            value.resize(get32());
+            ok = ok && in.read(&value[0], value.size());
+        };
+
+        char magic[4];
+        if (!in.read(magic, sizeof(magic)) || memcmp(magic, kMagic, sizeof(kMagic)) != 0 || get32() != kVersion) {
+            error = "search index is corrupt; rebuild it with `search --index <root>`";
+            return false;
+        }
+
+        files_.clear();
+        ids_.clear();
+        postings_.clear();
+        get_string(root_);
+        uint32_t file_count = get32();
+        for (uint32_t id = 0; ok && id < file_count; ++id) {
+            File file;
+            get_string(file.path);
+            file.size = get64();
+            file.mtime = static_cast<int64_t>(get64());
+            file.live = true;
+            ids_[file.path] = id;
+            files_.push_back(std::move(file));
+        }
+        live_ = files_.size();
+
+        uint32_t trigram_count = get32();
+        for (uint32_t i = 0; ok && i < trigram_count; ++i) {
+            uint32_t gram = get32();
+            Postings& list = postings_[gram];
+            list.count = get32();
+            list.last = get32();
+            get_string(list.bytes);
+        }
+        if (!ok) {
+            error = "search index is corrupt; rebuild it with `search --index <root>`";
+            return false;
+        }
+
+        // Replay paths touched since the snapshot, then catch any other edits
+        bool changed = false;
+        std::ifstream journal(journal_path());
+        std::string path;
+        while (std::getline(journal, path)) {
+            if (path.empty()) continue;
+            apply(path);
+            changed = true;
+        }
+
+        size_t indexed = files_.size();
+        for (size_t id = 0; id < indexed; ++id) {
+            if (!files_[id].live) continue;
+            struct stat st;
+            if (stat(files_[id].path.c_str(), &st) != 0 || static_cast<uint64_t>(st.st_size) != files_[id].size ||
+                mtime_of(st) != files_[id].mtime) {
+                std::string stale = files_[id].path;
+                apply(stale);
+                changed = true;
+            }
+        }
+
+        return changed ? save(error) : true;
+    }
+
+    void TrigramIndex::journal(const std::string& path) {
+        std::ofstream out(journal_path(), std::ios::app);
+        out << path << '\n';
+        if (++journaled_ >= kMaxJournal) {
+            std::string error;
+            save(error);
+        }
+    }
+
+    void TrigramIndex::update(const std::string& path) {
+        if (!contains(path)) return;
+        apply(path);
+        journal(path);
+    }
+
+    std::vector<uint32_t> TrigramIndex::candidates(std::string_view needle) const {
+        std::vector<uint32_t> result;
+        if (needle.size() < 3) {
+            for (size_t id = 0; id < files_.size(); ++id) {
+                if (files_[id].live) result.push_back(static_cast<uint32_t>(id));
+            }
+            return result;
+        }
+
+        std::vector<uint32_t> grams;
+        collect_trigrams(needle, grams);
+        std::vector<const Postings*> lists;
+        for (uint32_t gram : grams) {
+            auto it = postings_.find(gram);
+            if (it == postings_.end()) return result;
+            lists.push_back(&it->second);
+        }
+
+        // Intersect from the rarest trigram up, so the working set only shrinks
+        std::sort(lists.begin(), lists.end(), [](const Postings* a, const Postings* b) { return a->count < b->count; });
+        decode(lists[0]->bytes, lists[0]->count, result);
+        std::vector<uint32_t> ids;
+        for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+            decode(lists[i]->bytes, lists[i]->count, ids);
+            auto end = std::set_intersection(result.begin(), result.end(), ids.begin(), ids.end(), result.begin());
+            result.erase(end, result.end());
+        }
+
+        result.erase(std::remove_if(result.begin(), result.end(), [&](uint32_t id) { return !files_[id].live; }), result.end());
+        return result;
+    }
+
+    size_t TrigramIndex::search(std::string_view needle, bool ignore_case, const Sink& sink) {
+        std::string folded_needle;
+        if (ignore_case) {
+            folded_needle.assign(needle);
+            for (char& c : folded_needle) c = static_cast<char>(fold(static_cast<uint8_t>(c)));
+            needle = folded_needle;
+        }
+
+        std::vector<uint32_t> ids = candidates(needle);
+        std::string content;
+        std::string folded;
+        for (uint32_t id : ids) {
+            const std::string& path = files_[id].path;
+            if (!read_whole(path, content)) continue;
+
+            std::string_view haystack = content;
+            if (ignore_case) {
+                folded = content;
+                for (char& c : folded) c = static_cast<char>(fold(static_cast<uint8_t>(c)));
+                haystack = folded;
+            }
+
+            // Report each matching line once, counting newlines as we go
+            size_t line_number = 1;
+            size_t counted = 0;
+            size_t from = 0;
+            while (from <= haystack.size()) {
+                size_t at = find_literal(haystack, needle, from);
+                if (at == std::string_view::npos) break;
+
+                line_number += count_byte(content.data() + counted, at - counted, '\n');
+                counted = at;
+                const char* line_end = find_byte(content.data() + at, content.size() - at, '\n');
+                size_t end = line_end ? line_end - content.data() : content.size();
+                size_t start = at == 0 ? std::string::npos : content.rfind('\n', at - 1);
+                start = start == std::string::npos ? 0 : start + 1;
+
+                sink(path, line_number, std::string_view(content).substr(start, end - start));
+                from = end + 1;
+            }
+        }
+        return ids.size();
+    }
+
+    static TrigramIndex* shared_index = nullptr;
+    static bool shared_loaded = false;
+
+    TrigramIndex* search_index() {
+        if (!shared_loaded) {
+            shared_loaded = true;
+            TrigramIndex* index = new TrigramIndex();
+            std::string error;
+            if (index->load(error)) {
+                shared_index = index;
+            } else {
+                delete index;
+            }
+        }
+        return shared_index;
+    }
+
+    TrigramIndex* build_search_index(const std::string& root, std::string& error) {
+        TrigramIndex* index = new TrigramIndex();
+        if (!index->build(root, error)) {
+            delete index;
+            return nullptr;
+        }
+        delete shared_index;
+        shared_index = index;
+        shared_loaded = true;
+        return shared_index;
+    }
+}
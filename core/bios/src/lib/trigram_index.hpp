@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lib {
+    // Substring search over the files under a root directory. Every file is
+    // reduced to the set of (ASCII case-folded) byte trigrams it contains; a
+    // query intersects the posting lists of its own trigrams and only reads
+    // the candidate files to confirm real matches.
+    //
+    // Posting lists hold ascending file ids as varint deltas, so files added
+    // later just append to them. Changed files get a new id and their old id
+    // becomes a tombstone that is filtered at query time and dropped when the
+    // index is compacted on save.
+    //
+    // The index is saved under kDirectory as a snapshot plus a journal of
+    // paths touched since; load() replays the journal and re-checks every
+    // file's size and mtime, so edits made behind the index's back are
+    // picked up too.
+    class TrigramIndex {
+    public:
+        static constexpr const char* kDirectory = "/.bios/trigrams";
+
+        // Called for each matching line: path, 1-based line number, line text
+        using Sink = std::function<void(const std::string&, size_t, std::string_view)>;
+
+        // Index every regular file under `root` and save the result
+        bool build(const std::string& root, std::string& error);
+
+        // Load the saved index; false if none has been built
+        bool load(std::string& error);
+
+        // Write a compacted snapshot and clear the journal
+        bool save(std::string& error);
+
+        // Re-index one file, or drop it if it no longer exists. Paths outside
+        // the root are ignored.
+        void update(const std::string& path);
+
+        // Report each line containing `needle`; returns the number of files
+        // that were read to verify candidates
+        size_t search(std::string_view needle, bool ignore_case, const Sink& sink);
+
+        const std::string& root() const { return root_; }
+        size_t file_count() const { return live_; }
+        size_t trigram_count() const { return postings_.size(); }
+
+    private:
+        struct File {
+            std::string path;
+            uint64_t size;
+            int64_t mtime;
+            bool live;
+        };
+
+        struct Postings {
+            std::string bytes;      // Varint deltas between ascending ids
+            uint32_t last = 0;      // Last id appended
+            uint32_t count = 0;
+        };
+
+        std::string root_;
+        std::vector<File> files_;
+        std::unordered_map<std::string, uint32_t> ids_;
+        std::unordered_map<uint32_t, Postings> postings_;
+        size_t live_ = 0;
+        size_t journaled_ = 0;
+
+        bool contains(const std::string& path) const;
+        void add_file(const std::string& path, uint64_t size, int64_t mtime);
+        void drop_file(const std::string& path);
+        void apply(const std::string& path);
+        void walk(const std::string& dir);
+        void journal(const std::string& path);
+        std::vector<uint32_t> candidates(std::string_view needle) const;
+    };
+
+    // The index shared by the exports and commands, loaded on first use;
+    // nullptr until one has been built
+    TrigramIndex* search_index();
+
+    // Build (or rebuild) the shared index over `root`
+    TrigramIndex* build_search_index(const std::string& root, std::string& error);
+}
@@ -0,0 +1,376 @@
+#include "utf8.hpp"
+#include <cstring>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+namespace lib {
+    static inline bool is_continuation(uint8_t byte) { return (byte & 0xC0) == 0x80; }
+
+    static bool validate_scalar(const uint8_t* s, size_t len) {
+        size_t i = 0;
+        while (i < len) {
+            // Eight ASCII bytes at a time
+            if (i + 8 <= len) {
+                uint64_t word;
+                memcpy(&word, s + i, sizeof(word));
+                if ((word & 0x8080808080808080ULL) == 0) {
+                    i += 8;
+                    continue;
+                }
+            }
+
+            uint8_t lead = s[i];
+            if (lead < 0x80) {
+                ++i;
+                continue;
+            }
+
+            size_t need;
+            uint8_t low = 0x80, high = 0xBF;   // Allowed range of the second byte
+            if (lead >= 0xC2 && lead <= 0xDF) {
+                need = 1;
+            } else if (lead >= 0xE0 && lead <= 0xEF) {
+                need = 2;
+                if (lead == 0xE0) low = 0xA0;          // Overlong
+                if (lead == 0xED) high = 0x9F;         // Surrogates
+            } else if (lead >= 0xF0 && lead <= 0xF4) {
+                need = 3;
+                if (lead == 0xF0) low = 0x90;          // Overlong
+                if (lead == 0xF4) high = 0x8F;         // Above U+10FFFF
+            } else {
+                return false;
+            }
+
+            if (len - i <= need) return false;
+            if (s[i + 1] < low || s[i + 1] > high) return false;
+            for (size_t k = 2; k <= need; ++k) {
+                if (!is_continuation(s[i + k])) return false;
+            }
+            i += need + 1;
+        }
+        return true;
+    }
+
+#ifdef __wasm_simd128__
+    // Lookup-table validation after Keiser and Lemire, "Validating UTF-8 in
+    // less than one instruction per byte". Each byte is classified together
+    // with the byte before it through three nibble tables; any bit that
+    // survives the AND names an error. Three- and four-byte sequences are
+    // checked by requiring continuations two and three bytes after a lead.
+    enum : uint8_t {
+        kTooShort = 1 << 0,         // Lead byte not followed by a continuation
+        kTooLong = 1 << 1,          // ASCII followed by a continuation
+        kOverlong3 = 1 << 2,
+        kTooLarge = 1 << 3,
+        kSurrogate = 1 << 4,
+        kOverlong2 = 1 << 5,
+        kTooLarge1000 = 1 << 6,
+        kOverlong4 = 1 << 6,
+        kTwoConts = 1 << 7,         // Continuation after continuation
+        kCarry = kTooShort | kTooLong | kTwoConts,
+    };
+
+    static inline v128_t check_special_cases(v128_t input, v128_t prev1) {
+        const v128_t byte_1_high_table = wasm_i8x16_make(
+            kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+            kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+            kTooShort | kOverlong2,
+            kTooShort,
+            kTooShort | kOverlong3 | kSurrogate,
+            static_cast<int8_t>(kTooShort | kTooLarge | kTooLarge1000 | kOverlong4));
+        const v128_t byte_1_low_table = wasm_i8x16_make(
+            static_cast<int8_t>(kCarry | kOverlong3 | kOverlong2 | kOverlong4),
+            static_cast<int8_t>(kCarry | kOverlong2),
+            static_cast<int8_t>(kCarry),
+            static_cast<int8_t>(kCarry),
+            static_cast<int8_t>(kCarry | kTooLarge),
+            static_cast<int8_t>(kCarry | kTooLarge | kTooLarge1000),
+            static_cast<int8_t>(kCarry | kTooLarge | kTooLarge1000),
+            static_cast<int8_t>(kCarry | kTooLarge | kTooLarge1000),
+            static_cast<int8_t>(kCarry | kTooLarge | kTooLarge1000),
+            static_cast<int8_t>(kCarry | kTooLarge | kTooLarge1000),
+            static_cast<int8_t>(kCarry | kTooLarge | kTooLarge1000),
+            static_cast<int8_t>(kCarry | kTooLarge | kTooLarge1000),
+            static_cast<int8_t>(kCarry | kTooLarge | kTooLarge1000),
+            static_cast<int8_t>(kCarry | kTooLarge | kTooLarge1000 | kSurrogate),
+            static_cast<int8_t>(kCarry | kTooLarge | kTooLarge1000),
+            static_cast<int8_t>(kCarry | kTooLarge | kTooLarge1000));
+        const v128_t byte_2_high_table = wasm_i8x16_make(
+            kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+            static_cast<int8_t>(kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4),
+            static_cast<int8_t>(kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge),
+            static_cast<int8_t>(kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge),
+            static_cast<int8_t>(kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge),
+            kTooShort, kTooShort, kTooShort, kTooShort);
+
+        const v128_t nibble = wasm_i8x16_splat(0x0F);
+        v128_t byte_1_high = wasm_i8x16_swizzle(byte_1_high_table, wasm_u8x16_shr(prev1, 4));
+        v128_t byte_1_low = wasm_i8x16_swizzle(byte_1_low_table, wasm_v128_and(prev1, nibble));
+        v128_t byte_2_high = wasm_i8x16_swizzle(byte_2_high_table, wasm_u8x16_shr(input, 4));
+        return wasm_v128_and(wasm_v128_and(byte_1_high, byte_1_low), byte_2_high);
+    }
+
+    // Error bits for one block given the block before it
+    static inline v128_t check_block(v128_t input, v128_t prev_input) {
+        v128_t prev1 = wasm_i8x16_shuffle(prev_input, input, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30);
+        v128_t prev2 = wasm_i8x16_shuffle(prev_input, input, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29);
+        v128_t prev3 = wasm_i8x16_shuffle(prev_input, input, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28);
+        v128_t special = check_special_cases(input, prev1);
+
+        // High bit set where a continuation is required as the third or fourth byte
+        v128_t third = wasm_u8x16_sub_sat(prev2, wasm_u8x16_splat(0xE0 - 0x80));
+        v128_t fourth = wasm_u8x16_sub_sat(prev3, wasm_u8x16_splat(0xF0 - 0x80));
+        v128_t must_continue = wasm_v128_and(wasm_v128_or(third, fourth), wasm_u8x16_splat(0x80));
+        return wasm_v128_xor(must_continue, special);
+    }
+#endif
+
+    bool utf8_validate(const char* data, size_t len) {
+        const uint8_t* s = reinterpret_cast<const uint8_t*>(data);
+        size_t i = 0;
+
+#ifdef __wasm_simd128__
+        // A block is incomplete when its last bytes start a sequence that
+        // runs into the next block
+        const v128_t max_complete = wasm_u8x16_make(
+            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF, 0xDF, 0xBF);
+        v128_t error = wasm_i8x16_splat(0);
+        v128_t prev_input = wasm_i8x16_splat(0);
+        v128_t prev_incomplete = wasm_i8x16_splat(0);
+
+        for (; i + 16 <= len; i += 16) {
+            v128_t input = wasm_v128_load(s + i);
+            if (wasm_i8x16_bitmask(input) == 0) {
+                error = wasm_v128_or(error, prev_incomplete);
+            } else {
+                error = wasm_v128_or(error, check_block(input, prev_input));
+                prev_incomplete = wasm_u8x16_sub_sat(input, max_complete);
+            }
+            prev_input = input;
+        }
+        if (wasm_v128_any_true(error)) return false;
+
+        // Back up to the start of a sequence that may straddle the last block
+        size_t start = i;
+        for (size_t back = 1; back <= 3 && back <= i; ++back) {
+            uint8_t byte = s[i - back];
+            if (byte >= 0xC0) {
+                start = i - back;
+                break;
+            }
+            if (byte < 0x80) break;
+        }
+        i = start;
+#endif
+
+        return validate_scalar(s + i, len - i);
+    }
+
+    // Decode one character of valid UTF-8 at s[i] into UTF-16
+    static inline void decode_utf16(const uint8_t* s, size_t& i, char16_t* out, size_t& o) {
+        uint8_t lead = s[i];
+        if (lead < 0x80) {
+            out[o++] = lead;
+            i += 1;
+        } else if (lead < 0xE0) {
+            out[o++] = static_cast<char16_t>((lead & 0x1F) << 6 | (s[i + 1] & 0x3F));
+            i += 2;
+        } else if (lead < 0xF0) {
+            out[o++] = static_cast<char16_t>((lead & 0x0F) << 12 | (s[i + 1] & 0x3F) << 6 | (s[i + 2] & 0x3F));
+            i += 3;
+        } else {
+            uint32_t code = ((lead & 0x07) << 18 | (s[i + 1] & 0x3F) << 12 | (s[i + 2] & 0x3F) << 6 | (s[i + 3] & 0x3F)) - 0x10000;
+            out[o++] = static_cast<char16_t>(0xD800 + (code >> 10));
+            out[o++] = static_cast<char16_t>(0xDC00 + (code & 0x3FF));
+            i += 4;
+        }
+    }
+
+    size_t utf16_length_from_utf8(const char* data, size_t len) {
+        const uint8_t* s = reinterpret_cast<const uint8_t*>(data);
+        size_t count = 0;
+        size_t i = 0;
+
+#ifdef __wasm_simd128__
+        // One unit per non-continuation byte, plus one more per four-byte lead
+        for (; i + 16 <= len; i += 16) {
+            v128_t input = wasm_v128_load(s + i);
+            uint32_t leads = wasm_i8x16_bitmask(wasm_i8x16_gt(input, wasm_i8x16_splat(-65)));
+            uint32_t fours = wasm_i8x16_bitmask(wasm_u8x16_ge(input, wasm_u8x16_splat(0xF0)));
+            count += __builtin_popcount(leads) + __builtin_popcount(fours);
+        }
+#endif
+
+        for (; i < len; ++i) {
+            if (!is_continuation(s[i])) ++count;
+            if (s[i] >= 0xF0) ++count;
+        }
+        return count;
+    }
+
+    size_t utf8_to_utf16(const char* data, size_t len, char16_t* out) {
+        const uint8_t* s = reinterpret_cast<const uint8_t*>(data);
+        size_t i = 0;
+        size_t o = 0;
+
+#ifdef __wasm_simd128__
+        while (i + 16 <= len) {
+            v128_t input = wasm_v128_load(s + i);
+            if (wasm_i8x16_bitmask(input) == 0) {
+                wasm_v128_store(out + o, wasm_u16x8_extend_low_u8x16(input));
+                wasm_v128_store(out + o + 8, wasm_u16x8_extend_high_u8x16(input));
+                i += 16;
+                o += 16;
+                continue;
+            }
+
+            // Decode characters until past this block, then try ASCII again
+            size_t block_end = i + 16;
+            while (i < block_end) decode_utf16(s, i, out, o);
+        }
+#endif
+
+        while (i < len) decode_utf16(s, i, out, o);
+        return o;
+    }
+
+    size_t utf8_length_from_utf16(const char16_t* data, size_t len) {
+        size_t count = 0;
+        size_t i = 0;
+        while (i < len) {
+#ifdef __wasm_simd128__
+            // Eight ASCII units at a time
+            if (i + 8 <= len) {
+                v128_t units = wasm_v128_load(data + i);
+                if (!wasm_v128_any_true(wasm_v128_and(units, wasm_i16x8_splat(static_cast<int16_t>(0xFF80))))) {
+                    count += 8;
+                    i += 8;
+                    continue;
+                }
+            }
+#endif
+            char16_t unit = data[i++];
+            if (unit < 0x80) {
+                count += 1;
+            } else if (unit < 0x800) {
+                count += 2;
+            } else if (unit >= 0xD800 && unit <= 0xDBFF && i < len && data[i] >= 0xDC00 && data[i] <= 0xDFFF) {
+                count += 4;
+                ++i;
+            } else {
+                count += 3;
+            }
+        }
+        return count;
+    }
+
+    bool utf16_to_utf8(const char16_t* data, size_t len, char* out, size_t& written) {
+        size_t i = 0;
+        size_t o = 0;
+        while (i < len) {
+#ifdef __wasm_simd128__
+            // Sixteen ASCII units narrow to sixteen bytes
+            if (i + 16 <= len) {
+                v128_t low = wasm_v128_load(data + i);
+                v128_t high = wasm_v128_load(data + i + 8);
+                const v128_t non_ascii = wasm_i16x8_splat(static_cast<int16_t>(0xFF80));
+                if (!wasm_v128_any_true(wasm_v128_and(wasm_v128_or(low, high), non_ascii))) {
+                    wasm_v128_store(out + o, wasm_u8x16_narrow_i16x8(low, high));
+                    i += 16;
+                    o += 16;
+                    continue;
+                }
+            }
+#endif
+            uint32_t code = data[i++];
+            if (code < 0x80) {
+                out[o++] = static_cast<char>(code);
+            } else if (code < 0x800) {
+                out[o++] = static_cast<char>(0xC0 | code >> 6);
+                out[o++] = static_cast<char>(0x80 | (code & 0x3F));
+            } else if (code >= 0xD800 && code <= 0xDFFF) {
+                if (code > 0xDBFF || i >= len || data[i] < 0xDC00 || data[i] > 0xDFFF) return false;
+                code = 0x10000 + ((code - 0xD800) << 10) + (data[i++] - 0xDC00);
+                out[o++] = static_cast<char>(0xF0 | code >> 18);
+                out[o++] = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                out[o++] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out[o++] = static_cast<char>(0x80 | (code & 0x3F));
+            } else {
+                out[o++] = static_cast<char>(0xE0 | code >> 12);
+                out[o++] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out[o++] = static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+        written = o;
+        return true;
+    }
+
+    size_t utf8_length_from_latin1(const uint8_t* data, size_t len) {
+        size_t count = len;
+        size_t i = 0;
+#ifdef __wasm_simd128__
+        for (; i + 16 <= len; i += 16) count += __builtin_popcount(wasm_i8x16_bitmask(wasm_v128_load(data + i)));
+#endif
+        for (; i < len; ++i) count += data[i] >> 7;
+        return count;
+    }
+
+    size_t latin1_to_utf8(const uint8_t* data, size_t len, char* out) {
+        size_t i = 0;
+        size_t o = 0;
+        while (i < len) {
+#ifdef __wasm_simd128__
+            if (i + 16 <= len) {
+                v128_t input = wasm_v128_load(data + i);
+                if (wasm_i8x16_bitmask(input) == 0) {
+                    wasm_v128_store(out + o, input);
+                    i += 16;
+                    o += 16;
+                    continue;
+                }
+            }
+#endif
+            uint8_t byte = data[i++];
+            if (byte < 0x80) {
+                out[o++] = static_cast<char>(byte);
+            } else {
+                out[o++] = static_cast<char>(0xC0 | byte >> 6);
+                out[o++] = static_cast<char>(0x80 | (byte & 0x3F));
+            }
+        }
+        return o;
+    }
+
+    bool utf8_to_latin1(const char* data, size_t len, uint8_t* out, size_t& written) {
+        const uint8_t* s = reinterpret_cast<const uint8_t*>(data);
+        size_t i = 0;
+        size_t o = 0;
+        while (i < len) {
+#ifdef __wasm_simd128__
+            if (i + 16 <= len) {
+                v128_t input = wasm_v128_load(s + i);
+                if (wasm_i8x16_bitmask(input) == 0) {
+                    wasm_v128_store(out + o, input);
+                    i += 16;
+                    o += 16;
+                    continue;
+                }
+            }
+#endif
+            uint8_t lead = s[i];
+            if (lead < 0x80) {
+                out[o++] = lead;
+                i += 1;
+            } else if (lead == 0xC2 || lead == 0xC3) {
+                out[o++] = static_cast<uint8_t>((lead & 0x1F) << 6 | (s[i + 1] & 0x3F));
+                i += 2;
+            } else {
+                return false;
+            }
+        }
+        written = o;
+        return true;
+    }
+}
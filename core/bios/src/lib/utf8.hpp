@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace lib {
+    // UTF-8 validation and transcoding to and from UTF-16 (JavaScript
+    // strings) and Latin-1. Each kernel runs a 16-byte ASCII check first and
+    // copies pure-ASCII blocks with wide loads and stores; only blocks that
+    // contain multi-byte characters fall back to per-character work.
+
+    // True if `data` is well-formed UTF-8: no overlong forms, surrogates,
+    // code points above U+10FFFF or truncated sequences
+    bool utf8_validate(const char* data, size_t len);
+
+    // UTF-16 units needed for valid UTF-8 input
+    size_t utf16_length_from_utf8(const char* data, size_t len);
+
+    // Convert valid UTF-8 into `out`, which must hold
+    // utf16_length_from_utf8(data, len) units; returns the units written
+    size_t utf8_to_utf16(const char* data, size_t len, char16_t* out);
+
+    // UTF-8 bytes needed for UTF-16 input (unpaired surrogates count as three)
+    size_t utf8_length_from_utf16(const char16_t* data, size_t len);
+
+    // Convert UTF-16 into `out`, which must hold utf8_length_from_utf16(data, len)
+    // bytes; false on an unpaired surrogate
+    bool utf16_to_utf8(const char16_t* data, size_t len, char* out, size_t& written);
+
+    // UTF-8 bytes needed for Latin-1 input
+    size_t utf8_length_from_latin1(const uint8_t* data, size_t len);
+
+    // Convert Latin-1 into `out`, which must hold utf8_length_from_latin1(data, len)
+    // bytes; returns the bytes written
+    size_t latin1_to_utf8(const uint8_t* data, size_t len, char* out);
+
+    // Convert valid UTF-8 into `out` (at most `len` bytes); false if a code
+    // point is above U+00FF
+    bool utf8_to_latin1(const char* data, size_t len, uint8_t* out, size_t& written);
+}
@@ -0,0 +1,395 @@
+#include "zip.hpp"
+#include "deflate.hpp"
+#include "file_io.hpp"
+#include "hash.hpp"
+#include <cstring>
+#include <map>
+#include <sys/stat.h>
+
+namespace lib {
+    static const uint32_t kLocalSignature = 0x04034b50;
+    static const uint32_t kCentralSignature = 0x02014b50;
+    static const uint32_t kEndSignature = 0x06054b50;
+    static const uint32_t kEnd64Signature = 0x06064b50;
+    static const uint32_t kLocator64Signature = 0x07064b50;
+    static const size_t kEndSize = 22;
+    static const size_t kLocator64Size = 20;
+    static const size_t kEnd64Size = 56;
+    static const size_t kCentralSize = 46;
+    static const size_t kLocalSize = 30;
+    static const size_t kMaxComment = 0xffff;
+    static const uint16_t kZip64Extra = 0x0001;
+    static const uint16_t kEncrypted = 0x0001;
+    static const uint16_t kStored = 0;
+    static const uint16_t kDeflated = 8;
+    static const size_t kReadChunk = 64 * 1024;         // Compressed data read at a time
+    static const uint64_t kMaxReserve = 64 * 1024 * 1024;
+    static const uint64_t kMaxMemberSize = 0xffffffff;  // Extracted into memory, which wasm32 addresses in 32 bits
+
+    // `name` with empty and "." components dropped; false if it has ".."
+    static bool clean_name(const std::string& name, std::string& clean) {
+        clean.clear();
+        for (size_t start = 0; start <= name.size();) {
+            size_t slash = name.find('/', start);
+            if (slash == std::string::npos) slash = name.size();
+            std::string part = name.substr(start, slash - start);
+            if (part == "..") return false;
+            if (!part.empty() && part != ".") {
+                if (!clean.empty()) clean += '/';
+                clean += part;
+            }
+            start = slash + 1;
+        }
+        return true;
+    }
+
+    static std::string parent_of(const std::string& name) {
+        size_t slash = name.rfind('/');
+        return slash == std::string::npos ? std::string() : name.substr(0, slash);
+    }
+
+    static std::string base_of(const std::string& name) {
+        size_t slash = name.rfind('/');
+        return slash == std::string::npos ? name : name.substr(slash + 1);
+    }
+
+    ZipArchive::~ZipArchive() = default;
+
+    bool ZipArchive::open(const std::string& path, std::string& error) {
+        if (!file_.open(path, error)) {
+            error = path + ": cannot open";
+            return false;
+        }
+        path_ = path;
+        directories_[""];
+        if (!read_central_directory(file_.size(), error)) {
+            error = path + ": " + error;
+            return false;
+        }
+        return true;
+    }
+
+    // Offsets come from the archive, so are checked against its size first
+    bool ZipArchive::read_at(uint64_t offset, uint8_t* data, size_t len) const {
+        if (offset > file_.size() || len > file_.size() - offset) return false;
+        std::string error;
+        return file_.read(offset, len, reinterpret_cast<char*>(data), error);
+    }
+
+    bool ZipArchive::read_central_directory(uint64_t file_size, std::string& error) {
+        // The end record sits in the last 22 bytes, before a comment of up
+        // to 64 KB
+        uint64_t tail_size = file_size < kEndSize + kMaxComment ? file_size : kEndSize + kMaxComment;
+        std::vector<uint8_t> tail(tail_size);
+        uint64_t tail_start = file_size - tail_size;
+        if (tail_size < kEndSize || !read_at(tail_start, tail.data(), tail.size())) {
+            error = "not a zip file";
+            return false;
+        }
+        size_t end = tail_size - kEndSize + 1;
+        while (end-- > 0) {
+            if (read32(&tail[end]) == kEndSignature && end + kEndSize + read16(&tail[end + 20]) <= tail_size) break;
+        }
+        if (end == static_cast<size_t>(-1)) {
+            error = "not a zip file";
+            return false;
+        }
+
+        const uint8_t* record = &tail[end];
+        uint64_t end_offset = tail_start + end;
+        uint64_t count = read16(record + 10);
+        uint64_t directory_size = read32(record + 12);
+        uint64_t directory_offset = read32(record + 16);
+        if (read16(record + 4) != read16(record + 6)) {
+            error = "multi-disk archives are not supported";
+            return false;
+        }
+
+        // Zip64 keeps the real values in a record found through a locator
+        // just before the end record
+        bool zip64 = false;
+        if (end_offset >= kLocator64Size) {
+            uint8_t locator[kLocator64Size];
+            if (read_at(end_offset - kLocator64Size, locator, sizeof(locator)) && read32(locator) == kLocator64Signature) {
+                uint8_t record64[kEnd64Size];
+                uint64_t record64_offset = read64(locator + 8);
+                if (record64_offset + kEnd64Size > end_offset || !read_at(record64_offset, record64, sizeof(record64)) ||
+                    read32(record64) != kEnd64Signature) {
+                    error = "bad zip64 end record";
+                    return false;
+                }
+                count = read64(record64 + 32);
+                directory_size = read64(record64 + 40);
+                directory_offset = read64(record64 + 48);
+                end_offset = record64_offset;
+                zip64 = true;
+            }
+        }
+
+        // Data prepended to the archive (a self-extractor stub) shifts every
+        // offset by the same amount
+        if (directory_size > end_offset) {
+            error = "bad central directory size";
+            return false;
+        }
+        uint64_t shift = 0;
+        if (!zip64 && directory_offset + directory_size < end_offset) shift = end_offset - directory_offset - directory_size;
+        directory_offset += shift;
+        if (directory_offset + directory_size > end_offset) {
+            error = "bad central directory offset";
+            return false;
+        }
+
+        data_end_ = directory_offset;
+
+        std::vector<uint8_t> directory(static_cast<size_t>(directory_size));
+        if (!read_at(directory_offset, directory.data(), directory.size())) {
+            error = "cannot read central directory";
+            return false;
+        }
+
+        entries_.reserve(count < directory_size / kCentralSize ? count : directory_size / kCentralSize);
+        size_t pos = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            if (pos + kCentralSize > directory.size() || read32(&directory[pos]) != kCentralSignature) {
+                error = "bad central directory entry";
+                return false;
+            }
+            const uint8_t* p = &directory[pos];
+            size_t name_len = read16(p + 28);
+            size_t extra_len = read16(p + 30);
+            size_t comment_len = read16(p + 32);
+            if (pos + kCentralSize + name_len + extra_len + comment_len > directory.size()) {
+                error = "bad central directory entry";
+                return false;
+            }
+
+            ZipEntry entry;
+            std::string raw(reinterpret_cast<const char*>(p + kCentralSize), name_len);
+            entry.flags = read16(p + 8);
+            entry.method = read16(p + 10);
+            entry.crc = read32(p + 16);
+            entry.compressed_size = read32(p + 20);
+            entry.size = read32(p + 24);
+            entry.offset = read32(p + 42);
+            entry.directory = !raw.empty() && raw.back() == '/';
+            // Unix hosts keep st_mode in the high half of the external attributes
+            entry.mode = p[5] == 3 ? (read32(p + 38) >> 16) & 07777 : 0;
+
+            // Sizes and offset that overflowed 32 bits are in the zip64
+            // extra field, in this order, only for those that did
+            const uint8_t* extra = p + kCentralSize + name_len;
+            for (size_t e = 0; e + 4 <= extra_len;) {
+                uint16_t id = read16(extra + e);
+                size_t size = read16(extra + e + 2);
+                if (e + 4 + size > extra_len) break;
+                if (id == kZip64Extra) {
+                    const uint8_t* field = extra + e + 4;
+                    const uint8_t* field_end = field + size;
+                    if (entry.size == 0xffffffff && field + 8 <= field_end) {
+                        entry.size = read64(field);
+                        field += 8;
+                    }
+                    if (entry.compressed_size == 0xffffffff && field + 8 <= field_end) {
+                        entry.compressed_size = read64(field);
+                        field += 8;
+                    }
+                    if (entry.offset == 0xffffffff && field + 8 <= field_end) entry.offset = read64(field);
+                }
+                e += 4 + size;
+            }
+            entry.offset += shift;
+            pos += kCentralSize + name_len + extra_len + comment_len;
+            // The local header and the data have to fit before the central
+            // directory; written this way so huge zip64 values cannot wrap
+            if (entry.offset > data_end_ || data_end_ - entry.offset < kLocalSize ||
+                entry.compressed_size > data_end_ - entry.offset - kLocalSize) {
+                error = "bad central directory entry";
+                return false;
+            }
+
+            if (!clean_name(raw, entry.name) || (entry.name.empty() && !entry.directory)) continue;
+            if (entry.directory) {
+                if (add_directory(entry.name)) entries_.push_back(std::move(entry));
+                continue;
+            }
+            // A name already used for a file or directory keeps its first use
+            if (files_.find(entry.name) || directories_.find(entry.name)) continue;
+            std::string parent = parent_of(entry.name);
+            if (!add_directory(parent)) continue;
+            directories_[parent].push_back(base_of(entry.name));
+            files_[entry.name] = static_cast<uint32_t>(entries_.size());
+            entries_.push_back(std::move(entry));
+        }
+        return true;
+    }
+
+    // Record directory `name` and the directories above it, each in its
+    // parent's children; false if one of them is already a file
+    bool ZipArchive::add_directory(const std::string& name) {
+        for (std::string dir = name; !dir.empty(); dir = parent_of(dir)) {
+            if (files_.find(dir)) return false;
+        }
+        // Walk up to the nearest known directory, then add the missing
+        // ones below it top-down
+        std::vector<std::string> missing;
+        for (std::string dir = name; !directories_.find(dir); dir = parent_of(dir)) missing.push_back(dir);
+        for (auto it = missing.rbegin(); it != missing.rend(); ++it) {
+            directories_[parent_of(*it)].push_back(base_of(*it) + "/");
+            directories_[*it];
+        }
+        return true;
+    }
+
+    const ZipEntry* ZipArchive::find(std::string_view name) const {
+        uint32_t* index = files_.find(name);
+        return index ? &entries_[*index] : nullptr;
+    }
+
+    bool ZipArchive::is_directory(std::string_view name) const {
+        return directories_.find(name) != nullptr;
+    }
+
+    bool ZipArchive::list(std::string_view name, std::vector<std::string>& children) const {
+        std::vector<std::string>* found = directories_.find(name);
+        if (!found) return false;
+        children = *found;
+        return true;
+    }
+
+    bool ZipArchive::extract(const ZipEntry& entry, std::string& out, std::string& error) const {
+        if (entry.flags & kEncrypted) {
+            error = entry.name + ": encrypted members are not supported";
+            return false;
+        }
+        if (entry.method != kStored && entry.method != kDeflated) {
+            error = entry.name + ": unsupported compression method " + std::to_string(entry.method);
+            return false;
+        }
+
+        // The local header repeats the name and has its own extra field,
+        // which need not match the central directory's
+        uint8_t local[kLocalSize];
+        if (!read_at(entry.offset, local, sizeof(local)) || read32(local) != kLocalSignature) {
+            error = entry.name + ": bad local header";
+            return false;
+        }
+        uint64_t start = entry.offset + kLocalSize + read16(local + 26) + read16(local + 28);
+        if (start > data_end_ || entry.compressed_size > data_end_ - start) {
+            error = entry.name + ": member data runs past the end of the archive";
+            return false;
+        }
+        if (entry.size > kMaxMemberSize || entry.size > out.max_size() - out.size()) {
+            error = entry.name + ": member too large to extract";
+            return false;
+        }
+
+        size_t base = out.size();
+        out.reserve(base + (entry.size < kMaxReserve ? entry.size : kMaxReserve));
+        if (entry.method == kStored) {
+            if (entry.compressed_size != entry.size) {
+                error = entry.name + ": bad stored size";
+                return false;
+            }
+            out.resize(base + entry.size);
+            if (!read_at(start, reinterpret_cast<uint8_t*>(&out[base]), entry.size)) {
+                out.resize(base);
+                error = entry.name + ": unexpected end of archive";
+                return false;
+            }
+        } else {
+            Inflater inflater;
+            std::vector<uint8_t> chunk(kReadChunk);
+            for (uint64_t done = 0; done < entry.compressed_size;) {
+                size_t len = entry.compressed_size - done < kReadChunk ? entry.compressed_size - done : kReadChunk;
+                if (!read_at(start + done, chunk.data(), len)) {
+                    error = entry.name + ": unexpected end of archive";
+                    return false;
+                }
+                if (!inflater.update(chunk.data(), len, out, error)) {
+                    error = entry.name + ": " + error;
+                    return false;
+                }
+                if (out.size() - base > entry.size) break;
+                done += len;
+            }
+            if (!inflater.done()) {
+                error = entry.name + ": unexpected end of compressed data";
+                return false;
+            }
+        }
+
+        if (out.size() - base != entry.size ||
+            crc32(0, reinterpret_cast<const uint8_t*>(out.data()) + base, out.size() - base) != entry.crc) {
+            error = entry.name + ": CRC or size mismatch";
+            return false;
+        }
+        return true;
+    }
+
+    // Mounts by directory; a handful at most, so lookups walk them all
+    static std::map<std::string, ZipArchive*> mounts;
+
+    bool zip_mount(const std::string& archive, const std::string& dir, std::string& error) {
+        if (dir.empty() || dir[0] != '/') {
+            error = dir + ": mount point must be an absolute path";
+            return false;
+        }
+        std::string point = absolute_path(dir);
+        ZipArchive* zip = new ZipArchive();
+        if (!zip->open(archive, error)) {
+            delete zip;
+            return false;
+        }
+        for (size_t slash = point.find('/', 1); slash != std::string::npos; slash = point.find('/', slash + 1)) {
+            mkdir(point.substr(0, slash).c_str(), 0755);
+        }
+        struct stat st;
+        if (stat(point.c_str(), &st) != 0 && mkdir(point.c_str(), 0755) != 0) {
+            delete zip;
+            error = point + ": cannot create mount point";
+            return false;
+        }
+
+        auto it = mounts.find(point);
+        if (it != mounts.end()) {
+            delete it->second;
+            it->second = zip;
+        } else {
+            mounts[point] = zip;
+        }
+        return true;
+    }
+
+    bool zip_unmount(const std::string& dir) {
+        auto it = mounts.find(absolute_path(dir));
+        if (it == mounts.end()) return false;
+        delete it->second;
+        mounts.erase(it);
+        return true;
+    }
+
+    ZipArchive* zip_lookup(const std::string& path, std::string& member) {
+        if (mounts.empty()) return nullptr;
+        std::string full = absolute_path(path);
+        // The deepest mount point wins when mounts nest
+        ZipArchive* found = nullptr;
+        size_t found_len = 0;
+        for (const auto& mount : mounts) {
+            const std::string& point = mount.first;
+            size_t len = point == "/" ? 0 : point.size();
+            if (full.compare(0, len, point, 0, len) != 0 || (full.size() > len && full[len] != '/')) continue;
+            if (found && len < found_len) continue;
+            found = mount.second;
+            found_len = len;
+            member = full.size() > len ? full.substr(len + 1) : std::string();
+        }
+        return found;
+    }
+
+    std::vector<std::pair<std::string, std::string>> zip_mounts() {
+        std::vector<std::pair<std::string, std::string>> result;
+        for (const auto& mount : mounts) result.emplace_back(mount.first, mount.second->path());
+        return result;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "block_file.hpp"
+#include "flat_map.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lib {
+    // A member as recorded in the central directory
+    struct ZipEntry {
+        std::string name;               // Relative path, without a trailing '/'
+        uint64_t offset;                // Of the local header
+        uint64_t compressed_size;
+        uint64_t size;
+        uint32_t crc;
+        uint16_t method;                // 0 stored, 8 deflate
+        uint16_t flags;
+        uint32_t mode;                  // Unix permission bits when recorded, else 0
+        bool directory;
+    };
+
+    // Read-only zip archive (including zip64). Opening reads only the end
+    // of the file and the central directory, indexing member names and
+    // directories in hash tables; a member's data is read and inflated
+    // only when it is extracted. The archive stays open until destroyed,
+    // and is read through BlockReader, so it may be stored block-compressed.
+    //
+    // Names are cleaned like paths: a leading '/' and "." components are
+    // dropped, and members with ".." components are left out.
+    class ZipArchive {
+    public:
+        ZipArchive() = default;
+        ~ZipArchive();
+
+        ZipArchive(const ZipArchive&) = delete;
+        ZipArchive& operator=(const ZipArchive&) = delete;
+
+        bool open(const std::string& path, std::string& error);
+
+        const std::string& path() const { return path_; }
+        const std::vector<ZipEntry>& entries() const { return entries_; }
+
+        // The file member `name`, or nullptr
+        const ZipEntry* find(std::string_view name) const;
+
+        // True for "" (the root) and for directories, whether they have
+        // their own member or are implied by the names inside them
+        bool is_directory(std::string_view name) const;
+
+        // Names directly inside directory `name`, in archive order, each
+        // directory's with a trailing '/'; false if it is not a directory
+        bool list(std::string_view name, std::vector<std::string>& children) const;
+
+        // Append the content of `entry` to `out`, checking its CRC. Members
+        // of 4 GB or more are refused, as they cannot be held in memory.
+        bool extract(const ZipEntry& entry, std::string& out, std::string& error) const;
+
+    private:
+        mutable BlockReader file_;                                  // Block-compressed archives read the same as plain ones
+        std::string path_;
+        uint64_t data_end_ = 0;                                     // Start of the central directory, where member data ends
+        std::vector<ZipEntry> entries_;
+        mutable FlatHashMap<uint32_t> files_;                       // Name to index in entries_
+        mutable FlatHashMap<std::vector<std::string>> directories_; // Name to children
+
+        bool read_at(uint64_t offset, uint8_t* data, size_t len) const;
+        bool read_central_directory(uint64_t file_size, std::string& error);
+        bool add_directory(const std::string& name);
+    };
+
+    // Mount `archive` read-only on directory `dir` (absolute; created if
+    // missing), so that paths under it resolve inside the archive. A
+    // second mount on the same directory replaces the first.
+    bool zip_mount(const std::string& archive, const std::string& dir, std::string& error);
+    bool zip_unmount(const std::string& dir);
+
+    // The mounted archive `path` lies in, with `member` set to the path
+    // inside it ("" for the mount point); nullptr if it is not in a mount
+    ZipArchive* zip_lookup(const std::string& path, std::string& member);
+
+    // Mount points and their archives, sorted by mount point
+    std::vector<std::pair<std::string, std::string>> zip_mounts();
+}
@@ -0,0 +1,1378 @@
+#include "zstd.hpp"
+#include "entropy.hpp"
+#include "file_io.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace lib {
+    static const uint32_t kFrameMagic = 0xFD2FB528;
+    static const uint32_t kSkippableMagic = 0x184D2A50;     // Low four bits are free
+    static const uint32_t kDictionaryMagic = 0xEC30A437;
+    static const size_t kBlockSize = 128 * 1024;
+    static const int kMaxWindowLog = 27;                    // Largest window the decoder accepts
+    static const size_t kMinMatch = 4;
+    static const int kMaxHuffmanBits = 11;
+    static const size_t kMinHuffmanLiterals = 64;           // Fewer are stored raw
+    static const size_t kMinFourStreams = 256;              // Literals split into four Huffman streams
+
+    static const int kMaxLiteralLengthCode = 35;
+    static const int kMaxMatchLengthCode = 52;
+    static const int kMaxOffsetCode = 31;
+    static const int kMaxLiteralLengthLog = 9;
+    static const int kMaxMatchLengthLog = 9;
+    static const int kMaxOffsetLog = 8;
+    static const int kMaxWeightLog = 6;
+
+    static const uint32_t kLiteralLengthBase[36] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+        16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048, 4096,
+        8192, 16384, 32768, 65536};
+    static const uint8_t kLiteralLengthBits[36] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+        13, 14, 15, 16};
+    static const uint32_t kMatchLengthBase[53] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+        19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+        35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051,
+        4099, 8195, 16387, 32771, 65539};
+    static const uint8_t kMatchLengthBits[53] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+        12, 13, 14, 15, 16};
+
+    // Predefined distributions for blocks that do not describe their own
+    static const int16_t kLiteralLengthDefault[36] = {
+        4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+        -1, -1, -1, -1};
+    static const int16_t kMatchLengthDefault[53] = {
+        1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+        -1, -1, -1, -1, -1};
+    static const int16_t kOffsetDefault[29] = {
+        1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1};
+    static const int kLiteralLengthDefaultLog = 6;
+    static const int kMatchLengthDefaultLog = 6;
+    static const int kOffsetDefaultLog = 5;
+
+    // Window log, chain depth and lookahead for each level
+    static const struct {
+        int window_log;
+        size_t depth;
+        int lazy;
+    } kLevels[ZstdEncoder::kMaxLevel] = {
+        {19, 1, 0}, {19, 2, 0}, {20, 4, 1}, {20, 8, 1}, {20, 16, 1},
+        {21, 16, 2}, {21, 32, 2}, {21, 48, 2}, {21, 64, 2}, {22, 96, 2},
+        {22, 128, 2}, {22, 192, 2}, {22, 256, 2}, {22, 384, 2}, {22, 512, 2},
+        {22, 768, 2}, {22, 1024, 2}, {22, 1536, 2}, {22, 2048, 2}};
+
+    enum { kModePredefined, kModeRle, kModeCompressed, kModeRepeat };
+    enum { kBlockRaw, kBlockRle, kBlockCompressed, kBlockReserved };
+
+    namespace {
+        struct Sequence {
+            uint32_t literal_length;
+            uint32_t match_length;
+            uint32_t offset;        // As coded (offbase) when encoding, resolved when decoding
+        };
+
+        // Reads a stream from its end toward its start; reading past the
+        // start yields zeros and leaves remaining() negative
+        class BackwardReader {
+        public:
+            bool init(const uint8_t* data, size_t len) {
+                if (len == 0 || data[len - 1] == 0) return false;
+                data_ = data;
+                len_ = len;
+                position_ = static_cast<int64_t>(len) * 8 - 8 + (31 - __builtin_clz(data[len - 1]));
+                return true;
+            }
+
+            uint32_t peek(int bits) const { return bits_at(position_ - bits, bits); }
+            void skip(int bits) { position_ -= bits; }
+
+            uint32_t read(int bits) {
+                uint32_t value = peek(bits);
+                position_ -= bits;
+                return value;
+            }
+
+            int64_t remaining() const { return position_; }
+
+        private:
+            const uint8_t* data_ = nullptr;
+            size_t len_ = 0;
+            int64_t position_ = 0;
+
+            uint32_t bits_at(int64_t low, int bits) const {
+                if (bits == 0) return 0;
+                if (low < 0) return low + bits <= 0 ? 0 : bits_at(0, static_cast<int>(bits + low)) << -low;
+                size_t byte = static_cast<size_t>(low >> 3);
+                uint64_t word = 0;
+                memcpy(&word, data_ + byte, std::min<size_t>(8, len_ - byte));
+                return static_cast<uint32_t>((word >> (low & 7)) & ((uint64_t(1) << bits) - 1));
+            }
+        };
+
+        // Encoding side of an FSE table, as zstd builds it
+        class FseEncoder {
+        public:
+            int log = 0;            // 0 for a single repeated symbol, which costs no bits
+
+            void build(const int16_t* norm, int max_symbol, int table_log);
+
+            uint32_t begin(uint8_t symbol) const {
+                if (!log) return 0;
+                const Transform& t = transforms_[symbol];
+                uint32_t bits = (t.delta_bits + (1 << 15)) >> 16;
+                uint32_t value = (bits << 16) - t.delta_bits;
+                return states_[(value >> bits) + t.delta_state];
+            }
+
+            void encode(BitWriter& writer, uint32_t& state, uint8_t symbol) const {
+                if (!log) return;
+                const Transform& t = transforms_[symbol];
+                uint32_t bits = (state + t.delta_bits) >> 16;
+                writer.add(state, bits);
+                state = states_[(state >> bits) + t.delta_state];
+            }
+
+            void flush(BitWriter& writer, uint32_t state) const { writer.add(state, log); }
+
+        private:
+            struct Transform {
+                int32_t delta_state;
+                uint32_t delta_bits;
+            };
+
+            std::vector<uint16_t> states_;
+            std::vector<Transform> transforms_;
+        };
+    }
+
+    static inline int highbit(uint32_t value) { return 31 - __builtin_clz(value); }
+
+    static inline size_t match_length(const uint8_t* a, const uint8_t* b, const uint8_t* limit) {
+        const uint8_t* start = a;
+        while (a + 8 <= limit) {
+            uint64_t diff = read64(a) ^ read64(b);
+            if (diff) return a - start + (__builtin_ctzll(diff) >> 3);
+            a += 8;
+            b += 8;
+        }
+        while (a < limit && *a == *b) {
+            ++a;
+            ++b;
+        }
+        return a - start;
+    }
+
+    // Turn a coded offset into a distance, updating the repeat offsets the
+    // way the format defines. Returns 0 for an invalid repeat code.
+    static uint32_t resolve_offset(uint32_t reps[3], uint32_t offbase, uint32_t literal_length) {
+        if (offbase > 3) {
+            reps[2] = reps[1];
+            reps[1] = reps[0];
+            reps[0] = offbase - 3;
+            return reps[0];
+        }
+
+        // Without literals the codes shift by one: rep[1], rep[2], rep[0] - 1
+        uint32_t index = offbase - 1 + (literal_length == 0);
+        if (index == 0) return reps[0];
+        uint32_t offset = index == 3 ? reps[0] - 1 : reps[index];
+        if (index != 1) reps[2] = reps[1];
+        reps[1] = reps[0];
+        reps[0] = offset;
+        return offset;
+    }
+
+    // The coded form of `offset`, using a repeat code where one applies
+    static uint32_t code_offset(const uint32_t reps[3], uint32_t offset, uint32_t literal_length) {
+        if (literal_length > 0) {
+            if (offset == reps[0]) return 1;
+            if (offset == reps[1]) return 2;
+            if (offset == reps[2]) return 3;
+        } else {
+            if (offset == reps[1]) return 1;
+            if (offset == reps[2]) return 2;
+            if (offset == reps[0] - 1) return 3;
+        }
+        return offset + 3;
+    }
+
+    static uint8_t literal_length_code(uint32_t length) {
+        if (length < 16) return static_cast<uint8_t>(length);
+        return static_cast<uint8_t>(std::upper_bound(kLiteralLengthBase, kLiteralLengthBase + 36, length) - kLiteralLengthBase - 1);
+    }
+
+    static uint8_t match_length_code(uint32_t length) {
+        if (length < 35) return static_cast<uint8_t>(length - 3);
+        return static_cast<uint8_t>(std::upper_bound(kMatchLengthBase, kMatchLengthBase + 53, length) - kMatchLengthBase - 1);
+    }
+
+    // ---- FSE tables -------------------------------------------------------
+
+    // Lay symbols out over the table the way every FSE implementation must:
+    // "less than one" symbols at the top, the rest stepped through the rest
+    static void spread_symbols(const int16_t* norm, int max_symbol, int log, std::vector<uint8_t>& symbols) {
+        uint32_t size = 1u << log;
+        uint32_t mask = size - 1;
+        uint32_t high = size - 1;
+        symbols.assign(size, 0);
+        for (int s = 0; s <= max_symbol; ++s) {
+            if (norm[s] == -1) symbols[high--] = static_cast<uint8_t>(s);
+        }
+
+        uint32_t step = (size >> 1) + (size >> 3) + 3;
+        uint32_t position = 0;
+        for (int s = 0; s <= max_symbol; ++s) {
+            for (int i = 0; i < norm[s]; ++i) {
+                symbols[position] = static_cast<uint8_t>(s);
+                do {
+                    position = (position + step) & mask;
+                } while (position > high);
+            }
+        }
+    }
+
+    static void build_decoding_table(const int16_t* norm, int max_symbol, int log, ZstdEntropy::Fse& fse) {
+        std::vector<uint8_t> symbols;
+        spread_symbols(norm, max_symbol, log, symbols);
+
+        uint32_t size = 1u << log;
+        std::vector<uint32_t> next(max_symbol + 1);
+        for (int s = 0; s <= max_symbol; ++s) next[s] = norm[s] == -1 ? 1 : norm[s];
+
+        fse.log = log;
+        fse.cells.resize(size);
+        for (uint32_t u = 0; u < size; ++u) {
+            uint8_t symbol = symbols[u];
+            uint32_t state = next[symbol]++;
+            uint8_t bits = static_cast<uint8_t>(log - highbit(state));
+            fse.cells[u] = ZstdEntropy::Cell{static_cast<uint16_t>((state << bits) - size), symbol, bits};
+        }
+    }
+
+    static void build_rle_table(uint8_t symbol, ZstdEntropy::Fse& fse) {
+        fse.log = 0;
+        fse.cells.assign(1, ZstdEntropy::Cell{0, symbol, 0});
+    }
+
+    void FseEncoder::build(const int16_t* norm, int max_symbol, int table_log) {
+        std::vector<uint8_t> symbols;
+        spread_symbols(norm, max_symbol, table_log, symbols);
+
+        uint32_t size = 1u << table_log;
+        std::vector<uint32_t> cumulative(max_symbol + 2, 0);
+        for (int s = 0; s <= max_symbol; ++s) cumulative[s + 1] = cumulative[s] + (norm[s] == -1 ? 1 : norm[s]);
+
+        log = table_log;
+        states_.assign(size, 0);
+        for (uint32_t u = 0; u < size; ++u) states_[cumulative[symbols[u]]++] = static_cast<uint16_t>(size + u);
+
+        transforms_.assign(max_symbol + 1, Transform{0, 0});
+        int32_t total = 0;
+        for (int s = 0; s <= max_symbol; ++s) {
+            Transform& t = transforms_[s];
+            if (norm[s] == 0) {
+                t.delta_bits = ((table_log + 1) << 16) - size;
+            } else if (norm[s] == -1 || norm[s] == 1) {
+                t.delta_bits = (table_log << 16) - size;
+                t.delta_state = total - 1;
+                total += 1;
+            } else {
+                uint32_t max_bits = table_log - highbit(norm[s] - 1);
+                uint32_t min_state = static_cast<uint32_t>(norm[s]) << max_bits;
+                t.delta_bits = (max_bits << 16) - min_state;
+                t.delta_state = total - norm[s];
+                total += norm[s];
+            }
+        }
+    }
+
+    // A table log suited to `total` symbols up to `max_symbol`
+    static int choose_table_log(uint32_t total, int max_symbol, int max_log) {
+        int log = max_log;
+        int source_bits = total > 1 ? highbit(total - 1) - 2 : 0;
+        if (source_bits < log) log = source_bits;
+        int min_bits = std::min(highbit(total) + 1, highbit(std::max(max_symbol, 1)) + 2);
+        if (min_bits > log) log = min_bits;
+        return std::max(5, std::min(log, max_log));
+    }
+
+    // Scale `counts` to sum to 1 << log, keeping every present symbol
+    static void normalize(const uint32_t* counts, int max_symbol, uint32_t total, int log, int16_t* norm) {
+        int32_t target = 1 << log;
+        int32_t sum = 0;
+        int largest = 0;
+        for (int s = 0; s <= max_symbol; ++s) {
+            if (!counts[s]) {
+                norm[s] = 0;
+                continue;
+            }
+            uint64_t scaled = ((static_cast<uint64_t>(counts[s]) << log) + total / 2) / total;
+            norm[s] = static_cast<int16_t>(std::max<uint64_t>(1, scaled));
+            sum += norm[s];
+            if (counts[s] > counts[largest]) largest = s;
+        }
+
+        // Settle rounding on the most frequent symbols
+        if (sum < target) norm[largest] = static_cast<int16_t>(norm[largest] + target - sum);
+        while (sum > target) {
+            int most = 0;
+            for (int s = 1; s <= max_symbol; ++s) {
+                if (norm[s] > norm[most]) most = s;
+            }
+            int32_t take = std::min(sum - target, norm[most] / 2);
+            norm[most] = static_cast<int16_t>(norm[most] - take);
+            sum -= take;
+        }
+    }
+
+    // Estimated bits to code `counts` with `norm`, or infinity if some
+    // present symbol has no probability
+    static double fse_cost(const uint32_t* counts, int max_symbol, const int16_t* norm, int norm_max, int log) {
+        double bits = 0;
+        for (int s = 0; s <= max_symbol; ++s) {
+            if (!counts[s]) continue;
+            if (s > norm_max || norm[s] == 0) return HUGE_VAL;
+            bits += counts[s] * (log - std::log2(norm[s] == -1 ? 1 : norm[s]));
+        }
+        return bits;
+    }
+
+    static void write_fse_header(const int16_t* norm, int max_symbol, int log, std::string& out) {
+        BitWriter writer(out);
+        writer.add(log - 5, 4);
+
+        int remaining = (1 << log) + 1;
+        int threshold = 1 << log;
+        int bits = log + 1;
+        int symbol = 0;
+        bool previous_zero = false;
+        while (symbol <= max_symbol && remaining > 1) {
+            if (previous_zero) {
+                int start = symbol;
+                while (!norm[symbol]) ++symbol;
+                for (; symbol >= start + 3; start += 3) writer.add(3, 2);
+                writer.add(symbol - start, 2);
+            }
+
+            int count = norm[symbol++];
+            int max = 2 * threshold - 1 - remaining;
+            remaining -= count < 0 ? -count : count;
+            ++count;
+            if (count >= threshold) count += max;
+            writer.add(count, bits - (count < max));
+            previous_zero = count == 1;
+            while (remaining < threshold) {
+                --bits;
+                threshold >>= 1;
+            }
+        }
+        writer.finish();
+    }
+
+    static bool read_fse_header(const uint8_t* data, size_t len, int max_symbol, int max_log, int16_t* norm, int& log,
+                                size_t& used) {
+        size_t position = 0;
+        auto peek = [&](int bits) {
+            uint32_t value = 0;
+            for (int i = 0; i < bits; ++i) {
+                size_t bit = position + i;
+                if (bit / 8 < len && (data[bit / 8] >> (bit % 8)) & 1) value |= 1u << i;
+            }
+            return value;
+        };
+
+        log = static_cast<int>(peek(4)) + 5;
+        position = 4;
+        if (log > max_log) return false;
+
+        int remaining = (1 << log) + 1;
+        int threshold = 1 << log;
+        int bits = log + 1;
+        int symbol = 0;
+        while (remaining > 1 && symbol <= max_symbol) {
+            int max = 2 * threshold - 1 - remaining;
+            int value = static_cast<int>(peek(bits));
+            int count;
+            if ((value & (threshold - 1)) < max) {
+                count = value & (threshold - 1);
+                position += bits - 1;
+            } else {
+                count = value & (2 * threshold - 1);
+                if (count >= threshold) count -= max;
+                position += bits;
+            }
+
+            --count;    // -1 is "less than one"
+            remaining -= count < 0 ? -count : count;
+            if (remaining < 1) return false;
+            norm[symbol++] = static_cast<int16_t>(count);
+
+            if (count == 0) {
+                // A run of further zeros, in 2-bit pieces
+                for (uint32_t repeat = 3; repeat == 3;) {
+                    repeat = peek(2);
+                    position += 2;
+                    for (uint32_t i = 0; i < repeat; ++i) {
+                        if (symbol > max_symbol) return false;
+                        norm[symbol++] = 0;
+                    }
+                }
+            }
+            while (remaining < threshold) {
+                --bits;
+                threshold >>= 1;
+            }
+        }
+        if (remaining != 1 || position > len * 8) return false;
+
+        for (; symbol <= max_symbol; ++symbol) norm[symbol] = 0;
+        used = (position + 7) / 8;
+        return true;
+    }
+
+    // ---- Huffman literals -------------------------------------------------
+
+    // Build a decoding table from weights; `count` weights are given and
+    // the last symbol's is implied by completing the code
+    static bool build_huffman_table(uint8_t* weights, size_t count, ZstdEntropy& entropy) {
+        uint32_t total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (weights[i] > kMaxHuffmanBits) return false;
+            if (weights[i]) total += 1u << (weights[i] - 1);
+        }
+        if (total == 0) return false;
+
+        int max_bits = highbit(total) + 1;
+        if (max_bits > kMaxHuffmanBits) return false;
+        uint32_t rest = (1u << max_bits) - total;
+        if (rest & (rest - 1)) return false;
+        weights[count++] = static_cast<uint8_t>(highbit(rest) + 1);
+
+        // Shortest codes (lowest weights) first, then by symbol
+        uint32_t start[kMaxHuffmanBits + 2] = {0};
+        for (size_t i = 0; i < count; ++i) {
+            if (weights[i]) start[weights[i]] += 1u << (weights[i] - 1);
+        }
+        uint32_t next = 0;
+        for (int w = 1; w <= max_bits; ++w) {
+            uint32_t ranks = start[w];
+            start[w] = next;
+            next += ranks;
+        }
+
+        entropy.huffman_log = max_bits;
+        entropy.huffman.assign(size_t(1) << max_bits, 0);
+        for (size_t s = 0; s < count; ++s) {
+            uint8_t w = weights[s];
+            if (!w) continue;
+            uint16_t cell = static_cast<uint16_t>(s << 8 | (max_bits + 1 - w));
+            uint32_t length = 1u << (w - 1);
+            std::fill(entropy.huffman.begin() + start[w], entropy.huffman.begin() + start[w] + length, cell);
+            start[w] += length;
+        }
+        return true;
+    }
+
+    static bool read_huffman_table(const uint8_t* data, size_t len, ZstdEntropy& entropy, size_t& used) {
+        if (len < 1) return false;
+        uint8_t weights[256];
+        size_t count = 0;
+        uint8_t header = data[0];
+
+        if (header >= 128) {
+            // Four bits per weight
+            count = header - 127;
+            used = 1 + (count + 1) / 2;
+            if (used > len) return false;
+            for (size_t i = 0; i < count; ++i) weights[i] = (data[1 + i / 2] >> (i % 2 ? 0 : 4)) & 15;
+        } else {
+            // FSE-coded weights: two states interleaved on one stream
+            used = 1 + header;
+            if (used > len) return false;
+            int16_t norm[kMaxHuffmanBits + 1];
+            int log;
+            size_t table_used;
+            if (!read_fse_header(data + 1, header, kMaxHuffmanBits, kMaxWeightLog, norm, log, table_used)) return false;
+            ZstdEntropy::Fse fse;
+            build_decoding_table(norm, kMaxHuffmanBits, log, fse);
+
+            BackwardReader reader;
+            if (table_used >= header || !reader.init(data + 1 + table_used, header - table_used)) return false;
+            uint32_t states[2] = {reader.read(log), reader.read(log)};
+            for (int turn = 0;; turn ^= 1) {
+                if (count >= 255) return false;
+                const ZstdEntropy::Cell& cell = fse.cells[states[turn]];
+                weights[count++] = cell.symbol;
+                states[turn] = cell.base + reader.read(cell.bits);
+                if (reader.remaining() < 0) {
+                    weights[count++] = fse.cells[states[turn ^ 1]].symbol;
+                    break;
+                }
+            }
+        }
+        return build_huffman_table(weights, count, entropy);
+    }
+
+    static bool decode_huffman_stream(const uint8_t* data, size_t len, const ZstdEntropy& entropy, uint8_t* out, size_t count) {
+        BackwardReader reader;
+        if (!reader.init(data, len)) return false;
+        const uint16_t* table = entropy.huffman.data();
+        int log = entropy.huffman_log;
+        for (size_t i = 0; i < count; ++i) {
+            uint16_t cell = table[reader.peek(log)];
+            out[i] = static_cast<uint8_t>(cell >> 8);
+            reader.skip(cell & 0xff);
+        }
+        return reader.remaining() == 0;
+    }
+
+    static void write_literal_header(int type, size_t count, std::string& out) {
+        if (count < 32) {
+            out += static_cast<char>(type | count << 3);
+        } else if (count < 4096) {
+            out += static_cast<char>(type | 1 << 2 | (count & 15) << 4);
+            out += static_cast<char>(count >> 4);
+        } else {
+            out += static_cast<char>(type | 3 << 2 | (count & 15) << 4);
+            out += static_cast<char>(count >> 4);
+            out += static_cast<char>(count >> 12);
+        }
+    }
+
+    // Huffman tree description: weights of every symbol but the last
+    static bool write_huffman_weights(const uint8_t* weights, int last, std::string& out) {
+        if (last <= 128) {
+            out += static_cast<char>(127 + last);
+            for (int i = 0; i < last; i += 2) out += static_cast<char>(weights[i] << 4 | (i + 1 < last ? weights[i + 1] : 0));
+            return true;
+        }
+
+        uint32_t counts[kMaxHuffmanBits + 1] = {0};
+        int max_weight = 0;
+        int distinct = 0;
+        for (int i = 0; i < last; ++i) {
+            if (!counts[weights[i]]++) ++distinct;
+            max_weight = std::max<int>(max_weight, weights[i]);
+        }
+        if (distinct < 2) return false;
+
+        int16_t norm[kMaxHuffmanBits + 1];
+        int log = choose_table_log(last, max_weight, kMaxWeightLog);
+        normalize(counts, max_weight, last, log, norm);
+        std::string description;
+        write_fse_header(norm, max_weight, log, description);
+        FseEncoder encoder;
+        encoder.build(norm, max_weight, log);
+
+        // Two states, taking alternate weights, written back to front
+        BitWriter writer(description);
+        uint32_t states[2];
+        int i = last;
+        if (last & 1) {
+            states[0] = encoder.begin(weights[--i]);
+            states[1] = encoder.begin(weights[--i]);
+            encoder.encode(writer, states[0], weights[--i]);
+        } else {
+            states[1] = encoder.begin(weights[--i]);
+            states[0] = encoder.begin(weights[--i]);
+        }
+        while (i > 0) {
+            encoder.encode(writer, states[1], weights[--i]);
+            encoder.encode(writer, states[0], weights[--i]);
+        }
+        encoder.flush(writer, states[1]);
+        encoder.flush(writer, states[0]);
+        writer.close();
+
+        if (description.size() >= 128) return false;
+        out += static_cast<char>(description.size());
+        out += description;
+        return true;
+    }
+
+    static bool write_huffman_literals(const uint8_t* literals, size_t count, std::string& out) {
+        uint32_t counts[256] = {0};
+        for (size_t i = 0; i < count; ++i) ++counts[literals[i]];
+        int last = 255;
+        while (!counts[last]) --last;
+
+        uint8_t lengths[256];
+        int max_bits = huffman_code_lengths(counts, last + 1, kMaxHuffmanBits, lengths);
+        uint8_t weights[256];
+        for (int s = 0; s <= last; ++s) weights[s] = lengths[s] ? static_cast<uint8_t>(max_bits + 1 - lengths[s]) : 0;
+
+        std::string body;
+        if (!write_huffman_weights(weights, last, body)) return false;
+
+        // Codes in decoding-table order: lowest weight first, then symbol
+        uint32_t start[kMaxHuffmanBits + 2] = {0};
+        for (int s = 0; s <= last; ++s) {
+            if (weights[s]) start[weights[s]] += 1u << (weights[s] - 1);
+        }
+        uint32_t next = 0;
+        for (int w = 1; w <= max_bits; ++w) {
+            uint32_t ranks = start[w];
+            start[w] = next;
+            next += ranks;
+        }
+        uint16_t codes[256];
+        for (int s = 0; s <= last; ++s) {
+            if (!weights[s]) continue;
+            codes[s] = static_cast<uint16_t>(start[weights[s]] >> (weights[s] - 1));
+            start[weights[s]] += 1u << (weights[s] - 1);
+        }
+
+        // Each stream is written back to front so it decodes front to back
+        auto write_stream = [&](const uint8_t* data, size_t n) {
+            BitWriter writer(body);
+            for (size_t i = n; i-- > 0;) writer.add(codes[data[i]], lengths[data[i]]);
+            writer.close();
+        };
+        bool four = count >= kMinFourStreams;
+        if (four) {
+            size_t segment = (count + 3) / 4;
+            size_t table = body.size();
+            body.append(6, '\0');
+            size_t begin = body.size();
+            for (int i = 0; i < 4; ++i) {
+                size_t offset = segment * i;
+                write_stream(literals + offset, std::min(segment, count - offset));
+                if (i < 3) {
+                    size_t size = body.size() - begin;
+                    if (size > 0xffff) return false;
+                    body[table + 2 * i] = static_cast<char>(size);
+                    body[table + 2 * i + 1] = static_cast<char>(size >> 8);
+                    begin = body.size();
+                }
+            }
+        } else {
+            write_stream(literals, count);
+        }
+
+        // Sizes in 10, 14 or 18 bits; a single stream only fits in 10
+        size_t largest = std::max(count, body.size());
+        int format = !four ? 0 : largest < 1024 ? 1 : largest < 16384 ? 2 : 3;
+        int bits = format < 2 ? 10 : format == 2 ? 14 : 18;
+        if (largest >= (size_t(1) << bits) || body.size() + 5 >= count) return false;
+
+        uint64_t header = kBlockCompressed | format << 2 | static_cast<uint64_t>(count) << 4 |
+                          static_cast<uint64_t>(body.size()) << (4 + bits);
+        int header_size = format < 2 ? 3 : format == 2 ? 4 : 5;
+        for (int i = 0; i < header_size; ++i) out += static_cast<char>(header >> (8 * i));
+        out += body;
+        return true;
+    }
+
+    static void write_literals(const std::string& literals, std::string& out) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(literals.data());
+        size_t count = literals.size();
+        if (count > 1 && literals.find_first_not_of(literals[0]) == std::string::npos) {
+            write_literal_header(kBlockRle, count, out);
+            out += literals[0];
+            return;
+        }
+        if (count >= kMinHuffmanLiterals && write_huffman_literals(data, count, out)) return;
+        write_literal_header(kBlockRaw, count, out);
+        out += literals;
+    }
+
+    // ---- Sequences --------------------------------------------------------
+
+    // Pick the cheapest way to code one of the three symbol streams,
+    // preparing `encoder` and appending any table description to `out`
+    static int write_symbol_table(const std::vector<uint8_t>& codes, const int16_t* predefined, int predefined_max,
+                                  int predefined_log, int max_log, FseEncoder& encoder, std::string& out) {
+        uint32_t counts[kMaxMatchLengthCode + 1] = {0};
+        int max_symbol = 0;
+        int distinct = 0;
+        for (uint8_t code : codes) {
+            if (!counts[code]++) ++distinct;
+            max_symbol = std::max<int>(max_symbol, code);
+        }
+
+        if (distinct == 1) {
+            out += static_cast<char>(max_symbol);
+            encoder.log = 0;
+            return kModeRle;
+        }
+
+        uint32_t total = static_cast<uint32_t>(codes.size());
+        int16_t norm[kMaxMatchLengthCode + 1];
+        int log = choose_table_log(total, max_symbol, max_log);
+        normalize(counts, max_symbol, total, log, norm);
+        std::string description;
+        write_fse_header(norm, max_symbol, log, description);
+
+        double compressed = fse_cost(counts, max_symbol, norm, max_symbol, log) + 8.0 * description.size();
+        double fixed = fse_cost(counts, max_symbol, predefined, predefined_max, predefined_log);
+        if (fixed <= compressed) {
+            encoder.build(predefined, predefined_max, predefined_log);
+            return kModePredefined;
+        }
+        encoder.build(norm, max_symbol, log);
+        out += description;
+        return kModeCompressed;
+    }
+
+    static void write_sequences(const std::vector<Sequence>& sequences, std::string& out) {
+        size_t count = sequences.size();
+        if (count < 128) {
+            out += static_cast<char>(count);
+        } else if (count < 0x7F00) {
+            out += static_cast<char>((count >> 8) + 128);
+            out += static_cast<char>(count);
+        } else {
+            out += static_cast<char>(255);
+            out += static_cast<char>(count - 0x7F00);
+            out += static_cast<char>((count - 0x7F00) >> 8);
+        }
+        if (count == 0) return;
+
+        std::vector<uint8_t> literal_codes(count), offset_codes(count), match_codes(count);
+        for (size_t i = 0; i < count; ++i) {
+            literal_codes[i] = literal_length_code(sequences[i].literal_length);
+            offset_codes[i] = static_cast<uint8_t>(highbit(sequences[i].offset));
+            match_codes[i] = match_length_code(sequences[i].match_length);
+        }
+
+        size_t modes = out.size();
+        out += '\0';
+        FseEncoder literal_lengths, offsets, match_lengths;
+        int literal_mode = write_symbol_table(literal_codes, kLiteralLengthDefault, kMaxLiteralLengthCode,
+                                              kLiteralLengthDefaultLog, kMaxLiteralLengthLog, literal_lengths, out);
+        int offset_mode = write_symbol_table(offset_codes, kOffsetDefault, 28, kOffsetDefaultLog, kMaxOffsetLog, offsets, out);
+        int match_mode = write_symbol_table(match_codes, kMatchLengthDefault, kMaxMatchLengthCode, kMatchLengthDefaultLog,
+                                            kMaxMatchLengthLog, match_lengths, out);
+        out[modes] = static_cast<char>(literal_mode << 6 | offset_mode << 4 | match_mode << 2);
+
+        // Back to front, so the decoder reads the first sequence first
+        BitWriter writer(out);
+        auto extra_bits = [&](size_t i) {
+            const Sequence& sequence = sequences[i];
+            writer.add(sequence.literal_length - kLiteralLengthBase[literal_codes[i]], kLiteralLengthBits[literal_codes[i]]);
+            writer.add(sequence.match_length - kMatchLengthBase[match_codes[i]], kMatchLengthBits[match_codes[i]]);
+            writer.add(sequence.offset - (1u << offset_codes[i]), offset_codes[i]);
+        };
+
+        size_t last = count - 1;
+        uint32_t match_state = match_lengths.begin(match_codes[last]);
+        uint32_t offset_state = offsets.begin(offset_codes[last]);
+        uint32_t literal_state = literal_lengths.begin(literal_codes[last]);
+        extra_bits(last);
+        for (size_t i = last; i-- > 0;) {
+            offsets.encode(writer, offset_state, offset_codes[i]);
+            match_lengths.encode(writer, match_state, match_codes[i]);
+            literal_lengths.encode(writer, literal_state, literal_codes[i]);
+            extra_bits(i);
+        }
+        match_lengths.flush(writer, match_state);
+        offsets.flush(writer, offset_state);
+        literal_lengths.flush(writer, literal_state);
+        writer.close();
+    }
+
+    static bool read_symbol_table(int mode, const uint8_t*& data, const uint8_t* end, const int16_t* predefined,
+                                  int predefined_max, int predefined_log, int max_symbol, int max_log, ZstdEntropy::Fse& fse) {
+        switch (mode) {
+            case kModePredefined:
+                build_decoding_table(predefined, predefined_max, predefined_log, fse);
+                return true;
+            case kModeRle:
+                if (data >= end || *data > max_symbol) return false;
+                build_rle_table(*data++, fse);
+                return true;
+            case kModeCompressed: {
+                int16_t norm[kMaxMatchLengthCode + 1];
+                int log;
+                size_t used;
+                if (!read_fse_header(data, end - data, max_symbol, max_log, norm, log, used)) return false;
+                build_decoding_table(norm, max_symbol, log, fse);
+                data += used;
+                return true;
+            }
+            default:
+                return !fse.cells.empty();
+        }
+    }
+
+    static bool read_sequences(const uint8_t* data, size_t len, ZstdEntropy& entropy, std::vector<Sequence>& sequences) {
+        const uint8_t* end = data + len;
+        if (len < 1) return false;
+        size_t count = *data++;
+        if (count >= 128) {
+            if (count == 255) {
+                if (end - data < 2) return false;
+                count = data[0] + (data[1] << 8) + 0x7F00;
+                data += 2;
+            } else {
+                if (end - data < 1) return false;
+                count = ((count - 128) << 8) + *data++;
+            }
+        }
+        sequences.clear();
+        if (count == 0) return data == end;
+
+        if (data >= end) return false;
+        uint8_t modes = *data++;
+        if ((modes & 3) ||
+            !read_symbol_table(modes >> 6, data, end, kLiteralLengthDefault, kMaxLiteralLengthCode, kLiteralLengthDefaultLog,
+                               kMaxLiteralLengthCode, kMaxLiteralLengthLog, entropy.literal_lengths) ||
+            !read_symbol_table((modes >> 4) & 3, data, end, kOffsetDefault, 28, kOffsetDefaultLog, kMaxOffsetCode, kMaxOffsetLog,
+                               entropy.offsets) ||
+            !read_symbol_table((modes >> 2) & 3, data, end, kMatchLengthDefault, kMaxMatchLengthCode, kMatchLengthDefaultLog,
+                               kMaxMatchLengthCode, kMaxMatchLengthLog, entropy.match_lengths)) {
+            return false;
+        }
+
+        const ZstdEntropy::Fse& literal_lengths = entropy.literal_lengths;
+        const ZstdEntropy::Fse& offsets = entropy.offsets;
+        const ZstdEntropy::Fse& match_lengths = entropy.match_lengths;
+        BackwardReader reader;
+        if (!reader.init(data, end - data)) return false;
+        uint32_t literal_state = reader.read(literal_lengths.log);
+        uint32_t offset_state = reader.read(offsets.log);
+        uint32_t match_state = reader.read(match_lengths.log);
+
+        sequences.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            const ZstdEntropy::Cell& literal = literal_lengths.cells[literal_state];
+            const ZstdEntropy::Cell& offset = offsets.cells[offset_state];
+            const ZstdEntropy::Cell& match = match_lengths.cells[match_state];
+            if (literal.symbol > kMaxLiteralLengthCode || match.symbol > kMaxMatchLengthCode || offset.symbol > kMaxOffsetCode) {
+                return false;
+            }
+
+            uint32_t offbase = (1u << offset.symbol) + reader.read(offset.symbol);
+            uint32_t match_length = kMatchLengthBase[match.symbol] + reader.read(kMatchLengthBits[match.symbol]);
+            uint32_t literal_length = kLiteralLengthBase[literal.symbol] + reader.read(kLiteralLengthBits[literal.symbol]);
+            uint32_t distance = resolve_offset(entropy.reps, offbase, literal_length);
+            if (distance == 0) return false;
+            sequences[i] = Sequence{literal_length, match_length, distance};
+
+            if (i + 1 < count) {
+                literal_state = literal.base + reader.read(literal.bits);
+                match_state = match.base + reader.read(match.bits);
+                offset_state = offset.base + reader.read(offset.bits);
+            }
+        }
+        return reader.remaining() == 0;
+    }
+
+    // Header, entropy tables and repeat offsets of a trained dictionary;
+    // false for raw content
+    static bool read_dictionary(const std::string& dictionary, uint32_t& id, ZstdEntropy& entropy, size_t& content) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(dictionary.data());
+        size_t len = dictionary.size();
+        if (len < 8 || read32(data) != kDictionaryMagic) return false;
+
+        ZstdEntropy parsed;
+        size_t position = 8;
+        size_t used;
+        if (!read_huffman_table(data + position, len - position, parsed, used)) return false;
+        position += used;
+
+        int16_t norm[kMaxMatchLengthCode + 1];
+        int log;
+        if (!read_fse_header(data + position, len - position, kMaxOffsetCode, kMaxOffsetLog, norm, log, used)) return false;
+        build_decoding_table(norm, kMaxOffsetCode, log, parsed.offsets);
+        position += used;
+        if (!read_fse_header(data + position, len - position, kMaxMatchLengthCode, kMaxMatchLengthLog, norm, log, used)) return false;
+        build_decoding_table(norm, kMaxMatchLengthCode, log, parsed.match_lengths);
+        position += used;
+        if (!read_fse_header(data + position, len - position, kMaxLiteralLengthCode, kMaxLiteralLengthLog, norm, log, used)) {
+            return false;
+        }
+        build_decoding_table(norm, kMaxLiteralLengthCode, log, parsed.literal_lengths);
+        position += used;
+
+        if (len - position < 12) return false;
+        for (int i = 0; i < 3; ++i) {
+            parsed.reps[i] = read32(data + position + 4 * i);
+            if (parsed.reps[i] == 0 || parsed.reps[i] > len - position - 12) return false;
+        }
+
+        id = read32(data + 4);
+        entropy = parsed;
+        content = position + 12;
+        return true;
+    }
+
+    // ---- Encoder ----------------------------------------------------------
+
+    ZstdEncoder::ZstdEncoder(int level, const std::string& dictionary) {
+        level = level < 1 ? 1 : level > kMaxLevel ? kMaxLevel : level;
+        window_log_ = kLevels[level - 1].window_log;
+        depth_ = kLevels[level - 1].depth;
+        lazy_ = kLevels[level - 1].lazy;
+
+        ZstdEntropy entropy;
+        size_t content = 0;
+        if (read_dictionary(dictionary, dictionary_id_, entropy, content)) memcpy(reps_, entropy.reps, sizeof(reps_));
+
+        // Only the last window's worth of the dictionary can be matched
+        size_t window = size_t(1) << window_log_;
+        if (dictionary.size() - content > window) content = dictionary.size() - window;
+        window_.assign(dictionary.begin() + content, dictionary.end());
+        history_ = window_.size();
+    }
+
+    void ZstdEncoder::update(const uint8_t* data, size_t len, std::string& out) {
+        if (!started_) {
+            // Magic, a descriptor with the content checksum and dictionary
+            // ID flags, the window size and the dictionary ID if any
+            put32(out, kFrameMagic);
+            out += static_cast<char>(0x04 | (dictionary_id_ ? 3 : 0));
+            out += static_cast<char>((window_log_ - 10) << 3);
+            if (dictionary_id_) put32(out, dictionary_id_);
+            table_.assign(size_t(1) << (window_log_ - 2), 0);
+            chain_.assign(size_t(1) << window_log_, 0);
+            started_ = true;
+        }
+
+        while (len > 0) {
+            size_t take = std::min(len, kBlockSize - (window_.size() - history_));
+            window_.insert(window_.end(), data, data + take);
+            checksum_.update(data, take);
+            data += take;
+            len -= take;
+            if (window_.size() - history_ == kBlockSize) write_block(out, false);
+        }
+    }
+
+    void ZstdEncoder::finish(std::string& out) {
+        update(nullptr, 0, out);
+        write_block(out, true);
+        put32(out, static_cast<uint32_t>(checksum_.digest()));
+    }
+
+    ZstdEncoder::Match ZstdEncoder::find_match(size_t ip, size_t anchor, size_t end) {
+        const uint8_t* base = window_.data();
+        const uint8_t* limit = base + end;
+        const size_t window = size_t(1) << window_log_;
+        const size_t chain_mask = chain_.size() - 1;
+        const int hash_shift = 32 - (window_log_ - 2);
+        auto hash = [&](size_t pos) { return (read32(base + pos) * 2654435761U) >> hash_shift; };
+
+        for (; inserted_ < ip; ++inserted_) {
+            uint32_t h = hash(inserted_);
+            uint32_t position = window_start_ + static_cast<uint32_t>(inserted_);
+            chain_[position & chain_mask] = table_[h];
+            table_[h] = position + 1;
+        }
+
+        Match best = {0, 0, 0};
+        int best_score = 0;
+        auto consider = [&](size_t length, uint32_t offset, uint32_t offbase) {
+            int score = static_cast<int>(length) * 4 - highbit(offbase);
+            if (length >= kMinMatch && score > best_score) {
+                best = Match{length, offset, offbase};
+                best_score = score;
+            }
+        };
+
+        // Repeat offsets first: they cost almost nothing to code
+        uint32_t literal_length = static_cast<uint32_t>(ip - anchor);
+        uint32_t repeats[3] = {reps_[0], reps_[1], reps_[2]};
+        if (!literal_length) {
+            repeats[0] = reps_[1];
+            repeats[1] = reps_[2];
+            repeats[2] = reps_[0] - 1;
+        }
+        for (uint32_t i = 0; i < 3; ++i) {
+            uint32_t offset = repeats[i];
+            if (offset == 0 || offset > ip || offset > window || read32(base + ip) != read32(base + ip - offset)) continue;
+            consider(kMinMatch + match_length(base + ip + kMinMatch, base + ip - offset + kMinMatch, limit), offset, i + 1);
+        }
+
+        uint32_t h = hash(ip);
+        uint32_t position = window_start_ + static_cast<uint32_t>(ip);
+        uint32_t candidate = table_[h];
+        for (size_t tries = 0; candidate && tries < depth_ && best.length < end - ip; ++tries) {
+            uint32_t distance = position - (candidate - 1);
+            if (distance == 0 || distance > window || distance > ip) break;
+            const uint8_t* ref = base + ip - distance;
+            if (read32(ref) == read32(base + ip)) {
+                size_t length = kMinMatch + match_length(base + ip + kMinMatch, ref + kMinMatch, limit);
+                consider(length, distance, code_offset(reps_, distance, literal_length));
+            }
+            candidate = chain_[(candidate - 1) & chain_mask];
+        }
+
+        chain_[position & chain_mask] = table_[h];
+        table_[h] = position + 1;
+        inserted_ = ip + 1;
+        return best;
+    }
+
+    void ZstdEncoder::write_block(std::string& out, bool last) {
+        const uint8_t* base = window_.data();
+        const size_t start = history_;
+        const size_t end = window_.size();
+        const size_t size = end - start;
+        auto block_header = [&](int type, size_t value) {
+            uint32_t header = (last ? 1 : 0) | type << 1 | static_cast<uint32_t>(value) << 3;
+            out += static_cast<char>(header);
+            out += static_cast<char>(header >> 8);
+            out += static_cast<char>(header >> 16);
+        };
+
+        bool same = size > 0 && std::all_of(base + start, base + end, [&](uint8_t byte) { return byte == base[start]; });
+        if (size == 0 || (same && size > 1)) {
+            // Nothing left, or one byte repeated
+            block_header(size ? kBlockRle : kBlockRaw, size);
+            if (size) out += static_cast<char>(base[start]);
+            inserted_ = end;
+        } else {
+            uint32_t saved[3] = {reps_[0], reps_[1], reps_[2]};
+            std::vector<Sequence> sequences;
+            std::string literals;
+            size_t anchor = start;
+            size_t ip = start;
+            while (ip + kMinMatch <= end) {
+                Match match = find_match(ip, anchor, end);
+                if (!match.length) {
+                    ip += lazy_ ? 1 : 1 + ((ip - anchor) >> 8);
+                    continue;
+                }
+
+                // Look ahead for a better match before committing
+                for (int step = 0; step < lazy_ && ip + 1 + kMinMatch <= end; ++step) {
+                    Match next = find_match(ip + 1, anchor, end);
+                    int gain = static_cast<int>(next.length) * 4 - highbit(next.offbase ? next.offbase : 1);
+                    int current = static_cast<int>(match.length) * 4 - highbit(match.offbase) + 4;
+                    if (!next.length || gain <= current) break;
+                    match = next;
+                    ++ip;
+                }
+
+                // Pull the match start back over equal literals
+                while (ip > anchor && ip > match.offset && base[ip - 1] == base[ip - 1 - match.offset]) {
+                    --ip;
+                    ++match.length;
+                }
+
+                uint32_t literal_length = static_cast<uint32_t>(ip - anchor);
+                uint32_t offbase = code_offset(reps_, match.offset, literal_length);
+                resolve_offset(reps_, offbase, literal_length);
+                sequences.push_back(Sequence{literal_length, static_cast<uint32_t>(match.length), offbase});
+                literals.append(reinterpret_cast<const char*>(base + anchor), ip - anchor);
+                ip += match.length;
+                anchor = ip;
+            }
+            literals.append(reinterpret_cast<const char*>(base + anchor), end - anchor);
+
+            std::string body;
+            write_literals(literals, body);
+            write_sequences(sequences, body);
+            if (body.size() < size) {
+                block_header(kBlockCompressed, body.size());
+                out += body;
+            } else {
+                // Stored blocks leave the repeat offsets alone
+                memcpy(reps_, saved, sizeof(reps_));
+                block_header(kBlockRaw, size);
+                out.append(reinterpret_cast<const char*>(base + start), size);
+            }
+        }
+
+        // Drop history beyond the window, in large steps
+        size_t window = size_t(1) << window_log_;
+        history_ = end;
+        if (history_ > 2 * window) {
+            size_t drop = history_ - window;
+            window_.erase(window_.begin(), window_.begin() + drop);
+            window_start_ += static_cast<uint32_t>(drop);
+            history_ -= drop;
+            inserted_ -= std::min(inserted_, drop);
+        }
+    }
+
+    // ---- Decoder ----------------------------------------------------------
+
+    ZstdDecoder::ZstdDecoder(const std::string& dictionary) {
+        size_t content = 0;
+        read_dictionary(dictionary, dictionary_id_, dictionary_entropy_, content);
+        dictionary_ = dictionary.substr(content);
+    }
+
+    bool ZstdDecoder::decode_block(const uint8_t* src, size_t len, std::string& error) {
+        error = "corrupt zstd block";
+        if (len < 1) return false;
+
+        // Literals section
+        const uint8_t* end = src + len;
+        int type = src[0] & 3;
+        int format = (src[0] >> 2) & 3;
+        size_t count;
+        if (type == kBlockRaw || type == kBlockRle) {
+            size_t header = format == 1 ? 2 : format == 3 ? 3 : 1;
+            if (len < header) return false;
+            count = format == 1 ? (src[0] >> 4) + (src[1] << 4)
+                  : format == 3 ? (src[0] >> 4) + (src[1] << 4) + (src[2] << 12)
+                                : src[0] >> 3;
+            size_t stored = type == kBlockRaw ? count : 1;
+            if (count > block_max_ || len - header < stored) return false;
+            if (type == kBlockRaw) {
+                literals_.assign(src + header, src + header + count);
+            } else {
+                literals_.assign(count, src[header]);
+            }
+            src += header + stored;
+        } else {
+            size_t header = format < 2 ? 3 : format == 2 ? 4 : 5;
+            int bits = format < 2 ? 10 : format == 2 ? 14 : 18;
+            if (len < header) return false;
+            uint64_t value = 0;
+            for (size_t i = 0; i < header; ++i) value |= static_cast<uint64_t>(src[i]) << (8 * i);
+            count = (value >> 4) & ((1u << bits) - 1);
+            size_t compressed = (value >> (4 + bits)) & ((1u << bits) - 1);
+            if (count > block_max_ || len - header < compressed) return false;
+            const uint8_t* data = src + header;
+            src += header + compressed;
+
+            if (type == kBlockCompressed) {
+                size_t used;
+                if (!read_huffman_table(data, compressed, entropy_, used)) return false;
+                data += used;
+                compressed -= used;
+            } else if (entropy_.huffman.empty()) {
+                return false;
+            }
+
+            literals_.resize(count);
+            if (format == 0) {
+                if (!decode_huffman_stream(data, compressed, entropy_, literals_.data(), count)) return false;
+            } else {
+                if (compressed < 6) return false;
+                size_t sizes[4] = {static_cast<size_t>(data[0] | data[1] << 8), static_cast<size_t>(data[2] | data[3] << 8),
+                                   static_cast<size_t>(data[4] | data[5] << 8), 0};
+                if (sizes[0] + sizes[1] + sizes[2] > compressed - 6) return false;
+                sizes[3] = compressed - 6 - sizes[0] - sizes[1] - sizes[2];
+                size_t segment = (count + 3) / 4;
+                if (3 * segment > count) return false;
+                data += 6;
+                for (int i = 0; i < 4; ++i) {
+                    size_t n = i < 3 ? segment : count - 3 * segment;
+                    if (!decode_huffman_stream(data, sizes[i], entropy_, literals_.data() + segment * i, n)) return false;
+                    data += sizes[i];
+                }
+            }
+        }
+
+        // Sequences section, then execute them against the window
+        std::vector<Sequence> sequences;
+        if (!read_sequences(src, end - src, entropy_, sequences)) return false;
+
+        size_t start = window_.size();
+        size_t literal = 0;
+        window_.resize(start + block_max_);
+        uint8_t* base = window_.data();
+        size_t op = start;
+        const size_t op_end = start + block_max_;
+        for (const Sequence& sequence : sequences) {
+            if (sequence.literal_length > literals_.size() - literal || sequence.literal_length > op_end - op) return false;
+            // literals_ may be empty, and memcpy from its null data is undefined
+            if (sequence.literal_length) memcpy(base + op, literals_.data() + literal, sequence.literal_length);
+            literal += sequence.literal_length;
+            op += sequence.literal_length;
+
+            if (sequence.offset > op || sequence.match_length > op_end - op) return false;
+            uint8_t* dst = base + op;
+            const uint8_t* ref = dst - sequence.offset;
+            if (sequence.offset >= sequence.match_length) {
+                memcpy(dst, ref, sequence.match_length);
+            } else {
+                for (uint32_t i = 0; i < sequence.match_length; ++i) dst[i] = ref[i];
+            }
+            op += sequence.match_length;
+        }
+        size_t rest = literals_.size() - literal;
+        if (rest > op_end - op) return false;
+        if (rest) memcpy(base + op, literals_.data() + literal, rest);
+        window_.resize(op + rest);
+        error.clear();
+        return true;
+    }
+
+    bool ZstdDecoder::step(std::string& out, std::string& error, bool& progress) {
+        const uint8_t* in = input_.data() + consumed_;
+        size_t available = input_.size() - consumed_;
+        progress = false;
+
+        switch (state_) {
+            case kMagic: {
+                if (available < 4) return true;
+                uint32_t magic = read32(in);
+                if (magic == kFrameMagic) {
+                    consumed_ += 4;
+                    state_ = kHeader;
+                } else if ((magic & 0xFFFFFFF0U) == kSkippableMagic) {
+                    if (available < 8) return true;
+                    skip_ = read32(in + 4);
+                    consumed_ += 8;
+                    state_ = kSkip;
+                } else {
+                    error = "not a zstd frame";
+                    return false;
+                }
+                break;
+            }
+
+            case kHeader: {
+                if (available < 1) return true;
+                uint8_t descriptor = in[0];
+                int content_size_flag = descriptor >> 6;
+                bool single_segment = descriptor & 0x20;
+                int dictionary_flag = descriptor & 3;
+                size_t content_size_bytes = content_size_flag == 0 ? (single_segment ? 1 : 0) : size_t(1) << content_size_flag;
+                size_t dictionary_bytes = dictionary_flag == 3 ? 4 : dictionary_flag;
+                size_t length = 1 + (single_segment ? 0 : 1) + dictionary_bytes + content_size_bytes;
+                if (available < length) return true;
+                if (descriptor & 0x08) {
+                    error = "unsupported zstd frame header";
+                    return false;
+                }
+
+                const uint8_t* field = in + 1;
+                uint64_t window = 0;
+                if (!single_segment) {
+                    int exponent = *field >> 3;
+                    if (exponent + 10 > kMaxWindowLog) {
+                        error = "zstd window too large";
+                        return false;
+                    }
+                    uint64_t window_base = uint64_t(1) << (10 + exponent);
+                    window = window_base + (window_base / 8) * (*field & 7);
+                    ++field;
+                }
+                uint32_t dictionary_id = 0;
+                for (size_t i = 0; i < dictionary_bytes; ++i) dictionary_id |= static_cast<uint32_t>(*field++) << (8 * i);
+                uint64_t content_size = 0;
+                for (size_t i = 0; i < content_size_bytes; ++i) content_size |= static_cast<uint64_t>(*field++) << (8 * i);
+                if (content_size_bytes == 2) content_size += 256;
+                if (single_segment) window = content_size;
+                if (window > (uint64_t(1) << kMaxWindowLog)) {
+                    error = "zstd window too large";
+                    return false;
+                }
+                if (dictionary_id && dictionary_id != dictionary_id_) {
+                    error = "zstd frame needs a different dictionary";
+                    return false;
+                }
+
+                content_checksum_ = descriptor & 0x04;
+                has_content_size_ = content_size_bytes > 0;
+                content_size_ = content_size;
+                produced_ = 0;
+                window_size_ = static_cast<size_t>(window);
+                block_max_ = std::min(window_size_, kBlockSize);
+                entropy_ = dictionary_entropy_;
+                window_.assign(dictionary_.begin(), dictionary_.end());
+                checksum_ = Xxh64();
+                consumed_ += length;
+                state_ = kBlock;
+                break;
+            }
+
+            case kBlock: {
+                if (available < 3) return true;
+                uint32_t header = in[0] | in[1] << 8 | in[2] << 16;
+                bool last = header & 1;
+                int type = (header >> 1) & 3;
+                size_t size = header >> 3;
+                size_t stored = type == kBlockRle ? 1 : size;
+                if (type == kBlockReserved || (type == kBlockCompressed ? size > kBlockSize : size > block_max_)) {
+                    error = "corrupt zstd block";
+                    return false;
+                }
+                if (available < 3 + stored) return true;
+
+                size_t before = window_.size();
+                if (type == kBlockRaw) {
+                    window_.insert(window_.end(), in + 3, in + 3 + size);
+                } else if (type == kBlockRle) {
+                    window_.insert(window_.end(), size, in[3]);
+                } else if (!decode_block(in + 3, size, error)) {
+                    return false;
+                }
+
+                size_t produced = window_.size() - before;
+                out.append(reinterpret_cast<const char*>(window_.data() + before), produced);
+                checksum_.update(window_.data() + before, produced);
+                produced_ += produced;
+                if (window_.size() > 2 * window_size_ + kBlockSize) window_.erase(window_.begin(), window_.end() - window_size_);
+                consumed_ += 3 + stored;
+
+                if (last) {
+                    if (has_content_size_ && produced_ != content_size_) {
+                        error = "zstd frame size mismatch";
+                        return false;
+                    }
+                    window_.clear();
+                    window_.shrink_to_fit();
+                    state_ = content_checksum_ ? kChecksum : kMagic;
+                }
+                break;
+            }
+
+            case kChecksum: {
+                if (available < 4) return true;
+                if (read32(in) != static_cast<uint32_t>(checksum_.digest())) {
+                    error = "zstd content checksum mismatch";
+                    return false;
+                }
+                consumed_ += 4;
+                state_ = kMagic;
+                break;
+            }
+
+            case kSkip: {
+                size_t take = std::min(available, skip_);
+                consumed_ += take;
+                skip_ -= take;
+                if (skip_ == 0) state_ = kMagic;
+                if (take == 0 && skip_ > 0) return true;
+                break;
+            }
+        }
+
+        progress = true;
+        return true;
+    }
+
+    bool ZstdDecoder::update(const uint8_t* data, size_t len, std::string& out, std::string& error) {
+        if (consumed_ > 0 && consumed_ * 2 >= input_.size()) {
+            input_.erase(input_.begin(), input_.begin() + consumed_);
+            consumed_ = 0;
+        }
+        input_.insert(input_.end(), data, data + len);
+
+        bool progress = true;
+        while (progress) {
+            if (!step(out, error, progress)) return false;
+        }
+        return true;
+    }
+
+    bool ZstdDecoder::finish(std::string& error) const {
+        if (consumed_ != input_.size() || state_ != kMagic) {
+            error = "truncated zstd frame";
+            return false;
+        }
+        return true;
+    }
+
+    bool is_zstd_frame(const uint8_t* data, size_t len) {
+        return len >= 4 && read32(data) == kFrameMagic;
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include "hash.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lib {
+    // Entropy tables a zstd frame starts with (from its dictionary, if any)
+    // and carries from block to block for the "repeat" modes
+    struct ZstdEntropy {
+        struct Cell {
+            uint16_t base;      // Next state, before adding the bits read
+            uint8_t symbol;
+            uint8_t bits;
+        };
+        struct Fse {
+            std::vector<Cell> cells;        // Empty until a block defines the table
+            int log = 0;
+        };
+
+        std::vector<uint16_t> huffman;      // Symbol << 8 | code length, for every max-length prefix
+        int huffman_log = 0;
+        Fse literal_lengths, offsets, match_lengths;
+        uint32_t reps[3] = {1, 4, 8};
+    };
+
+    // Zstandard frame format (RFC 8878), readable by the zstd tool. Blocks
+    // of up to 128 KB hold Huffman-coded literals and FSE-coded sequences
+    // of (literal length, match length, offset), with the last three
+    // offsets reusable as cheap repeat codes; frames end with an XXH64 of
+    // their content.
+    //
+    // Matches come from hash chains over a window that grows with the
+    // level (512 KB at 1, 4 MB from 10), searched deeper and with lazier
+    // parsing as the level rises: 1-2 are greedy, 3-5 check one position
+    // ahead before committing to a match and 6-19 check two.
+    //
+    // A dictionary is either raw content or one trained by `zstd --train`
+    // (magic 0xEC30A437). Its content is history the first block can
+    // match against; a trained dictionary also supplies the initial repeat
+    // offsets and its ID is recorded in the frame. Anything else, including
+    // a malformed trained dictionary, is used as raw content.
+    class ZstdEncoder {
+    public:
+        static const int kMaxLevel = 19;
+
+        explicit ZstdEncoder(int level = 3, const std::string& dictionary = std::string());
+
+        // Append compressed output for `data` to `out`; a block is written
+        // whenever enough input has been buffered
+        void update(const uint8_t* data, size_t len, std::string& out);
+
+        // Flush the last block and end the frame
+        void finish(std::string& out);
+
+    private:
+        struct Match {
+            size_t length;
+            uint32_t offset;
+            uint32_t offbase;       // Offset as coded: 1-3 repeat codes, else offset + 3
+        };
+
+        int window_log_;
+        size_t depth_;              // Chain entries examined per position
+        int lazy_;                  // Positions looked ahead before taking a match
+        bool started_ = false;
+        uint32_t dictionary_id_ = 0;
+        std::vector<uint8_t> window_;       // History (starting with the dictionary), then the pending block
+        size_t history_ = 0;                // Bytes of window_ that are history
+        size_t inserted_ = 0;               // Bytes of window_ entered into the hash chains
+        uint32_t window_start_ = 0;         // Stream position of window_[0]
+        std::vector<uint32_t> table_;       // Hash -> stream position + 1
+        std::vector<uint32_t> chain_;       // Position -> previous position + 1 with the same hash
+        uint32_t reps_[3] = {1, 4, 8};
+        Xxh64 checksum_;
+
+        Match find_match(size_t ip, size_t anchor, size_t end);
+        void write_block(std::string& out, bool last);
+    };
+
+    // Streaming decoder for zstd frames (and skippable frames), given the
+    // dictionary they were compressed with, if any
+    class ZstdDecoder {
+    public:
+        explicit ZstdDecoder(const std::string& dictionary = std::string());
+
+        // Decode as much of the input seen so far as possible into `out`
+        bool update(const uint8_t* data, size_t len, std::string& out, std::string& error);
+
+        // Check that the input ended on a frame boundary
+        bool finish(std::string& error) const;
+
+    private:
+        enum State { kMagic, kHeader, kBlock, kChecksum, kSkip };
+
+        State state_ = kMagic;
+        std::vector<uint8_t> input_;
+        size_t consumed_ = 0;
+        size_t skip_ = 0;
+        uint32_t dictionary_id_ = 0;
+        std::string dictionary_;            // Dictionary content
+        ZstdEntropy dictionary_entropy_;
+        ZstdEntropy entropy_;
+        bool content_checksum_ = false;
+        bool has_content_size_ = false;
+        uint64_t content_size_ = 0;
+        uint64_t produced_ = 0;
+        size_t window_size_ = 0;
+        size_t block_max_ = 0;
+        std::vector<uint8_t> window_;       // Decoded history, starting with the dictionary
+        std::vector<uint8_t> literals_;
+        Xxh64 checksum_;
+
+        bool step(std::string& out, std::string& error, bool& progress);
+        bool decode_block(const uint8_t* src, size_t len, std::string& error);
+    };
+
+    // True if `data` starts with a zstd frame
+    bool is_zstd_frame(const uint8_t* data, size_t len);
+}
@@ -0,0 +1,183 @@
+// Every command that reads file contents has to see the same bytes whether
+// the file is stored plain or block-compressed: each runs against a plain
+// copy and a compressed copy and the outputs are compared.
+#include "harness.hpp"
+#include "block_file.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+extern "C" {
+    int write_file(const char* path, const char* content);
+    int set_compression(const char* dir, int enabled);
+    uint8_t* fs_snapshot(const char* root, int compress, size_t* out_len);
+    int fs_restore(const uint8_t* buf, size_t len, const char* root);
+}
+
+// Replace each "{}" in `pattern` with `dir`
+static std::string expand(const std::string& pattern, const std::string& dir) {
+    std::string out;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern.compare(i, 2, "{}") == 0) {
+            out += dir;
+            ++i;
+        } else {
+            out += pattern[i];
+        }
+    }
+    return out;
+}
+
+// Output of `pattern` run in `dir`, with `dir` written as "{}" so runs in
+// different directories compare equal
+static std::string run_in(const std::string& pattern, const std::string& dir, int& status) {
+    status = harness::run(expand(pattern, dir));
+    std::string output = harness::take_output() + harness::take_errors();
+    std::string out;
+    for (size_t pos = 0; pos < output.size();) {
+        if (output.compare(pos, dir.size(), dir) == 0) {
+            out += "{}";
+            pos += dir.size();
+        } else {
+            out += output[pos++];
+        }
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <scratch dir>\n", argv[0]);
+        return 2;
+    }
+    const std::string root = argv[1];
+    const std::string plain = root + "/plain";
+    const std::string packed = root + "/packed";
+    harness::scratch(plain);
+    harness::scratch(packed);
+    CHECK(set_compression(packed.c_str(), 1) == 0);
+
+    // Several 64 KB blocks of each, so reads cross block boundaries
+    std::string csv;
+    for (int i = 0; i < 20000; ++i) csv += std::to_string(i) + ",name" + std::to_string(i % 97) + "," + std::to_string(i * 7) + "\n";
+    std::string json = "{\"rows\":[";
+    for (int i = 0; i < 5000; ++i) json += (i ? ",{\"id\":" : "{\"id\":") + std::to_string(i) + ",\"name\":\"item" + std::to_string(i) + "\"}";
+    json += "]}";
+    std::string pairs;
+    for (int i = 0; i < 20000; ++i) pairs += "key" + std::to_string(100000 + i) + "\tvalue" + std::to_string(i % 97) + "\n";
+    for (const std::string& dir : {plain, packed}) {
+        CHECK(write_file((dir + "/data.csv").c_str(), csv.c_str()) == 0);
+        CHECK(write_file((dir + "/doc.json").c_str(), json.c_str()) == 0);
+        CHECK(write_file((dir + "/pairs.tsv").c_str(), pairs.c_str()) == 0);
+        harness::scratch(dir + "/out");
+    }
+    harness::take_output();
+    CHECK(harness::read_raw(packed + "/data.csv").compare(0, 4, "BLKZ") == 0);
+    CHECK(harness::read_raw(packed + "/doc.json").compare(0, 4, "BLKZ") == 0);
+    CHECK(harness::read_raw(packed + "/pairs.tsv").compare(0, 4, "BLKZ") == 0);
+    CHECK(harness::read_raw(plain + "/data.csv") == csv);
+
+    const std::vector<std::string> commands = {
+        "cat {}/doc.json",
+        "head -n 3 {}/data.csv",
+        "tail -n 3 {}/data.csv",
+        "tail -n 5000 {}/data.csv",
+        "sed -n '19990,20000p' {}/data.csv",
+        "cut -d , -f 2 {}/data.csv",
+        "fields -d , 'where $2 == name5 sum $3' {}/data.csv",
+        "csv 'where $1 > 19995 print $2, $3' {}/data.csv",
+        "json .rows[4321].name {}/doc.json",
+        "base64 {}/data.csv",
+        "xxd -s 65500 -l 100 {}/data.csv",
+        "sha256sum {}/data.csv {}/doc.json",
+        "b3sum {}/data.csv",
+        "lz4 {}/data.csv {}/out/data.csv.lz4",
+        "tar -cf {}/out/data.tar -C {} data.csv doc.json",
+        "btree {}/out/pairs.bt load {}/pairs.tsv",
+        "btree {}/out/pairs.bt scan key119990 -n 3",
+    };
+    for (const std::string& command : commands) {
+        int plain_status, packed_status;
+        std::string expected = run_in(command, plain, plain_status);
+        std::string actual = run_in(command, packed, packed_status);
+        if (actual != expected || packed_status != plain_status) {
+            harness::fail(__FILE__, __LINE__, "output differs on a compressed file: " + command);
+        }
+        CHECK(plain_status == 0);
+    }
+
+    // What the commands write follows the directory's policy: compressed
+    // under `packed`, with the same content the plain run produced
+    const std::string out = packed + "/out/";
+    CHECK(harness::run("tar -xf " + out + "data.tar -C " + out) == 0);
+    CHECK(harness::run("lz4 -d " + out + "data.csv.lz4 " + out + "unpacked.csv") == 0);
+    CHECK(harness::run("base64 " + plain + "/data.csv " + plain + "/out/data.b64") == 0);
+    CHECK(harness::run("base64 -d " + plain + "/out/data.b64 " + out + "decoded.csv") == 0);
+    CHECK(harness::run("xxd -p " + plain + "/data.csv " + plain + "/out/data.hex") == 0);
+    CHECK(harness::run("xxd -r -p " + plain + "/out/data.hex " + out + "reversed.csv") == 0);
+    CHECK(harness::run("cp " + plain + "/data.csv " + out + "copied.csv") == 0);
+    size_t image_len = 0;
+    uint8_t* image = fs_snapshot(plain.c_str(), 0, &image_len);
+    CHECK(image != nullptr);
+    CHECK(image && fs_restore(image, image_len, (out + "restored").c_str()) > 0);
+    free(image);
+    harness::take_output();
+    harness::take_errors();
+
+    std::string content, error;
+    for (const char* name : {"data.csv", "unpacked.csv", "decoded.csv", "reversed.csv", "copied.csv", "restored/data.csv"}) {
+        CHECK(harness::read_raw(out + name).compare(0, 4, "BLKZ") == 0);
+        CHECK(lib::load_file(out + name, content, error));
+        CHECK_EQ(content, csv);
+    }
+    CHECK(lib::load_file(out + "doc.json", content, error));
+    CHECK_EQ(content, json);
+    CHECK(lib::load_file(out + "data.csv.lz4", content, error));
+    CHECK_EQ(content, harness::read_raw(plain + "/out/data.csv.lz4"));
+    CHECK(harness::read_raw(plain + "/data.csv") == csv);
+
+    // In-place edits read the content and keep the directory's policy
+    std::string edited = csv;
+    for (size_t pos = 0; (pos = edited.find("name", pos)) != std::string::npos; pos += 4) edited.replace(pos, 4, "NAME");
+    CHECK(harness::run("sed -i s/name/NAME/ " + packed + "/data.csv") == 0);
+    CHECK(lib::load_file(packed + "/data.csv", content, error));
+    CHECK_EQ(content, edited);
+    CHECK(harness::read_raw(packed + "/data.csv").compare(0, 4, "BLKZ") == 0);
+
+    // A compressed file damaged past its first block fails the commands
+    // that read it line by line, and sed -i leaves it as it was
+    std::string damaged = harness::read_raw(packed + "/data.csv");
+    for (size_t i = damaged.size() - 200; i < damaged.size(); ++i) damaged[i] = static_cast<char>(~damaged[i]);
+    harness::write_raw(packed + "/damaged.csv", damaged);
+    for (const char* command : {"sed -n p ", "sed -i s/NAME/name/ ", "cut -d , -f 2 ", "fields -d , 'count' "}) {
+        if (harness::run(command + packed + "/damaged.csv") == 0) {
+            harness::fail(__FILE__, __LINE__, std::string("reads a damaged file to the end: ") + command);
+        }
+    }
+    harness::take_output();
+    CHECK(harness::take_errors().find("damaged.csv") != std::string::npos);
+    CHECK(harness::read_raw(packed + "/damaged.csv") == damaged);
+    CHECK(harness::read_raw(packed + "/damaged.csv.sed.tmp").empty());
+
+    // Headers whose size and block count disagree are refused rather than
+    // read past the index: here the size is near 2^64, where rounding the
+    // block count up would wrap to 0
+    std::string header = "BLKZ";
+    auto put = [&header](uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) header += static_cast<char>(value >> (8 * i));
+    };
+    put(1, 4);
+    put(~0ull, 8);
+    put(65536, 4);
+    put(0, 4);
+    harness::write_raw(plain + "/corrupt", header);
+    lib::BlockReader reader;
+    CHECK(!reader.open(plain + "/corrupt", error));
+    CHECK(error.find("corrupt block index") != std::string::npos);
+    CHECK(harness::run("head -n 1 " + plain + "/corrupt") != 0);
+    harness::take_output();
+    harness::take_errors();
+
+    return harness::finish("block_file_readers");
+}
@@ -0,0 +1,65 @@
+// cp and mv decide "same file" and "into itself" by device and inode, not
+// by how the paths are spelled: copying a file over itself would truncate
+// it to nothing, and copying a tree into itself would never finish.
+#include "harness.hpp"
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static bool exists(const std::string& path) {
+    struct stat st;
+    return lstat(path.c_str(), &st) == 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <scratch dir>\n", argv[0]);
+        return 2;
+    }
+    const std::string root = argv[1];
+    harness::scratch(root);
+    harness::scratch(root + "/d/inner");
+    harness::write_raw(root + "/f", "keep me\n");
+    harness::write_raw(root + "/d/inner/g", "nested\n");
+    CHECK(link((root + "/f").c_str(), (root + "/hard").c_str()) == 0);
+    CHECK(symlink("d", (root + "/alias").c_str()) == 0);
+    CHECK(chdir(root.c_str()) == 0);
+
+    // A file onto itself, however it is named, fails and leaves it whole
+    CHECK(harness::run("cp f ./f") != 0);
+    CHECK(harness::take_errors().find("same file") != std::string::npos);
+    CHECK(harness::run("cp f " + root + "/f") != 0);
+    CHECK(harness::run("cp f hard") != 0);
+    CHECK(harness::run("cp -r d/inner/g d/../d/inner/g") != 0);
+    harness::take_errors();
+    CHECK_EQ(harness::read_raw("f"), "keep me\n");
+    CHECK_EQ(harness::read_raw("d/inner/g"), "nested\n");
+
+    // A tree into itself or below itself fails before creating anything
+    CHECK(harness::run("cp -r d ./d/sub") != 0);
+    CHECK(harness::take_errors().find("into itself") != std::string::npos);
+    CHECK(!exists("d/sub"));
+    CHECK(harness::run("cp -r d alias/inner/sub") != 0);
+    CHECK(!exists("d/inner/sub"));
+    CHECK(harness::run("cp -r d ./d") != 0);
+    CHECK(!exists("d/d"));
+    CHECK(harness::run("mv d ./d/inner/moved") != 0);
+    CHECK(harness::run("mv d alias/inner") != 0);
+    harness::take_errors();
+    CHECK(exists("d/inner/g") && !exists("d/inner/moved") && !exists("d/inner/d"));
+
+    // Moving a file onto another name for itself changes nothing
+    CHECK(harness::run("mv f ./f") == 0);
+    CHECK_EQ(harness::read_raw("f"), "keep me\n");
+
+    // Copies elsewhere still work
+    CHECK(harness::run("cp -r d copy") == 0);
+    CHECK_EQ(harness::read_raw("copy/inner/g"), "nested\n");
+    CHECK(harness::run("cp f copy/f") == 0);
+    CHECK_EQ(harness::read_raw("copy/f"), "keep me\n");
+    CHECK(harness::run("mv copy moved") == 0);
+    CHECK(exists("moved/inner/g") && !exists("copy"));
+
+    return harness::finish("copy_into_itself");
+}
@@ -0,0 +1,35 @@
+// cut keeps field ranges as ranges: a list reaching far past any real
+// field count costs no more memory than a short one, and ranges past the
+// first few thousand fields still select exactly their fields.
+#include "harness.hpp"
+#include <cstdio>
+#include <string>
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <scratch dir>\n", argv[0]);
+        return 2;
+    }
+    const std::string root = argv[1];
+    harness::scratch(root);
+
+    // One line of 6000 fields, "f1,f2,..."
+    std::string line;
+    for (int i = 1; i <= 6000; ++i) line += (i > 1 ? ",f" : "f") + std::to_string(i);
+    harness::write_raw(root + "/wide", line + "\n");
+    harness::write_raw(root + "/short", "a,b,c\n");
+    const std::string wide = " " + root + "/wide";
+
+    CHECK(harness::run("cut -d , -f 1-4000000000 " + root + "/short") == 0);
+    CHECK_EQ(harness::take_output(), "a,b,c\n");
+    CHECK(harness::run("cut -d , -f 2-2147483647" + wide) == 0);
+    CHECK_EQ(harness::take_output(), line.substr(3) + "\n");
+    CHECK(harness::run("cut -d , -f 4095-4097,5999" + wide) == 0);
+    CHECK_EQ(harness::take_output(), "f4095,f4096,f4097,f5999\n");
+    CHECK(harness::run("cut -d , -f 5000-5001,3" + wide) == 0);
+    CHECK_EQ(harness::take_output(), "f3,f5000,f5001\n");
+    CHECK(harness::run("cut -d , -f 3-2 " + root + "/short") != 0);
+
+    harness::take_errors();
+    return harness::finish("cut_ranges");
+}
@@ -0,0 +1,120 @@
+// Removed documents stay counted in document frequencies until their
+// segment is rewritten. The top-k a query returns after removals must
+// still be the one a brute-force BM25 over the live documents gives.
+#include "harness.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+extern "C" {
+    int index_add(const char* key, const char* text, size_t len);
+    int index_remove(const char* key);
+    int index_commit();
+    char* index_query(const char* query, int limit);
+}
+
+static const int kDocs = 400;
+
+struct Doc {
+    std::string key;
+    int tf;         // Occurrences of the query term
+    bool live;
+};
+
+// Every document is kDocs words long and document `i` holds the query term
+// i + 1 times. With lengths equal, BM25 ranks a single-term query by tf
+// whatever the idf and the index-wide average length (other tests index
+// files too), so the brute-force order is simply by tf.
+static std::string text_of(const Doc& doc) {
+    std::string text;
+    for (int i = 0; i < doc.tf; ++i) text += "zqthe ";
+    for (int i = doc.tf; i < kDocs; ++i) text += "filler ";
+    return text;
+}
+
+static std::vector<std::string> brute_force(const std::vector<Doc>& docs, size_t k) {
+    std::vector<const Doc*> live;
+    for (const Doc& doc : docs) {
+        if (doc.live) live.push_back(&doc);
+    }
+    std::sort(live.begin(), live.end(), [](const Doc* a, const Doc* b) { return a->tf > b->tf; });
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < k && i < live.size(); ++i) keys.push_back(live[i]->key);
+    return keys;
+}
+
+static void check_top(const std::vector<Doc>& docs, size_t k) {
+    char* result = index_query("zqthe", static_cast<int>(k));
+    CHECK(result != nullptr);
+    if (!result) return;
+    std::vector<std::string> keys;
+    std::string lines = result;
+    free(result);
+    for (size_t pos = 0; pos < lines.size();) {
+        size_t tab = lines.find('\t', pos);
+        size_t end = lines.find('\n', pos);
+        if (tab == std::string::npos || end == std::string::npos || tab > end) break;
+        CHECK(atof(lines.substr(pos, tab - pos).c_str()) > 0);
+        keys.push_back(lines.substr(tab + 1, end - tab - 1));
+        pos = end + 1;
+    }
+    std::vector<std::string> expected = brute_force(docs, k);
+    CHECK(keys.size() == expected.size());
+    for (size_t i = 0; i < keys.size() && i < expected.size(); ++i) CHECK_EQ(keys[i], expected[i]);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <scratch dir>\n", argv[0]);
+        return 2;
+    }
+    // The index lives under /.bios/fts, which needs write access to /.
+    // Documents an earlier run left behind are removed first.
+    const std::string root = argv[1];
+    std::vector<Doc> docs;
+    for (int i = 0; i < kDocs; ++i) {
+        docs.push_back(Doc{root + "/doc" + std::to_string(i), i + 1, true});
+        index_remove(docs.back().key.c_str());
+    }
+    if (index_commit() != 0) {
+        fprintf(stderr, "fts_ranking: cannot save the index, skipped\n%s", harness::take_errors().c_str());
+        return 77;
+    }
+
+    // 100 documents with the term, then half of them removed: df counts
+    // all 100 while only 50 are live
+    for (int i = 0; i < 100; ++i) {
+        std::string text = text_of(docs[i]);
+        CHECK(index_add(docs[i].key.c_str(), text.c_str(), text.size()) == 0);
+    }
+    CHECK(index_commit() == 0);
+    for (int i = 0; i < 100; i += 2) {
+        CHECK(index_remove(docs[i].key.c_str()) == 0);
+        docs[i].live = false;
+    }
+    docs.resize(100);
+    check_top(docs, 10);
+    check_top(docs, 50);
+
+    // More segments, with removals spread across them
+    for (int i = 100; i < kDocs; ++i) {
+        docs.push_back(Doc{root + "/doc" + std::to_string(i), i + 1, true});
+        std::string text = text_of(docs[i]);
+        CHECK(index_add(docs[i].key.c_str(), text.c_str(), text.size()) == 0);
+    }
+    CHECK(index_commit() == 0);
+    for (int i = 1; i < kDocs; i += 3) {
+        if (!docs[i].live) continue;
+        CHECK(index_remove(docs[i].key.c_str()) == 0);
+        docs[i].live = false;
+    }
+    check_top(docs, 20);
+
+    for (const Doc& doc : docs) {
+        if (doc.live) index_remove(doc.key.c_str());
+    }
+    CHECK(index_commit() == 0);
+    return harness::finish("fts_ranking");
+}
@@ -0,0 +1,102 @@
+#include "harness.hpp"
+#include <emscripten.h>
+#include <emscripten/console.h>
+#include <emscripten/eventloop.h>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+extern "C" int execute(const char* command);
+
+namespace {
+    std::string output;
+    std::string errors;
+    int failures = 0;
+}
+
+// Stand-ins for the Emscripten runtime. Timers never fire: the tests
+// drive anything deferred (journal commits, tail -f polls) through the
+// exports that flush it.
+extern "C" {
+    void emscripten_console_log(const char* text) {
+        output += text;
+        output += '\n';
+    }
+
+    void emscripten_console_warn(const char* text) {
+        emscripten_console_log(text);
+    }
+
+    void emscripten_console_error(const char* text) {
+        errors += text;
+        errors += '\n';
+    }
+
+    double emscripten_get_now(void) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+    }
+
+    int emscripten_set_timeout(void (*)(void*), double, void*) {
+        return 1;
+    }
+
+    int emscripten_set_interval(void (*)(void*), double, void*) {
+        return 1;
+    }
+
+    void emscripten_clear_interval(int) {}
+}
+
+namespace harness {
+    std::string take_output() {
+        std::string taken;
+        taken.swap(output);
+        return taken;
+    }
+
+    std::string take_errors() {
+        std::string taken;
+        taken.swap(errors);
+        return taken;
+    }
+
+    int run(const std::string& line) {
+        return execute(line.c_str());
+    }
+
+    void scratch(const std::string& dir) {
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+    }
+
+    std::string read_raw(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::ostringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    }
+
+    void write_raw(const std::string& path, const std::string& data) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+
+    void fail(const char* file, int line, const std::string& message) {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, message.c_str());
+        if (!errors.empty()) fprintf(stderr, "  console errors:\n%s", errors.c_str());
+        ++failures;
+    }
+
+    int finish(const char* test) {
+        if (failures) {
+            fprintf(stderr, "%s: %d check(s) failed\n", test, failures);
+            return 1;
+        }
+        printf("%s: ok\n", test);
+        return 0;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+
+// Shared by the host-native tests: console output captured from the
+// stubbed Emscripten calls, scratch files, and checks that count failures
+// rather than stop at the first
+namespace harness {
+    // Lines logged or warned since the last call, each ending in "\n"
+    std::string take_output();
+
+    // Lines logged as errors since the last call
+    std::string take_errors();
+
+    // Run `line` through the execute() export, as the shell does
+    int run(const std::string& line);
+
+    // Make `dir` (and its parents) exist and hold nothing
+    void scratch(const std::string& dir);
+
+    // File bytes as stored, without decoding; empty if unreadable
+    std::string read_raw(const std::string& path);
+    void write_raw(const std::string& path, const std::string& data);
+
+    void fail(const char* file, int line, const std::string& message);
+
+    // Exit status for main(): 0 when every check passed
+    int finish(const char* test);
+}
+
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) harness::fail(__FILE__, __LINE__, #condition);           \
+    } while (0)
+
+// Strings compared whole; a mismatch reports where they part
+#define CHECK_EQ(actual, expected)                                                  \
+    do {                                                                            \
+        std::string a_ = (actual), e_ = (expected);                                 \
+        if (a_ != e_) {                                                             \
+            size_t at_ = 0;                                                         \
+            while (at_ < a_.size() && at_ < e_.size() && a_[at_] == e_[at_]) ++at_; \
+            harness::fail(__FILE__, __LINE__, std::string(#actual " != " #expected  \
+                          ", differing at byte ") + std::to_string(at_) + " of " +   \
+                          std::to_string(a_.size()) + " and " + std::to_string(e_.size())); \
+        }                                                                           \
+    } while (0)
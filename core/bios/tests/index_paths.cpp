@@ -0,0 +1,85 @@
+// The indexes kept in step through file_events must match the paths those
+// events carry, which are absolute, however the index was first named: an
+// index built from a relative path still sees later writes and removals,
+// whichever export or command makes them.
+#include "harness.hpp"
+#include "file_io.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+    int write_file(const char* path, const char* content);
+    int delete_file(const char* path);
+    int search_build(const char* root);
+    char* search_query(const char* query, int ignore_case, int files_only);
+    char* line_range(const char* path, size_t start, size_t count, size_t* total_lines);
+}
+
+// Line count of `path` through its saved line index
+static size_t line_count(const std::string& path) {
+    size_t total = 0;
+    free(line_range(path.c_str(), 1, 1, &total));
+    return total;
+}
+
+// Paths of the indexed files holding `query`, one per line
+static std::string query_files(const std::string& query) {
+    char* result = search_query(query.c_str(), 0, 1);
+    std::string files = result ? result : "<no index>";
+    free(result);
+    return files;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <scratch dir>\n", argv[0]);
+        return 2;
+    }
+    const std::string root = argv[1];
+    harness::scratch(root + "/docs");
+    harness::write_raw(root + "/docs/old.txt", "first words\n");
+    if (chdir(root.c_str()) != 0) {
+        fprintf(stderr, "index_paths: cannot enter %s\n", root.c_str());
+        return 1;
+    }
+    char cwd[4096];
+    const std::string docs = std::string(getcwd(cwd, sizeof(cwd)) ? cwd : root.c_str()) + "/docs";
+
+    // A line index opened as "./docs/..." is dropped by a write to the
+    // absolute path, even when the rewrite keeps the size and mtime
+    const std::string lines = docs + "/lines.txt";
+    harness::write_raw(lines, "one\ntwo\nsix\n");
+    struct stat st;
+    CHECK(stat(lines.c_str(), &st) == 0);
+    CHECK(line_count("./docs/lines.txt") == 3);
+    CHECK(write_file(lines.c_str(), "one\n\ntwo\nsix") == 0);
+    lib::set_mtime(lines, static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+    CHECK(line_count("./docs/lines.txt") == 4);
+    CHECK(line_count("docs/lines.txt") == 4);
+
+    // The search index lives under /.bios, which needs write access to /
+    if (search_build("docs") != 0) {
+        fprintf(stderr, "index_paths: cannot build the search index, skipped\n%s", harness::take_errors().c_str());
+        return 77;
+    }
+    CHECK_EQ(query_files("first"), docs + "/old.txt\n");
+    CHECK(write_file((docs + "/new.txt").c_str(), "later words\n") == 0);
+    CHECK_EQ(query_files("later"), docs + "/new.txt\n");
+    CHECK(delete_file((docs + "/old.txt").c_str()) == 0);
+    CHECK_EQ(query_files("first"), "");
+
+    // Commands writing an output file report it too
+    harness::write_raw(root + "/encoded.b64", "ZGVjb2RlZCB0ZXh0Cg==\n");
+    harness::write_raw(root + "/encoded.hex", "68657820746578740a\n");
+    CHECK(harness::run("base64 -d encoded.b64 docs/decoded.txt") == 0);
+    CHECK(harness::run("xxd -r -p encoded.hex docs/hex.txt") == 0);
+    CHECK_EQ(query_files("decoded"), docs + "/decoded.txt\n");
+    CHECK_EQ(query_files("hex text"), docs + "/hex.txt\n");
+
+    harness::take_output();
+    harness::take_errors();
+    return harness::finish("index_paths");
+}
@@ -0,0 +1,92 @@
+// With the journal on, writes wait in its queue; exports that go to the
+// FS directly must apply the queue first, or they read old content and
+// have their own writes overwritten when the older queued write lands.
+#include "harness.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+extern "C" {
+    int write_file(const char* path, const char* content);
+    uint8_t* read_range(const char* path, size_t offset, size_t len, size_t* out_len);
+    char* read_file(const char* path);
+    char* list_directory(const char* path);
+    char* line_range(const char* path, size_t start, size_t count, size_t* total_lines);
+    uint8_t* fs_snapshot(const char* root, int compress, size_t* out_len);
+    int fs_restore(const uint8_t* buf, size_t len, const char* root);
+    int journal_enable(double interval_ms);
+    int journal_disable();
+    int journal_sync();
+    int journal_checkpoint();
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <scratch dir>\n", argv[0]);
+        return 2;
+    }
+    // The log lives at /.bios/journal.log, which needs write access to /.
+    // Enabling replays what an earlier run left, so the scratch directories
+    // are made after it.
+    if (journal_enable(1000) != 0) {
+        fprintf(stderr, "journal_exports: cannot enable the journal, skipped\n%s", harness::take_errors().c_str());
+        return 77;
+    }
+    const std::string root = argv[1];
+    const std::string image_dir = root + "/image";
+    const std::string dest = root + "/dest";
+    harness::scratch(image_dir);
+    harness::scratch(dest);
+
+    harness::write_raw(image_dir + "/a.txt", "restored\n");
+    size_t image_len = 0;
+    uint8_t* image = fs_snapshot(image_dir.c_str(), 0, &image_len);
+    CHECK(image != nullptr);
+
+    // A restore over a path with a queued write wins over the older write
+    CHECK(write_file((dest + "/a.txt").c_str(), "queued\n") == 0);
+    CHECK(harness::read_raw(dest + "/a.txt").empty());
+    CHECK(fs_restore(image, image_len, dest.c_str()) == 1);
+    CHECK(journal_sync() == 0);
+    CHECK_EQ(harness::read_raw(dest + "/a.txt"), "restored\n");
+    free(image);
+
+    // Reads see what is queued
+    CHECK(write_file((dest + "/b.txt").c_str(), "one\ntwo\nthree\n") == 0);
+    size_t len = 0;
+    uint8_t* range = read_range((dest + "/b.txt").c_str(), 4, 3, &len);
+    CHECK(range != nullptr);
+    if (range) CHECK_EQ(std::string(reinterpret_cast<char*>(range), len), "two");
+    free(range);
+
+    CHECK(write_file((dest + "/c.txt").c_str(), "x\ny\n") == 0);
+    size_t total = 0;
+    char* lines = line_range((dest + "/c.txt").c_str(), 2, 1, &total);
+    CHECK(lines != nullptr);
+    if (lines) CHECK_EQ(lines, "y\n");
+    CHECK(total == 2);
+    free(lines);
+
+    CHECK(write_file((dest + "/d.txt").c_str(), "d") == 0);
+    char* listing = list_directory(dest.c_str());
+    CHECK(listing != nullptr);
+    if (listing) CHECK(("\n" + std::string(listing)).find("\nd.txt\n") != std::string::npos);
+    free(listing);
+
+    // A relative and an absolute name for one file share a queue entry, so
+    // the later write is the one that lands
+    CHECK(chdir(dest.c_str()) == 0);
+    CHECK(write_file("jfile", "first") == 0);
+    CHECK(write_file((dest + "/jfile").c_str(), "second") == 0);
+    char* queued = read_file("jfile");
+    CHECK(queued != nullptr);
+    if (queued) CHECK_EQ(queued, "second");
+    free(queued);
+    CHECK(journal_sync() == 0);
+    CHECK_EQ(harness::read_raw(dest + "/jfile"), "second");
+
+    CHECK(journal_checkpoint() == 0);
+    CHECK(journal_disable() == 0);
+    return harness::finish("journal_exports");
+}
@@ -0,0 +1,45 @@
+// Quoted keys in a query path are JSON strings: a quote or bracket escaped
+// inside one does not end it, and escapes are decoded before keys compare.
+#include "harness.hpp"
+#include "json.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const std::string kDocument =
+    R"({"a]b": 1, "say \"hi\"": 2, "tab\there": 3, "café": 4, "plain": {"x": 5}})";
+
+// The values `expr` selects, comma-separated, or "error: " and the message
+static std::string query(const std::string& expr) {
+    lib::JsonDocument document;
+    std::vector<std::string_view> results;
+    std::string error;
+    if (!document.index(kDocument.data(), kDocument.size(), error) || !document.query(expr, results, error)) {
+        return "error: " + error;
+    }
+    std::string out;
+    for (std::string_view result : results) out += (out.empty() ? "" : ",") + std::string(result);
+    return out;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <scratch dir>\n", argv[0]);
+        return 2;
+    }
+
+    CHECK_EQ(query(R"(.["a]b"])"), "1");
+    CHECK_EQ(query(R"(.["say \"hi\""])"), "2");
+    CHECK_EQ(query(R"(."say \"hi\"")"), "2");
+    CHECK_EQ(query(R"(.["tab\there"])"), "3");
+    CHECK_EQ(query(R"(.["café"])"), "4");
+    CHECK_EQ(query(R"(.["caf\u00e9"])"), "4");
+    CHECK_EQ(query(R"(.["plain"].x)"), "5");
+    CHECK_EQ(query(R"(.["plain"]["x"])"), "5");
+
+    CHECK_EQ(query(R"(.["a]b)"), "error: unterminated key");
+    CHECK_EQ(query(R"(.["plain"x])"), "error: unterminated [");
+    CHECK_EQ(query(R"(.["bad \q"])"), "error: invalid escape in key");
+
+    return harness::finish("json_keys");
+}
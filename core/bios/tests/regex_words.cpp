@@ -0,0 +1,57 @@
+// `\b \B \< \>` are zero-width word assertions, in both basic and extended
+// syntax, rather than the letters b and B or the bytes < and >. Like the
+// other zero-width steps, they are followed without recursing, so long
+// programs run on the small wasm stack.
+#include "harness.hpp"
+#include "regex.hpp"
+#include <cstdio>
+#include <string>
+
+// "start-end" of the first match of `pattern` in `text`, or "none"
+static std::string first_match(const std::string& pattern, int flags, const std::string& text) {
+    lib::Regex regex;
+    std::string error;
+    if (!regex.compile(pattern, flags, &error)) return "error: " + error;
+    lib::Regex::Match match;
+    if (!regex.search(text, 0, match)) return "none";
+    return std::to_string(match.start[0]) + "-" + std::to_string(match.end[0]);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <scratch dir>\n", argv[0]);
+        return 2;
+    }
+    const std::string root = argv[1];
+    harness::scratch(root);
+
+    for (int flags : {0, static_cast<int>(lib::Regex::kExtended)}) {
+        CHECK_EQ(first_match("\\bcat\\b", flags, "concat cat_s cat."), "13-16");
+        CHECK_EQ(first_match("\\Bcat", flags, "cat concat"), "7-10");
+        CHECK_EQ(first_match("\\<cat", flags, "bobcat catalog"), "7-10");
+        CHECK_EQ(first_match("cat\\>", flags, "catalog bobcat"), "11-14");
+        CHECK_EQ(first_match("\\bb", flags, "abb b"), "4-5");
+        CHECK_EQ(first_match("\\b", flags, "  x"), "2-2");
+        CHECK_EQ(first_match("\\<", flags, "   "), "none");
+    }
+
+    // Tens of thousands of zero-width steps in a row, with the captures
+    // of the path taken kept
+    std::string text(10, 'a');
+    CHECK_EQ(first_match("(a?{500}){60}b", lib::Regex::kExtended, text + "b"), "0-11");
+    CHECK_EQ(first_match("(a?{500}){60}\\b", lib::Regex::kExtended, text), "0-10");
+    lib::Regex regex;
+    lib::Regex::Match match;
+    CHECK(regex.compile("(a|ab)(c|bcd)(d*)", lib::Regex::kExtended));
+    CHECK(regex.search("abcd", 0, match));
+    CHECK(match.end[1] == 1 && match.start[2] == 1 && match.end[2] == 4 && match.start[3] == 4 && match.end[3] == 4);
+
+    // Through sed, where an empty assertion match must still advance
+    harness::write_raw(root + "/words", "one two_three two four\n");
+    CHECK(harness::run("sed 's/\\</[/g' " + root + "/words") == 0);
+    CHECK_EQ(harness::take_output(), "[one [two_three [two [four\n");
+    CHECK(harness::run("sed -E 's/o\\b/0/g' " + root + "/words") == 0);
+    CHECK_EQ(harness::take_output(), "one two_three tw0 four\n");
+
+    return harness::finish("regex_words");
+}
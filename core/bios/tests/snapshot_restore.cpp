@@ -0,0 +1,128 @@
+// fs_restore must keep every entry under the restore root: an image can
+// make a symlink and then name a file below it, and the root may already
+// hold a symlink where the image expects a directory.
+#include "harness.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+extern "C" {
+    uint8_t* fs_snapshot(const char* root, int compress, size_t* out_len);
+    int fs_restore(const uint8_t* buf, size_t len, const char* root);
+}
+
+namespace {
+    struct Entry {
+        char type;
+        std::string name;
+        std::string data;
+    };
+}
+
+static void put32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) out += static_cast<char>(value >> (8 * i));
+}
+
+static void put64(std::string& out, uint64_t value) {
+    put32(out, static_cast<uint32_t>(value));
+    put32(out, static_cast<uint32_t>(value >> 32));
+}
+
+// An uncompressed image in the layout lib/snapshot.hpp describes
+static std::string image(const std::vector<Entry>& entries) {
+    std::string names, data, out = "FSIM";
+    for (const Entry& entry : entries) names += entry.name;
+    for (const Entry& entry : entries) data += entry.data;
+    put32(out, 1);
+    put32(out, static_cast<uint32_t>(entries.size()));
+    put32(out, static_cast<uint32_t>(names.size()));
+    put64(out, data.size());
+    uint32_t name_offset = 0;
+    uint64_t data_offset = 0;
+    for (const Entry& entry : entries) {
+        out += entry.type;
+        out.append(3, '\0');
+        put32(out, entry.type == 'd' ? 0755 : 0644);
+        put64(out, 0);
+        put32(out, name_offset);
+        put32(out, static_cast<uint32_t>(entry.name.size()));
+        put64(out, data_offset);
+        put64(out, entry.data.size());
+        put64(out, entry.data.size());
+        name_offset += static_cast<uint32_t>(entry.name.size());
+        data_offset += entry.data.size();
+    }
+    return out + names + data;
+}
+
+static int restore(const std::string& bytes, const std::string& root) {
+    return fs_restore(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size(), root.c_str());
+}
+
+static bool exists(const std::string& path) {
+    struct stat st;
+    return lstat(path.c_str(), &st) == 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <scratch dir>\n", argv[0]);
+        return 2;
+    }
+    const std::string root = argv[1];
+    const std::string dest = root + "/dest";
+    const std::string outside = root + "/outside";
+    harness::scratch(root);
+    harness::scratch(dest);
+    harness::scratch(outside);
+
+    // A link made by the image, then a file below it
+    CHECK(restore(image({{'l', "a", outside}, {'f', "a/pwned", "x"}}), dest) == -1);
+    CHECK(harness::take_errors().find("symlink") != std::string::npos);
+    CHECK(!exists(outside + "/pwned"));
+
+    // Deeper, and with a directory entry below the link
+    CHECK(restore(image({{'d', "b", ""}, {'l', "b/c", outside}, {'d', "b/c/d", ""}, {'f', "b/c/d/pwned", "x"}}), dest) == -1);
+    CHECK(!exists(outside + "/d"));
+
+    // A symlink already in the root where the image has a directory
+    CHECK(symlink(outside.c_str(), (dest + "/e").c_str()) == 0);
+    CHECK(restore(image({{'d', "e", ""}, {'f', "e/pwned", "x"}}), dest) == -1);
+    CHECK(restore(image({{'f', "e/pwned", "x"}}), dest) == -1);
+    harness::take_errors();
+    CHECK(!exists(outside + "/pwned"));
+
+    // Links themselves still restore, and a snapshot round-trips
+    CHECK(restore(image({{'d', "g", ""}, {'f', "g/file", "content"}, {'l', "g/link", "file"}}), dest) == 3);
+    CHECK_EQ(harness::read_raw(dest + "/g/link"), "content");
+    size_t len = 0;
+    uint8_t* snapshot = fs_snapshot((dest + "/g").c_str(), 1, &len);
+    CHECK(snapshot != nullptr);
+    harness::scratch(root + "/copy");
+    CHECK(fs_restore(snapshot, len, (root + "/copy").c_str()) == 2);
+    CHECK_EQ(harness::read_raw(root + "/copy/link"), "content");
+    free(snapshot);
+
+    // A compressed entry claiming far more than its data holds is refused
+    // without first allocating the claimed size
+    harness::scratch(root + "/big");
+    harness::write_raw(root + "/big/file", std::string(100000, 'a'));
+    snapshot = fs_snapshot((root + "/big").c_str(), 1, &len);
+    CHECK(snapshot != nullptr && len > 24 + 48);
+    if (snapshot && len > 24 + 48) {
+        CHECK(snapshot[24] == 'f' && (snapshot[25] & 1));
+        std::string claimed;
+        put64(claimed, 1ull << 62);
+        std::copy(claimed.begin(), claimed.end(), snapshot + 24 + 40);
+        CHECK(fs_restore(snapshot, len, (root + "/copy").c_str()) == -1);
+    }
+    free(snapshot);
+    harness::take_errors();
+
+    return harness::finish("snapshot_restore");
+}
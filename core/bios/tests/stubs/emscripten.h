@@ -0,0 +1,5 @@
+#pragma once
+// Host stand-in for the parts of Emscripten the BIOS uses; see harness.cpp
+#define EMSCRIPTEN_KEEPALIVE
+
+extern "C" double emscripten_get_now(void);
@@ -0,0 +1,7 @@
+#pragma once
+
+extern "C" {
+    void emscripten_console_log(const char* text);
+    void emscripten_console_warn(const char* text);
+    void emscripten_console_error(const char* text);
+}
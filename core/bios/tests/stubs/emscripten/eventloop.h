@@ -0,0 +1,7 @@
+#pragma once
+
+extern "C" {
+    int emscripten_set_timeout(void (*callback)(void*), double ms, void* user_data);
+    int emscripten_set_interval(void (*callback)(void*), double ms, void* user_data);
+    void emscripten_clear_interval(int id);
+}
@@ -0,0 +1,186 @@
+// A zip's central directory is trusted for where each member's data is and
+// how big it is; values that point past the archive must be refused when
+// it is opened, before anything is allocated or read for them. Mounted,
+// an archive is read-only to every writer.
+#include "harness.hpp"
+#include "hash.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+extern "C" {
+    int zip_open(const char* path);
+    uint8_t* zip_read(int handle, const char* name, size_t* out_len);
+    int zip_close(int handle);
+    int zip_mount(const char* archive, const char* dir);
+    int set_compression(const char* dir, int enabled);
+    int write_file(const char* path, const char* content);
+    char* read_file(const char* path);
+    int file_exists(const char* path);
+    int delete_file(const char* path);
+    char16_t* read_text(const char* path, size_t* out_len);
+    uint8_t* read_range(const char* path, size_t offset, size_t len, size_t* out_len);
+    char* line_range(const char* path, size_t start, size_t count, size_t* total_lines);
+}
+
+static void put16(std::string& out, uint16_t value) {
+    for (int i = 0; i < 2; ++i) out += static_cast<char>(value >> (8 * i));
+}
+
+static void put32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) out += static_cast<char>(value >> (8 * i));
+}
+
+namespace {
+    // What the central directory says about the one stored member; the
+    // local header always holds the real name and data
+    struct Member {
+        uint32_t compressed_size;
+        uint32_t size;
+        uint32_t offset = 0;
+        uint16_t local_extra = 0;       // Claimed by the local header, not present
+    };
+}
+
+// A zip holding "a.txt" with `data`, described by `member`
+static std::string archive(const std::string& data, const Member& member) {
+    const std::string name = "a.txt";
+    uint32_t crc = lib::crc32(0, reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    std::string out;
+    put32(out, 0x04034b50);
+    put16(out, 20);
+    put16(out, 0);
+    put16(out, 0);
+    put32(out, 0);
+    put32(out, crc);
+    put32(out, static_cast<uint32_t>(data.size()));
+    put32(out, static_cast<uint32_t>(data.size()));
+    put16(out, static_cast<uint16_t>(name.size()));
+    put16(out, member.local_extra);
+    out += name + data;
+
+    uint32_t directory_offset = static_cast<uint32_t>(out.size());
+    put32(out, 0x02014b50);
+    put16(out, 20);
+    put16(out, 20);
+    put16(out, 0);
+    put16(out, 0);
+    put32(out, 0);
+    put32(out, crc);
+    put32(out, member.compressed_size);
+    put32(out, member.size);
+    put16(out, static_cast<uint16_t>(name.size()));
+    put16(out, 0);
+    put16(out, 0);
+    put16(out, 0);
+    put16(out, 0);
+    put32(out, 0);
+    put32(out, member.offset);
+    out += name;
+
+    uint32_t directory_size = static_cast<uint32_t>(out.size()) - directory_offset;
+    put32(out, 0x06054b50);
+    put16(out, 0);
+    put16(out, 0);
+    put16(out, 1);
+    put16(out, 1);
+    put32(out, directory_size);
+    put32(out, directory_offset);
+    put16(out, 0);
+    return out;
+}
+
+// The content of "a.txt" in the zip at `path`, or "<open failed>" or
+// "<read failed>"
+static std::string read_member(const std::string& path) {
+    int handle = zip_open(path.c_str());
+    if (handle < 0) return "<open failed>";
+    size_t len = 0;
+    uint8_t* data = zip_read(handle, "a.txt", &len);
+    zip_close(handle);
+    if (!data) return "<read failed>";
+    std::string content(reinterpret_cast<char*>(data), len);
+    free(data);
+    return content;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <scratch dir>\n", argv[0]);
+        return 2;
+    }
+    const std::string root = argv[1];
+    harness::scratch(root);
+    const std::string path = root + "/test.zip";
+
+    harness::write_raw(path, archive("hello", Member{5, 5}));
+    CHECK_EQ(read_member(path), "hello");
+
+    // Sizes far beyond the archive: near 4 GB, which a 32-bit size_t
+    // would have to allocate, and just one byte too many
+    harness::write_raw(path, archive("hello", Member{0xfffffff0, 0xfffffff0}));
+    CHECK_EQ(read_member(path), "<open failed>");
+    harness::write_raw(path, archive("hello", Member{40, 40}));
+    CHECK_EQ(read_member(path), "<open failed>");
+
+    // A member said to start past the central directory
+    harness::write_raw(path, archive("hello", Member{5, 5, 1000000}));
+    CHECK_EQ(read_member(path), "<open failed>");
+
+    // A local header whose extra field pushes the data past the end
+    harness::write_raw(path, archive("hello", Member{5, 5, 0, 0xffff}));
+    CHECK_EQ(read_member(path), "<read failed>");
+
+    // Writes under a mount point are refused, and the member still reads
+    // from the archive
+    const std::string mount = root + "/mnt";
+    harness::write_raw(path, archive("hello", Member{5, 5}));
+    CHECK(zip_mount(path.c_str(), mount.c_str()) == 0);
+    CHECK(write_file((mount + "/a.txt").c_str(), "changed") != 0);
+    CHECK(write_file((mount + "/b.txt").c_str(), "new") != 0);
+    CHECK(delete_file((mount + "/a.txt").c_str()) != 0);
+    CHECK(harness::run("echo changed > " + mount + "/a.txt") != 0);
+    CHECK(harness::run("rm " + mount + "/a.txt") != 0);
+    harness::write_raw(root + "/c.txt", "copied");
+    CHECK(harness::run("cp " + root + "/c.txt " + mount + "/c.txt") != 0);
+    CHECK(harness::run("mv " + root + "/c.txt " + mount + "/c.txt") != 0);
+    CHECK(harness::read_raw(root + "/c.txt") == "copied");
+    char* content = read_file((mount + "/a.txt").c_str());
+    CHECK(content && std::string(content) == "hello");
+    free(content);
+    CHECK(file_exists((mount + "/b.txt").c_str()) == 0);
+
+    // Every read export sees the member
+    size_t len = 0;
+    char16_t* text = read_text((mount + "/a.txt").c_str(), &len);
+    CHECK(text && len == 5 && text[0] == 'h' && text[4] == 'o');
+    free(text);
+    uint8_t* range = read_range((mount + "/a.txt").c_str(), 1, 3, &len);
+    CHECK(range && std::string(reinterpret_cast<char*>(range), len) == "ell");
+    free(range);
+    size_t total = 0;
+    char* lines = line_range((mount + "/a.txt").c_str(), 1, 1, &total);
+    CHECK(lines && std::string(lines) == "hello" && total == 1);
+    free(lines);
+    CHECK(read_text((mount + "/b.txt").c_str(), &len) == nullptr);
+
+    // An archive copied where compression is on is stored block-compressed,
+    // and still opens and mounts
+    const std::string packed = root + "/packed";
+    const std::string large(200000, 'z');
+    harness::scratch(packed);
+    CHECK(set_compression(packed.c_str(), 1) == 0);
+    harness::write_raw(path, archive(large, Member{200000, 200000}));
+    CHECK(harness::run("cp " + path + " " + packed + "/test.zip") == 0);
+    CHECK(harness::read_raw(packed + "/test.zip").compare(0, 4, "BLKZ") == 0);
+    CHECK(read_member(packed + "/test.zip") == large);
+    CHECK(zip_mount((packed + "/test.zip").c_str(), (root + "/packed_mnt").c_str()) == 0);
+    content = read_file((root + "/packed_mnt/a.txt").c_str());
+    CHECK(content && std::string(content) == large);
+    free(content);
+
+    harness::take_output();
+    harness::take_errors();
+    return harness::finish("zip_bounds");
+}